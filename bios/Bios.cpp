@@ -1,7 +1,19 @@
 #include <iostream>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "Bios.h"
+#include "../util/crc32.h"
 #include "../util/logging.h"
 
+Bios::~Bios() {
+    if (this->data != nullptr) {
+        munmap((void*) this->data, this->range.length);
+    }
+}
+
 uint8_t Bios::load8(const uint32_t &offset) const {
     return this->data[offset];
 }
@@ -16,30 +28,39 @@ uint32_t Bios::load32(const uint32_t& offset) const {
     return b0 | (b1 << 8u) | (b2 << 16u) | (b3 << 24u);
 }
 
-void Bios::readBinary(const char* fname, const uint32_t& fileLen) {
-    // TODO: move to util/filesystem
-    FILE *file;
+void Bios::mapBinary(const char* fname, const uint32_t& fileLen) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        DEBUG("Unable_to_open_BIOS:" << fname);
+        throw std::exception();
+    }
 
-    //Open file
-    file = fopen(fname, "rb");
-    if (!file)
-    {
-        fprintf(stderr, "Unable to open file %s", fname);
-        return;
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size != (off_t) fileLen) {
+        DEBUG("BIOS_must_be_" << std::dec << fileLen << "_bytes:" << fname);
+        close(fd);
+        throw std::exception();
     }
 
-    //Allocate memory
-    data = (unsigned char *) malloc(fileLen+1);
-    if (!data)
-    {
-        fprintf(stderr, "Memory error!");
-        fclose(file);
-        return;
+    // shared and read-only: the pages come straight from the page cache, never copied
+    void* mapped = mmap(nullptr, fileLen, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        DEBUG("Unable_to_map_BIOS:" << fname);
+        throw std::exception();
     }
+    this->data = (const unsigned char*) mapped;
 
-    //Read file contents into buffer
-    fread(data, fileLen, 1, file);
-    DEBUG("BIOS:" << data)
-    fclose(file);
+    this->crc = crc32_checksum(this->data, fileLen);
+    for (const auto& known : KNOWN_BIOSES) {
+        if (known.crc == this->crc) {
+            this->name = known.name;
+        }
+    }
+    if (this->name.empty()) {
+        // might be a modified or bad dump, run it anyway
+        DEBUG("Unknown_BIOS_dump,_CRC32:" << std::hex << this->crc);
+    } else {
+        DEBUG("BIOS:" << this->name);
+    }
 }
-
@@ -4,25 +4,50 @@
 #include <cstdint>
 #include <cstdio>
 #include <fstream>
+#include <string>
 #include "../memory/Range.h"
 
+// BIOS dumps with a known CRC-32
+struct KnownBios {
+    uint32_t crc;
+    const char* name;
+};
+
+const KnownBios KNOWN_BIOSES[] = {
+    {0x3b601fc8, "SCPH-1000 (v1.0 J)"},
+    {0x37157331, "SCPH-1001 (v2.2 U)"},
+    {0xff3eeb8c, "SCPH-5500 (v3.0 J)"},
+    {0x8d8cb7e4, "SCPH-5501 (v3.0 U)"},
+    {0xd786f0b9, "SCPH-5502 (v3.0 E)"},
+    {0x502224b6, "SCPH-7001 (v4.1 U)"},
+    {0x318178bf, "SCPH-7502 (v4.1 E)"},
+};
+
+// The BIOS image, mapped read-only from the file. Every process mapping the same file shares
+// its pages through the page cache, and all machines of a process share one Bios object.
 class Bios {
 public:
     const uint32_t START_ADDRESS = 0x1fc00000;
 
+    // throws if the file can not be mapped or has the wrong size
     Bios(const char *fname, const uint32_t& buffersize) : range(Range(START_ADDRESS, buffersize)) {
-        this->readBinary(fname, buffersize);
+        this->mapBinary(fname, buffersize);
     }
+    ~Bios();
+    Bios(const Bios&) = delete;
+    Bios& operator=(const Bios&) = delete;
 
     uint32_t load32(const uint32_t& offset) const;
 
     Range range;
-    unsigned char *data = nullptr;
+    const unsigned char *data = nullptr;
+    uint32_t crc = 0;
+    std::string name; // of the dump, empty if unknown
 
     uint8_t load8(const uint32_t &offset) const;
 
 private:
-    void readBinary(const char *string, const uint32_t &i);
+    void mapBinary(const char *string, const uint32_t &i);
 };
 
 
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cstring>
+#include "Exe.h"
+#include "../util/logging.h"
+
+// read a 32 bit little endian word from the header
+uint32_t headerWord(const std::string& data, const uint32_t& offset) {
+    auto b0 = (uint32_t) (uint8_t) data[offset + 0];
+    auto b1 = (uint32_t) (uint8_t) data[offset + 1];
+    auto b2 = (uint32_t) (uint8_t) data[offset + 2];
+    auto b3 = (uint32_t) (uint8_t) data[offset + 3];
+
+    return b0 | (b1 << 8u) | (b2 << 16u) | (b3 << 24u);
+}
+
+bool PsxExe::load(const std::string &fname) {
+    if (!file_exists(fname)) {
+        DEBUG("EXE not found:" << fname);
+        return false;
+    }
+
+    auto data = read_file_to_string(fname);
+    if (data.size() < HEADER_SIZE || data.compare(0, 8, "PS-X EXE") != 0) {
+        DEBUG("Invalid_PS-X_EXE_header:" << fname);
+        return false;
+    }
+
+    this->pc = headerWord(data, 0x10);
+    this->gp = headerWord(data, 0x14);
+    this->text_address = headerWord(data, 0x18);
+    auto text_size = headerWord(data, 0x1c);
+    this->bss_address = headerWord(data, 0x28);
+    this->bss_size = headerWord(data, 0x2c);
+    auto sp_base = headerWord(data, 0x30);
+    auto sp_offset = headerWord(data, 0x34);
+    this->sp = sp_base != 0 ? sp_base + sp_offset : 0;
+
+    // some linkers pad the file, others cut the last sector short
+    text_size = std::min<uint32_t>(text_size, (uint32_t) data.size() - HEADER_SIZE);
+    auto text_offset = this->text_address & 0x1fffffffu;
+    if (text_offset + text_size > 2 * 1024 * 1024) {
+        DEBUG("PS-X_EXE_text_does_not_fit_into_RAM:0x" << std::hex << this->text_address << "+0x" << text_size);
+        return false;
+    }
+
+    this->text.assign(data.begin() + HEADER_SIZE, data.begin() + HEADER_SIZE + text_size);
+
+    DEBUG("Loaded_PS-X_EXE:" << fname << "_pc:0x" << std::hex << this->pc << "_text:0x" << this->text_address << "+0x" << text_size);
+    return true;
+}
+
+void PsxExe::copyToRam(Ram *ram) const {
+    auto text_offset = this->text_address & 0x1fffffffu;
+    std::copy(this->text.begin(), this->text.end(), ram->data.begin() + text_offset);
+    ram->markDirty(text_offset, (uint32_t) this->text.size());
+
+    if (this->bss_size != 0) {
+        auto bss_offset = this->bss_address & 0x1fffffffu;
+        auto bss_size = std::min<uint32_t>(this->bss_size, ram->SIZE - std::min(bss_offset, ram->SIZE));
+        std::fill_n(ram->data.begin() + std::min(bss_offset, ram->SIZE), bss_size, 0);
+        ram->markDirty(std::min(bss_offset, ram->SIZE), bss_size);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef PSXEMU_EXE_H
+#define PSXEMU_EXE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../memory/Ram.h"
+
+// once the kernel is initialized, the BIOS jumps to the shell at this address.
+// side-loaded executables replace the shell.
+const uint32_t SHELL_ENTRY_POINT = 0x80030000;
+
+// PS-X EXE executable, as found on CDs and in homebrew
+// http://problemkaputt.de/psx-spx.htm#cdromfileformats
+class PsxExe {
+public:
+    const uint32_t HEADER_SIZE = 0x800;
+
+    // parse the header and read the text section. Returns false if the file is not a valid executable
+    bool load(const std::string& fname);
+    // copy the text section into RAM and clear the BSS
+    void copyToRam(Ram* ram) const;
+
+    uint32_t pc = 0; // initial program counter
+    uint32_t gp = 0; // initial global pointer ($28)
+    uint32_t sp = 0; // initial stack pointer ($29 and $30), 0 keeps the BIOS stack
+    uint32_t text_address = 0; // destination of the text section in RAM
+    uint32_t bss_address = 0;
+    uint32_t bss_size = 0;
+    std::vector<unsigned char> text;
+};
+
+
+#endif //PSXEMU_EXE_H
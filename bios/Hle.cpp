@@ -0,0 +1,306 @@
+#include <cstring>
+#include <cctype>
+#include "Hle.h"
+#include "../util/logging.h"
+
+BiosHle::BiosHle(Ram *ram) {
+    this->ram = ram;
+}
+
+HleFunction* BiosHle::lookup(const uint32_t &table, const uint32_t &number) {
+    for (auto& function : this->functions) {
+        if (function.table == table && function.number == number) {
+            return &function;
+        }
+    }
+    return nullptr;
+}
+
+bool BiosHle::call(const uint32_t &table, const uint32_t regs[32], uint32_t &result) {
+    // function number is passed in $t1
+    auto function = this->lookup(table, regs[9]);
+    if (function == nullptr || !function->enabled) {
+        return false;
+    }
+
+    if (!(this->*(function->operation))(regs, result)) {
+        return false;
+    }
+
+    function->calls++;
+    return true;
+}
+
+bool BiosHle::setEnabled(const std::string &name, bool enabled) {
+    bool found = false;
+    for (auto& function : this->functions) {
+        if (name == function.name) {
+            function.enabled = enabled;
+            found = true;
+        }
+    }
+    return found;
+}
+
+std::vector<std::string> BiosHle::disabledFunctions() const {
+    std::vector<std::string> names;
+    for (const auto& function : this->functions) {
+        if (!function.enabled) {
+            names.emplace_back(function.name);
+        }
+    }
+    return names;
+}
+
+void BiosHle::printStats() const {
+    for (const auto& function : this->functions) {
+        DEBUG("BIOS_HLE:" << std::hex << function.table << "(" << function.number << ")_" << function.name
+              << (function.enabled ? "" : "_(disabled)") << ":_" << std::dec << function.calls << "_calls");
+    }
+}
+
+// translate a pointer passed by the guest into host memory. Returns nullptr if the
+// range is not entirely in RAM, so the call falls back to the BIOS implementation.
+// The range is marked dirty, the caller may write through the pointer
+uint8_t* BiosHle::ramPointer(const uint32_t &address, const uint32_t &length) const {
+    auto offset = address & 0x1fffffffu;
+    if (offset >= this->ram->SIZE || length > this->ram->SIZE - offset) {
+        return nullptr;
+    }
+    this->ram->markDirty(offset, length);
+    return this->ram->data.data() + offset;
+}
+
+// get the length of a zero terminated string in RAM
+bool BiosHle::ramString(const uint32_t &address, uint32_t &length) const {
+    auto start = this->ramPointer(address, 1);
+    if (start == nullptr) {
+        return false;
+    }
+    auto available = this->ram->SIZE - (address & 0x1fffffffu);
+    auto end = (const uint8_t*) memchr(start, 0, available);
+    if (end == nullptr) {
+        return false;
+    }
+    length = (uint32_t) (end - start);
+    return true;
+}
+
+// A(17h): strcmp(str1, str2)
+bool BiosHle::hleStrcmp(const uint32_t regs[32], uint32_t &result) {
+    auto a = regs[4], b = regs[5];
+    if (a == 0 || b == 0) {
+        result = (a == 0 && b == 0) ? 0 : (a == 0 ? (uint32_t) -1 : 1);
+        return true;
+    }
+
+    uint32_t len_a, len_b;
+    if (!this->ramString(a, len_a) || !this->ramString(b, len_b)) {
+        return false;
+    }
+    auto sa = this->ramPointer(a, len_a + 1);
+    auto sb = this->ramPointer(b, len_b + 1);
+
+    uint32_t i = 0;
+    while (sa[i] == sb[i] && sa[i] != 0) {
+        i++;
+    }
+    result = (uint32_t) ((int32_t) sa[i] - (int32_t) sb[i]);
+    return true;
+}
+
+// A(18h): strncmp(str1, str2, maxlen)
+bool BiosHle::hleStrncmp(const uint32_t regs[32], uint32_t &result) {
+    auto a = regs[4], b = regs[5];
+    auto maxlen = (int32_t) regs[6];
+    if (a == 0 || b == 0) {
+        result = (a == 0 && b == 0) ? 0 : (a == 0 ? (uint32_t) -1 : 1);
+        return true;
+    }
+
+    uint32_t len_a, len_b;
+    if (!this->ramString(a, len_a) || !this->ramString(b, len_b)) {
+        return false;
+    }
+    auto sa = this->ramPointer(a, len_a + 1);
+    auto sb = this->ramPointer(b, len_b + 1);
+
+    result = 0;
+    for (int32_t i = 0; i < maxlen; i++) {
+        if (sa[i] != sb[i] || sa[i] == 0) {
+            result = (uint32_t) ((int32_t) sa[i] - (int32_t) sb[i]);
+            break;
+        }
+    }
+    return true;
+}
+
+// A(19h): strcpy(dst, src)
+bool BiosHle::hleStrcpy(const uint32_t regs[32], uint32_t &result) {
+    auto dst = regs[4], src = regs[5];
+    if (dst == 0 || src == 0) {
+        result = 0;
+        return true;
+    }
+
+    uint32_t len;
+    if (!this->ramString(src, len)) {
+        return false;
+    }
+    auto d = this->ramPointer(dst, len + 1);
+    if (d == nullptr) {
+        return false;
+    }
+    memmove(d, this->ramPointer(src, len + 1), len + 1);
+    result = dst;
+    return true;
+}
+
+// A(1Bh): strlen(src)
+bool BiosHle::hleStrlen(const uint32_t regs[32], uint32_t &result) {
+    if (regs[4] == 0) {
+        result = 0;
+        return true;
+    }
+    return this->ramString(regs[4], result);
+}
+
+// A(25h): toupper(char)
+bool BiosHle::hleToupper(const uint32_t regs[32], uint32_t &result) {
+    result = (uint32_t) toupper((uint8_t) regs[4]);
+    return true;
+}
+
+// A(26h): tolower(char)
+bool BiosHle::hleTolower(const uint32_t regs[32], uint32_t &result) {
+    result = (uint32_t) tolower((uint8_t) regs[4]);
+    return true;
+}
+
+// A(28h): bzero(dst, len)
+bool BiosHle::hleBzero(const uint32_t regs[32], uint32_t &result) {
+    auto dst = regs[4];
+    auto len = (int32_t) regs[5];
+    if (dst == 0 || len <= 0) {
+        result = 0;
+        return true;
+    }
+
+    auto d = this->ramPointer(dst, (uint32_t) len);
+    if (d == nullptr) {
+        return false;
+    }
+    memset(d, 0, (size_t) len);
+    result = dst;
+    return true;
+}
+
+// A(2Ah): memcpy(dst, src, len)
+bool BiosHle::hleMemcpy(const uint32_t regs[32], uint32_t &result) {
+    auto dst = regs[4], src = regs[5];
+    auto len = (int32_t) regs[6];
+    if (dst == 0 || len <= 0) {
+        result = dst;
+        return true;
+    }
+
+    auto d = this->ramPointer(dst, (uint32_t) len);
+    auto s = this->ramPointer(src, (uint32_t) len);
+    if (d == nullptr || s == nullptr) {
+        return false;
+    }
+    // the BIOS copies forwards byte by byte, memmove gives the same result unless the ranges overlap
+    if (d > s && d < s + len) {
+        for (int32_t i = 0; i < len; i++) {
+            d[i] = s[i];
+        }
+    } else {
+        memmove(d, s, (size_t) len);
+    }
+    result = dst;
+    return true;
+}
+
+// A(2Bh): memset(dst, fillbyte, len)
+bool BiosHle::hleMemset(const uint32_t regs[32], uint32_t &result) {
+    auto dst = regs[4];
+    auto len = (int32_t) regs[6];
+    if (dst == 0 || len <= 0) {
+        result = dst;
+        return true;
+    }
+
+    auto d = this->ramPointer(dst, (uint32_t) len);
+    if (d == nullptr) {
+        return false;
+    }
+    memset(d, (uint8_t) regs[5], (size_t) len);
+    result = dst;
+    return true;
+}
+
+// A(2Ch): memmove(dst, src, len)
+bool BiosHle::hleMemmove(const uint32_t regs[32], uint32_t &result) {
+    auto dst = regs[4], src = regs[5];
+    auto len = (int32_t) regs[6];
+    if (dst == 0 || len <= 0) {
+        result = dst;
+        return true;
+    }
+
+    auto d = this->ramPointer(dst, (uint32_t) len);
+    auto s = this->ramPointer(src, (uint32_t) len);
+    if (d == nullptr || s == nullptr) {
+        return false;
+    }
+    memmove(d, s, (size_t) len);
+    result = dst;
+    return true;
+}
+
+// A(2Dh): memcmp(src1, src2, len)
+bool BiosHle::hleMemcmp(const uint32_t regs[32], uint32_t &result) {
+    auto len = (int32_t) regs[6];
+    if (regs[4] == 0 || regs[5] == 0 || len <= 0) {
+        result = 0;
+        return true;
+    }
+
+    auto a = this->ramPointer(regs[4], (uint32_t) len);
+    auto b = this->ramPointer(regs[5], (uint32_t) len);
+    if (a == nullptr || b == nullptr) {
+        return false;
+    }
+    result = 0;
+    for (int32_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            result = (uint32_t) ((int32_t) a[i] - (int32_t) b[i]);
+            break;
+        }
+    }
+    return true;
+}
+
+// A(2Fh): rand(), same linear congruential generator as the BIOS
+bool BiosHle::hleRand(const uint32_t /* regs */[32], uint32_t &result) {
+    this->rand_seed = this->rand_seed * 0x41c64e6du + 0x3039u;
+    result = (this->rand_seed >> 16u) & 0x7fffu;
+    return true;
+}
+
+// A(30h): srand(seed)
+bool BiosHle::hleSrand(const uint32_t regs[32], uint32_t &result) {
+    this->rand_seed = regs[4];
+    result = 0;
+    return true;
+}
+
+// A(3Ch)/B(3Dh): std_out_putchar(char), print to the host terminal
+bool BiosHle::hlePutchar(const uint32_t regs[32], uint32_t &result) {
+    std::cout << (char) regs[4];
+    if ((char) regs[4] == '\n') {
+        std::cout.flush();
+    }
+    result = regs[4];
+    return true;
+}
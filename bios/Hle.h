@@ -0,0 +1,84 @@
+#ifndef PSXEMU_HLE_H
+#define PSXEMU_HLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../memory/Ram.h"
+
+class BiosHle;
+// returns false if the call can not be handled natively, e.g. when a pointer is outside of RAM
+typedef bool (BiosHle::*Hle_operation)(const uint32_t regs[32], uint32_t& result);
+
+struct HleFunction {
+    uint32_t table; // 0xa0, 0xb0 or 0xc0
+    uint32_t number; // function number, passed in $t1
+    const char* name;
+    Hle_operation operation;
+    bool enabled;
+    uint64_t calls; // number of calls handled natively
+};
+
+// High level emulation of the BIOS kernel functions reached through the A0/B0/C0 jump tables.
+// http://problemkaputt.de/psx-spx.htm#biosfunctionsummary
+class BiosHle {
+public:
+    explicit BiosHle(Ram* ram);
+
+    // Handle a call to the kernel table at 'table' (0xa0, 0xb0, 0xc0). Returns false
+    // if the function is not implemented or disabled, in which case the BIOS code is interpreted.
+    bool call(const uint32_t& table, const uint32_t regs[32], uint32_t& result);
+
+    // enable or disable a function by name, returns false if there is no such function
+    bool setEnabled(const std::string& name, bool enabled);
+    // names of the functions kept interpreted
+    std::vector<std::string> disabledFunctions() const;
+    void printStats() const;
+
+    uint32_t rand_seed = 0; // state of the native rand(), saved with the CPU
+
+private:
+    Ram* ram;
+
+    HleFunction* lookup(const uint32_t& table, const uint32_t& number);
+
+    uint8_t* ramPointer(const uint32_t& address, const uint32_t& length) const;
+    bool ramString(const uint32_t& address, uint32_t& length) const;
+
+    bool hleStrcmp(const uint32_t regs[32], uint32_t& result);
+    bool hleStrncmp(const uint32_t regs[32], uint32_t& result);
+    bool hleStrcpy(const uint32_t regs[32], uint32_t& result);
+    bool hleStrlen(const uint32_t regs[32], uint32_t& result);
+    bool hleToupper(const uint32_t regs[32], uint32_t& result);
+    bool hleTolower(const uint32_t regs[32], uint32_t& result);
+    bool hleBzero(const uint32_t regs[32], uint32_t& result);
+    bool hleMemcpy(const uint32_t regs[32], uint32_t& result);
+    bool hleMemset(const uint32_t regs[32], uint32_t& result);
+    bool hleMemmove(const uint32_t regs[32], uint32_t& result);
+    bool hleMemcmp(const uint32_t regs[32], uint32_t& result);
+    bool hleRand(const uint32_t regs[32], uint32_t& result);
+    bool hleSrand(const uint32_t regs[32], uint32_t& result);
+    bool hlePutchar(const uint32_t regs[32], uint32_t& result);
+
+    HleFunction functions[15] = {
+        {0xa0, 0x17, "strcmp", &BiosHle::hleStrcmp, true, 0},
+        {0xa0, 0x18, "strncmp", &BiosHle::hleStrncmp, true, 0},
+        {0xa0, 0x19, "strcpy", &BiosHle::hleStrcpy, true, 0},
+        {0xa0, 0x1b, "strlen", &BiosHle::hleStrlen, true, 0},
+        {0xa0, 0x25, "toupper", &BiosHle::hleToupper, true, 0},
+        {0xa0, 0x26, "tolower", &BiosHle::hleTolower, true, 0},
+        {0xa0, 0x28, "bzero", &BiosHle::hleBzero, true, 0},
+        {0xa0, 0x2a, "memcpy", &BiosHle::hleMemcpy, true, 0},
+        {0xa0, 0x2b, "memset", &BiosHle::hleMemset, true, 0},
+        {0xa0, 0x2c, "memmove", &BiosHle::hleMemmove, true, 0},
+        {0xa0, 0x2d, "memcmp", &BiosHle::hleMemcmp, true, 0},
+        // the HLE seed is not shared with the BIOS, so rand and srand should be toggled together
+        {0xa0, 0x2f, "rand", &BiosHle::hleRand, true, 0},
+        {0xa0, 0x30, "srand", &BiosHle::hleSrand, true, 0},
+        {0xa0, 0x3c, "putchar", &BiosHle::hlePutchar, true, 0},
+        {0xb0, 0x3d, "putchar", &BiosHle::hlePutchar, true, 0},
+    };
+};
+
+
+#endif //PSXEMU_HLE_H
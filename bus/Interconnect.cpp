@@ -1,6 +1,8 @@
 #include "Interconnect.h"
 #include "../memory/MemoryMap.h"
 #include "../util/logging.h"
+#include "../state/Savestate.h"
+#include <algorithm>
 
 // Load 32 bit from the appropriate peripehral, by checking
 // if it is in range of the memory and calculating the offset
@@ -26,8 +28,8 @@ uint32_t Interconnect::load32(const uint32_t &address)
     }
     if (IRQ_CONTROL.contains(absAddr))
     {
-        DEBUG("STUB:IRQ_control_read:_0x" << std::hex << absAddr);
-        return 0; // we do not have interrupts for now so just return 0
+        uint32_t offset = (absAddr - IRQ_CONTROL.start);
+        return offset == 0 ? this->irq->getStatus() : this->irq->getMask();
     }
     if (DMA.contains(absAddr))
     {
@@ -98,25 +100,13 @@ uint32_t Interconnect::load32(const uint32_t &address)
     {
         return 0xffffffff; // no expansion connected, so all ones
     }
+    if (MDEC.contains(absAddr))
+    {
+        return this->mdec->load(absAddr - MDEC.start);
+    }
     if (TIMERS.contains(absAddr))
     {
-        uint32_t offset = (absAddr - TIMERS.start);
-        switch (offset)
-        {
-        case 0:
-            // TODO: this should not be written to (yet)
-            DEBUG("STUB:Unhandled_load32_from_Timer0:_0x" << absAddr);
-            return 0;
-            break;
-        case 16:
-            DEBUG("STUB:Unhandled_load32_from_Timer1:_0x" << absAddr);
-            return 0;
-            break;
-        case 32:
-            DEBUG("STUB:Unhandled_load32_from_Timer2:_0x" << absAddr);
-            return 0;
-            break;
-        }
+        return this->timers->load(absAddr - TIMERS.start);
     }
     if (this->spu->range.contains(absAddr))
     {
@@ -176,7 +166,15 @@ void Interconnect::store32(const uint32_t &address, const uint32_t &value)
     }
     if (IRQ_CONTROL.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_write_to_IRQ_CONTROL_register:0x" << std::hex << value);
+        uint32_t offset = (absAddr - IRQ_CONTROL.start);
+        if (offset == 0)
+        {
+            this->irq->acknowledge(value);
+        }
+        else
+        {
+            this->irq->setMask(value);
+        }
         return;
     }
     if (DMA.contains(absAddr))
@@ -219,8 +217,15 @@ void Interconnect::store32(const uint32_t &address, const uint32_t &value)
                 return this->dma->setControl(value);
                 break;
             case 4:
-                return this->dma->setInterrupt(value);
-                break;
+            {
+                bool irqBefore = this->dma->irq();
+                this->dma->setInterrupt(value);
+                if (!irqBefore && this->dma->irq())
+                {
+                    this->irq->request(IrqDma);
+                }
+                return;
+            }
             default:
                 DEBUG("STUB:Unhandled_write_to_DMA_register:0x" << std::hex << absAddr);
                 throw std::exception();
@@ -252,7 +257,12 @@ void Interconnect::store32(const uint32_t &address, const uint32_t &value)
     }
     if (TIMERS.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_write_to_TIMER_register:0x" << std::hex << absAddr);
+        this->timers->store(absAddr - TIMERS.start, value);
+        return;
+    }
+    if (MDEC.contains(absAddr))
+    {
+        this->mdec->store(absAddr - MDEC.start, value);
         return;
     }
     if (this->ram->range.contains(absAddr))
@@ -286,7 +296,7 @@ void Interconnect::store8(const uint32_t &address, const uint8_t &value)
     }
     if (CDROM_STATUS.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_write_to_CDROM_STATUS_register:0x" << std::hex << value);
+        this->cdrom->store(absAddr - CDROM_STATUS.start, value);
         return;
     }
 
@@ -307,6 +317,10 @@ uint8_t Interconnect::load8(const uint32_t &address)
     {
         return 0xff; // no expansion implemented, default returns all ones
     }
+    if (CDROM_STATUS.contains(absAddr))
+    {
+        return this->cdrom->load(absAddr - CDROM_STATUS.start);
+    }
     if (this->ram->range.contains(absAddr))
     {
         uint32_t offset = (absAddr - this->ram->range.start);
@@ -327,8 +341,12 @@ uint16_t Interconnect::load16(uint32_t address)
     }
     if (IRQ_CONTROL.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_read_from_IRQ_CONTROL_register:0x" << std::hex << absAddr);
-        return 0;
+        uint32_t offset = (absAddr - IRQ_CONTROL.start);
+        return (uint16_t) (offset == 0 ? this->irq->getStatus() : this->irq->getMask());
+    }
+    if (TIMERS.contains(absAddr))
+    {
+        return (uint16_t) this->timers->load(absAddr - TIMERS.start);
     }
     if (this->ram->range.contains(absAddr))
     {
@@ -357,12 +375,20 @@ void Interconnect::store16(const uint32_t &address, const uint16_t &value)
     }
     if (TIMERS.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_write_to_TIMER_register:0x" << std::hex << value);
+        this->timers->store(absAddr - TIMERS.start, value);
         return;
     }
     if (IRQ_CONTROL.contains(absAddr))
     {
-        DEBUG("STUB:Unhandled_write_to_IRQ_CONTROL_register:0x" << std::hex << value);
+        uint32_t offset = (absAddr - IRQ_CONTROL.start);
+        if (offset == 0)
+        {
+            this->irq->acknowledge(value);
+        }
+        else
+        {
+            this->irq->setMask(value);
+        }
         return;
     }
     if (this->ram->range.contains(absAddr))
@@ -375,12 +401,23 @@ void Interconnect::store16(const uint32_t &address, const uint16_t &value)
     throw std::exception();
 }
 
-uint32_t Interconnect::maskRegion(const uint32_t &address)
+uint32_t Interconnect::maskRegion(const uint32_t &address) const
 {
     auto index = (uint8_t)(address >> 29u);
     return address & REGION_MASK[index];
 }
 
+bool Interconnect::changesBetweenEvents(const uint32_t &address) const
+{
+    auto absAddr = this->maskRegion(address);
+    // RAM and the BIOS, the common case
+    if (absAddr < TIMERS.start)
+    {
+        return false;
+    }
+    return TIMERS.contains(absAddr) || this->spu->range.contains(absAddr);
+}
+
 void Interconnect::doDma(const Port &port)
 {
     // DMA Transfer to/from RAM
@@ -408,6 +445,29 @@ void Interconnect::doDmaBlock(const Port &port)
     // transfer size in words
     uint32_t transferSize = channel->getTransferSize();
 
+    if (port == MdecIn || port == MdecOut)
+    {
+        // the output channel waits for the input to be decoded
+        if (!this->doDmaMdec(port, channel, transferSize))
+        {
+            return;
+        }
+        this->dmaDone(port);
+        if (port == MdecIn && this->dma->getChannel(MdecOut)->isActive())
+        {
+            this->doDma(MdecOut);
+        }
+        return;
+    }
+
+    if (port == Spu && channel->getStepMode() == Increment)
+    {
+        // sample uploads are hundreds of KiB, they are copied in bulk
+        this->doDmaSpu(channel, transferSize * 4);
+        this->dmaDone(port);
+        return;
+    }
+
     while (transferSize > 0)
     {
         // mask addr to ignore the two LSBs
@@ -423,6 +483,9 @@ void Interconnect::doDmaBlock(const Port &port)
             case Gpu_port:
                 this->gpu->gp0(srcWord);
                 break;
+            case Spu:
+                this->spu->dma_write((const uint8_t*)&srcWord, 4);
+                break;
             default:
                 DEBUG("Unhandled_FROM_RAM_dma_direction");
                 throw std::exception();
@@ -432,6 +495,12 @@ void Interconnect::doDmaBlock(const Port &port)
         case ToRam:
             switch (port)
             {
+            case CdRom:
+                srcWord = this->cdrom->dma_read();
+                break;
+            case Spu:
+                this->spu->dma_read((uint8_t*)&srcWord, 4);
+                break;
             case Otc:
                 // Clear ordering table
                 if (transferSize == 1)
@@ -459,7 +528,57 @@ void Interconnect::doDmaBlock(const Port &port)
         transferSize -= 1;
     }
 
-    channel->done();
+    this->dmaDone(port);
+}
+
+// Copy a block between RAM and sound RAM at once. The RAM address wraps at the end of RAM
+void Interconnect::doDmaSpu(Channel *channel, const uint32_t &size)
+{
+    uint32_t addr = channel->base & 0x1ffffc;
+    uint32_t done = 0;
+    while (done < size)
+    {
+        uint32_t n = std::min(size - done, this->ram->SIZE - addr);
+        if (channel->direction == FromRam)
+        {
+            this->spu->dma_write(&this->ram->data[addr], n);
+        }
+        else
+        {
+            this->spu->dma_read(&this->ram->data[addr], n);
+            this->ram->markDirty(addr, n);
+        }
+        addr = (addr + n) & 0x1ffffc;
+        done += n;
+    }
+}
+
+// Feed or drain the MDEC in one go. Output transfers stay pending, returning false, until enough
+// macroblocks are decoded
+bool Interconnect::doDmaMdec(const Port &port, Channel *channel, const uint32_t &size)
+{
+    if (port == MdecOut && !this->mdec->output_ready(size))
+    {
+        return false;
+    }
+    uint32_t addr = channel->base & 0x1ffffc;
+    uint32_t done = 0;
+    while (done < size)
+    {
+        uint32_t n = std::min(size - done, (this->ram->SIZE - addr) / 4);
+        if (port == MdecIn)
+        {
+            this->mdec->dma_write(&this->ram->data[addr], n);
+        }
+        else
+        {
+            this->mdec->dma_read(&this->ram->data[addr], n);
+            this->ram->markDirty(addr, n * 4);
+        }
+        addr = (addr + n * 4) & 0x1ffffc;
+        done += n;
+    }
+    return true;
 }
 
 // Emulate DMA transfer for linked list synchronization mode
@@ -512,5 +631,31 @@ void Interconnect::doDmaLinkedList(const Port &port)
         addr = header & 0x1ffffc;
     }
 
-    channel->done();
-}
\ No newline at end of file
+    this->dmaDone(port);
+}
+
+// Mark the channel transfer as completed and raise the DMA interrupt on a rising edge of the DMA IRQ line
+void Interconnect::dmaDone(const Port &port)
+{
+    bool irqBefore = this->dma->irq();
+
+    this->dma->getChannel(port)->done();
+    this->dma->channelDone(port);
+
+    if (!irqBefore && this->dma->irq())
+    {
+        this->irq->request(IrqDma);
+    }
+}
+
+void Interconnect::serialize(Savestate &state) {
+    this->scheduler->serialize(state);
+    this->irq->serialize(state);
+    this->ram->serialize(state);
+    this->dma->serialize(state);
+    this->gpu->serialize(state);
+    this->spu->serialize(state);
+    this->timers->serialize(state);
+    this->cdrom->serialize(state);
+    this->mdec->serialize(state);
+}
@@ -6,6 +6,11 @@
 #include "../memory/Dma.h"
 #include "../gpu/Gpu.h"
 #include "../spu/Spu.h"
+#include "Scheduler.h"
+#include "Irq.h"
+#include "../timer/Timers.h"
+#include "../cdrom/CdRom.h"
+#include "../mdec/Mdec.h"
 
 // KUSEG, KSEG etc. all refer to the same address space, so convert them to real addresses,
 // by masking their region bits.
@@ -28,13 +33,23 @@ public:
     Dma *dma;
     Gpu* gpu;
     Spunit* spu;
+    Scheduler* scheduler;
+    InterruptController* irq;
+    Timers* timers;
+    CdRomController* cdrom;
+    Mdec* mdec;
 
-    Interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu, Spunit* spu) {
+    Interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu, Spunit* spu, Scheduler* scheduler, InterruptController* irq, Timers* timers, CdRomController* cdrom, Mdec* mdec) {
         this->bios = bios;
         this->ram = ram;
         this->dma = dma;
         this->gpu = gpu;
         this->spu = spu;
+        this->scheduler = scheduler;
+        this->irq = irq;
+        this->timers = timers;
+        this->cdrom = cdrom;
+        this->mdec = mdec;
     };
 
     uint32_t load32(const uint32_t& address);
@@ -46,12 +61,22 @@ public:
 
     uint16_t load16(uint32_t address);
 
+    // everything behind the bus except the BIOS, which is read only
+    void serialize(Savestate& state);
+
+    // The timer registers move with the cycle count and the SPU catches up when it is read, so
+    // these change without a scheduled event. A loop polling them is never idle.
+    bool changesBetweenEvents(const uint32_t& address) const;
+
 private:
-    uint32_t maskRegion(const uint32_t& address);
+    uint32_t maskRegion(const uint32_t& address) const;
 
     void doDma(const Port &port);
     void doDmaBlock(const Port &port);
     void doDmaLinkedList(const Port &port);
+    void doDmaSpu(Channel *channel, const uint32_t &size);
+    bool doDmaMdec(const Port &port, Channel *channel, const uint32_t &size);
+    void dmaDone(const Port &port);
 };
 
 
@@ -0,0 +1,31 @@
+#include "Irq.h"
+#include "../state/Savestate.h"
+
+// the CPU only looks at the interrupt line between two scheduler slices,
+// so end the current slice whenever the line may have been raised
+void InterruptController::notify() {
+    if (this->pending()) {
+        this->scheduler->schedule(InterruptCheckEvent, 0);
+    }
+}
+
+void InterruptController::request(const IrqSource &source) {
+    this->status |= (uint16_t) (1u << source);
+    this->notify();
+}
+
+// writing 0 to a bit of I_STAT acknowledges it, writing 1 leaves it unchanged
+void InterruptController::acknowledge(const uint32_t &value) {
+    this->status &= (uint16_t) value;
+}
+
+void InterruptController::setMask(const uint32_t &value) {
+    this->mask = (uint16_t) (value & 0x7ffu);
+    this->notify();
+}
+
+void InterruptController::serialize(Savestate &state) {
+    state.section("IRQ ");
+    state.value(this->status);
+    state.value(this->mask);
+}
@@ -0,0 +1,53 @@
+#ifndef PSXEMU_IRQ_H
+#define PSXEMU_IRQ_H
+
+#include <cstdint>
+#include "Scheduler.h"
+
+class Savestate;
+
+// Interrupt sources, bit positions in I_STAT and I_MASK
+enum IrqSource {
+    IrqVBlank = 0,
+    IrqGpu = 1,
+    IrqCdRom = 2,
+    IrqDma = 3,
+    IrqTimer0 = 4,
+    IrqTimer1 = 5,
+    IrqTimer2 = 6,
+    IrqController = 7, // controller and memory card byte received
+    IrqSio = 8,
+    IrqSpu = 9,
+    IrqLightpen = 10,
+};
+
+// Interrupt controller at 0x1f801070: latches interrupt requests of the peripherals in I_STAT,
+// its output (I_STAT & I_MASK) is connected to bit 10 of the CPU cause register.
+// http://problemkaputt.de/psx-spx.htm#interrupts
+class InterruptController {
+public:
+    explicit InterruptController(Scheduler* scheduler) {
+        this->scheduler = scheduler;
+    }
+
+    void request(const IrqSource& source);
+    // true if an unmasked interrupt is pending
+    bool pending() const { return (this->status & this->mask) != 0; }
+
+    uint32_t getStatus() const { return this->status; }
+    void acknowledge(const uint32_t& value);
+    uint32_t getMask() const { return this->mask; }
+    void setMask(const uint32_t& value);
+    void serialize(Savestate& state);
+
+    uint16_t status = 0; // I_STAT
+    uint16_t mask = 0; // I_MASK
+
+private:
+    Scheduler* scheduler;
+
+    void notify();
+};
+
+
+#endif //PSXEMU_IRQ_H
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include "Scheduler.h"
+#include "../state/Savestate.h"
+#include "../util/logging.h"
+
+Scheduler::Scheduler() {
+    std::fill(std::begin(this->deadlines), std::end(this->deadlines), NEVER);
+}
+
+void Scheduler::setHandler(const EventType &event, EventHandler handler) {
+    this->handlers[event] = std::move(handler);
+}
+
+void Scheduler::schedule(const EventType &event, const uint64_t &delay) {
+    auto previous = this->deadlines[event];
+    this->deadlines[event] = this->cycles + delay;
+    if (previous == this->next_deadline) {
+        // the event may have been the earliest one and moved later
+        this->updateNextDeadline();
+    } else {
+        this->next_deadline = std::min(this->next_deadline, this->deadlines[event]);
+    }
+}
+
+void Scheduler::cancel(const EventType &event) {
+    this->deadlines[event] = NEVER;
+    this->updateNextDeadline();
+}
+
+void Scheduler::updateNextDeadline() {
+    this->next_deadline = *std::min_element(std::begin(this->deadlines), std::end(this->deadlines));
+}
+
+void Scheduler::runEvents() {
+    while (this->due()) {
+        // earliest event first, handlers may reschedule themselves or other events
+        auto next = std::min_element(std::begin(this->deadlines), std::end(this->deadlines));
+        auto event = (EventType) (next - std::begin(this->deadlines));
+
+        *next = NEVER;
+        this->updateNextDeadline();
+
+        if (!this->handlers[event]) {
+            DEBUG("ERROR:no_handler_for_scheduled_event:" << std::dec << event);
+            throw std::exception();
+        }
+        this->handlers[event]();
+    }
+}
+
+uint64_t Scheduler::skipToNextEvent() {
+    if (this->next_deadline == NEVER || this->cycles >= this->next_deadline) {
+        return 0;
+    }
+
+    auto skipped = this->next_deadline - this->cycles;
+    this->cycles = this->next_deadline;
+    return skipped;
+}
+
+void Scheduler::serialize(Savestate &state) {
+    state.section("SCHD");
+    state.value(this->cycles);
+    state.value(this->deadlines);
+    state.value(this->next_deadline);
+}
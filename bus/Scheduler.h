@@ -0,0 +1,61 @@
+#ifndef PSXEMU_SCHEDULER_H
+#define PSXEMU_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+
+class Savestate;
+
+// nothing scheduled
+const uint64_t NEVER = UINT64_MAX;
+
+// things that happen at a known point in time, independent of what the CPU does
+enum EventType {
+    VBlankEvent = 0,
+    InterruptCheckEvent, // ends the current CPU slice so a pending interrupt is taken
+    Timer0Event, // root counter target/overflow interrupts
+    Timer1Event,
+    Timer2Event,
+    CdRomCommandEvent, // first response of a CD-ROM command
+    CdRomDriveEvent, // CD-ROM seek done or sector read
+    CdRomIrqEvent, // next queued CD-ROM response
+    SpuEvent, // mix the next chunk of audio
+    EventCount
+};
+
+typedef std::function<void()> EventHandler;
+
+// Keeps track of the global cycle count (CPU clock) and of the next point in time
+// at which a peripheral needs attention. The CPU runs uninterrupted until then.
+class Scheduler {
+public:
+    Scheduler();
+
+    uint64_t cycles = 0; // global cycle counter
+
+    void setHandler(const EventType& event, EventHandler handler);
+    // schedule 'event' to run 'delay' cycles from now, replacing any earlier schedule of the same event
+    void schedule(const EventType& event, const uint64_t& delay);
+    void cancel(const EventType& event);
+
+    // true if at least one event is due
+    bool due() const { return this->cycles >= this->next_deadline; }
+    uint64_t nextDeadline() const { return this->next_deadline; }
+    // run all events that are due, in order of their deadline
+    void runEvents();
+    // fast forward the cycle counter to the next event, returns the number of skipped cycles
+    uint64_t skipToNextEvent();
+
+    // deadlines only, handlers belong to the components and are not part of a savestate
+    void serialize(Savestate& state);
+
+private:
+    uint64_t deadlines[EventCount];
+    EventHandler handlers[EventCount];
+    uint64_t next_deadline = NEVER;
+
+    void updateNextDeadline();
+};
+
+
+#endif //PSXEMU_SCHEDULER_H
@@ -0,0 +1,263 @@
+#include "BinCue.h"
+#include "../util/logging.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+
+// a track as written in the cue sheet, relative to its file
+struct CueTrack
+{
+    uint8_t number;
+    TrackType type;
+    uint32_t index1; // sectors into the file
+    uint32_t pregap; // sectors of silence that are not in the file
+};
+
+struct CueFile
+{
+    size_t mapped; // index in BinCueDisc::files
+    std::vector<CueTrack> tracks;
+};
+
+static bool parse_msf(const std::string& text, uint32_t& sectors)
+{
+    unsigned m, s, f;
+    if (sscanf(text.c_str(), "%u:%u:%u", &m, &s, &f) != 3)
+    {
+        return false;
+    }
+    sectors = (m * 60 + s) * SECTORS_PER_SECOND + f;
+    return true;
+}
+
+BinCueDisc::~BinCueDisc()
+{
+    for (const auto& file : this->files)
+    {
+        unmap_image(file);
+    }
+}
+
+bool BinCueDisc::map_file(const std::string& fname, size_t& index)
+{
+    MappedFile file = MappedFile();
+    if (!map_image(fname, file))
+    {
+        return false;
+    }
+    if (file.size % SECTOR_SIZE != 0)
+    {
+        DEBUG("Disc_image_is_not_made_of_" << std::dec << SECTOR_SIZE << "_byte_sectors:" << fname);
+        unmap_image(file);
+        return false;
+    }
+    index = this->files.size();
+    this->files.push_back(file);
+    return true;
+}
+
+bool BinCueDisc::open_bin(const std::string& fname)
+{
+    size_t index;
+    if (!this->map_file(fname, index))
+    {
+        return false;
+    }
+    this->sector_count = (uint32_t)(this->files[index].size / SECTOR_SIZE);
+    this->segments.push_back({0, this->sector_count, (int32_t)index, 0});
+    this->tracks.push_back({1, DataTrack, 0, this->sector_count});
+    return true;
+}
+
+bool BinCueDisc::open_cue(const std::string& fname)
+{
+    std::ifstream cue(fname);
+    if (!cue)
+    {
+        DEBUG("Unable_to_open_cue_sheet:" << fname);
+        return false;
+    }
+    auto directory = fs::path(fname).parent_path();
+
+    std::vector<CueFile> cue_files;
+    std::string line;
+    while (std::getline(cue, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "FILE")
+        {
+            // the name may be quoted and contain spaces, the type follows it
+            auto first = line.find('"');
+            auto last = line.rfind('"');
+            std::string name;
+            if (first != std::string::npos && last > first)
+            {
+                name = line.substr(first + 1, last - first - 1);
+            }
+            else
+            {
+                tokens >> name;
+            }
+            if (line.find("BINARY") == std::string::npos)
+            {
+                DEBUG("Unsupported_cue_file_type:" << line);
+                return false;
+            }
+            CueFile file = CueFile();
+            if (!this->map_file((directory / name).string(), file.mapped))
+            {
+                return false;
+            }
+            cue_files.push_back(file);
+        }
+        else if (keyword == "TRACK")
+        {
+            unsigned number = 0;
+            std::string type;
+            tokens >> number >> type;
+            if (cue_files.empty())
+            {
+                DEBUG("Cue_track_before_any_file:" << line);
+                return false;
+            }
+            CueTrack track = {(uint8_t)number, DataTrack, 0, 0};
+            if (type == "AUDIO")
+            {
+                track.type = AudioTrack;
+            }
+            else if (type != "MODE2/2352" && type != "MODE1/2352")
+            {
+                DEBUG("Unsupported_track_type:" << type);
+                return false;
+            }
+            cue_files.back().tracks.push_back(track);
+        }
+        else if (keyword == "INDEX" || keyword == "PREGAP")
+        {
+            unsigned index = 1;
+            if (keyword == "INDEX")
+            {
+                tokens >> index;
+            }
+            std::string msf;
+            tokens >> msf;
+            uint32_t sectors;
+            if (cue_files.empty() || cue_files.back().tracks.empty() || !parse_msf(msf, sectors))
+            {
+                DEBUG("Invalid_cue_line:" << line);
+                return false;
+            }
+            auto& track = cue_files.back().tracks.back();
+            if (keyword == "PREGAP")
+            {
+                track.pregap = sectors;
+            }
+            else if (index == 1)
+            {
+                track.index1 = sectors;
+            }
+        }
+        // REM, CATALOG, TITLE, ... do not change the layout
+    }
+
+    // the files follow each other on the disc
+    uint32_t position = 0;
+    for (const auto& file : cue_files)
+    {
+        auto file_sectors = (uint32_t)(this->files[file.mapped].size / SECTOR_SIZE);
+        for (size_t i = 0; i < file.tracks.size(); i++)
+        {
+            const auto& track = file.tracks[i];
+            if (i == 0 && track.pregap != 0)
+            {
+                this->segments.push_back({position, track.pregap, -1, 0});
+                position += track.pregap;
+            }
+            else if (track.pregap != 0)
+            {
+                DEBUG("STUB:PREGAP_within_a_file_ignored,_track_" << std::dec << (uint32_t)track.number);
+            }
+            this->tracks.push_back({track.number, track.type, position + track.index1, 0});
+        }
+        this->segments.push_back({position, file_sectors, (int32_t)file.mapped, 0});
+        position += file_sectors;
+    }
+    this->sector_count = position;
+
+    if (this->tracks.empty())
+    {
+        DEBUG("No_tracks_in_cue_sheet:" << fname);
+        return false;
+    }
+    for (size_t i = 0; i < this->tracks.size(); i++)
+    {
+        auto end = i + 1 < this->tracks.size() ? this->tracks[i + 1].start : this->sector_count;
+        this->tracks[i].length = end - this->tracks[i].start;
+    }
+    return true;
+}
+
+const DiscSegment* BinCueDisc::segment_at(const uint32_t& lba)
+{
+    if (this->last_segment < this->segments.size())
+    {
+        const auto& segment = this->segments[this->last_segment];
+        if (lba >= segment.start && lba < segment.start + segment.length)
+        {
+            return &segment;
+        }
+    }
+    for (size_t i = 0; i < this->segments.size(); i++)
+    {
+        const auto& segment = this->segments[i];
+        if (lba >= segment.start && lba < segment.start + segment.length)
+        {
+            this->last_segment = i;
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+const uint8_t* BinCueDisc::read_sector(const uint32_t& lba)
+{
+    auto segment = this->segment_at(lba);
+    if (segment == nullptr)
+    {
+        return nullptr;
+    }
+    if (segment->file < 0)
+    {
+        return this->silence;
+    }
+    const auto& file = this->files[segment->file];
+    return file.data + segment->offset + (uint64_t)(lba - segment->start) * SECTOR_SIZE;
+}
+
+void BinCueDisc::prefetch(const uint32_t& lba)
+{
+    // only ask again once the drive went through half of the previous window, or jumped
+    if (lba >= this->readahead_start && lba + READAHEAD_SECTORS / 2 < this->readahead_end)
+    {
+        return;
+    }
+    auto segment = this->segment_at(lba);
+    if (segment == nullptr || segment->file < 0)
+    {
+        return;
+    }
+    auto end = std::min(lba + READAHEAD_SECTORS, segment->start + segment->length);
+    const auto& file = this->files[segment->file];
+
+    auto page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    auto from = segment->offset + (uint64_t)(lba - segment->start) * SECTOR_SIZE;
+    auto to = segment->offset + (uint64_t)(end - segment->start) * SECTOR_SIZE;
+    auto aligned = from & ~(page_size - 1);
+    madvise((void*)(file.data + aligned), to - aligned, MADV_WILLNEED);
+
+    this->readahead_start = lba;
+    this->readahead_end = end;
+}
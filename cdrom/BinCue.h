@@ -0,0 +1,50 @@
+#ifndef BINCUE_H
+#define BINCUE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Disc.h"
+
+// sectors the kernel is asked to read ahead of the drive, about half a second at double speed
+const uint32_t READAHEAD_SECTORS = 64;
+
+// a contiguous run of sectors of the disc
+struct DiscSegment
+{
+    uint32_t start; // first LBA
+    uint32_t length;
+    int32_t file; // index in files, -1 for a pregap that is not in the image
+    uint64_t offset; // bytes into the file
+};
+
+// Raw (2352 bytes per sector) images, described by a cue sheet or a single .bin.
+// The files are memory-mapped read-only: sectors are served straight from the page cache,
+// which every machine and process using the same image shares, and the kernel is told to
+// read ahead of the drive.
+class BinCueDisc : public Disc
+{
+public:
+    ~BinCueDisc();
+
+    bool open_cue(const std::string& fname);
+    // a single data track
+    bool open_bin(const std::string& fname);
+
+    const uint8_t* read_sector(const uint32_t& lba) override;
+    void prefetch(const uint32_t& lba) override;
+
+private:
+    std::vector<MappedFile> files;
+    std::vector<DiscSegment> segments; // in order of LBA
+    size_t last_segment = 0; // reads are mostly sequential
+    uint32_t readahead_start = 0, readahead_end = 0; // LBA range last handed to the kernel
+    uint8_t silence[SECTOR_SIZE] = {};
+
+    bool map_file(const std::string& fname, size_t& index);
+    const DiscSegment* segment_at(const uint32_t& lba);
+};
+
+#endif
@@ -0,0 +1,588 @@
+#include "CdRom.h"
+#include "../gpu/Constants.h"
+#include "../util/logging.h"
+#include "../state/Savestate.h"
+#include <algorithm>
+#include <cstring>
+
+// Response timings in CPU cycles, averages of the measurements in the nocash docs
+const uint64_t CDROM_ACK_CYCLES = 0xc4e1; // first response of most commands
+const uint64_t CDROM_INIT_ACK_CYCLES = 0x13cce;
+const uint64_t CDROM_GETID_CYCLES = 0x4a00; // second response of GetID
+const uint64_t CDROM_PAUSE_IDLE_CYCLES = 0x1df2; // Pause/Stop when the drive is not reading
+const uint64_t CDROM_PAUSE_SINGLE_CYCLES = 0x21181c;
+const uint64_t CDROM_PAUSE_DOUBLE_CYCLES = 0x10bd93;
+const uint64_t CDROM_READ_TOC_CYCLES = CPU_CLOCK_HZ / 2;
+// delay between the acknowledge of an interrupt and the next one
+const uint64_t CDROM_IRQ_DELAY_CYCLES = 0x800;
+// seek time grows with the distance, a full stroke takes a fraction of a second
+const uint64_t CDROM_SEEK_BASE_CYCLES = 0x10000;
+const uint64_t CDROM_SEEK_CYCLES_PER_SECTOR = 16;
+
+// mode register bits
+const uint8_t MODE_DOUBLE_SPEED = 0x80;
+const uint8_t MODE_XA_ADPCM = 0x40;
+const uint8_t MODE_WHOLE_SECTOR = 0x20;
+
+// error codes of INT5 responses
+const uint8_t CDROM_ERROR_PARAMETERS = 0x20;
+const uint8_t CDROM_ERROR_COMMAND = 0x40;
+const uint8_t CDROM_ERROR_NO_DISC = 0x80;
+
+CdRomController::CdRomController(Scheduler* scheduler, InterruptController* irq)
+{
+    this->scheduler = scheduler;
+    this->irq = irq;
+
+    this->scheduler->setHandler(CdRomCommandEvent, [this]() { this->execute(); });
+    this->scheduler->setHandler(CdRomDriveEvent, [this]() { this->drive_event(); });
+    this->scheduler->setHandler(CdRomIrqEvent, [this]() { this->deliver(); });
+}
+
+uint8_t CdRomController::stat() const
+{
+    uint8_t value = 0;
+    if (this->motor_on)
+    {
+        value |= 0x02;
+    }
+    if (this->disc == nullptr)
+    {
+        value |= 0x10; // shell open
+    }
+    if (this->drive == DriveReading)
+    {
+        value |= 0x20;
+    }
+    if (this->drive == DriveSeeking)
+    {
+        value |= 0x40;
+    }
+    return value;
+}
+
+uint8_t CdRomController::load(const uint32_t& offset)
+{
+    switch (offset & 3)
+    {
+        case 0:
+        {
+            uint8_t status = this->index;
+            status |= (uint8_t)(this->param_count == 0) << 3;
+            status |= (uint8_t)(this->param_count < CDROM_FIFO_SIZE) << 4;
+            status |= (uint8_t)(this->response_pos < this->response_size) << 5;
+            status |= (uint8_t)(this->data_pos < this->data_size) << 6;
+            status |= (uint8_t)this->busy << 7;
+            return status;
+        }
+        case 1:
+            if (this->response_pos < this->response_size)
+            {
+                return this->response[this->response_pos++];
+            }
+            return 0;
+        case 2:
+            if (this->data_pos < this->data_size)
+            {
+                return this->data[this->data_pos++];
+            }
+            return 0;
+        default:
+            // the unused bits read as ones
+            if ((this->index & 1) == 0)
+            {
+                return this->irq_enable | 0xe0;
+            }
+            return this->irq_flags | 0xe0;
+    }
+}
+
+void CdRomController::store(const uint32_t& offset, const uint8_t& value)
+{
+    switch (((offset & 3) << 2) | this->index)
+    {
+        case 0x0: case 0x1: case 0x2: case 0x3:
+            this->index = value & 3;
+            break;
+        case 0x4: // command
+            if (this->busy)
+            {
+                DEBUG("CDROM_command_0x" << std::hex << (uint32_t)value << "_while_0x" << (uint32_t)this->command << "_is_busy");
+            }
+            this->busy = true;
+            this->command = value;
+            this->scheduler->schedule(CdRomCommandEvent, value == 0x0a ? CDROM_INIT_ACK_CYCLES : CDROM_ACK_CYCLES);
+            break;
+        case 0x8: // parameter
+            if (this->param_count < CDROM_FIFO_SIZE)
+            {
+                this->params[this->param_count++] = value;
+            }
+            break;
+        case 0x9:
+            this->irq_enable = value & 0x1f;
+            break;
+        case 0xc: // request register
+            if ((value & 0x80) != 0)
+            {
+                this->load_data_fifo(); // the last sector read
+            }
+            else
+            {
+                this->data_size = 0;
+                this->data_pos = 0;
+            }
+            break;
+        case 0xd: // interrupt flag, writing ones acknowledges
+            this->irq_flags &= ~(value & 0x1f);
+            if ((value & 0x40) != 0)
+            {
+                this->param_count = 0;
+            }
+            this->schedule_delivery(CDROM_IRQ_DELAY_CYCLES);
+            break;
+        default:
+            // sound map and CD audio volume
+            break;
+    }
+}
+
+uint32_t CdRomController::dma_read()
+{
+    uint32_t word = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        word |= (uint32_t)this->load(2) << (i * 8);
+    }
+    return word;
+}
+
+void CdRomController::push_response(const CdRomInterrupt& type, const uint8_t* bytes, const uint8_t& size, const uint64_t& delay)
+{
+    CdRomResponse response = {this->scheduler->cycles + delay, (uint8_t)type, size, {}};
+    memcpy(response.bytes, bytes, size);
+    auto position = std::upper_bound(this->pending.begin(), this->pending.end(), response.cycle,
+        [](const uint64_t& cycle, const CdRomResponse& other) { return cycle < other.cycle; });
+    this->pending.insert(position, response);
+    this->schedule_delivery(0);
+}
+
+void CdRomController::push_stat(const CdRomInterrupt& type, const uint64_t& delay)
+{
+    uint8_t stat = this->stat();
+    this->push_response(type, &stat, 1, delay);
+}
+
+void CdRomController::push_error(const uint8_t& code)
+{
+    uint8_t bytes[2] = { (uint8_t)(this->stat() | 0x01), code };
+    this->push_response(CdError, bytes, 2);
+}
+
+// the next response is delivered once the previous interrupt is acknowledged
+void CdRomController::schedule_delivery(const uint64_t& min_delay)
+{
+    if ((this->irq_flags & 7) != 0 || this->pending.empty())
+    {
+        return;
+    }
+    auto now = this->scheduler->cycles;
+    auto at = std::max(this->pending.front().cycle, now + min_delay);
+    this->scheduler->schedule(CdRomIrqEvent, at - now);
+}
+
+void CdRomController::deliver()
+{
+    if ((this->irq_flags & 7) != 0 || this->pending.empty())
+    {
+        return;
+    }
+    if (this->pending.front().cycle > this->scheduler->cycles)
+    {
+        this->schedule_delivery(0);
+        return;
+    }
+
+    auto response = this->pending.front();
+    this->pending.pop_front();
+    memcpy(this->response, response.bytes, response.size);
+    this->response_size = response.size;
+    this->response_pos = 0;
+    this->irq_flags = response.type;
+    if ((this->irq_flags & this->irq_enable) != 0)
+    {
+        this->irq->request(IrqCdRom);
+    }
+}
+
+uint64_t CdRomController::sector_cycles() const
+{
+    auto speed = (this->mode & MODE_DOUBLE_SPEED) != 0 ? 2 : 1;
+    return CPU_CLOCK_HZ / (SECTORS_PER_SECOND * speed);
+}
+
+void CdRomController::start_seek(const bool& then_read)
+{
+    this->read_after_seek = then_read;
+    this->motor_on = true;
+    if (!this->seek_pending && then_read)
+    {
+        // continue where the head is
+        this->drive = DriveReading;
+        this->scheduler->schedule(CdRomDriveEvent, this->sector_cycles());
+        return;
+    }
+
+    auto target = this->seek_pending ? this->seek_target : this->position;
+    auto distance = target > this->position ? target - this->position : this->position - target;
+    this->seek_target = target;
+    this->seek_pending = false;
+    this->drive = DriveSeeking;
+    this->scheduler->schedule(CdRomDriveEvent, CDROM_SEEK_BASE_CYCLES + distance * CDROM_SEEK_CYCLES_PER_SECTOR);
+}
+
+void CdRomController::drive_event()
+{
+    switch (this->drive)
+    {
+        case DriveSeeking:
+            this->position = this->seek_target;
+            if (this->disc != nullptr)
+            {
+                this->disc->prefetch(this->position);
+            }
+            if (this->read_after_seek)
+            {
+                this->drive = DriveReading;
+                this->scheduler->schedule(CdRomDriveEvent, this->sector_cycles());
+            }
+            else
+            {
+                this->drive = DriveIdle;
+                this->push_stat(CdComplete);
+            }
+            break;
+        case DriveReading:
+            this->read_next_sector();
+            break;
+        default:
+            break;
+    }
+}
+
+void CdRomController::read_next_sector()
+{
+    const uint8_t* raw = this->disc != nullptr ? this->disc->read_sector(this->position) : nullptr;
+    if (raw == nullptr)
+    {
+        this->drive = DriveIdle;
+        this->push_stat(CdDataEnd);
+        return;
+    }
+    this->position++;
+    this->disc->prefetch(this->position);
+    this->scheduler->schedule(CdRomDriveEvent, this->sector_cycles());
+
+    // real-time XA audio sectors go to the SPU when ADPCM is enabled, never to the CPU
+    uint8_t submode = raw[18];
+    if ((this->mode & MODE_XA_ADPCM) != 0 && raw[15] == 2 && (submode & 0x44) == 0x44)
+    {
+        return;
+    }
+
+    memcpy(this->sector, raw, SECTOR_SIZE);
+    // a sector whose interrupt is still queued is replaced by the newer one
+    for (const auto& response : this->pending)
+    {
+        if (response.type == CdDataReady)
+        {
+            return;
+        }
+    }
+    this->push_stat(CdDataReady);
+}
+
+void CdRomController::load_data_fifo()
+{
+    if ((this->mode & MODE_WHOLE_SECTOR) != 0)
+    {
+        memcpy(this->data, this->sector + 12, CDROM_WHOLE_SECTOR_SIZE);
+        this->data_size = CDROM_WHOLE_SECTOR_SIZE;
+    }
+    else
+    {
+        // mode 2 sectors have an 8 byte subheader before the data
+        auto offset = this->sector[15] == 1 ? 16 : 24;
+        memcpy(this->data, this->sector + offset, CDROM_DATA_SIZE);
+        this->data_size = CDROM_DATA_SIZE;
+    }
+    this->data_pos = 0;
+}
+
+void CdRomController::execute()
+{
+    this->busy = false;
+    auto needs = [this](const uint8_t& count) {
+        if (this->param_count < count)
+        {
+            this->push_error(CDROM_ERROR_PARAMETERS);
+            return false;
+        }
+        return true;
+    };
+    auto needs_disc = [this]() {
+        if (this->disc == nullptr)
+        {
+            this->push_error(CDROM_ERROR_NO_DISC);
+            return false;
+        }
+        return true;
+    };
+
+    switch (this->command)
+    {
+        case 0x01: // Getstat
+            this->push_stat(CdAcknowledge);
+            break;
+        case 0x02: // Setloc
+            if (needs(3))
+            {
+                this->seek_target = msf_to_lba(bcd_to_binary(this->params[0]), bcd_to_binary(this->params[1]), bcd_to_binary(this->params[2]));
+                this->seek_pending = true;
+                this->push_stat(CdAcknowledge);
+            }
+            break;
+        case 0x03: // Play
+            DEBUG("STUB:CD_audio_playback");
+            this->push_stat(CdAcknowledge);
+            break;
+        case 0x06: // ReadN
+        case 0x1b: // ReadS
+            if (needs_disc())
+            {
+                this->push_stat(CdAcknowledge);
+                this->start_seek(true);
+            }
+            break;
+        case 0x07: // MotorOn
+            this->push_stat(CdAcknowledge);
+            this->motor_on = true;
+            this->push_stat(CdComplete, CDROM_ACK_CYCLES);
+            break;
+        case 0x08: // Stop
+        case 0x09: // Pause
+        {
+            bool was_idle = this->drive == DriveIdle;
+            this->push_stat(CdAcknowledge);
+            this->drive = DriveIdle;
+            this->scheduler->cancel(CdRomDriveEvent);
+            if (this->command == 0x08)
+            {
+                this->motor_on = false;
+            }
+            auto delay = was_idle ? CDROM_PAUSE_IDLE_CYCLES
+                : (this->mode & MODE_DOUBLE_SPEED) != 0 ? CDROM_PAUSE_DOUBLE_CYCLES : CDROM_PAUSE_SINGLE_CYCLES;
+            this->push_stat(CdComplete, delay);
+            break;
+        }
+        case 0x0a: // Init
+            this->mode = MODE_WHOLE_SECTOR;
+            this->motor_on = true;
+            this->drive = DriveIdle;
+            this->scheduler->cancel(CdRomDriveEvent);
+            this->push_stat(CdAcknowledge);
+            this->push_stat(CdComplete, CDROM_ACK_CYCLES);
+            break;
+        case 0x0b: // Mute
+        case 0x0c: // Demute
+            this->push_stat(CdAcknowledge);
+            break;
+        case 0x0d: // Setfilter
+            if (needs(2))
+            {
+                this->filter_file = this->params[0];
+                this->filter_channel = this->params[1];
+                this->push_stat(CdAcknowledge);
+            }
+            break;
+        case 0x0e: // Setmode
+            if (needs(1))
+            {
+                this->mode = this->params[0];
+                this->push_stat(CdAcknowledge);
+            }
+            break;
+        case 0x0f: // Getparam
+        {
+            uint8_t bytes[5] = { this->stat(), this->mode, 0, this->filter_file, this->filter_channel };
+            this->push_response(CdAcknowledge, bytes, 5);
+            break;
+        }
+        case 0x10: // GetlocL: header and subheader of the last sector read
+            this->push_response(CdAcknowledge, this->sector + 12, 8);
+            break;
+        case 0x11: // GetlocP
+        {
+            if (!needs_disc())
+            {
+                break;
+            }
+            auto track = this->disc->track_at(this->position);
+            uint32_t relative = this->position >= track->start ? this->position - track->start : 0;
+            uint8_t m, s, f, am, as, af;
+            m = (uint8_t)(relative / (60 * SECTORS_PER_SECOND));
+            s = (uint8_t)((relative / SECTORS_PER_SECOND) % 60);
+            f = (uint8_t)(relative % SECTORS_PER_SECOND);
+            lba_to_msf(this->position, am, as, af);
+            uint8_t bytes[8] = {
+                binary_to_bcd(track->number), 0x01,
+                binary_to_bcd(m), binary_to_bcd(s), binary_to_bcd(f),
+                binary_to_bcd(am), binary_to_bcd(as), binary_to_bcd(af)
+            };
+            this->push_response(CdAcknowledge, bytes, 8);
+            break;
+        }
+        case 0x12: // SetSession, single session discs only
+            if (needs(1) && needs_disc())
+            {
+                this->push_stat(CdAcknowledge);
+                this->push_stat(CdComplete, CDROM_ACK_CYCLES);
+            }
+            break;
+        case 0x13: // GetTN
+            if (needs_disc())
+            {
+                uint8_t bytes[3] = { this->stat(), 0x01, binary_to_bcd((uint8_t)this->disc->tracks.size()) };
+                this->push_response(CdAcknowledge, bytes, 3);
+            }
+            break;
+        case 0x14: // GetTD, track 0 is the end of the disc
+        {
+            if (!needs(1) || !needs_disc())
+            {
+                break;
+            }
+            auto number = bcd_to_binary(this->params[0]);
+            if (number > this->disc->tracks.size())
+            {
+                this->push_error(CDROM_ERROR_PARAMETERS);
+                break;
+            }
+            auto lba = number == 0 ? this->disc->sector_count : this->disc->tracks[number - 1].start;
+            uint8_t m, s, f;
+            lba_to_msf(lba, m, s, f);
+            uint8_t bytes[3] = { this->stat(), binary_to_bcd(m), binary_to_bcd(s) };
+            this->push_response(CdAcknowledge, bytes, 3);
+            break;
+        }
+        case 0x15: // SeekL
+        case 0x16: // SeekP
+            if (needs_disc())
+            {
+                this->push_stat(CdAcknowledge);
+                this->seek_pending = true; // seeks to the Setloc target even if a read used it
+                this->start_seek(false);
+            }
+            break;
+        case 0x19: // Test
+            if (needs(1) && this->params[0] == 0x20)
+            {
+                // date and version of the controller firmware: 1994-09-19, vC0
+                uint8_t bytes[4] = { 0x94, 0x09, 0x19, 0xc0 };
+                this->push_response(CdAcknowledge, bytes, 4);
+            }
+            else if (this->param_count != 0)
+            {
+                DEBUG("STUB:CDROM_test_command_0x" << std::hex << (uint32_t)this->params[0]);
+                this->push_error(CDROM_ERROR_COMMAND);
+            }
+            break;
+        case 0x1a: // GetID
+        {
+            this->push_stat(CdAcknowledge);
+            if (this->disc == nullptr)
+            {
+                uint8_t bytes[8] = { 0x08, 0x40, 0, 0, 0, 0, 0, 0 };
+                this->push_response(CdError, bytes, 8, CDROM_GETID_CYCLES);
+                break;
+            }
+            if (this->disc->tracks.front().type == AudioTrack)
+            {
+                uint8_t bytes[8] = { this->stat(), 0x90, 0, 0, 0, 0, 0, 0 };
+                this->push_response(CdError, bytes, 8, CDROM_GETID_CYCLES);
+                break;
+            }
+            // data discs are taken as licensed, the region comes from the license text in sector 4
+            char region = 'A';
+            auto license = this->disc->read_sector(4);
+            if (license != nullptr)
+            {
+                std::string text = std::string((const char*)license + 24, CDROM_DATA_SIZE);
+                // the text is laid out in fixed width columns: "Amer  ica", "Euro pe", "Inc."
+                if (text.find("Euro") != std::string::npos)
+                {
+                    region = 'E';
+                }
+                else if (text.find("Inc.") != std::string::npos)
+                {
+                    region = 'I';
+                }
+            }
+            uint8_t bytes[8] = { this->stat(), 0x00, 0x20, 0x00, 'S', 'C', 'E', (uint8_t)region };
+            this->push_response(CdComplete, bytes, 8, CDROM_GETID_CYCLES);
+            break;
+        }
+        case 0x1e: // ReadTOC
+            if (needs_disc())
+            {
+                this->push_stat(CdAcknowledge);
+                this->push_stat(CdComplete, CDROM_READ_TOC_CYCLES);
+            }
+            break;
+        default:
+            DEBUG("STUB:Unhandled_CDROM_command:0x" << std::hex << (uint32_t)this->command);
+            this->push_error(CDROM_ERROR_COMMAND);
+            break;
+    }
+    this->param_count = 0;
+}
+
+void CdRomController::serialize(Savestate& state)
+{
+    // pending events are restored with the scheduler deadlines
+    state.section("CDRM");
+    state.value(this->index);
+    state.value(this->irq_enable);
+    state.value(this->irq_flags);
+    state.value(this->params);
+    state.value(this->param_count);
+    state.value(this->response);
+    state.value(this->response_size);
+    state.value(this->response_pos);
+    state.value(this->busy);
+    state.value(this->command);
+    state.value(this->mode);
+    state.value(this->motor_on);
+    state.value(this->drive);
+    state.value(this->read_after_seek);
+    state.value(this->position);
+    state.value(this->seek_target);
+    state.value(this->seek_pending);
+    state.value(this->filter_file);
+    state.value(this->filter_channel);
+    state.value(this->sector);
+    state.value(this->data);
+    state.value(this->data_size);
+    state.value(this->data_pos);
+
+    uint32_t count = (uint32_t)this->pending.size();
+    state.value(count);
+    if (!state.saving())
+    {
+        this->pending.resize(count);
+    }
+    for (auto& response : this->pending)
+    {
+        state.value(response);
+    }
+}
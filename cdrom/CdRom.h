@@ -0,0 +1,112 @@
+#ifndef CDROM_H
+#define CDROM_H
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include "Disc.h"
+#include "../bus/Scheduler.h"
+#include "../bus/Irq.h"
+
+class Savestate;
+
+const uint32_t CDROM_FIFO_SIZE = 16; // parameter and response FIFOs
+// payload of a sector as the CPU reads it: the whole sector except the sync bytes, or only the data
+const uint32_t CDROM_WHOLE_SECTOR_SIZE = 0x924;
+const uint32_t CDROM_DATA_SIZE = 0x800;
+
+// Interrupt types, the low 3 bits of the interrupt flag register
+enum CdRomInterrupt
+{
+    CdNoInterrupt = 0,
+    CdDataReady = 1, // INT1, a sector was read
+    CdComplete = 2, // INT2, second response of a command
+    CdAcknowledge = 3, // INT3, first response of every command
+    CdDataEnd = 4, // INT4, end of the disc
+    CdError = 5 // INT5
+};
+
+enum CdRomDriveState
+{
+    DriveIdle,
+    DriveSeeking,
+    DriveReading
+};
+
+// a response waiting for the interrupt flag to be acknowledged. Responses are delivered one at
+// a time, in order of 'cycle'
+struct CdRomResponse
+{
+    uint64_t cycle; // not delivered before this cycle
+    uint8_t type; // CdRomInterrupt
+    uint8_t size;
+    uint8_t bytes[CDROM_FIFO_SIZE];
+};
+
+// CD-ROM controller at 0x1f801800: four byte-wide registers, banked by an index register,
+// in front of parameter, response and data FIFOs. The drive mechanics (seeking, reading at
+// 75 or 150 sectors per second) run on the scheduler, sectors come from a Disc image.
+// CD audio and XA-ADPCM playback are not emulated, XA audio sectors are skipped.
+// http://problemkaputt.de/psx-spx.htm#cdromcontroller
+class CdRomController
+{
+public:
+    CdRomController(Scheduler* scheduler, InterruptController* irq);
+    ~CdRomController() {};
+
+    Disc* disc = nullptr; // not part of the machine state, nullptr if the drive is empty
+
+    uint8_t load(const uint32_t& offset);
+    void store(const uint32_t& offset, const uint8_t& value);
+    // DMA channel 3 reads the data FIFO
+    uint32_t dma_read();
+    void serialize(Savestate& state);
+
+private:
+    Scheduler* scheduler;
+    InterruptController* irq;
+
+    uint8_t index = 0; // register bank
+    uint8_t irq_enable = 0;
+    uint8_t irq_flags = 0; // type of the delivered, not acknowledged interrupt
+    uint8_t params[CDROM_FIFO_SIZE] = {};
+    uint8_t param_count = 0;
+    uint8_t response[CDROM_FIFO_SIZE] = {};
+    uint8_t response_size = 0, response_pos = 0;
+    std::deque<CdRomResponse> pending;
+
+    // command written, its first response is not out yet
+    bool busy = false;
+    uint8_t command = 0;
+
+    // drive
+    uint8_t mode = 0;
+    bool motor_on = false;
+    CdRomDriveState drive = DriveIdle;
+    bool read_after_seek = false; // otherwise the seek completes with INT2
+    uint32_t position = 0; // next sector under the head
+    uint32_t seek_target = 0; // set by Setloc
+    bool seek_pending = false; // Setloc has not been used by a read or seek yet
+    uint8_t filter_file = 0, filter_channel = 0;
+
+    uint8_t sector[SECTOR_SIZE] = {}; // last sector read
+    uint8_t data[CDROM_WHOLE_SECTOR_SIZE] = {}; // data FIFO
+    uint16_t data_size = 0, data_pos = 0;
+
+    uint8_t stat() const;
+    void push_response(const CdRomInterrupt& type, const uint8_t* bytes, const uint8_t& size, const uint64_t& delay = 0);
+    void push_stat(const CdRomInterrupt& type, const uint64_t& delay = 0);
+    void push_error(const uint8_t& code);
+    void schedule_delivery(const uint64_t& min_delay);
+    void deliver();
+
+    void execute();
+    void start_seek(const bool& then_read);
+    void read_next_sector();
+    void drive_event();
+    uint64_t sector_cycles() const;
+    void load_data_fifo();
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "Compressed.h"
+#include "../util/logging.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifdef PSXEMU_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// the hunk offsets follow the track table, aligned for 64 bit reads from the mapping
+static size_t offsets_position(const uint32_t& track_count)
+{
+    size_t position = sizeof(CompressedDiscHeader) + track_count * sizeof(CompressedDiscTrack);
+    return (position + sizeof(CompressedHunkOffset) - 1) & ~(sizeof(CompressedHunkOffset) - 1);
+}
+
+CompressedDisc::~CompressedDisc()
+{
+    if (this->worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->work_ready.notify_one();
+        this->worker.join();
+    }
+    if (this->file.data != nullptr)
+    {
+        unmap_image(this->file);
+    }
+}
+
+bool CompressedDisc::open(const std::string& fname)
+{
+    if (!map_image(fname, this->file))
+    {
+        return false;
+    }
+    CompressedDiscHeader header = {};
+    if (this->file.size >= sizeof(header))
+    {
+        memcpy(&header, this->file.data, sizeof(header));
+    }
+    if (header.magic != COMPRESSED_DISC_MAGIC || header.version != COMPRESSED_DISC_VERSION || header.hunk_sectors == 0)
+    {
+        DEBUG("Invalid_compressed_disc_image:" << fname);
+        return false;
+    }
+    this->hunk_sectors = header.hunk_sectors;
+    this->hunk_count = header.hunk_count;
+    this->sector_count = header.sector_count;
+
+    auto table = offsets_position(header.track_count);
+    auto hunks_needed = (header.sector_count + header.hunk_sectors - 1) / header.hunk_sectors;
+    if (header.track_count == 0 || header.hunk_count != hunks_needed ||
+        table + (header.hunk_count + 1) * sizeof(CompressedHunkOffset) > this->file.size)
+    {
+        DEBUG("Truncated_compressed_disc_image:" << fname);
+        return false;
+    }
+    auto tracks = (const CompressedDiscTrack*)(this->file.data + sizeof(header));
+    for (uint32_t i = 0; i < header.track_count; i++)
+    {
+        this->tracks.push_back({tracks[i].number, (TrackType)tracks[i].type, tracks[i].start, tracks[i].length});
+    }
+    this->offsets = (const CompressedHunkOffset*)(this->file.data + table);
+    for (uint32_t i = 0; i < header.hunk_count; i++)
+    {
+        if (this->offsets[i] > this->offsets[i + 1] || this->offsets[i + 1] > this->file.size)
+        {
+            DEBUG("Corrupt_hunk_table_in_compressed_disc_image:" << fname);
+            return false;
+        }
+    }
+
+    this->worker = std::thread(&CompressedDisc::run_worker, this);
+    return true;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> CompressedDisc::decompress(const uint32_t& hunk) const
+{
+    auto first = hunk * this->hunk_sectors;
+    auto size = (size_t)std::min(this->hunk_sectors, this->sector_count - first) * SECTOR_SIZE;
+    auto data = std::make_shared<std::vector<uint8_t>>(size);
+
+    auto source = this->file.data + this->offsets[hunk];
+    auto source_size = (size_t)(this->offsets[hunk + 1] - this->offsets[hunk]);
+    if (source_size == size)
+    {
+        memcpy(data->data(), source, size);
+        return data;
+    }
+#ifdef PSXEMU_HAVE_ZLIB
+    uLongf decompressed = (uLongf)size;
+    if (uncompress(data->data(), &decompressed, source, (uLong)source_size) == Z_OK && decompressed == size)
+    {
+        return data;
+    }
+    DEBUG("Corrupt_hunk_" << std::dec << hunk << "_in_compressed_disc_image");
+#else
+    DEBUG("Compressed_disc_images_need_zlib,_hunk_" << std::dec << hunk << "_unreadable");
+#endif
+    return nullptr;
+}
+
+void CompressedDisc::run_worker()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->work_ready.wait(lock, [this]() { return this->stopping || !this->queue.empty(); });
+        if (this->stopping)
+        {
+            return;
+        }
+        auto hunk = this->queue.front();
+        this->queue.pop_front();
+        if (this->cache.count(hunk) != 0)
+        {
+            continue;
+        }
+
+        this->decoding = hunk;
+        lock.unlock();
+        auto data = this->decompress(hunk);
+        lock.lock();
+        this->decoding = UINT32_MAX;
+
+        this->lru.push_front(hunk);
+        this->cache[hunk] = {this->lru.begin(), std::move(data)};
+        while (this->cache.size() > HUNK_CACHE_SIZE)
+        {
+            this->cache.erase(this->lru.back());
+            this->lru.pop_back();
+        }
+        this->hunk_ready.notify_all();
+    }
+}
+
+bool CompressedDisc::wanted(const uint32_t& hunk) const
+{
+    return this->cache.count(hunk) != 0 || this->decoding == hunk ||
+           std::find(this->queue.begin(), this->queue.end(), hunk) != this->queue.end();
+}
+
+const uint8_t* CompressedDisc::read_sector(const uint32_t& lba)
+{
+    if (lba >= this->sector_count)
+    {
+        return nullptr;
+    }
+    auto hunk = lba / this->hunk_sectors;
+    if (this->current == nullptr || this->current_index != hunk)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto it = this->cache.find(hunk);
+        if (it == this->cache.end())
+        {
+            // the drive waits for this one, it goes before the prefetches
+            if (this->decoding != hunk)
+            {
+                auto queued = std::find(this->queue.begin(), this->queue.end(), hunk);
+                if (queued != this->queue.end())
+                {
+                    this->queue.erase(queued);
+                }
+                this->queue.push_front(hunk);
+                this->work_ready.notify_one();
+            }
+            // the queue is shorter than the cache, the hunk cannot be evicted before we wake up
+            this->hunk_ready.wait(lock, [&]() { return (it = this->cache.find(hunk)) != this->cache.end(); });
+        }
+        this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+        this->current = it->second.data;
+        this->current_index = hunk;
+        if (this->current == nullptr)
+        {
+            return nullptr;
+        }
+    }
+    return this->current->data() + (size_t)(lba % this->hunk_sectors) * SECTOR_SIZE;
+}
+
+void CompressedDisc::prefetch(const uint32_t& lba)
+{
+    auto hunk = lba / this->hunk_sectors;
+    if (lba >= this->sector_count || hunk == this->prefetched_hunk)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    // after a seek, the hunks queued for the previous position are not going to be read
+    if (hunk != this->prefetched_hunk + 1)
+    {
+        this->queue.clear();
+    }
+    this->prefetched_hunk = hunk;
+    auto end = std::min(hunk + 1 + HUNK_PREFETCH, this->hunk_count);
+    for (auto next = hunk; next < end; next++)
+    {
+        if (!this->wanted(next))
+        {
+            this->queue.push_back(next);
+        }
+    }
+    this->work_ready.notify_one();
+}
+
+std::unique_ptr<Disc> open_compressed_disc(const std::string& fname)
+{
+    auto disc = std::make_unique<CompressedDisc>();
+    if (!disc->open(fname))
+    {
+        return nullptr;
+    }
+    return disc;
+}
+
+bool write_compressed_disc(Disc& disc, const std::string& fname)
+{
+#ifdef PSXEMU_HAVE_ZLIB
+    CompressedDiscHeader header = {COMPRESSED_DISC_MAGIC, COMPRESSED_DISC_VERSION, HUNK_SECTORS, disc.sector_count,
+                                   (uint32_t)disc.tracks.size(), (disc.sector_count + HUNK_SECTORS - 1) / HUNK_SECTORS};
+    std::vector<uint8_t> table(offsets_position(header.track_count), 0);
+    memcpy(table.data(), &header, sizeof(header));
+    for (size_t i = 0; i < disc.tracks.size(); i++)
+    {
+        const auto& track = disc.tracks[i];
+        CompressedDiscTrack entry = {track.number, (uint8_t)track.type, 0, track.start, track.length};
+        memcpy(table.data() + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+    }
+    std::vector<CompressedHunkOffset> offsets(header.hunk_count + 1);
+
+    FILE* file = fopen(fname.c_str(), "wb");
+    if (!file)
+    {
+        DEBUG("Unable_to_write_compressed_disc_image:" << fname);
+        return false;
+    }
+    // the offsets are known once every hunk is written, they are filled in at the end
+    bool ok = fwrite(table.data(), 1, table.size(), file) == table.size() &&
+              fwrite(offsets.data(), sizeof(CompressedHunkOffset), offsets.size(), file) == offsets.size();
+    uint64_t position = table.size() + offsets.size() * sizeof(CompressedHunkOffset);
+
+    std::vector<uint8_t> hunk(HUNK_SECTORS * SECTOR_SIZE);
+    std::vector<uint8_t> compressed(compressBound((uLong)hunk.size()));
+    for (uint32_t i = 0; ok && i < header.hunk_count; i++)
+    {
+        auto first = i * HUNK_SECTORS;
+        auto sectors = std::min(HUNK_SECTORS, disc.sector_count - first);
+        for (uint32_t sector = 0; ok && sector < sectors; sector++)
+        {
+            auto raw = disc.read_sector(first + sector);
+            ok = raw != nullptr;
+            if (ok)
+            {
+                memcpy(hunk.data() + sector * SECTOR_SIZE, raw, SECTOR_SIZE);
+            }
+        }
+        auto size = (size_t)sectors * SECTOR_SIZE;
+        uLongf compressed_size = (uLongf)compressed.size();
+        const uint8_t* payload = hunk.data();
+        size_t payload_size = size;
+        // a hunk that does not get smaller is stored as is, its size tells the reader
+        if (compress2(compressed.data(), &compressed_size, hunk.data(), (uLong)size, Z_BEST_COMPRESSION) == Z_OK &&
+            compressed_size < size)
+        {
+            payload = compressed.data();
+            payload_size = compressed_size;
+        }
+        offsets[i] = position;
+        ok = ok && fwrite(payload, 1, payload_size, file) == payload_size;
+        position += payload_size;
+    }
+    offsets[header.hunk_count] = position;
+
+    ok = ok && fseek(file, (long)table.size(), SEEK_SET) == 0 &&
+         fwrite(offsets.data(), sizeof(CompressedHunkOffset), offsets.size(), file) == offsets.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        DEBUG("Unable_to_write_compressed_disc_image:" << fname);
+        return false;
+    }
+    DEBUG("Compressed_disc_image:" << fname << "_" << std::dec << (uint64_t)disc.sector_count * SECTOR_SIZE << "_to_" << position << "_bytes");
+    return true;
+#else
+    DEBUG("Compressed_disc_images_need_zlib,_unable_to_write:" << fname);
+    return false;
+#endif
+}
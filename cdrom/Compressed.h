@@ -0,0 +1,102 @@
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Disc.h"
+
+const uint32_t COMPRESSED_DISC_MAGIC = 0x44585350; // "PSXD"
+const uint32_t COMPRESSED_DISC_VERSION = 1;
+// sectors per hunk, the unit of compression and caching. Large enough for deflate to find the
+// repetitions of the sector headers, small enough to decompress quickly on a seek
+const uint32_t HUNK_SECTORS = 16;
+// decompressed hunks kept in memory, about 2.4 MiB
+const uint32_t HUNK_CACHE_SIZE = 64;
+// hunks decompressed ahead of a sequential read, about as far as the BIN/CUE read-ahead
+const uint32_t HUNK_PREFETCH = 4;
+
+// file header, followed by the track table, the hunk offsets and the hunks
+struct CompressedDiscHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hunk_sectors;
+    uint32_t sector_count;
+    uint32_t track_count;
+    uint32_t hunk_count;
+};
+
+struct CompressedDiscTrack
+{
+    uint8_t number;
+    uint8_t type; // TrackType
+    uint16_t reserved;
+    uint32_t start;
+    uint32_t length;
+};
+
+// hunk_count + 1 offsets from the start of the file: hunk i is stored between offsets i and
+// i + 1. A hunk as long as its sectors is stored as is, otherwise it is deflated
+typedef uint64_t CompressedHunkOffset;
+
+struct CachedHunk
+{
+    std::list<uint32_t>::iterator lru; // position in CompressedDisc::lru
+    std::shared_ptr<const std::vector<uint8_t>> data; // nullptr if the hunk is corrupt
+};
+
+// Images made of independently compressed hunks of sectors, like CHD. Hunks are decompressed
+// on a worker thread into a bounded LRU cache; sequential reads make the worker decompress the
+// following hunks before the drive gets there, a seek waits for a single hunk.
+class CompressedDisc : public Disc
+{
+public:
+    ~CompressedDisc();
+
+    bool open(const std::string& fname);
+
+    const uint8_t* read_sector(const uint32_t& lba) override;
+    void prefetch(const uint32_t& lba) override;
+
+private:
+    MappedFile file = {nullptr, 0};
+    uint32_t hunk_sectors = HUNK_SECTORS;
+    uint32_t hunk_count = 0;
+    const CompressedHunkOffset* offsets = nullptr; // in the mapping
+
+    // only used by the machine thread: the hunk of the last sector read stays alive even if
+    // the worker evicts it from the cache
+    uint32_t current_index = 0;
+    std::shared_ptr<const std::vector<uint8_t>> current;
+    uint32_t prefetched_hunk = UINT32_MAX;
+
+    // shared with the worker
+    std::mutex mutex;
+    std::condition_variable work_ready, hunk_ready;
+    std::unordered_map<uint32_t, CachedHunk> cache;
+    std::list<uint32_t> lru; // most recently used first
+    std::deque<uint32_t> queue; // hunks to decompress, reads of the drive go first
+    uint32_t decoding = UINT32_MAX; // hunk the worker is decompressing
+    bool stopping = false;
+    std::thread worker;
+
+    bool wanted(const uint32_t& hunk) const;
+    std::shared_ptr<const std::vector<uint8_t>> decompress(const uint32_t& hunk) const;
+    void run_worker();
+};
+
+std::unique_ptr<Disc> open_compressed_disc(const std::string& fname);
+// compress every sector of 'disc' into a .cdz image
+bool write_compressed_disc(Disc& disc, const std::string& fname);
+
+#endif
@@ -0,0 +1,81 @@
+#include "Disc.h"
+#include "BinCue.h"
+#include "Compressed.h"
+#include "../util/logging.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_image(const std::string& fname, MappedFile& file)
+{
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        DEBUG("Unable_to_open_disc_image:" << fname);
+        return false;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        DEBUG("Empty_disc_image:" << fname);
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        DEBUG("Unable_to_map_disc_image:" << fname);
+        return false;
+    }
+    file = {(const uint8_t*)mapped, (size_t)info.st_size};
+    return true;
+}
+
+void unmap_image(const MappedFile& file)
+{
+    munmap((void*)file.data, file.size);
+}
+
+const Track* Disc::track_at(const uint32_t& lba) const
+{
+    for (auto it = this->tracks.rbegin(); it != this->tracks.rend(); it++)
+    {
+        if (lba >= it->start)
+        {
+            return &*it;
+        }
+    }
+    // pregap of the first track
+    return this->tracks.empty() ? nullptr : &this->tracks.front();
+}
+
+std::unique_ptr<Disc> open_disc(const std::string& fname)
+{
+    auto extension = fs::path(fname).extension().string();
+    for (auto& c : extension)
+    {
+        c = (char)tolower(c);
+    }
+
+    std::unique_ptr<Disc> disc;
+    if (extension == ".cdz")
+    {
+        disc = open_compressed_disc(fname);
+    }
+    else
+    {
+        auto bin_cue = std::make_unique<BinCueDisc>();
+        if (extension == ".cue" ? bin_cue->open_cue(fname) : bin_cue->open_bin(fname))
+        {
+            disc = std::move(bin_cue);
+        }
+    }
+    if (!disc)
+    {
+        return nullptr;
+    }
+    DEBUG("Disc:" << fname << "_tracks:" << std::dec << disc->tracks.size() << "_sectors:" << disc->sector_count);
+    return disc;
+}
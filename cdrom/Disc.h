@@ -0,0 +1,89 @@
+#ifndef DISC_H
+#define DISC_H
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+const uint32_t SECTOR_SIZE = 2352; // raw sector: sync, header, subheader, data, EDC/ECC
+const uint32_t SECTORS_PER_SECOND = 75;
+// MSF 00:02:00 is the first sector of the program area, images start there
+const uint32_t PREGAP_SECTORS = 150;
+
+enum TrackType
+{
+    DataTrack,
+    AudioTrack
+};
+
+struct Track
+{
+    uint8_t number;
+    TrackType type;
+    uint32_t start; // LBA of INDEX 01
+    uint32_t length; // sectors, up to the next track
+};
+
+inline uint8_t bcd_to_binary(const uint8_t& value)
+{
+    return (value >> 4) * 10 + (value & 0xf);
+}
+
+inline uint8_t binary_to_bcd(const uint8_t& value)
+{
+    return (uint8_t)(((value / 10) << 4) | (value % 10));
+}
+
+// absolute MSF (minutes, seconds, frames) to LBA, 0 at 00:02:00. Addresses in the lead-in clamp to 0
+inline uint32_t msf_to_lba(const uint8_t& m, const uint8_t& s, const uint8_t& f)
+{
+    uint32_t sector = ((uint32_t)m * 60 + s) * SECTORS_PER_SECOND + f;
+    return sector < PREGAP_SECTORS ? 0 : sector - PREGAP_SECTORS;
+}
+
+inline void lba_to_msf(const uint32_t& lba, uint8_t& m, uint8_t& s, uint8_t& f)
+{
+    uint32_t sector = lba + PREGAP_SECTORS;
+    m = (uint8_t)(sector / (60 * SECTORS_PER_SECOND));
+    s = (uint8_t)((sector / SECTORS_PER_SECOND) % 60);
+    f = (uint8_t)(sector % SECTORS_PER_SECOND);
+}
+
+// a file mapped read-only, shared with every machine and process using it
+struct MappedFile
+{
+    const uint8_t* data;
+    size_t size;
+};
+
+// map a whole image file, false if it cannot be opened or is empty
+bool map_image(const std::string& fname, MappedFile& file);
+void unmap_image(const MappedFile& file);
+
+// A disc image, as seen by the drive: a sequence of raw sectors, addressed by LBA.
+// Backends serve sectors straight from where they keep them, without copying.
+// A disc belongs to a single machine, it is not thread safe.
+class Disc
+{
+public:
+    virtual ~Disc() {};
+
+    // raw sector at 'lba', nullptr past the end of the disc. Valid until the next call
+    virtual const uint8_t* read_sector(const uint32_t& lba) = 0;
+    // the drive is going to read sequentially from 'lba' on
+    virtual void prefetch(const uint32_t& /* lba */) {};
+
+    uint32_t sector_count = 0;
+    std::vector<Track> tracks; // in order, numbered from 1
+
+    // the track containing 'lba', nullptr if there is none
+    const Track* track_at(const uint32_t& lba) const;
+};
+
+// open a .cue sheet, a compressed .cdz image or a raw .bin image holding a single data track
+std::unique_ptr<Disc> open_disc(const std::string& fname);
+
+#endif
@@ -3,15 +3,39 @@
 #include "Cpu.h"
 #include "Instruction.h"
 #include "../util/logging.h"
+#include "../state/Savestate.h"
 
 void Cpu::runNextInstruction() {
 
+    this->scheduler->cycles += CYCLES_PER_INSTRUCTION;
+
     if (this->pc % 4 != 0) {
         return this->exception(LoadAddressError);
     }
 
+    // replace the BIOS shell with a side-loaded executable once the kernel is initialized
+    if (this->sideload_exe != nullptr && !this->sideloaded && this->pc == SHELL_ENTRY_POINT) {
+        this->sideload();
+    }
+
+    // kernel calls through the A0/B0/C0 tables can be handled natively
+    if (this->hle != nullptr && this->callHle()) {
+        return;
+    }
+
     // emulate branch delay slot: execute instruction, already fetch next instruction at PC (IP)
-    Instruction instruction = Instruction(this->load32(this->pc));
+    // BIOS code is read straight from the image, with its handler from the predecoded table
+    CpuOperation operation = nullptr;
+    Instruction instruction = Instruction(0);
+    auto bios = this->interconnect->bios;
+    auto physical = this->pc & REGION_MASK[this->pc >> 29u];
+    if (this->predecoded_bios != nullptr && bios->range.contains(physical)) {
+        auto offset = physical - bios->range.start;
+        instruction.opcode = bios->load32(offset);
+        operation = this->predecoded_bios->operations[offset >> 2u];
+    } else {
+        instruction.opcode = this->interconnect->load32(this->pc);
+    }
 
     // if the last instruction was a branch, we're in the delay slot
     this->inDelaySlot = this->branching;
@@ -36,33 +60,148 @@ void Cpu::runNextInstruction() {
     */
 
     // execute next instrudction
-    this->decodeAndExecute(instruction);
+    this->decodeAndExecute(instruction, operation);
 
     // copy to actual registers
     std::copy(std::begin(out_regs), std::end(out_regs), std::begin(regs));
 }
 
-uint16_t Cpu::load16(uint32_t address) const {
+// if the PC points to one of the BIOS kernel table entry points, run the function natively
+// and return to the caller. Returns false if the BIOS code has to be interpreted.
+bool Cpu::callHle() {
+    auto address = this->pc & 0x1fffffffu;
+    if (address != 0xa0 && address != 0xb0 && address != 0xc0) {
+        return false;
+    }
+
+    // a pending load or branch would be observable by the BIOS code, leave these to the interpreter
+    if (this->load.registerIndex.index != 0 || this->branching) {
+        return false;
+    }
+
+    uint32_t result;
+    if (!this->hle->call(address, this->regs, result)) {
+        return false;
+    }
+    this->idle.side_effects = true;
+
+    // return value in $v0
+    this->regs[2] = result;
+    std::copy(std::begin(regs), std::end(regs), std::begin(out_regs));
+
+    // return to the caller, like the "jr $ra" at the end of the function
+    this->pc = this->regs[31];
+    this->next_pc = this->pc + 4;
+    return true;
+}
+
+// copy the side-loaded executable into RAM and jump to its entry point
+void Cpu::sideload() {
+    this->sideload_exe->copyToRam(this->interconnect->ram);
+    this->idle.side_effects = true;
+
+    this->regs[28] = this->sideload_exe->gp;
+    if (this->sideload_exe->sp != 0) {
+        this->regs[29] = this->sideload_exe->sp;
+        this->regs[30] = this->sideload_exe->sp;
+    }
+    std::copy(std::begin(regs), std::end(regs), std::begin(out_regs));
+
+    this->pc = this->sideload_exe->pc;
+    this->next_pc = this->pc + 4;
+
+    DEBUG("Side-loaded_EXE,_jumping_to_0x" << std::hex << this->pc);
+    this->sideloaded = true;
+}
+
+// Called between scheduler slices. Bit 10 of the cause register mirrors the interrupt controller output,
+// bits 8 and 9 are software interrupts. The interrupt is taken if enabled in SR (IEc and the IM bits)
+void Cpu::checkInterrupts() {
+    if (this->interconnect->irq->pending()) {
+        this->cause |= 1u << 10u;
+    } else {
+        this->cause &= ~(1u << 10u);
+    }
+
+    if ((this->sr & 1u) == 0 || (this->sr & this->cause & 0xff00u) == 0) {
+        return;
+    }
+
+    // the instruction at PC has not been executed yet, it is the one to return to
+    auto interrupted_pc = this->pc;
+    auto in_delay_slot = this->branching;
+
+    // hardware quirk: a GTE command at the interrupted address is executed anyway. EPC still
+    // points at it, the BIOS handler sees the GTE command there and skips it when returning
+    if (this->pc % 4 == 0 && (this->load32(this->pc) >> 25u) == 0b0100101) {
+        this->runNextInstruction();
+    }
+
+    this->current_pc = interrupted_pc;
+    this->inDelaySlot = in_delay_slot;
+    this->branching = false;
+    this->exception(Interrupt);
+}
+
+uint16_t Cpu::load16(uint32_t address) {
+    this->noteVolatileLoad(address);
     return this->interconnect->load16(address);
 }
 
-uint32_t Cpu::load32(const uint32_t& address) const {
+uint32_t Cpu::load32(const uint32_t& address) {
+    this->noteVolatileLoad(address);
     return this->interconnect->load32(address);
 }
 
-void Cpu::store8(const uint32_t &address, const uint8_t &value) const {
+// a register that changes between events makes the loop reading it busy, not idle
+void Cpu::noteVolatileLoad(const uint32_t &address) {
+    if (this->interconnect->changesBetweenEvents(address)) {
+        this->idle.side_effects = true;
+    }
+}
+
+void Cpu::store8(const uint32_t &address, const uint8_t &value) {
+    this->idle.side_effects = true;
     this->interconnect->store8(address, value);
 }
 
-void Cpu::store16(const uint32_t &address, const uint16_t &value) const {
+void Cpu::store16(const uint32_t &address, const uint16_t &value) {
+    this->idle.side_effects = true;
     this->interconnect->store16(address, value);
 }
 
-void Cpu::store32(const uint32_t &address, const uint32_t &value) const {
+void Cpu::store32(const uint32_t &address, const uint32_t &value) {
+    this->idle.side_effects = true;
     this->interconnect->store32(address, value);
 }
 
-void Cpu::decodeAndExecute(const Instruction& instruction) {
+// Called for backwards jumps. If the CPU comes back to the same loop head with the same register
+// values and nothing was written in between, it will keep spinning until an event changes the
+// value it polls (e.g. GPU status or IRQ status), so we can skip straight to that event.
+void Cpu::detectIdleLoop(const uint32_t &target) {
+    if (!this->idle_skip || target > this->current_pc || this->current_pc - target > IDLE_LOOP_MAX_SIZE) {
+        return;
+    }
+
+    bool same_loop = target == this->idle.head && !this->idle.side_effects;
+    if (same_loop && this->hi == this->idle.hi && this->lo == this->idle.lo
+        && std::equal(std::begin(out_regs), std::end(out_regs), std::begin(this->idle.regs))) {
+        auto skipped = this->scheduler->skipToNextEvent();
+        if (skipped != 0) {
+            this->idle_loops_skipped++;
+            this->idle_cycles_skipped += skipped;
+        }
+        return;
+    }
+
+    this->idle.head = target;
+    this->idle.hi = this->hi;
+    this->idle.lo = this->lo;
+    this->idle.side_effects = false;
+    std::copy(std::begin(out_regs), std::end(out_regs), std::begin(this->idle.regs));
+}
+
+void Cpu::decodeAndExecute(const Instruction& instruction, CpuOperation operation) {
 
     if (this->current_pc == 0x80000080) {
         //this->DEBUG = true;
@@ -73,82 +212,97 @@ void Cpu::decodeAndExecute(const Instruction& instruction) {
         getchar();
     }
 
+    if (operation == nullptr) {
+        operation = Cpu::decode(instruction);
+    }
+    (this->*operation)(instruction);
+}
+
+// Select the handler of an instruction. Decoding only depends on the instruction word,
+// so code that can not change (the BIOS) is decoded once ahead of time
+CpuOperation Cpu::decode(const Instruction& instruction) {
     switch(instruction.function()) {
         // http://mipsconverter.com/opcodes.html
         // http://problemkaputt.de/psx-spx.htm#cpuspecifications
         case 0b000000:
             switch (instruction.subfunction()) {
-                case 0b000000: this->OP_SLL(instruction); break;
-                case 0b000010: this->OP_SRL(instruction); break;
-                case 0b000011: this->OP_SRA(instruction); break;
-                case 0b000100: this->OP_SLLV(instruction); break;
-                case 0b000110: this->OP_SRLV(instruction); break;
-                case 0b000111: this->OP_SRAV(instruction); break;
-                case 0b001000: this->OP_JR(instruction); break;
-                case 0b001001: this->OP_JALR(instruction); break;
-                case 0b001100: this->OP_SYSCALL(instruction); break;
-                case 0b001101: this->OP_BREAK(instruction); break;
-                case 0b010000: this->OP_MFHI(instruction); break;
-                case 0b010001: this->OP_MTHI(instruction); break;
-                case 0b010010: this->OP_MFLO(instruction); break;
-                case 0b010011: this->OP_MTLO(instruction); break;
-                case 0b011000: this->OP_MULT(instruction); break;
-                case 0b011001: this->OP_MULTU(instruction); break;
-                case 0b011010: this->OP_DIV(instruction); break;
-                case 0b011011: this->OP_DIVU(instruction); break;
-                case 0b100000: this->OP_ADD(instruction); break;
-                case 0b100001: this->OP_ADDU(instruction); break;
-                case 0b100010: this->OP_SUB(instruction); break;
-                case 0b100011: this->OP_SUBU(instruction); break;
-                case 0b100100: this->OP_AND(instruction); break;
-                case 0b100101: this->OP_OR(instruction); break;
-                case 0b100110: this->OP_XOR(instruction); break;
-                case 0b100111: this->OP_NOR(instruction); break;
-                case 0b101010: this->OP_SLT(instruction); break;
-                case 0b101011: this->OP_SLTU(instruction); break;
-                default: this->OP_ILLEGAL(instruction);
+                case 0b000000: return &Cpu::OP_SLL;
+                case 0b000010: return &Cpu::OP_SRL;
+                case 0b000011: return &Cpu::OP_SRA;
+                case 0b000100: return &Cpu::OP_SLLV;
+                case 0b000110: return &Cpu::OP_SRLV;
+                case 0b000111: return &Cpu::OP_SRAV;
+                case 0b001000: return &Cpu::OP_JR;
+                case 0b001001: return &Cpu::OP_JALR;
+                case 0b001100: return &Cpu::OP_SYSCALL;
+                case 0b001101: return &Cpu::OP_BREAK;
+                case 0b010000: return &Cpu::OP_MFHI;
+                case 0b010001: return &Cpu::OP_MTHI;
+                case 0b010010: return &Cpu::OP_MFLO;
+                case 0b010011: return &Cpu::OP_MTLO;
+                case 0b011000: return &Cpu::OP_MULT;
+                case 0b011001: return &Cpu::OP_MULTU;
+                case 0b011010: return &Cpu::OP_DIV;
+                case 0b011011: return &Cpu::OP_DIVU;
+                case 0b100000: return &Cpu::OP_ADD;
+                case 0b100001: return &Cpu::OP_ADDU;
+                case 0b100010: return &Cpu::OP_SUB;
+                case 0b100011: return &Cpu::OP_SUBU;
+                case 0b100100: return &Cpu::OP_AND;
+                case 0b100101: return &Cpu::OP_OR;
+                case 0b100110: return &Cpu::OP_XOR;
+                case 0b100111: return &Cpu::OP_NOR;
+                case 0b101010: return &Cpu::OP_SLT;
+                case 0b101011: return &Cpu::OP_SLTU;
+                default: return &Cpu::OP_ILLEGAL;
             }
-            break;
-        case 0b000001: this->OP_BXX(instruction); break;
-        case 0b000010: this->OP_J(instruction); break;
-        case 0b000011: this->OP_JAL(instruction); break;
-        case 0b000100: this->OP_BEQ(instruction); break;
-        case 0b000101: this->OP_BNE(instruction); break;
-        case 0b000110: this->OP_BLEZ(instruction); break;
-        case 0b000111: this->OP_BGTZ(instruction); break;
-        case 0b001000: this->OP_ADDI(instruction); break;
-        case 0b001001: this->OP_ADDIU(instruction); break;
-        case 0b001010: this->OP_SLTI(instruction); break;
-        case 0b001011: this->OP_SLTIU(instruction); break;
-        case 0b001100: this->OP_ANDI(instruction); break;
-        case 0b001101: this->OP_ORI(instruction); break;
-        case 0b001110: this->OP_XORI(instruction); break;
-        case 0b001111: this->OP_LUI(instruction); break;
-        case 0b010000: this->OP_COP0(instruction); break;
-        case 0b010001: this->OP_COP1(instruction); break;
-        case 0b010010: this->OP_COP2(instruction); break;
-        case 0b010011: this->OP_COP3(instruction); break;
-        case 0b100000: this->OP_LB(instruction); break;
-        case 0b100001: this->OP_LH(instruction); break;
-        case 0b100010: this->OP_LWL(instruction); break;
-        case 0b100011: this->OP_LW(instruction); break;
-        case 0b100100: this->OP_LBU(instruction); break;
-        case 0b100101: this->OP_LHU(instruction); break;
-        case 0b100110: this->OP_LWR(instruction); break;
-        case 0b101000: this->OP_SB(instruction); break;
-        case 0b101001: this->OP_SH(instruction); break;
-        case 0b101010: this->OP_SWL(instruction); break;
-        case 0b101011: this->OP_SW(instruction); break;
-        case 0b101110: this->OP_SWR(instruction); break;
-        case 0b110000: this->OP_LWC0(instruction); break;
-        case 0b110001: this->OP_LWC1(instruction); break;
-        case 0b110010: this->OP_LWC2(instruction); break;
-        case 0b110011: this->OP_LWC3(instruction); break;
-        case 0b111000: this->OP_SWC0(instruction); break;
-        case 0b111001: this->OP_SWC1(instruction); break;
-        case 0b111010: this->OP_SWC2(instruction); break;
-        case 0b111011: this->OP_SWC3(instruction); break;
-        default: this->OP_ILLEGAL(instruction);
+        case 0b000001: return &Cpu::OP_BXX;
+        case 0b000010: return &Cpu::OP_J;
+        case 0b000011: return &Cpu::OP_JAL;
+        case 0b000100: return &Cpu::OP_BEQ;
+        case 0b000101: return &Cpu::OP_BNE;
+        case 0b000110: return &Cpu::OP_BLEZ;
+        case 0b000111: return &Cpu::OP_BGTZ;
+        case 0b001000: return &Cpu::OP_ADDI;
+        case 0b001001: return &Cpu::OP_ADDIU;
+        case 0b001010: return &Cpu::OP_SLTI;
+        case 0b001011: return &Cpu::OP_SLTIU;
+        case 0b001100: return &Cpu::OP_ANDI;
+        case 0b001101: return &Cpu::OP_ORI;
+        case 0b001110: return &Cpu::OP_XORI;
+        case 0b001111: return &Cpu::OP_LUI;
+        case 0b010000: return &Cpu::OP_COP0;
+        case 0b010001: return &Cpu::OP_COP1;
+        case 0b010010: return &Cpu::OP_COP2;
+        case 0b010011: return &Cpu::OP_COP3;
+        case 0b100000: return &Cpu::OP_LB;
+        case 0b100001: return &Cpu::OP_LH;
+        case 0b100010: return &Cpu::OP_LWL;
+        case 0b100011: return &Cpu::OP_LW;
+        case 0b100100: return &Cpu::OP_LBU;
+        case 0b100101: return &Cpu::OP_LHU;
+        case 0b100110: return &Cpu::OP_LWR;
+        case 0b101000: return &Cpu::OP_SB;
+        case 0b101001: return &Cpu::OP_SH;
+        case 0b101010: return &Cpu::OP_SWL;
+        case 0b101011: return &Cpu::OP_SW;
+        case 0b101110: return &Cpu::OP_SWR;
+        case 0b110000: return &Cpu::OP_LWC0;
+        case 0b110001: return &Cpu::OP_LWC1;
+        case 0b110010: return &Cpu::OP_LWC2;
+        case 0b110011: return &Cpu::OP_LWC3;
+        case 0b111000: return &Cpu::OP_SWC0;
+        case 0b111001: return &Cpu::OP_SWC1;
+        case 0b111010: return &Cpu::OP_SWC2;
+        case 0b111011: return &Cpu::OP_SWC3;
+        default: return &Cpu::OP_ILLEGAL;
+    }
+}
+
+PredecodedBios::PredecodedBios(const Bios &bios) {
+    this->operations.resize(bios.range.length / 4);
+    for (uint32_t i = 0; i < this->operations.size(); i++) {
+        this->operations[i] = Cpu::decode(Instruction(bios.load32(i * 4)));
     }
 }
 
@@ -162,6 +316,8 @@ void Cpu::setRegister(const RegisterIndex &t, const uint32_t &v) {
 }
 
 void Cpu::exception(Exception exception) {
+    this->idle.side_effects = true;
+
     // exception handler address depends on the BEV bit
     auto handler = (this->sr & (1u << 22u)) != 0 ? 0xbfc00180 : 0x80000080;
 
@@ -171,8 +327,9 @@ void Cpu::exception(Exception exception) {
     this->sr &= ~0x3fu;
     this->sr |= (mode << 2u) & 0x3fu;
 
-    // update cause register with bits 6:2 (the exception code)
-    this->cause = ((uint32_t) exception) << 2u;
+    // update cause register with bits 6:2 (the exception code), keep the interrupt pending bits
+    this->cause &= 0xff00u;
+    this->cause |= ((uint32_t) exception) << 2u;
 
     // save current instruction address in EPC
     this->epc = this->current_pc;
@@ -188,3 +345,34 @@ void Cpu::exception(Exception exception) {
     this->pc = handler;
     this->next_pc = this->pc + 4;
 }
+
+void Cpu::serialize(Savestate &state) {
+    state.section("CPU ");
+    state.value(this->pc);
+    state.value(this->current_pc);
+    state.value(this->next_pc);
+    state.value(this->regs);
+    state.value(this->out_regs);
+    state.value(this->sr);
+    state.value(this->hi);
+    state.value(this->lo);
+    state.value(this->cause);
+    state.value(this->epc);
+    state.value(this->load);
+    state.value(this->branching);
+    state.value(this->inDelaySlot);
+    state.value(this->n_instructions);
+    state.value(this->sideloaded);
+    // the layout does not depend on whether HLE is enabled
+    uint32_t hle_seed = this->hle != nullptr ? this->hle->rand_seed : 0;
+    state.value(hle_seed);
+    if (this->hle != nullptr) {
+        this->hle->rand_seed = hle_seed;
+    }
+    this->gte.serialize(state);
+
+    if (!state.saving()) {
+        // the loop being watched is most likely not the one running after the load
+        this->idle = {};
+    }
+}
@@ -2,8 +2,26 @@
 #define PSXEMU_CPU_H
 
 #include <cstdint>
+#include <vector>
 #include "../bus/Interconnect.h"
 #include "Instruction.h"
+#include "Gte.h"
+#include "../bios/Hle.h"
+#include "../bios/Exe.h"
+
+// average number of CPU cycles per instruction, we do not emulate pipeline stalls or cache timings
+const uint32_t CYCLES_PER_INSTRUCTION = 2;
+// loops spanning more bytes than this are never considered idle loops
+const uint32_t IDLE_LOOP_MAX_SIZE = 0x40;
+
+// state of the idle loop detection: a loop is idle if an iteration does not change
+// the registers and has no side effects, so it will spin until the next scheduled event
+struct IdleLoop {
+    uint32_t head; // address the backwards branch jumps to
+    uint32_t regs[32]; // registers at the last iteration
+    uint32_t hi, lo;
+    bool side_effects; // a store, coprocessor write or timer/SPU read happened since the last iteration
+};
 
 struct LoadRegister {
     RegisterIndex registerIndex;
@@ -11,6 +29,7 @@ struct LoadRegister {
 };
 
 enum Exception {
+    Interrupt = 0x0, // external interrupt, via the interrupt controller
     SysCall = 0x8, // caused by syscall opcode
     Overflow = 0xc, // overflow on addi/add
     LoadAddressError = 0x4, // if not 32 bit aligned
@@ -20,6 +39,17 @@ enum Exception {
     IllegalInstruction = 0xa,
 };
 
+class Cpu;
+typedef void (Cpu::*CpuOperation)(const Instruction& instruction);
+
+// Handler of every word of a BIOS image. The BIOS is read-only, so the table is built once
+// and shared by all CPUs running that image
+struct PredecodedBios {
+    explicit PredecodedBios(const Bios& bios);
+
+    std::vector<CpuOperation> operations;
+};
+
 class Cpu {
 public:
     Interconnect* interconnect;
@@ -29,7 +59,11 @@ public:
           sr(0),
           hi(0xdeadbeef),
           lo(0xdeadbeef),
-          load({{0}, 0})
+          cause(0),
+          epc(0),
+          load({{0}, 0}),
+          branching(false),
+          inDelaySlot(false)
     {
         // set general purpose registers to default value
         for (uint32_t& reg : this->regs) {
@@ -42,16 +76,38 @@ public:
 
         // memory interface: interconnect for peripherals
         this->interconnect = interconnect;
+        this->scheduler = interconnect->scheduler;
     }
     void runNextInstruction();
+    // take an interrupt if the interrupt controller has one pending and the CPU accepts it
+    void checkInterrupts();
+    void serialize(Savestate& state);
+    static CpuOperation decode(const Instruction& instruction);
+
+    Gte gte; // coprocessor 2
+    const PredecodedBios* predecoded_bios = nullptr; // must match interconnect->bios
+    BiosHle* hle = nullptr; // optional high level emulation of the BIOS kernel calls
+    const PsxExe* sideload_exe = nullptr; // executable to run instead of the BIOS shell
+    bool sideloaded = false; // part of the machine state, loading an earlier state runs the EXE again
+
+    // fast forward to the next scheduled event when the CPU spins in an idle loop
+    bool idle_skip = true;
+    uint64_t idle_loops_skipped = 0;
+    uint64_t idle_cycles_skipped = 0;
 
 private:
-    void store8(const uint32_t &address, const uint8_t &value) const;
-    void store16(const uint32_t& address, const uint16_t & value) const;
-    void store32(const uint32_t& address, const uint32_t& value) const;
-    uint32_t load32(const uint32_t& address) const;
-
-    void decodeAndExecute(const Instruction &instruction);
+    Scheduler* scheduler;
+    IdleLoop idle = {};
+
+    void store8(const uint32_t &address, const uint8_t &value);
+    void store16(const uint32_t& address, const uint16_t & value);
+    void store32(const uint32_t& address, const uint32_t& value);
+    uint32_t load32(const uint32_t& address);
+
+    // 'operation' is the handler if it is already known
+    void decodeAndExecute(const Instruction &instruction, CpuOperation operation = nullptr);
+    bool callHle();
+    void sideload();
     // opcodes
     void OP_LUI(const Instruction& instruction);
     void OP_ORI(const Instruction& instruction);
@@ -115,6 +171,10 @@ private:
     void OP_SWC1(const Instruction &instruction);
     void OP_SWC2(const Instruction &instruction);
     void OP_SWC3(const Instruction &instruction);
+    void OP_MFC2(const Instruction &instruction);
+    void OP_CFC2(const Instruction &instruction);
+    void OP_MTC2(const Instruction &instruction);
+    void OP_CTC2(const Instruction &instruction);
 
     // registers
     uint32_t pc; // Instruction Pointer (Program Counter)
@@ -139,8 +199,10 @@ private:
     unsigned int n_instructions = 0;
 
     void branch(uint32_t offset);
+    void detectIdleLoop(const uint32_t& target);
     void exception(Exception exception);
-    uint8_t load8(const uint32_t &address) const;
+    uint8_t load8(const uint32_t &address);
+    void noteVolatileLoad(const uint32_t& address);
 
     void OP_SYSCALL(const Instruction &instruction);
 
@@ -156,7 +218,7 @@ private:
 
     void OP_LHU(const Instruction &instruction);
 
-    uint16_t load16(uint32_t address) const;
+    uint16_t load16(uint32_t address);
 
     void OP_ILLEGAL(const Instruction &instruction);
 
@@ -0,0 +1,763 @@
+#include <array>
+#include <algorithm>
+#include "Gte.h"
+#include "../state/Savestate.h"
+#include "../util/logging.h"
+
+// reciprocal table used by the GTE division (unsigned newton-raphson)
+constexpr std::array<uint8_t, 257> makeUnrTable() {
+    std::array<uint8_t, 257> table = {};
+    for (int i = 0; i < 257; i++) {
+        table[i] = (uint8_t) std::max(0, (0x40000 / (i + 0x100) + 1) / 2 - 0x101);
+    }
+    return table;
+}
+constexpr std::array<uint8_t, 257> UNR_TABLE = makeUnrTable();
+
+// divide n by d the way the hardware does it, only valid if n < d * 2
+uint32_t unrDivide(uint32_t n, uint32_t d) {
+    auto shift = __builtin_clz(d) - 16;
+    n <<= shift;
+    d <<= shift;
+
+    uint32_t u = UNR_TABLE[(d - 0x7fc0u) >> 7u] + 0x101u;
+    d = (0x2000080u - d * u) >> 8u;
+    d = (0x80u + d * u) >> 8u;
+
+    return (uint32_t) std::min<uint64_t>(0x1ffffu, (((uint64_t) n * d) + 0x8000u) >> 16u);
+}
+
+bool RtpKey::operator==(const RtpKey &other) const {
+    return std::equal(std::begin(rotation), std::end(rotation), std::begin(other.rotation))
+        && std::equal(std::begin(translation), std::end(translation), std::begin(other.translation))
+        && std::equal(std::begin(vertex), std::end(vertex), std::begin(other.vertex))
+        && ofx == other.ofx && ofy == other.ofy && h == other.h
+        && dqa == other.dqa && dqb == other.dqb && sf_lm == other.sf_lm;
+}
+
+// cheap multiplicative hash, the inputs of static geometry differ mostly in the vertex
+uint32_t hashRtpKey(const RtpKey& key) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+    for (auto r : key.rotation) mix((uint16_t) r);
+    for (auto t : key.translation) mix((uint32_t) t);
+    for (auto c : key.vertex) mix((uint16_t) c);
+    mix(key.sf_lm);
+    return hash ^ (hash >> 15u);
+}
+
+Gte::Gte() = default;
+
+void Gte::enableRtpCache(bool enable) {
+    this->rtp_cache.reset(enable ? new RtpCacheEntry[RTP_CACHE_SIZE]() : nullptr);
+    this->rtp_cache_hits = 0;
+    this->rtp_cache_misses = 0;
+}
+
+double Gte::rtpCacheHitRate() const {
+    auto total = this->rtp_cache_hits + this->rtp_cache_misses;
+    return total == 0 ? 0.0 : (double) this->rtp_cache_hits / (double) total;
+}
+
+// pack two signed 16 bit values into a register
+uint32_t pack16(const int16_t& lo, const int16_t& hi) {
+    return ((uint32_t) (uint16_t) lo) | (((uint32_t) (uint16_t) hi) << 16u);
+}
+
+// read a 3x3 matrix register (5 registers per matrix, the last holds only element 33)
+uint32_t getMatrix(const int16_t m[3][3], const uint32_t& reg) {
+    switch (reg) {
+        case 0: return pack16(m[0][0], m[0][1]);
+        case 1: return pack16(m[0][2], m[1][0]);
+        case 2: return pack16(m[1][1], m[1][2]);
+        case 3: return pack16(m[2][0], m[2][1]);
+        default: return (uint32_t) (int32_t) m[2][2];
+    }
+}
+
+void setMatrix(int16_t m[3][3], const uint32_t& reg, const uint32_t& value) {
+    auto lo = (int16_t) value;
+    auto hi = (int16_t) (value >> 16u);
+    switch (reg) {
+        case 0: m[0][0] = lo; m[0][1] = hi; break;
+        case 1: m[0][2] = lo; m[1][0] = hi; break;
+        case 2: m[1][1] = lo; m[1][2] = hi; break;
+        case 3: m[2][0] = lo; m[2][1] = hi; break;
+        default: m[2][2] = lo; break;
+    }
+}
+
+// convert IR1-IR3 to a 15 bit color, used by IRGB/ORGB
+uint32_t irToColor(const int16_t& value) {
+    return (uint32_t) std::clamp(value >> 7, 0, 0x1f);
+}
+
+// MFC2: read a data register
+uint32_t Gte::getData(const uint32_t &reg) const {
+    switch (reg) {
+        case 0: case 2: case 4:
+            return pack16(this->v[reg / 2][0], this->v[reg / 2][1]);
+        case 1: case 3: case 5:
+            return (uint32_t) (int32_t) this->v[reg / 2][2];
+        case 6:
+            return this->rgbc[0] | (this->rgbc[1] << 8u) | (this->rgbc[2] << 16u) | (this->rgbc[3] << 24u);
+        case 7:
+            return this->otz;
+        case 8: case 9: case 10: case 11:
+            return (uint32_t) (int32_t) this->ir[reg - 8];
+        case 12: case 13: case 14:
+            return pack16(this->sxy[reg - 12][0], this->sxy[reg - 12][1]);
+        case 15: // SXYP mirrors SXY2 on reads
+            return pack16(this->sxy[2][0], this->sxy[2][1]);
+        case 16: case 17: case 18: case 19:
+            return this->sz[reg - 16];
+        case 20: case 21: case 22: {
+            auto& c = this->rgb_fifo[reg - 20];
+            return c[0] | (c[1] << 8u) | (c[2] << 16u) | (c[3] << 24u);
+        }
+        case 23:
+            return this->res1;
+        case 24: case 25: case 26: case 27:
+            return (uint32_t) this->mac[reg - 24];
+        case 28: case 29:
+            return irToColor(this->ir[1]) | (irToColor(this->ir[2]) << 5u) | (irToColor(this->ir[3]) << 10u);
+        case 30:
+            return this->lzcs;
+        default:
+            return this->lzcr;
+    }
+}
+
+// MTC2: write a data register
+void Gte::setData(const uint32_t &reg, const uint32_t &value) {
+    switch (reg) {
+        case 0: case 2: case 4:
+            this->v[reg / 2][0] = (int16_t) value;
+            this->v[reg / 2][1] = (int16_t) (value >> 16u);
+            break;
+        case 1: case 3: case 5:
+            this->v[reg / 2][2] = (int16_t) value;
+            break;
+        case 6:
+            for (int i = 0; i < 4; i++) {
+                this->rgbc[i] = (uint8_t) (value >> (8u * i));
+            }
+            break;
+        case 7:
+            this->otz = (uint16_t) value;
+            break;
+        case 8: case 9: case 10: case 11:
+            this->ir[reg - 8] = (int16_t) value;
+            break;
+        case 12: case 13: case 14:
+            this->sxy[reg - 12][0] = (int16_t) value;
+            this->sxy[reg - 12][1] = (int16_t) (value >> 16u);
+            break;
+        case 15: // writing SXYP pushes to the FIFO
+            this->pushSxy((int16_t) value, (int16_t) (value >> 16u));
+            break;
+        case 16: case 17: case 18: case 19:
+            this->sz[reg - 16] = (uint16_t) value;
+            break;
+        case 20: case 21: case 22:
+            for (int i = 0; i < 4; i++) {
+                this->rgb_fifo[reg - 20][i] = (uint8_t) (value >> (8u * i));
+            }
+            break;
+        case 23:
+            this->res1 = value;
+            break;
+        case 24: case 25: case 26: case 27:
+            this->mac[reg - 24] = (int32_t) value;
+            break;
+        case 28: // IRGB expands the 15 bit color into IR1-IR3
+            this->ir[1] = (int16_t) ((value & 0x1fu) << 7u);
+            this->ir[2] = (int16_t) (((value >> 5u) & 0x1fu) << 7u);
+            this->ir[3] = (int16_t) (((value >> 10u) & 0x1fu) << 7u);
+            break;
+        case 29: // ORGB is read only
+            break;
+        case 30: {
+            this->lzcs = value;
+            // count leading bits that are equal to the sign bit
+            auto bits = ((int32_t) value < 0) ? ~value : value;
+            this->lzcr = bits == 0 ? 32 : __builtin_clz(bits);
+            break;
+        }
+        default: // LZCR is read only
+            break;
+    }
+}
+
+// CFC2: read a control register
+uint32_t Gte::getControl(const uint32_t &reg) const {
+    switch (reg) {
+        case 0: case 1: case 2: case 3: case 4:
+            return getMatrix(this->rotation, reg);
+        case 5: case 6: case 7:
+            return (uint32_t) this->translation[reg - 5];
+        case 8: case 9: case 10: case 11: case 12:
+            return getMatrix(this->light, reg - 8);
+        case 13: case 14: case 15:
+            return (uint32_t) this->background_color[reg - 13];
+        case 16: case 17: case 18: case 19: case 20:
+            return getMatrix(this->light_color, reg - 16);
+        case 21: case 22: case 23:
+            return (uint32_t) this->far_color[reg - 21];
+        case 24:
+            return (uint32_t) this->ofx;
+        case 25:
+            return (uint32_t) this->ofy;
+        case 26: // hardware bug: H is sign extended on reads
+            return (uint32_t) (int32_t) (int16_t) this->h;
+        case 27:
+            return (uint32_t) (int32_t) this->dqa;
+        case 28:
+            return (uint32_t) this->dqb;
+        case 29:
+            return (uint32_t) (int32_t) this->zsf3;
+        case 30:
+            return (uint32_t) (int32_t) this->zsf4;
+        default:
+            return this->flag;
+    }
+}
+
+// CTC2: write a control register
+void Gte::setControl(const uint32_t &reg, const uint32_t &value) {
+    switch (reg) {
+        case 0: case 1: case 2: case 3: case 4:
+            setMatrix(this->rotation, reg, value);
+            break;
+        case 5: case 6: case 7:
+            this->translation[reg - 5] = (int32_t) value;
+            break;
+        case 8: case 9: case 10: case 11: case 12:
+            setMatrix(this->light, reg - 8, value);
+            break;
+        case 13: case 14: case 15:
+            this->background_color[reg - 13] = (int32_t) value;
+            break;
+        case 16: case 17: case 18: case 19: case 20:
+            setMatrix(this->light_color, reg - 16, value);
+            break;
+        case 21: case 22: case 23:
+            this->far_color[reg - 21] = (int32_t) value;
+            break;
+        case 24:
+            this->ofx = (int32_t) value;
+            break;
+        case 25:
+            this->ofy = (int32_t) value;
+            break;
+        case 26:
+            this->h = (uint16_t) value;
+            break;
+        case 27:
+            this->dqa = (int16_t) value;
+            break;
+        case 28:
+            this->dqb = (int32_t) value;
+            break;
+        case 29:
+            this->zsf3 = (int16_t) value;
+            break;
+        case 30:
+            this->zsf4 = (int16_t) value;
+            break;
+        default:
+            // only bits 30:12 are writable, bit 31 summarizes the error bits
+            this->flag = value & 0x7ffff000u;
+            if ((this->flag & 0x7f87e000u) != 0) {
+                this->flag |= 1u << 31u;
+            }
+            break;
+    }
+}
+
+// execute a GTE command (COP2 imm25)
+void Gte::command(const uint32_t &command) {
+    this->flag = 0;
+    auto shift = ((command >> 19u) & 1u) * 12u;
+    bool lm = ((command >> 10u) & 1u) != 0;
+
+    switch (command & 0x3fu) {
+        case 0x01: this->cmdRtps(command); break;
+        case 0x06: this->cmdNclip(); break;
+        case 0x0c: this->cmdOp(shift, lm); break;
+        case 0x10: this->cmdDpcs(this->rgbc, shift, lm); break;
+        case 0x11: this->cmdIntpl(shift, lm); break;
+        case 0x12: this->cmdMvmva(command, shift, lm); break;
+        case 0x13: this->cmdNcds(0, shift, lm); break;
+        case 0x14: this->cmdCdp(shift, lm); break;
+        case 0x16:
+            for (uint32_t i = 0; i < 3; i++) {
+                this->cmdNcds(i, shift, lm);
+            }
+            break;
+        case 0x1b: this->cmdNccs(0, shift, lm); break;
+        case 0x1c: this->cmdCc(shift, lm); break;
+        case 0x1e: this->cmdNcs(0, shift, lm); break;
+        case 0x20:
+            for (uint32_t i = 0; i < 3; i++) {
+                this->cmdNcs(i, shift, lm);
+            }
+            break;
+        case 0x28: this->cmdSqr(shift, lm); break;
+        case 0x29: this->cmdDcpl(shift, lm); break;
+        case 0x2a:
+            // DPCT: depth cueing of the three colors of the FIFO, each push moves the next one to the front
+            for (uint32_t i = 0; i < 3; i++) {
+                this->cmdDpcs(this->rgb_fifo[0], shift, lm);
+            }
+            break;
+        case 0x2d: this->cmdAvsz3(); break;
+        case 0x2e: this->cmdAvsz4(); break;
+        case 0x30: this->cmdRtpt(command); break;
+        case 0x3d: this->cmdGpf(shift, lm); break;
+        case 0x3e: this->cmdGpl(shift, lm); break;
+        case 0x3f:
+            for (uint32_t i = 0; i < 3; i++) {
+                this->cmdNccs(i, shift, lm);
+            }
+            break;
+        default:
+            // the unused command numbers leave the registers alone
+            DEBUG("Unknown_GTE_command:_0x" << std::hex << command);
+            break;
+    }
+
+    if ((this->flag & 0x7f87e000u) != 0) {
+        this->flag |= 1u << 31u;
+    }
+}
+
+// check a 44 bit MAC1-MAC3 result for overflows and set the flag bits
+int64_t Gte::checkMac(const uint32_t &index, const int64_t &value, uint32_t &flags) const {
+    if (value > 0x7ffffffffffll) {
+        flags |= 1u << (31u - index);
+    } else if (value < -0x80000000000ll) {
+        flags |= 1u << (28u - index);
+    }
+    // sign extend from 44 bits
+    return (int64_t) ((uint64_t) value << 20u) >> 20u;
+}
+
+int32_t Gte::checkMac0(const int64_t &value, uint32_t &flags) const {
+    if (value > 0x7fffffffll) {
+        flags |= 1u << 16u;
+    } else if (value < -0x80000000ll) {
+        flags |= 1u << 15u;
+    }
+    return (int32_t) value;
+}
+
+int16_t Gte::saturateIr(const uint32_t &index, const int32_t &value, bool lm, uint32_t &flags) const {
+    int32_t min = lm ? 0 : -0x8000;
+    if (value < min || value > 0x7fff) {
+        flags |= 1u << (25u - index);
+    }
+    return (int16_t) std::clamp(value, min, 0x7fff);
+}
+
+void Gte::pushSz(const uint16_t &value) {
+    this->sz[0] = this->sz[1];
+    this->sz[1] = this->sz[2];
+    this->sz[2] = this->sz[3];
+    this->sz[3] = value;
+}
+
+void Gte::pushSxy(const int16_t &x, const int16_t &y) {
+    this->sxy[0][0] = this->sxy[1][0];
+    this->sxy[0][1] = this->sxy[1][1];
+    this->sxy[1][0] = this->sxy[2][0];
+    this->sxy[1][1] = this->sxy[2][1];
+    this->sxy[2][0] = x;
+    this->sxy[2][1] = y;
+}
+
+// push MAC1-MAC3 SAR 4 to the color FIFO, with the code of RGBC
+void Gte::pushColor() {
+    uint8_t color[4];
+    for (uint32_t i = 0; i < 3; i++) {
+        auto value = this->mac[i + 1] >> 4;
+        if (value < 0 || value > 0xff) {
+            this->flag |= 1u << (21u - i);
+        }
+        color[i] = (uint8_t) std::clamp(value, 0, 0xff);
+    }
+    color[3] = this->rgbc[3];
+    std::copy(std::begin(this->rgb_fifo[1]), std::end(this->rgb_fifo[1]), std::begin(this->rgb_fifo[0]));
+    std::copy(std::begin(this->rgb_fifo[2]), std::end(this->rgb_fifo[2]), std::begin(this->rgb_fifo[1]));
+    std::copy(std::begin(color), std::end(color), std::begin(this->rgb_fifo[2]));
+}
+
+void Gte::setMac(const uint32_t &index, const int64_t &value, const uint32_t &shift) {
+    this->mac[index] = (int32_t) (this->checkMac(index, value, this->flag) >> shift);
+}
+
+void Gte::setMacIr(const uint32_t &index, const int64_t &value, const uint32_t &shift, bool lm) {
+    this->setMac(index, value, shift);
+    this->ir[index] = this->saturateIr(index, this->mac[index], lm, this->flag);
+}
+
+// MAC1-MAC3 = (T SHL 12 + M * V) SAR shift, every partial sum is checked for overflows
+void Gte::multiplyMatrix(const int16_t m[3][3], const int16_t vector[3], const int32_t translation[3], const uint32_t &shift, bool lm) {
+    // the vector can be IR1-IR3, which are overwritten row by row
+    int16_t in[3] = {vector[0], vector[1], vector[2]};
+    for (uint32_t i = 0; i < 3; i++) {
+        int64_t value = this->checkMac(i + 1, ((int64_t) translation[i] << 12u) + (int64_t) m[i][0] * in[0], this->flag);
+        value = this->checkMac(i + 1, value + (int64_t) m[i][1] * in[1], this->flag);
+        this->setMacIr(i + 1, value + (int64_t) m[i][2] * in[2], shift, lm);
+    }
+}
+
+// IR = BK SHL 12 + LCM * IR, the light colors seen from the light intensities in IR
+void Gte::lightColor(const uint32_t &shift, bool lm) {
+    this->multiplyMatrix(this->light_color, &this->ir[1], this->background_color, shift, lm);
+}
+
+// MAC = RGB * IR SHL 4, the color of RGBC lit by IR
+void Gte::multiplyColor(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMacIr(i + 1, ((int64_t) this->rgbc[i] * this->ir[i + 1]) << 4u, shift, lm);
+    }
+}
+
+// MAC = MAC + (FC - MAC) * IR0, the depth cueing of the color in MAC1-MAC3
+void Gte::interpolateFarColor(const uint32_t &shift, bool lm) {
+    int64_t in[3] = {this->mac[1], this->mac[2], this->mac[3]};
+    // the difference is saturated without lm
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMacIr(i + 1, ((int64_t) this->far_color[i] << 12u) - in[i], shift, false);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMacIr(i + 1, (int64_t) this->ir[i + 1] * this->ir[0] + in[i], shift, lm);
+    }
+}
+
+// perspective transformation of vector V<index>, does not touch the register state
+RtpResult Gte::computeRtp(const uint32_t &index, const uint32_t &command, bool last) {
+    auto shift = ((command >> 19u) & 1u) * 12u;
+    bool lm = ((command >> 10u) & 1u) != 0;
+    auto& vec = this->v[index];
+
+    RtpResult result = {};
+    result.ir[0] = this->ir[0];
+
+    int64_t z = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+        int64_t value = ((int64_t) this->translation[i] << 12u)
+                + (int64_t) this->rotation[i][0] * vec[0]
+                + (int64_t) this->rotation[i][1] * vec[1]
+                + (int64_t) this->rotation[i][2] * vec[2];
+        value = this->checkMac(i + 1, value, result.flag);
+        result.mac[i + 1] = (int32_t) (value >> shift);
+        z = value >> 12u;
+    }
+
+    result.ir[1] = this->saturateIr(1, result.mac[1], lm, result.flag);
+    result.ir[2] = this->saturateIr(2, result.mac[2], lm, result.flag);
+    // hardware bug: the IR3 saturation flag is computed from the unshifted Z value
+    uint32_t unused = 0;
+    result.ir[3] = this->saturateIr(3, result.mac[3], lm, unused);
+    if (z < -0x8000 || z > 0x7fff) {
+        result.flag |= 1u << 22u;
+    }
+
+    if (z < 0 || z > 0xffff) {
+        result.flag |= 1u << 18u;
+    }
+    result.sz = (uint16_t) std::clamp<int64_t>(z, 0, 0xffff);
+
+    uint32_t n;
+    if (this->h < result.sz * 2u) {
+        n = unrDivide(this->h, result.sz);
+    } else {
+        n = 0x1ffff;
+        result.flag |= 1u << 17u;
+    }
+
+    auto x = this->checkMac0((int64_t) n * result.ir[1] + this->ofx, result.flag) >> 16;
+    if (x < -0x400 || x > 0x3ff) {
+        result.flag |= 1u << 14u;
+    }
+    result.sx = (int16_t) std::clamp(x, -0x400, 0x3ff);
+
+    result.mac[0] = this->checkMac0((int64_t) n * result.ir[2] + this->ofy, result.flag);
+    auto y = result.mac[0] >> 16;
+    if (y < -0x400 || y > 0x3ff) {
+        result.flag |= 1u << 13u;
+    }
+    result.sy = (int16_t) std::clamp(y, -0x400, 0x3ff);
+
+    // depth cueing, only for the last vertex
+    if (last) {
+        result.mac[0] = this->checkMac0((int64_t) n * this->dqa + this->dqb, result.flag);
+        auto depth = result.mac[0] >> 12;
+        if (depth < 0 || depth > 0x1000) {
+            result.flag |= 1u << 12u;
+        }
+        result.ir[0] = (int16_t) std::clamp(depth, 0, 0x1000);
+    }
+
+    return result;
+}
+
+void Gte::applyRtp(const RtpResult &result) {
+    std::copy(std::begin(result.mac), std::end(result.mac), std::begin(this->mac));
+    std::copy(std::begin(result.ir), std::end(result.ir), std::begin(this->ir));
+    this->pushSz(result.sz);
+    this->pushSxy(result.sx, result.sy);
+    this->flag |= result.flag;
+}
+
+// transform a single vertex, going through the result cache if enabled
+void Gte::rtp(const uint32_t &index, const uint32_t &command, bool last) {
+    if (this->rtp_cache == nullptr) {
+        return this->applyRtp(this->computeRtp(index, command, last));
+    }
+
+    RtpKey key = {};
+    for (int i = 0; i < 9; i++) {
+        key.rotation[i] = this->rotation[i / 3][i % 3];
+    }
+    std::copy(std::begin(this->translation), std::end(this->translation), std::begin(key.translation));
+    std::copy(std::begin(this->v[index]), std::end(this->v[index]), std::begin(key.vertex));
+    key.ofx = this->ofx;
+    key.ofy = this->ofy;
+    key.h = this->h;
+    key.dqa = this->dqa;
+    key.dqb = this->dqb;
+    // only the sf and lm bits change the result. non-last vertices keep IR0, so they are keyed separately
+    key.sf_lm = (command & ((1u << 19u) | (1u << 10u))) | (uint32_t) last;
+
+    auto& entry = this->rtp_cache[hashRtpKey(key) % RTP_CACHE_SIZE];
+    if (entry.valid && entry.key == key) {
+        this->rtp_cache_hits++;
+    } else {
+        this->rtp_cache_misses++;
+        entry.valid = true;
+        entry.key = key;
+        entry.result = this->computeRtp(index, command, last);
+    }
+
+    auto result = entry.result;
+    if (!last) {
+        result.ir[0] = this->ir[0];
+    }
+    this->applyRtp(result);
+}
+
+// RTPS: perspective transformation of V0
+void Gte::cmdRtps(const uint32_t &command) {
+    this->rtp(0, command, true);
+}
+
+// RTPT: perspective transformation of V0, V1 and V2
+void Gte::cmdRtpt(const uint32_t &command) {
+    this->rtp(0, command, false);
+    this->rtp(1, command, false);
+    this->rtp(2, command, true);
+}
+
+// NCLIP: normal clipping, MAC0 = signed area of the screen triangle
+void Gte::cmdNclip() {
+    auto& s = this->sxy;
+    int64_t value = (int64_t) s[0][0] * s[1][1] + (int64_t) s[1][0] * s[2][1] + (int64_t) s[2][0] * s[0][1]
+            - (int64_t) s[0][0] * s[2][1] - (int64_t) s[1][0] * s[0][1] - (int64_t) s[2][0] * s[1][1];
+    this->mac[0] = this->checkMac0(value, this->flag);
+}
+
+// set OTZ from MAC0, shared by AVSZ3 and AVSZ4
+void setOtz(int32_t mac0, uint16_t& otz, uint32_t& flag) {
+    auto value = mac0 >> 12;
+    if (value < 0 || value > 0xffff) {
+        flag |= 1u << 18u;
+    }
+    otz = (uint16_t) std::clamp(value, 0, 0xffff);
+}
+
+// AVSZ3: average of three Z values
+void Gte::cmdAvsz3() {
+    int64_t sum = (int64_t) this->sz[1] + this->sz[2] + this->sz[3];
+    this->mac[0] = this->checkMac0((int64_t) this->zsf3 * sum, this->flag);
+    setOtz(this->mac[0], this->otz, this->flag);
+}
+
+// AVSZ4: average of four Z values
+void Gte::cmdAvsz4() {
+    int64_t sum = (int64_t) this->sz[0] + this->sz[1] + this->sz[2] + this->sz[3];
+    this->mac[0] = this->checkMac0((int64_t) this->zsf4 * sum, this->flag);
+    setOtz(this->mac[0], this->otz, this->flag);
+}
+
+// OP: outer product of the rotation matrix diagonal and IR
+void Gte::cmdOp(const uint32_t &shift, bool lm) {
+    int64_t d[3] = {this->rotation[0][0], this->rotation[1][1], this->rotation[2][2]};
+    int64_t in[3] = {this->ir[1], this->ir[2], this->ir[3]};
+    this->setMacIr(1, d[1] * in[2] - d[2] * in[1], shift, lm);
+    this->setMacIr(2, d[2] * in[0] - d[0] * in[2], shift, lm);
+    this->setMacIr(3, d[0] * in[1] - d[1] * in[0], shift, lm);
+}
+
+// MVMVA: multiply a matrix and a vector, plus a translation, all selected by the command
+void Gte::cmdMvmva(const uint32_t &command, const uint32_t &shift, bool lm) {
+    static const int32_t NO_TRANSLATION[3] = {};
+    auto mx = (command >> 17u) & 3u;
+    auto vx = (command >> 15u) & 3u;
+    auto cv = (command >> 13u) & 3u;
+
+    // matrix 3 is made of whatever is on the internal bus
+    auto r = (int16_t) (this->rgbc[0] << 4u);
+    int16_t garbage[3][3] = {
+        {(int16_t) -r, r, this->ir[0]},
+        {this->rotation[0][2], this->rotation[0][2], this->rotation[0][2]},
+        {this->rotation[1][1], this->rotation[1][1], this->rotation[1][1]},
+    };
+    const int16_t (*m)[3] = mx == 0 ? this->rotation : mx == 1 ? this->light : mx == 2 ? this->light_color : garbage;
+    const int16_t* vector = vx == 3 ? &this->ir[1] : this->v[vx];
+    int16_t in[3] = {vector[0], vector[1], vector[2]};
+    const int32_t* translation = cv == 0 ? this->translation : cv == 1 ? this->background_color
+            : cv == 2 ? this->far_color : NO_TRANSLATION;
+
+    if (cv != 2) {
+        return this->multiplyMatrix(m, in, translation, shift, lm);
+    }
+    // hardware bug: with the far color the first column only sets the flags, it is left out of the result
+    for (uint32_t i = 0; i < 3; i++) {
+        int64_t first = this->checkMac(i + 1, ((int64_t) translation[i] << 12u) + (int64_t) m[i][0] * in[0], this->flag);
+        this->saturateIr(i + 1, (int32_t) (first >> shift), false, this->flag);
+        int64_t value = this->checkMac(i + 1, (int64_t) m[i][1] * in[1], this->flag);
+        this->setMacIr(i + 1, value + (int64_t) m[i][2] * in[2], shift, lm);
+    }
+}
+
+// NCS: normal color of V<index>, from the light matrix and the light colors
+void Gte::cmdNcs(const uint32_t &index, const uint32_t &shift, bool lm) {
+    static const int32_t NO_TRANSLATION[3] = {};
+    this->multiplyMatrix(this->light, this->v[index], NO_TRANSLATION, shift, lm);
+    this->lightColor(shift, lm);
+    this->pushColor();
+}
+
+// NCCS: normal color of V<index> applied to RGBC
+void Gte::cmdNccs(const uint32_t &index, const uint32_t &shift, bool lm) {
+    static const int32_t NO_TRANSLATION[3] = {};
+    this->multiplyMatrix(this->light, this->v[index], NO_TRANSLATION, shift, lm);
+    this->lightColor(shift, lm);
+    this->multiplyColor(shift, lm);
+    this->pushColor();
+}
+
+// NCDS: normal color of V<index> applied to RGBC, with depth cueing
+void Gte::cmdNcds(const uint32_t &index, const uint32_t &shift, bool lm) {
+    static const int32_t NO_TRANSLATION[3] = {};
+    this->multiplyMatrix(this->light, this->v[index], NO_TRANSLATION, shift, lm);
+    this->lightColor(shift, lm);
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMac(i + 1, ((int64_t) this->rgbc[i] * this->ir[i + 1]) << 4u, 0);
+    }
+    this->interpolateFarColor(shift, lm);
+    this->pushColor();
+}
+
+// CC: like NCCS from light intensities already in IR
+void Gte::cmdCc(const uint32_t &shift, bool lm) {
+    this->lightColor(shift, lm);
+    this->multiplyColor(shift, lm);
+    this->pushColor();
+}
+
+// CDP: like NCDS from light intensities already in IR
+void Gte::cmdCdp(const uint32_t &shift, bool lm) {
+    this->lightColor(shift, lm);
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMac(i + 1, ((int64_t) this->rgbc[i] * this->ir[i + 1]) << 4u, 0);
+    }
+    this->interpolateFarColor(shift, lm);
+    this->pushColor();
+}
+
+// DPCS: depth cueing of a color, RGBC or the front of the color FIFO for DPCT
+void Gte::cmdDpcs(const uint8_t color[4], const uint32_t &shift, bool lm) {
+    // the FIFO moves when the result is pushed
+    uint8_t in[3] = {color[0], color[1], color[2]};
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMac(i + 1, (int64_t) in[i] << 16u, 0);
+    }
+    this->interpolateFarColor(shift, lm);
+    this->pushColor();
+}
+
+// DCPL: depth cueing of RGBC lit by IR
+void Gte::cmdDcpl(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMac(i + 1, ((int64_t) this->rgbc[i] * this->ir[i + 1]) << 4u, 0);
+    }
+    this->interpolateFarColor(shift, lm);
+    this->pushColor();
+}
+
+// INTPL: interpolation of IR and the far color
+void Gte::cmdIntpl(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMac(i + 1, (int64_t) this->ir[i + 1] << 12u, 0);
+    }
+    this->interpolateFarColor(shift, lm);
+    this->pushColor();
+}
+
+// SQR: square of IR
+void Gte::cmdSqr(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMacIr(i + 1, (int64_t) this->ir[i + 1] * this->ir[i + 1], shift, lm);
+    }
+}
+
+// GPF: IR scaled by IR0
+void Gte::cmdGpf(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        this->setMacIr(i + 1, (int64_t) this->ir[0] * this->ir[i + 1], shift, lm);
+    }
+    this->pushColor();
+}
+
+// GPL: IR scaled by IR0, added to MAC
+void Gte::cmdGpl(const uint32_t &shift, bool lm) {
+    for (uint32_t i = 0; i < 3; i++) {
+        int64_t base = (int64_t) this->mac[i + 1] << shift;
+        this->setMacIr(i + 1, base + (int64_t) this->ir[0] * this->ir[i + 1], shift, lm);
+    }
+    this->pushColor();
+}
+
+// the RTP cache is keyed on all of its inputs, so it stays valid across a state load
+void Gte::serialize(Savestate &state) {
+    state.section("GTE ");
+    state.value(this->v);
+    state.value(this->rgbc);
+    state.value(this->otz);
+    state.value(this->ir);
+    state.value(this->sxy);
+    state.value(this->sz);
+    state.value(this->rgb_fifo);
+    state.value(this->res1);
+    state.value(this->mac);
+    state.value(this->lzcs);
+    state.value(this->lzcr);
+    state.value(this->rotation);
+    state.value(this->translation);
+    state.value(this->light);
+    state.value(this->background_color);
+    state.value(this->light_color);
+    state.value(this->far_color);
+    state.value(this->ofx);
+    state.value(this->ofy);
+    state.value(this->h);
+    state.value(this->dqa);
+    state.value(this->dqb);
+    state.value(this->zsf3);
+    state.value(this->zsf4);
+    state.value(this->flag);
+}
@@ -0,0 +1,130 @@
+#ifndef PSXEMU_GTE_H
+#define PSXEMU_GTE_H
+
+#include <cstdint>
+#include <memory>
+
+class Savestate;
+
+// number of entries of the direct mapped RTPS/RTPT result cache
+const uint32_t RTP_CACHE_SIZE = 4096;
+
+// everything that influences the result of a single vertex perspective transformation
+struct RtpKey {
+    int16_t rotation[9];
+    int32_t translation[3];
+    int16_t vertex[3];
+    int32_t ofx, ofy;
+    uint16_t h;
+    int16_t dqa;
+    int32_t dqb;
+    uint32_t sf_lm; // shift and limit bits of the command
+
+    bool operator==(const RtpKey& other) const;
+};
+
+// output of a single vertex perspective transformation
+struct RtpResult {
+    int32_t mac[4];
+    int16_t ir[4];
+    uint16_t sz;
+    int16_t sx, sy;
+    uint32_t flag;
+};
+
+struct RtpCacheEntry {
+    bool valid;
+    RtpKey key;
+    RtpResult result;
+};
+
+// Geometry Transformation Engine (coprocessor 2)
+// http://problemkaputt.de/psx-spx.htm#geometrytransformationenginegte
+class Gte {
+public:
+    Gte();
+
+    uint32_t getData(const uint32_t& reg) const;
+    void setData(const uint32_t& reg, const uint32_t& value);
+    uint32_t getControl(const uint32_t& reg) const;
+    void setControl(const uint32_t& reg, const uint32_t& value);
+    void command(const uint32_t& command);
+    void serialize(Savestate& state);
+
+    // RTPS/RTPT memoization for static geometry, disabled by default
+    void enableRtpCache(bool enable);
+    bool rtpCacheEnabled() const { return this->rtp_cache != nullptr; }
+    uint64_t rtp_cache_hits = 0;
+    uint64_t rtp_cache_misses = 0;
+    double rtpCacheHitRate() const;
+
+private:
+    // data registers
+    int16_t v[3][3] = {}; // input vectors V0-V2 (x, y, z)
+    uint8_t rgbc[4] = {}; // color and code value
+    uint16_t otz = 0; // average Z value for ordering tables
+    int16_t ir[4] = {}; // 16bit accumulators IR0-IR3
+    int16_t sxy[3][2] = {}; // screen XY coordinate FIFO
+    uint16_t sz[4] = {}; // screen Z coordinate FIFO
+    uint8_t rgb_fifo[3][4] = {}; // color FIFO
+    uint32_t res1 = 0; // prohibited register, still read/writable
+    int32_t mac[4] = {}; // 32bit accumulators MAC0-MAC3
+    uint32_t lzcs = 0; // leading zeroes count source
+    uint32_t lzcr = 32; // leading zeroes count result
+
+    // control registers
+    int16_t rotation[3][3] = {}; // rotation matrix
+    int32_t translation[3] = {}; // translation vector
+    int16_t light[3][3] = {}; // light source matrix
+    int32_t background_color[3] = {};
+    int16_t light_color[3][3] = {}; // light color matrix
+    int32_t far_color[3] = {};
+    int32_t ofx = 0, ofy = 0; // screen offset (16.16 fixed point)
+    uint16_t h = 0; // projection plane distance
+    int16_t dqa = 0; // depth queuing coefficient
+    int32_t dqb = 0; // depth queuing offset
+    int16_t zsf3 = 0, zsf4 = 0; // average Z scale factors
+    uint32_t flag = 0; // calculation errors
+
+    std::unique_ptr<RtpCacheEntry[]> rtp_cache;
+
+    void cmdRtps(const uint32_t& command);
+    void cmdRtpt(const uint32_t& command);
+    void cmdNclip();
+    void cmdAvsz3();
+    void cmdAvsz4();
+    void cmdOp(const uint32_t& shift, bool lm);
+    void cmdMvmva(const uint32_t& command, const uint32_t& shift, bool lm);
+    void cmdNcs(const uint32_t& index, const uint32_t& shift, bool lm);
+    void cmdNccs(const uint32_t& index, const uint32_t& shift, bool lm);
+    void cmdNcds(const uint32_t& index, const uint32_t& shift, bool lm);
+    void cmdCc(const uint32_t& shift, bool lm);
+    void cmdCdp(const uint32_t& shift, bool lm);
+    void cmdDpcs(const uint8_t color[4], const uint32_t& shift, bool lm);
+    void cmdDcpl(const uint32_t& shift, bool lm);
+    void cmdIntpl(const uint32_t& shift, bool lm);
+    void cmdSqr(const uint32_t& shift, bool lm);
+    void cmdGpf(const uint32_t& shift, bool lm);
+    void cmdGpl(const uint32_t& shift, bool lm);
+
+    void rtp(const uint32_t& index, const uint32_t& command, bool last);
+    RtpResult computeRtp(const uint32_t& index, const uint32_t& command, bool last);
+    void applyRtp(const RtpResult& result);
+
+    int64_t checkMac(const uint32_t& index, const int64_t& value, uint32_t& flags) const;
+    int32_t checkMac0(const int64_t& value, uint32_t& flags) const;
+    int16_t saturateIr(const uint32_t& index, const int32_t& value, bool lm, uint32_t& flags) const;
+    void pushSz(const uint16_t& value);
+    void pushSxy(const int16_t& x, const int16_t& y);
+    void pushColor();
+
+    void setMac(const uint32_t& index, const int64_t& value, const uint32_t& shift);
+    void setMacIr(const uint32_t& index, const int64_t& value, const uint32_t& shift, bool lm);
+    void multiplyMatrix(const int16_t m[3][3], const int16_t vector[3], const int32_t translation[3], const uint32_t& shift, bool lm);
+    void lightColor(const uint32_t& shift, bool lm);
+    void multiplyColor(const uint32_t& shift, bool lm);
+    void interpolateFarColor(const uint32_t& shift, bool lm);
+};
+
+
+#endif //PSXEMU_GTE_H
@@ -172,6 +172,8 @@ void Cpu::OP_J(const Instruction& instruction) {
 
     // immediate is shifted 2 to the right, because the two LSBs of pc are always zero anyway (due to the 32bit boundary)
     this->next_pc = (this->next_pc & 0xf0000000u) | (immediate << 2u);
+
+    this->detectIdleLoop(this->next_pc);
 }
 
 // jump and link
@@ -228,6 +230,8 @@ void Cpu::branch(uint32_t offset) {
 
     this->next_pc = this->next_pc + off;
     this->next_pc = this->next_pc - 4; // compensate for the pc += 4 of run_next_instruction
+
+    this->detectIdleLoop(this->next_pc);
 }
 
 // branch (if) not equal
@@ -278,6 +282,7 @@ void Cpu::OP_MTC0(const Instruction& instruction) {
     auto cop_r = instruction.d().index; // which register of cop0 to load into
 
     auto value = this->getRegister(cpu_r);
+    this->idle.side_effects = true;
 
     switch (cop_r) {
         case 3:
@@ -290,14 +295,16 @@ void Cpu::OP_MTC0(const Instruction& instruction) {
                 DEBUG("Unhandled_write_to_cop0_register:_" << std::dec << cop_r);
                 throw std::exception();
             }
+            break;
         case 12: // status register
             this->sr = value;
+            // interrupts may have been unmasked
+            this->scheduler->schedule(InterruptCheckEvent, 0);
+            break;
+        case 13: // cause register, only the software interrupt bits are writable
+            this->cause = (this->cause & ~0x300u) | (value & 0x300u);
+            this->scheduler->schedule(InterruptCheckEvent, 0);
             break;
-        case 13: // cause register, for exceptions
-            if (value != 0) {
-                DEBUG("Unhandled_write_to_CAUSE_register:_" << std::dec << value);
-                throw std::exception();
-            }
         default:
             DEBUG("STUB:Unhandled_cop0_register:_" << std::dec << cop_r);
     }
@@ -331,7 +338,8 @@ void Cpu::OP_JR(const Instruction &instruction) {
     this->next_pc= this->getRegister(s);
 }
 
-uint8_t Cpu::load8(const uint32_t& address) const {
+uint8_t Cpu::load8(const uint32_t& address) {
+    this->noteVolatileLoad(address);
     return this->interconnect->load8(address);
 }
 
@@ -667,6 +675,8 @@ void Cpu::OP_RFE(const Instruction &instruction) {
     auto mode = this->sr & 0x3fu;
     this->sr &= ~0x3fu;
     this->sr |= mode >> 2u;
+    // interrupts may have been unmasked
+    this->scheduler->schedule(InterruptCheckEvent, 0);
 }
 
 // load halfword unsigned
@@ -778,8 +788,60 @@ void Cpu::OP_COP3(const Instruction &instruction) {
 
 // coprocessor 2, GTE (geometry transform engine)
 void Cpu::OP_COP2(const Instruction &instruction) {
-    DEBUG("STUB:unhandled_GTE_instruction:_x0" << std::hex << instruction.opcode);
-    throw std::exception();
+    // the GTE must be enabled in the status register
+    if ((this->sr & (1u << 30u)) == 0) {
+        return this->exception(CoprocessorError);
+    }
+
+    // GTE state is not part of the idle loop detection
+    this->idle.side_effects = true;
+
+    // bit 25 set: GTE command, lower 25 bits are the command word
+    if ((instruction.opcode & (1u << 25u)) != 0) {
+        return this->gte.command(instruction.opcode & 0x1ffffffu);
+    }
+
+    switch (instruction.cop_opcode()) {
+        case 0b00000: this->OP_MFC2(instruction); break;
+        case 0b00010: this->OP_CFC2(instruction); break;
+        case 0b00100: this->OP_MTC2(instruction); break;
+        case 0b00110: this->OP_CTC2(instruction); break;
+        default:
+            DEBUG("STUB:unhandled_GTE_instruction:_x0" << std::hex << instruction.opcode);
+            throw std::exception();
+    }
+}
+
+// move from coprocessor2 data register
+void Cpu::OP_MFC2(const Instruction &instruction) {
+    auto cpu_r = instruction.t();
+    auto cop_r = instruction.d().index;
+
+    this->load = {cpu_r, this->gte.getData(cop_r)};
+}
+
+// move from coprocessor2 control register
+void Cpu::OP_CFC2(const Instruction &instruction) {
+    auto cpu_r = instruction.t();
+    auto cop_r = instruction.d().index;
+
+    this->load = {cpu_r, this->gte.getControl(cop_r)};
+}
+
+// move to coprocessor2 data register
+void Cpu::OP_MTC2(const Instruction &instruction) {
+    auto cpu_r = instruction.t();
+    auto cop_r = instruction.d().index;
+
+    this->gte.setData(cop_r, this->getRegister(cpu_r));
+}
+
+// move to coprocessor2 control register
+void Cpu::OP_CTC2(const Instruction &instruction) {
+    auto cpu_r = instruction.t();
+    auto cop_r = instruction.d().index;
+
+    this->gte.setControl(cop_r, this->getRegister(cpu_r));
 }
 
 // load word left (little endian only)
@@ -910,8 +972,18 @@ void Cpu::OP_LWC1(const Instruction& instruction) {
     this->exception(CoprocessorError);
 }
 void Cpu::OP_LWC2(const Instruction& instruction) {
-    DEBUG("Unhandled_GTE_LWC_instruction:_0x" << std::hex << instruction.opcode);
-    throw std::exception();
+    auto immediate = instruction.imm_se();
+    auto s = instruction.s();
+
+    auto addr = this->getRegister(s) + immediate;
+
+    if (addr % 4 != 0) {
+        return this->exception(LoadAddressError);
+    }
+
+    // target register index is in the t field, but refers to a GTE data register
+    this->idle.side_effects = true;
+    this->gte.setData(instruction.t().index, this->load32(addr));
 }
 void Cpu::OP_LWC3(const Instruction& instruction) {
     // not supported by c3
@@ -928,8 +1000,16 @@ void Cpu::OP_SWC1(const Instruction& instruction) {
     this->exception(CoprocessorError);
 }
 void Cpu::OP_SWC2(const Instruction& instruction) {
-    DEBUG("Unhandled_GTE_SWC_instruction:_0x" << std::hex << instruction.opcode);
-    throw std::exception();
+    auto immediate = instruction.imm_se();
+    auto s = instruction.s();
+
+    auto addr = this->getRegister(s) + immediate;
+
+    if (addr % 4 != 0) {
+        return this->exception(StoreAddressError);
+    }
+
+    this->store32(addr, this->gte.getData(instruction.t().index));
 }
 void Cpu::OP_SWC3(const Instruction& instruction) {
     // not supported by c3
@@ -8,4 +8,13 @@
 const uint16_t SCREEN_WIDTH_PX = 1024;
 const uint16_t SCREEN_HEIGHT_PX = 512;
 
+// http://problemkaputt.de/psx-spx.htm#gputimings
+const uint64_t CPU_CLOCK_HZ = 33868800;
+const uint64_t NTSC_GPU_CLOCK_HZ = 53693175;
+const uint64_t PAL_GPU_CLOCK_HZ = 53203425;
+const uint64_t NTSC_GPU_CYCLES_PER_LINE = 3413;
+const uint64_t PAL_GPU_CYCLES_PER_LINE = 3406;
+const uint64_t NTSC_LINES_PER_FRAME = 263;
+const uint64_t PAL_LINES_PER_FRAME = 314;
+
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "../util/logging.h"
 #include <exception>
 #include "CommandBuffer.h"
+#include "Constants.h"
+#include "../state/Savestate.h"
 
 // Return the horizontal resolution from the 2 bit field hr1 and the one bit field hr1
 HorizontalResolution from_fields(const uint8_t& hr1, const uint8_t& hr2) 
@@ -91,75 +93,228 @@ uint32_t Gpu::status_read()
     return regval;
 }
 
+// Number of CPU cycles between two vertical blanks, depending on the video mode
+uint64_t Gpu::cpu_cycles_per_frame() const
+{
+    if (this->vmode == PAL)
+    {
+        return PAL_LINES_PER_FRAME * PAL_GPU_CYCLES_PER_LINE * CPU_CLOCK_HZ / PAL_GPU_CLOCK_HZ;
+    }
+    return NTSC_LINES_PER_FRAME * NTSC_GPU_CYCLES_PER_LINE * CPU_CLOCK_HZ / NTSC_GPU_CLOCK_HZ;
+}
+
+// GPU clock in Hz, depending on the video mode
+uint64_t Gpu::clock_hz() const
+{
+    return this->vmode == PAL ? PAL_GPU_CLOCK_HZ : NTSC_GPU_CLOCK_HZ;
+}
+
+// Number of GPU cycles per scanline, depending on the video mode
+uint64_t Gpu::cycles_per_line() const
+{
+    return this->vmode == PAL ? PAL_GPU_CYCLES_PER_LINE : NTSC_GPU_CYCLES_PER_LINE;
+}
+
+// Number of GPU cycles per pixel (dot), depending on the horizontal resolution
+uint64_t Gpu::dotclock_divider() const
+{
+    if ((this->hres & 1) != 0)
+    {
+        return 7; // 368 pixels
+    }
+    switch ((this->hres >> 1) & 3)
+    {
+        case 0:
+            return 10; // 256 pixels
+        case 1:
+            return 8; // 320 pixels
+        case 2:
+            return 5; // 512 pixels
+        default:
+            return 4; // 640 pixels
+    }
+}
+
+void Gpu::set_headless(const bool& headless)
+{
+    if (this->renderer != nullptr)
+    {
+        // the rasterizer takes over from what the renderer drew
+        if (headless)
+        {
+            this->sync_vram();
+        }
+        this->renderer->headless = headless;
+    }
+}
+
+// Bring 'vram' up to date with the frame the renderer is drawing
+void Gpu::sync_vram()
+{
+    if (this->renderer != nullptr)
+    {
+        this->renderer->download_vram({0, 0, VRAM_WIDTH, VRAM_HEIGHT});
+    }
+}
+
+// The software rasterizer only draws the frames no renderer draws
+bool Gpu::rasterizing() const
+{
+    return this->renderer == nullptr || this->renderer->headless;
+}
+
+// Called by the scheduler at the start of the vertical blank
+void Gpu::vblank()
+{
+    if (this->renderer != nullptr)
+    {
+        this->renderer->display();
+    }
+}
+
+// Drawing settings for the software rasterizer
+RasterState Gpu::raster_state(const bool& semi_transparent) const
+{
+    RasterState state;
+    state.left = this->drawing_area_left;
+    state.top = this->drawing_area_top;
+    state.right = this->drawing_area_right;
+    state.bottom = this->drawing_area_bottom;
+    state.offset_x = this->drawing_x_offset;
+    state.offset_y = this->drawing_y_offset;
+    state.force_set_mask_bit = this->force_set_mask_bit;
+    state.preserve_masked_pixels = this->preserve_masked_pixels;
+    state.window_mask_x = (uint8_t)(this->texture_window_x_mask * 8);
+    state.window_mask_y = (uint8_t)(this->texture_window_y_mask * 8);
+    state.window_offset_x = (uint8_t)(this->texture_window_x_offset * 8);
+    state.window_offset_y = (uint8_t)(this->texture_window_y_offset * 8);
+    state.semi_transparent = semi_transparent;
+    state.semi_transparency = this->semi_transparency;
+    return state;
+}
+
+// Attributes of a primitive for the renderer, with the current texture page and mask settings
+Primitive Gpu::primitive(const bool& textured, const bool& semi_transparent, const uint16_t& clut) const
+{
+    GLushort page = (GLushort)(this->page_base_x | (this->page_base_y << 4) | (this->texture_depth << 7));
+    GLushort flags = (GLushort)(this->semi_transparency << PRIMITIVE_MODE_SHIFT);
+    if (textured)
+    {
+        flags |= PRIMITIVE_TEXTURED;
+    }
+    if (semi_transparent)
+    {
+        flags |= PRIMITIVE_SEMI_TRANSPARENT;
+    }
+    if (this->force_set_mask_bit)
+    {
+        flags |= PRIMITIVE_FORCE_MASK;
+    }
+    if (this->preserve_masked_pixels)
+    {
+        flags |= PRIMITIVE_CHECK_MASK;
+    }
+    return Primitive(page, clut, flags);
+}
+
+// Parse a vertex for the rasterizer from a gp0 position and colour param
+static RasterVertex vertex_from_gp0(const uint32_t& position, const uint32_t& color)
+{
+    RasterVertex vertex;
+    // 11 bit signed coordinates
+    vertex.x = (int32_t)(int16_t)(position << 5) >> 5;
+    vertex.y = (int32_t)(int16_t)((position >> 16) << 5) >> 5;
+    vertex.r = (uint8_t)color;
+    vertex.g = (uint8_t)(color >> 8);
+    vertex.b = (uint8_t)(color >> 16);
+    vertex.u = 0;
+    vertex.v = 0;
+    return vertex;
+}
+
+// Select the handler and parameter count of the GP0 command starting with 'value'
+void Gpu::gp0_decode(const uint32_t& value)
+{
+    uint32_t opcode = (value >> 24) & 0xff;
+
+    switch (opcode) {
+        case 0x00: 
+            this->current_command.command_method = &Gpu::gp0_nop;
+            this->current_command.command.len    = 1;
+            break;
+        case 0x01:
+            this->current_command.command_method = &Gpu::gp0_clear_cache;
+            this->current_command.command.len    = 1;
+            break;
+        case 0x1f:
+            this->current_command.command_method = &Gpu::gp0_interrupt_request;
+            this->current_command.command.len    = 1;
+            break;
+        case 0x28:
+        case 0x2a:
+            this->current_command.command_method = &Gpu::gp0_quad_mono;
+            this->current_command.command.len    = 5;
+            break;
+        case 0x2c:
+        case 0x2e:
+            this->current_command.command_method = &Gpu::gp0_quad_texture_blend;
+            this->current_command.command.len    = 9;
+            break;
+        case 0x30:
+        case 0x32:
+            this->current_command.command_method = &Gpu::gp0_triangle_shaded;
+            this->current_command.command.len    = 6;
+            break;
+        case 0x38:
+        case 0x3a:
+            this->current_command.command_method = &Gpu::gp0_quad_shaded;
+            this->current_command.command.len    = 8;
+            break;
+        case 0xa0:
+            this->current_command.command_method = &Gpu::gp0_image_load;
+            this->current_command.command.len    = 3; // param 2 and 3 are used to calculate num of words used in transfer
+            break;
+        case 0xc0:
+            this->current_command.command_method = &Gpu::gp0_image_store;
+            this->current_command.command.len    = 3; // just as 0xA0
+        case 0xe1:
+            this->current_command.command_method = &Gpu::gp0_draw_mode;
+            this->current_command.command.len    = 1;
+            break;
+        case 0xe2:
+            this->current_command.command_method = &Gpu::gp0_texture_window;
+            this->current_command.command.len    = 1;
+            break;
+        case 0xe3:
+            this->current_command.command_method = &Gpu::gp0_set_drawing_area_top_left;
+            this->current_command.command.len    = 1;
+            break;
+        case 0xe4:
+            this->current_command.command_method = &Gpu::gp0_set_drawing_area_bottom_right;
+            this->current_command.command.len    = 1;
+            break;
+        case 0xe5:
+            this->current_command.command_method = &Gpu::gp0_drawing_offset;
+            this->current_command.command.len    = 1;
+            break;
+        case 0xe6:
+            this->current_command.command_method = &Gpu::gp0_mask_bit_setting;
+            this->current_command.command.len    = 1;
+            break;
+        default:
+            DEBUG("Unhandled_GP0_command_0x" << std::hex << value);
+            throw std::exception();
+            break;
+    }
+}
+
 // Handles write to the GP0 command register
 void Gpu::gp0(const uint32_t& value)
 {
     // if a new command should be fetched
     if (this->current_command.words_remaining == 0)
     {
-        uint32_t opcode = (value >> 24) & 0xff;
-
-        switch (opcode) {
-            case 0x00: 
-                this->current_command.command_method = &Gpu::gp0_nop;
-                this->current_command.command.len    = 1;
-                break;
-            case 0x01:
-                this->current_command.command_method = &Gpu::gp0_clear_cache;
-                this->current_command.command.len    = 1;
-                break;
-            case 0x28:
-                this->current_command.command_method = &Gpu::gp0_quad_mono_opaque;
-                this->current_command.command.len    = 5;
-                break;
-            case 0x2c:
-                this->current_command.command_method = &Gpu::gp0_quad_texture_blend_opaque;
-                this->current_command.command.len    = 9;
-                break;
-            case 0x30:
-                this->current_command.command_method = &Gpu::gp0_triangle_shaded_opaque;
-                this->current_command.command.len    = 6;
-                break;
-            case 0x38:
-                this->current_command.command_method = &Gpu::gp0_quad_shaded_opaque;
-                this->current_command.command.len    = 8;
-                break;
-            case 0xa0:
-                this->current_command.command_method = &Gpu::gp0_image_load;
-                this->current_command.command.len    = 3; // param 2 and 3 are used to calculate num of words used in transfer
-                break;
-            case 0xc0:
-                this->current_command.command_method = &Gpu::gp0_image_store;
-                this->current_command.command.len    = 3; // just as 0xA0
-            case 0xe1:
-                this->current_command.command_method = &Gpu::gp0_draw_mode;
-                this->current_command.command.len    = 1;
-                break;
-            case 0xe2:
-                this->current_command.command_method = &Gpu::gp0_texture_window;
-                this->current_command.command.len    = 1;
-                break;
-            case 0xe3:
-                this->current_command.command_method = &Gpu::gp0_set_drawing_area_top_left;
-                this->current_command.command.len    = 1;
-                break;
-            case 0xe4:
-                this->current_command.command_method = &Gpu::gp0_set_drawing_area_bottom_right;
-                this->current_command.command.len    = 1;
-                break;
-            case 0xe5:
-                this->current_command.command_method = &Gpu::gp0_drawing_offset;
-                this->current_command.command.len    = 1;
-                break;
-            case 0xe6:
-                this->current_command.command_method = &Gpu::gp0_mask_bit_setting;
-                this->current_command.command.len    = 1;
-                break;
-            default:
-                DEBUG("Unhandled_GP0_command_0x" << std::hex << value);
-                throw std::exception();
-                break;
-        }
+        this->gp0_decode(value);
         this->current_command.words_remaining = this->current_command.command.len;
         this->current_command.command.clear();
     }
@@ -274,11 +429,27 @@ void Gpu::gp0_nop(const uint32_t& value)
 // GP0(0x01): Clear texture cache
 void Gpu::gp0_clear_cache(const uint32_t& value)
 {
-    DEBUG("STUB:gp0_clear_texture_cache");
+    // the decoded texture pages follow the VRAM writes, there is nothing stale to drop
+}
+
+// GP0(0x1F): Interrupt request
+void Gpu::gp0_interrupt_request(const uint32_t& value)
+{
+    if (!this->interrupted && this->irq != nullptr)
+    {
+        this->irq->request(IrqGpu);
+    }
+    this->interrupted = true;
+}
+
+// Bit 1 of the opcode selects semi-transparency for polygon commands
+static bool semi_transparent_from_gp0(const uint32_t& value)
+{
+    return ((value >> 25) & 1) != 0;
 }
 
-// GP0(0x28): Monochrome Opaque Quadrilateral
-void Gpu::gp0_quad_mono_opaque(const uint32_t& value)
+// GP0(0x28), GP0(0x2A): Monochrome Quadrilateral, opaque or semi-transparent
+void Gpu::gp0_quad_mono(const uint32_t& value)
 {
     Position positions[4] = {
         pos_from_gp0(this->current_command.command[1]),
@@ -292,18 +463,37 @@ void Gpu::gp0_quad_mono_opaque(const uint32_t& value)
     Color colors[4] = { 
         color, color, color, color
     };
+    TexCoord texcoords[4] = {
+        TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0)
+    };
+    bool semi_transparent = semi_transparent_from_gp0(this->current_command.command[0]);
 
-    this->renderer->push_quad(positions, colors);
+    RasterVertex vertices[4];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        vertices[i] = vertex_from_gp0(this->current_command.command[i + 1], this->current_command.command[0]);
+    }
+    if (this->rasterizing())
+    {
+        this->rasterizer.draw_quad(vertices, this->raster_state(semi_transparent), nullptr);
+    }
+
+    if (this->renderer != nullptr)
+    {
+        this->renderer->push_quad(positions, colors, texcoords, this->primitive(false, semi_transparent, 0));
+    }
 }
 
-// GP0(0x2C): Textured Opaque Quadrilateral
-void Gpu::gp0_quad_texture_blend_opaque(const uint32_t& value)
+// GP0(0x2C), GP0(0x2E): Textured Quadrilateral blended with the colour, opaque or semi-transparent
+void Gpu::gp0_quad_texture_blend(const uint32_t& value)
 {
-    // TODO: sony logo will be drawn here
-
     // first param: color
     auto color = color_from_gp0(this->current_command.command[0]);
-    
+    Color colors[4] = {
+        color, color, color, color
+    };
+    bool semi_transparent = semi_transparent_from_gp0(this->current_command.command[0]);
+
     Position positions[4] = {
         pos_from_gp0(this->current_command.command[1]),
         pos_from_gp0(this->current_command.command[3]),
@@ -312,29 +502,43 @@ void Gpu::gp0_quad_texture_blend_opaque(const uint32_t& value)
     };
 
     // third param: CLUT+texcoord1 CLUTYYXX
-    uint16_t CLUT      = this->current_command.command[4] && 0b11110000;
-    uint8_t texcoord_x = (uint8_t)(this->current_command.command[4] & 0b00000011);
-    uint8_t texcoord_y = (uint8_t)(this->current_command.command[4] & 0b00001100);
-
-    // fifth param: texcoord2+texpage PageYYXX
-    uint16_t Page       = this->current_command.command[4] && 0b11110000;
-    uint8_t texcoord2_x = (uint8_t)(this->current_command.command[4] & 0b00000011);
-    uint8_t texcoord2_y = (uint8_t)(this->current_command.command[4] & 0b00001100);
- 
-    // seventh param: texcoord3 0000YYXX
-    uint8_t texcoord3_x = (uint8_t)(this->current_command.command[6] & 0b00000011);
-    uint8_t texcoord3_y = (uint8_t)(this->current_command.command[6] & 0b00001100);
+    uint16_t clut = (uint16_t)(this->current_command.command[2] >> 16);
+    // fifth param: texpage+texcoord2 PageYYXX, the page replaces the one of the draw mode
+    uint16_t page = (uint16_t)(this->current_command.command[4] >> 16);
+    this->page_base_x = (uint8_t)(page & 0xf);
+    this->page_base_y = (uint8_t)((page >> 4) & 1);
+    this->semi_transparency = (uint8_t)((page >> 5) & 3);
+    // depth 3 is reserved and reads the page as 15 bit
+    this->texture_depth = ((page >> 7) & 3) == 3 ? T15Bit : (TextureDepth)((page >> 7) & 3);
+
+    // seventh and nineth param: texcoord3 and texcoord4 0000YYXX
+    RasterVertex vertices[4];
+    TexCoord texcoords[4] = {
+        TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0)
+    };
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        uint32_t texcoord = this->current_command.command[i * 2 + 2];
+        vertices[i] = vertex_from_gp0(this->current_command.command[i * 2 + 1], this->current_command.command[0]);
+        vertices[i].u = (uint8_t)texcoord;
+        vertices[i].v = (uint8_t)(texcoord >> 8);
+        texcoords[i] = TexCoord(vertices[i].u, vertices[i].v);
+    }
 
-    // nineth param: texcoord4 0000YYXX
-    uint8_t texcoord4_x = (uint8_t)(this->current_command.command[8] & 0b00000011);
-    uint8_t texcoord4_y = (uint8_t)(this->current_command.command[8] & 0b00001100);
+    if (this->rasterizing())
+    {
+        auto texture = this->texture_cache.lookup(this->page_base_x, this->page_base_y, this->texture_depth, clut);
+        this->rasterizer.draw_quad(vertices, this->raster_state(semi_transparent), texture);
+    }
 
-    // TODO: push to renderer
-    DEBUG("STUB:draw_quad_texture_blend_opaque")
+    if (this->renderer != nullptr)
+    {
+        this->renderer->push_quad(positions, colors, texcoords, this->primitive(true, semi_transparent, clut));
+    }
 }
 
-// GP0(0x30): Shaded Opaque Triangle
-void Gpu::gp0_triangle_shaded_opaque(const uint32_t& value)
+// GP0(0x30), GP0(0x32): Shaded Triangle, opaque or semi-transparent
+void Gpu::gp0_triangle_shaded(const uint32_t& value)
 {
     Position positions[3] = {
         pos_from_gp0(this->current_command.command[1]),
@@ -347,13 +551,30 @@ void Gpu::gp0_triangle_shaded_opaque(const uint32_t& value)
         color_from_gp0(this->current_command.command[2]),
         color_from_gp0(this->current_command.command[4])
     };
+    TexCoord texcoords[3] = {
+        TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0)
+    };
+    bool semi_transparent = semi_transparent_from_gp0(this->current_command.command[0]);
+
+    RasterVertex vertices[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        vertices[i] = vertex_from_gp0(this->current_command.command[i * 2 + 1], this->current_command.command[i * 2]);
+    }
+    if (this->rasterizing())
+    {
+        this->rasterizer.draw_triangle(vertices, this->raster_state(semi_transparent), nullptr);
+    }
 
-    DEBUG("Drawing_triangle_shaded_opaque");
-    this->renderer->push_triangle(positions, colors);
+    DEBUG("Drawing_triangle_shaded");
+    if (this->renderer != nullptr)
+    {
+        this->renderer->push_triangle(positions, colors, texcoords, this->primitive(false, semi_transparent, 0));
+    }
 }
 
-// GP0(0x38): Shaded Opaque Quadrilateral
-void Gpu::gp0_quad_shaded_opaque(const uint32_t& value)
+// GP0(0x38), GP0(0x3A): Shaded Quadrilateral, opaque or semi-transparent
+void Gpu::gp0_quad_shaded(const uint32_t& value)
 {
     Position positions[4] = {
         pos_from_gp0(this->current_command.command[1]),
@@ -368,8 +589,25 @@ void Gpu::gp0_quad_shaded_opaque(const uint32_t& value)
         color_from_gp0(this->current_command.command[4]),
         color_from_gp0(this->current_command.command[6])
     };
+    TexCoord texcoords[4] = {
+        TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0), TexCoord(0, 0)
+    };
+    bool semi_transparent = semi_transparent_from_gp0(this->current_command.command[0]);
+
+    RasterVertex vertices[4];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        vertices[i] = vertex_from_gp0(this->current_command.command[i * 2 + 1], this->current_command.command[i * 2]);
+    }
+    if (this->rasterizing())
+    {
+        this->rasterizer.draw_quad(vertices, this->raster_state(semi_transparent), nullptr);
+    }
 
-    this->renderer->push_quad(positions, colors);
+    if (this->renderer != nullptr)
+    {
+        this->renderer->push_quad(positions, colors, texcoords, this->primitive(false, semi_transparent, 0));
+    }
 }
 
 // GP0(0xA0): Image load (from CPU to VRAM)
@@ -398,6 +636,14 @@ void Gpu::gp0_image_load(const uint32_t& value)
     // store num of words expected for this image
     this->current_command.words_remaining = image_size / 2;
 
+    // the tiles written are uploaded to the renderer as a whole, they have to hold what it drew
+    if (this->renderer != nullptr)
+    {
+        VramRect target = {(uint32_t)(this->image_load_vram_target_x % VRAM_WIDTH), (uint32_t)(this->image_load_vram_target_y % VRAM_HEIGHT),
+                           this->image_load_vram_width, this->image_load_vram_height};
+        this->renderer->download_vram(target);
+    }
+
     // put G0 to image load mode
     this->gp0_mode = GP0Mode::ImageLoad;
 
@@ -453,6 +699,10 @@ void Gpu::gp0_texture_window(const uint32_t& value)
     this->texture_window_y_mask   = (uint8_t)((value >> 5) & 0x1f);
     this->texture_window_x_offset = (uint8_t)((value >> 10) & 0x1f);
     this->texture_window_y_offset = (uint8_t)((value >> 15) & 0x1f);
+    if (this->renderer != nullptr)
+    {
+        this->renderer->set_texture_window(this->texture_window_x_mask * 8, this->texture_window_y_mask * 8, this->texture_window_x_offset * 8, this->texture_window_y_offset * 8);
+    }
 }
 
 // GP0(0xE3): Set drawing area top left
@@ -460,6 +710,10 @@ void Gpu::gp0_set_drawing_area_top_left(const uint32_t& value)
 {
     this->drawing_area_top  = (uint16_t)((value >> 10) & 0x3ff);
     this->drawing_area_left = (uint16_t)(value & 0x3ff);
+    if (this->renderer != nullptr)
+    {
+        this->renderer->set_drawing_area(this->drawing_area_left, this->drawing_area_top, this->drawing_area_right, this->drawing_area_bottom);
+    }
     DEBUG("Current Drawing area: " << std::dec << this->drawing_area_left << " " << this->drawing_area_top << ", " << this->drawing_area_bottom << " " << (uint32_t)(this->drawing_area_right));
 }
 
@@ -468,6 +722,10 @@ void Gpu::gp0_set_drawing_area_bottom_right(const uint32_t& value)
 {
     this->drawing_area_bottom = (uint16_t)((value >> 10) & 0x3ff);
     this->drawing_area_right  = (uint16_t)(value & 0x3ff);
+    if (this->renderer != nullptr)
+    {
+        this->renderer->set_drawing_area(this->drawing_area_left, this->drawing_area_top, this->drawing_area_right, this->drawing_area_bottom);
+    }
     DEBUG("Current Drawing area: " << std::dec << this->drawing_area_left << " " << this->drawing_area_top << ", " << this->drawing_area_bottom << " " << (uint32_t)(this->drawing_area_right));
 }
 
@@ -478,13 +736,12 @@ void Gpu::gp0_drawing_offset(const uint32_t& value)
     uint16_t y = (uint16_t)((value >> 11) & 0x7ff);
 
     // Values are 11bit two's complement signed values so we need to shift the value to 16 bits to force sign extension
-    int16_t drawing_x_offset = (int16_t)(x << 5) >> 5;
-    int16_t drawing_y_offset = (int16_t)(y << 5) >> 5;
-    this->renderer->set_drawing_offset(drawing_x_offset, drawing_y_offset);
-
-    // TODO: FIXME: temporary hack to render screen, fix when timing is implemented
-    DEBUG("RENDER----------------------------------")
-    this->renderer->display();
+    this->drawing_x_offset = (int16_t)(x << 5) >> 5;
+    this->drawing_y_offset = (int16_t)(y << 5) >> 5;
+    if (this->renderer != nullptr)
+    {
+        this->renderer->set_drawing_offset(this->drawing_x_offset, this->drawing_y_offset);
+    }
 }
 
 // GP0(0xE6): set mask bit setting
@@ -515,6 +772,8 @@ void Gpu::gp1_reset(const uint32_t& value)
     this->drawing_area_top = 0;
     this->drawing_area_bottom = 0;
     this->drawing_area_right = 0;
+    this->drawing_x_offset = 0;
+    this->drawing_y_offset = 0;
     this->force_set_mask_bit = false;
     this->preserve_masked_pixels = false;
     this->dma_direction = Off;
@@ -531,6 +790,13 @@ void Gpu::gp1_reset(const uint32_t& value)
     this->display_line_end = 0x100;
     this->display_depth = D15Bits;
 
+    if (this->renderer != nullptr)
+    {
+        this->renderer->set_drawing_offset(0, 0);
+        this->renderer->set_drawing_area(0, 0, 0, 0);
+        this->renderer->set_texture_window(0, 0, 0, 0);
+    }
+
     // Also clear command buffer
     this->gp1_reset_command_buffer(0);
 
@@ -573,7 +839,7 @@ void Gpu::gp1_dma_direction(const uint32_t& value)
 // GP1 (0x02): Acknowledge interrupt
 void Gpu::gp1_acknowledge_irq(const uint32_t& value)
 {
-    this->interrupted = true;
+    this->interrupted = false;
 }
 
 // GP1 (0x03): Display enable
@@ -612,7 +878,7 @@ void Gpu::gp1_display_mode(const uint32_t& value)
     this->hres = from_fields(hr1, hr2);
 
     this->vres          = ((value & 0x4) != 0) ? Y480Lines : Y240Lines;
-    this->vmode         = ((value & 0x8) != 0) ? NTSC : PAL;
+    this->vmode         = ((value & 0x8) != 0) ? PAL : NTSC;
     this->display_depth = ((value & 0x10) != 0) ? D24Bits : D15Bits; 
 
     this->interlaced = (value & 0x20) != 0;
@@ -622,4 +888,75 @@ void Gpu::gp1_display_mode(const uint32_t& value)
         DEBUG("Unsupported_display_mode_0x" << std::hex << value);
         throw std::exception();
     }
-}
\ No newline at end of file
+}
+
+// The renderer is not part of the state, it only holds the primitives of the current frame
+void Gpu::serialize(Savestate& state)
+{
+    state.section("GPU ");
+    state.value(this->gp0_mode);
+    state.value(this->current_command.command.buffer);
+    state.value(this->current_command.command.len);
+    state.value(this->current_command.words_remaining);
+    if (!state.saving() && this->gp0_mode == GP0Mode::Command && this->current_command.words_remaining != 0)
+    {
+        // the handler is a code address, look it up again from the opcode of the buffered command
+        auto len = this->current_command.command.len;
+        this->gp0_decode(this->current_command.command.buffer[0]);
+        this->current_command.command.len = len;
+    }
+
+    state.value(this->page_base_x);
+    state.value(this->page_base_y);
+    state.value(this->semi_transparency);
+    state.value(this->texture_depth);
+    state.value(this->dithering);
+    state.value(this->draw_to_display);
+    state.value(this->force_set_mask_bit);
+    state.value(this->preserve_masked_pixels);
+    state.value(this->field);
+    state.value(this->disable_textures);
+    state.value(this->hres);
+    state.value(this->vres);
+    state.value(this->vmode);
+    state.value(this->display_depth);
+    state.value(this->interlaced);
+    state.value(this->display_disabled);
+    state.value(this->interrupted);
+    state.value(this->dma_direction);
+    state.value(this->rectangle_texture_x_flip);
+    state.value(this->rectangle_texture_y_flip);
+    state.value(this->texture_window_x_mask);
+    state.value(this->texture_window_y_mask);
+    state.value(this->texture_window_x_offset);
+    state.value(this->texture_window_y_offset);
+    state.value(this->drawing_area_left);
+    state.value(this->drawing_area_top);
+    state.value(this->drawing_area_right);
+    state.value(this->drawing_area_bottom);
+    state.value(this->drawing_x_offset);
+    state.value(this->drawing_y_offset);
+    state.value(this->display_vram_x_start);
+    state.value(this->display_vram_y_start);
+    state.value(this->display_horiz_start);
+    state.value(this->display_horiz_end);
+    state.value(this->display_line_start);
+    state.value(this->display_line_end);
+    state.value(this->image_load_vram_target_x);
+    state.value(this->image_load_vram_target_y);
+    state.value(this->image_load_vram_width);
+    state.value(this->image_load_vram_height);
+    state.value(this->image_load_initial_x);
+    state.value(this->first_texel_in_row);
+
+    // whether saving or loading, nothing the renderer drew may be left behind
+    this->sync_vram();
+    this->vram.serialize(state);
+
+    if (!state.saving() && this->renderer != nullptr)
+    {
+        this->renderer->set_drawing_offset(this->drawing_x_offset, this->drawing_y_offset);
+        this->renderer->set_drawing_area(this->drawing_area_left, this->drawing_area_top, this->drawing_area_right, this->drawing_area_bottom);
+        this->renderer->set_texture_window(this->texture_window_x_mask * 8, this->texture_window_y_mask * 8, this->texture_window_x_offset * 8, this->texture_window_y_offset * 8);
+    }
+}
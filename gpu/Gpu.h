@@ -5,8 +5,11 @@
 
 #include "Renderer.h"
 #include "CommandBuffer.h"
+#include "TextureCache.h"
+#include "Rasterizer.h"
 #include <exception>
 #include "../memory/Vram.h"
+#include "../bus/Irq.h"
 
 class Gpu;
 typedef void (Gpu::*Gpu_operation)(const uint32_t& value);
@@ -27,13 +30,6 @@ enum GP0Mode {
     ImageLoad // load image to VRAM
 };
 
-// Depth of pixel values in a texture page
-enum TextureDepth {
-    T4Bit = 0, // 4 bits per pixel
-    T8Bit = 1, 
-    T15Bit = 2
-};
-
 // Interlaced output splits frames in two fields
 enum Field {
     Bottom = 0, // even lines
@@ -74,7 +70,9 @@ enum DmaDirection {
 class Gpu
 {
 public:
-    Gpu() // We are assuming default values of 0 here
+    // a headless GPU has no renderer: no window or GL context is created and nothing is drawn,
+    // so any number of them can live in one process
+    explicit Gpu(const bool& headless = false) // We are assuming default values of 0 here
         : gp0_mode(Command),
           current_command(GPUCommand()), 
           page_base_x(0), page_base_y(0),
@@ -94,10 +92,17 @@ public:
           interrupted(false),
           dma_direction(Off),
           rectangle_texture_x_flip(false), rectangle_texture_y_flip(false),
-          vram(Vram())
+          vram(Vram()),
+          texture_cache(&this->vram),
+          rasterizer(&this->vram, &this->texture_cache)
     {
+        if (headless)
+        {
+            return;
+        }
         // Setup renderer
-        this->renderer = new Renderer();
+        this->renderer = new Renderer(&this->vram);
+        this->renderer->set_drawing_area(this->drawing_area_left, this->drawing_area_top, this->drawing_area_right, this->drawing_area_bottom);
         // init vram
         this->vram.init();
     };
@@ -108,15 +113,31 @@ public:
 
     GP0Mode gp0_mode;
     GPUCommand current_command;
+    InterruptController* irq = nullptr; // for GP0(0x1F)
     Vram vram; 
     uint32_t status_read();
     uint32_t read();
     void gp0(const uint32_t& value);
     void gp1(const uint32_t& value);
+
+    // timing, in CPU cycles
+    uint64_t cpu_cycles_per_frame() const;
+    // clocks driving the root counters
+    uint64_t clock_hz() const;
+    uint64_t cycles_per_line() const;
+    uint64_t dotclock_divider() const;
+    void vblank();
+    // hidden frames (run-ahead, fast forward) are not drawn
+    void set_headless(const bool& headless);
+    // read back what the renderer drew, before 'vram' is looked at from outside
+    void sync_vram();
+    void serialize(Savestate& state);
     
 
 private:
-    Renderer* renderer;
+    Renderer* renderer = nullptr; // null when headless
+    TextureCache texture_cache; // decoded texture pages for the rasterizer
+    Rasterizer rasterizer; // draws into 'vram' while no renderer draws the frame
 
     uint8_t page_base_x; // Texture page base X coord (4 bits, 64 bytes increment)
     uint8_t page_base_y; // 1 bit, 256 line increment
@@ -140,14 +161,16 @@ private:
     bool rectangle_texture_x_flip;
     bool rectangle_texture_y_flip;
 
-    uint8_t texture_window_x_mask; // 8 px steps
-    uint8_t texture_window_y_mask; // 8 px steps
-    uint8_t texture_window_x_offset; // 8 px steps
-    uint8_t texture_window_y_offset; // 8 px steps
-    uint16_t drawing_area_left; // leftmost col of drawing area
-    uint16_t drawing_area_top; // topmost col of drawing area
-    uint16_t drawing_area_right; // ...
-    uint16_t drawing_area_bottom; 
+    uint8_t texture_window_x_mask = 0; // 8 px steps
+    uint8_t texture_window_y_mask = 0; // 8 px steps
+    uint8_t texture_window_x_offset = 0; // 8 px steps
+    uint8_t texture_window_y_offset = 0; // 8 px steps
+    uint16_t drawing_area_left = 0; // leftmost col of drawing area
+    uint16_t drawing_area_top = 0; // topmost col of drawing area
+    uint16_t drawing_area_right = 0; // ...
+    uint16_t drawing_area_bottom = 0; 
+    int16_t drawing_x_offset = 0; // added to the vertices
+    int16_t drawing_y_offset = 0;
     uint16_t display_vram_x_start; // first col of the display are in VRAM
     uint16_t display_vram_y_start; // first line of the display are in VRAM
     uint16_t display_horiz_start; // display output horizontal start relative to HSYNC
@@ -161,12 +184,17 @@ private:
     uint16_t image_load_initial_x;
     bool first_texel_in_row = true;
 
+    bool rasterizing() const;
+    RasterState raster_state(const bool& semi_transparent) const;
+    Primitive primitive(const bool& textured, const bool& semi_transparent, const uint16_t& clut) const;
+    void gp0_decode(const uint32_t& value);
     void gp0_nop(const uint32_t& value);
     void gp0_clear_cache(const uint32_t& value);
-    void gp0_quad_mono_opaque(const uint32_t& value);
-    void gp0_quad_shaded_opaque(const uint32_t& value);
-    void gp0_quad_texture_blend_opaque(const uint32_t& value);
-    void gp0_triangle_shaded_opaque(const uint32_t& value);
+    void gp0_interrupt_request(const uint32_t& value);
+    void gp0_quad_mono(const uint32_t& value);
+    void gp0_quad_shaded(const uint32_t& value);
+    void gp0_quad_texture_blend(const uint32_t& value);
+    void gp0_triangle_shaded(const uint32_t& value);
     void gp0_image_load(const uint32_t& value);
     void gp0_image_store(const uint32_t& value);
     void gp0_draw_mode(const uint32_t& value);
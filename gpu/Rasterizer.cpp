@@ -0,0 +1,172 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <utility>
+
+// twice the signed area of a, b, p: positive when p is on the inner side of a -> b
+static int64_t edge(const RasterVertex& a, const RasterVertex& b, const int32_t& x, const int32_t& y)
+{
+    return (int64_t)(b.x - a.x) * (y - a.y) - (int64_t)(b.y - a.y) * (x - a.x);
+}
+
+// pixels on a top or left edge are drawn, the ones on a bottom or right edge belong to the
+// neighbouring primitive
+static bool top_left(const RasterVertex& a, const RasterVertex& b)
+{
+    return b.y < a.y || (b.y == a.y && b.x > a.x);
+}
+
+// relative to the first vertex and in integers, so a texel coordinate that lands on a pixel is
+// not rounded down to the previous one
+static uint8_t interpolate(const int64_t weights[3], const int64_t& area, const uint8_t& a, const uint8_t& b, const uint8_t& c)
+{
+    int64_t delta = weights[1] * (b - a) + weights[2] * (c - a);
+    // rounded down, also when negative
+    int64_t step = delta >= 0 ? delta / area : -((-delta + area - 1) / area);
+    return (uint8_t)std::clamp(a + step, (int64_t)0, (int64_t)255);
+}
+
+// texture colour times the vertex colour, 0x80 leaves the texel as it is
+static uint16_t modulate(const uint16_t& texel, const uint8_t& r, const uint8_t& g, const uint8_t& b)
+{
+    uint32_t tr = std::min(((texel & 0x1f) * (uint32_t)r) >> 7, 0x1fu);
+    uint32_t tg = std::min((((texel >> 5) & 0x1f) * (uint32_t)g) >> 7, 0x1fu);
+    uint32_t tb = std::min((((texel >> 10) & 0x1f) * (uint32_t)b) >> 7, 0x1fu);
+    return (uint16_t)(tr | (tg << 5) | (tb << 10) | (texel & 0x8000));
+}
+
+// one of the 4 semi-transparency modes, per 5 bit component. The mask bit is the one of 'front'
+static uint16_t blend(const uint16_t& back, const uint16_t& front, const uint8_t& mode)
+{
+    uint16_t result = front & 0x8000;
+    for (uint32_t shift = 0; shift < 15; shift += 5)
+    {
+        int32_t b = (back >> shift) & 0x1f;
+        int32_t f = (front >> shift) & 0x1f;
+        int32_t component;
+        switch (mode)
+        {
+            case 0:
+                component = (b + f) / 2;
+                break;
+            case 1:
+                component = b + f;
+                break;
+            case 2:
+                component = b - f;
+                break;
+            default:
+                component = b + f / 4;
+                break;
+        }
+        result |= (uint16_t)(std::clamp(component, 0, 0x1f) << shift);
+    }
+    return result;
+}
+
+Rasterizer::Rasterizer(Vram* vram, TextureCache* textures)
+{
+    this->vram = vram;
+    this->textures = textures;
+}
+
+void Rasterizer::draw_triangle(const RasterVertex vertices[3], const RasterState& state, TexturePage* texture)
+{
+    RasterVertex v[3] = {vertices[0], vertices[1], vertices[2]};
+    for (auto& vertex : v)
+    {
+        vertex.x += state.offset_x;
+        vertex.y += state.offset_y;
+    }
+    int64_t area = edge(v[0], v[1], v[2].x, v[2].y);
+    if (area == 0)
+    {
+        return;
+    }
+    if (area < 0)
+    {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+
+    int32_t min_x = std::min({v[0].x, v[1].x, v[2].x});
+    int32_t max_x = std::max({v[0].x, v[1].x, v[2].x});
+    int32_t min_y = std::min({v[0].y, v[1].y, v[2].y});
+    int32_t max_y = std::max({v[0].y, v[1].y, v[2].y});
+    // the GPU skips primitives larger than this
+    if (max_x - min_x >= VRAM_WIDTH || max_y - min_y >= VRAM_HEIGHT)
+    {
+        return;
+    }
+    min_x = std::max(min_x, (int32_t)state.left);
+    min_y = std::max(min_y, (int32_t)state.top);
+    max_x = std::min(max_x, (int32_t)state.right);
+    max_y = std::min(max_y, (int32_t)state.bottom);
+
+    // w0 is the weight of v[0], from the edge across it
+    const RasterVertex* edges[3][2] = {{&v[1], &v[2]}, {&v[2], &v[0]}, {&v[0], &v[1]}};
+    int64_t bias[3], step_x[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bias[i] = top_left(*edges[i][0], *edges[i][1]) ? 0 : -1;
+        step_x[i] = -(int64_t)(edges[i][1]->y - edges[i][0]->y);
+    }
+
+    for (int32_t y = min_y; y <= max_y; y++)
+    {
+        int64_t w[3];
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            w[i] = edge(*edges[i][0], *edges[i][1], min_x, y);
+        }
+        for (int32_t x = min_x; x <= max_x; x++, w[0] += step_x[0], w[1] += step_x[1], w[2] += step_x[2])
+        {
+            if (w[0] + bias[0] < 0 || w[1] + bias[1] < 0 || w[2] + bias[2] < 0)
+            {
+                continue;
+            }
+            if (state.preserve_masked_pixels && (this->vram->get(x, y) & 0x8000) != 0)
+            {
+                continue;
+            }
+            uint8_t r = interpolate(w, area, v[0].r, v[1].r, v[2].r);
+            uint8_t g = interpolate(w, area, v[0].g, v[1].g, v[2].g);
+            uint8_t b = interpolate(w, area, v[0].b, v[1].b, v[2].b);
+
+            uint16_t pixel;
+            if (texture != nullptr)
+            {
+                uint8_t u = interpolate(w, area, v[0].u, v[1].u, v[2].u);
+                uint8_t tv = interpolate(w, area, v[0].v, v[1].v, v[2].v);
+                u = (u & ~state.window_mask_x) | (state.window_offset_x & state.window_mask_x);
+                tv = (tv & ~state.window_mask_y) | (state.window_offset_y & state.window_mask_y);
+                uint16_t texel = this->textures->row(*texture, tv)[u];
+                // black without the mask bit is transparent
+                if (texel == 0)
+                {
+                    continue;
+                }
+                pixel = modulate(texel, r, g, b);
+            }
+            else
+            {
+                pixel = (uint16_t)((r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10));
+            }
+            // only the texels with the mask bit are semi-transparent
+            if (state.semi_transparent && (texture == nullptr || (pixel & 0x8000) != 0))
+            {
+                pixel = blend(this->vram->get(x, y), pixel, state.semi_transparency);
+            }
+            if (state.force_set_mask_bit)
+            {
+                pixel |= 0x8000;
+            }
+            this->vram->set(x, y, pixel);
+        }
+    }
+}
+
+void Rasterizer::draw_quad(const RasterVertex vertices[4], const RasterState& state, TexturePage* texture)
+{
+    this->draw_triangle(vertices, state, texture);
+    this->draw_triangle(vertices + 1, state, texture);
+}
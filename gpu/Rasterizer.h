@@ -0,0 +1,50 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#pragma once
+
+#include <stdint.h>
+#include "TextureCache.h"
+#include "../memory/Vram.h"
+
+// A vertex after the command is parsed, before the drawing offset is applied
+struct RasterVertex
+{
+    int32_t x, y;
+    uint8_t r, g, b;
+    uint8_t u, v;
+};
+
+// GP0(0xE1-0xE6) settings, and how the primitive being drawn uses them
+struct RasterState
+{
+    uint32_t left, top, right, bottom; // drawing area, inclusive
+    int32_t offset_x, offset_y;
+    bool force_set_mask_bit;
+    bool preserve_masked_pixels;
+    uint8_t window_mask_x, window_mask_y; // texture window, in texels
+    uint8_t window_offset_x, window_offset_y;
+    bool semi_transparent; // blended with the pixels under it
+    uint8_t semi_transparency; // blending mode
+};
+
+// Draws the primitives into the emulated VRAM when there is no renderer or it is headless (batch
+// runs, run-ahead frames), so VRAM holds what the console would have drawn. Textured primitives
+// sample the decoded pages of the texture cache.
+// http://problemkaputt.de/psx-spx.htm#gpurenderpolygoncommands
+class Rasterizer
+{
+public:
+    Rasterizer(Vram* vram, TextureCache* textures);
+
+    // 'texture' is null for untextured primitives. Textured ones are blended with the vertex colours
+    void draw_triangle(const RasterVertex vertices[3], const RasterState& state, TexturePage* texture);
+    // drawn as the triangles 0-1-2 and 1-2-3, like the hardware does
+    void draw_quad(const RasterVertex vertices[4], const RasterState& state, TexturePage* texture);
+
+private:
+    Vram* vram;
+    TextureCache* textures;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "../util/logging.h"
 #include "../util/filesystem.h"
 #include "Constants.h"
+#include <algorithm>
 #include <exception>
 #include <vector>
 
@@ -85,44 +86,90 @@ GLuint find_program_uniform(const GLuint& program, const std::string& attr)
     return (GLuint)index;
 }
 
-Renderer::Renderer()
+// read and compile a shader from the shaders directory
+GLuint load_shader(const std::string& path, const GLenum& shader_type)
 {
-    if (!this->init_sdl()) 
+    if (!file_exists(path))
     {
+        DEBUG("Shader not found. Expected path:" << path);
         throw std::exception();
     }
+    return compile_shader(read_file_to_string(path), shader_type);
+}
 
-    // TODO: fix hardcoded paths
-    auto vertex_shader_path = "../gpu/shaders/vertex.glsl";
-    auto fragment_shader_path = "../gpu/shaders/fragment.glsl";
-    if (!file_exists(vertex_shader_path))
+// VRAM rects overlap
+static bool intersects(const VramRect& a, const VramRect& b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// grow 'a' to cover 'b' too
+static void extend(VramRect& a, const VramRect& b)
+{
+    if (b.width == 0 || b.height == 0)
     {
-        DEBUG("Shader not found. Expected path:" << vertex_shader_path);
-        throw std::exception();
+        return;
     }
-    if (!file_exists(fragment_shader_path))
+    if (a.width == 0 || a.height == 0)
     {
-        DEBUG("Shader not found. Expected path:" << vertex_shader_path);
-        throw std::exception();
+        a = b;
+        return;
     }
+    uint32_t right = std::max(a.x + a.width, b.x + b.width);
+    uint32_t bottom = std::max(a.y + a.height, b.y + b.height);
+    a.x = std::min(a.x, b.x);
+    a.y = std::min(a.y, b.y);
+    a.width = right - a.x;
+    a.height = bottom - a.y;
+}
 
-    auto vs_src = read_file_to_string("../gpu/shaders/vertex.glsl");
-    auto fg_src = read_file_to_string("../gpu/shaders/fragment.glsl");
-    this->vertex_shader   = compile_shader(vs_src, GL_VERTEX_SHADER);
-    this->fragment_shader = compile_shader(fg_src, GL_FRAGMENT_SHADER);
+// the texels of a texture page or CLUT starting at x wrap around to the left of VRAM
+static void push_wrapped(std::vector<VramRect>& rects, const uint32_t& x, const uint32_t& y, const uint32_t& width, const uint32_t& height)
+{
+    rects.push_back({x, y, std::min(width, VRAM_WIDTH - x), height});
+    if (x + width > VRAM_WIDTH)
+    {
+        rects.push_back({0, y, x + width - VRAM_WIDTH, height});
+    }
+}
+
+Renderer::Renderer(Vram* vram)
+{
+    this->vram = vram;
+    if (!this->init_sdl()) 
+    {
+        throw std::exception();
+    }
 
+    // TODO: fix hardcoded paths
+    this->vertex_shader   = load_shader("../gpu/shaders/vertex.glsl", GL_VERTEX_SHADER);
+    this->fragment_shader = load_shader("../gpu/shaders/fragment.glsl", GL_FRAGMENT_SHADER);
     this->program = link_program({this->vertex_shader, this->fragment_shader});
+    this->copy_vertex_shader   = load_shader("../gpu/shaders/copy_vertex.glsl", GL_VERTEX_SHADER);
+    this->copy_fragment_shader = load_shader("../gpu/shaders/copy_fragment.glsl", GL_FRAGMENT_SHADER);
+    this->copy_program = link_program({this->copy_vertex_shader, this->copy_fragment_shader});
+
+    // Copy program: rects of VRAM positions, the words are read from the texture on unit 1
+    glUseProgram(this->copy_program);
+    glGenVertexArrays(1, &this->copy_vertex_array_object);
+    glBindVertexArray(this->copy_vertex_array_object);
+    this->copy_positions = Buffer<Position>();
+    this->copy_positions.init_buffer();
+    auto index = find_program_attrib(this->copy_program, "vertex_position");
+    glEnableVertexAttribArray(index);
+    glVertexAttribIPointer(index, 2, GL_SHORT, 0, nullptr);
+    glUniform1i(find_program_uniform(this->copy_program, "vram16"), 1);
+
     glUseProgram(this->program);
 
     // Vertex attribute object
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    glGenVertexArrays(1, &this->vertex_array_object);
+    glBindVertexArray(this->vertex_array_object);
 
     // Set up Positions buffer
     this->positions = Buffer<Position>();
     this->positions.init_buffer();
-    auto index = find_program_attrib(program, "vertex_position");
+    index = find_program_attrib(program, "vertex_position");
     glEnableVertexAttribArray(index);
     // 2 GLShort attributes, not normalized
     glVertexAttribIPointer(index, 2, GL_SHORT, 0, nullptr);
@@ -139,15 +186,69 @@ Renderer::Renderer()
     // 3 GLubyte attributes, not normalized
     glVertexAttribIPointer(index, 3, GL_UNSIGNED_BYTE, 0, nullptr);
 
+    // Set up Texture coordinates buffer
+    this->texcoords = Buffer<TexCoord>();
+    this->texcoords.init_buffer();
+    index = find_program_attrib(program, "vertex_texcoord");
+    glEnableVertexAttribArray(index);
+    // 2 GLubyte attributes, not normalized
+    glVertexAttribIPointer(index, 2, GL_UNSIGNED_BYTE, 0, nullptr);
+
+    // Set up Primitive attributes buffer
+    this->primitives = Buffer<Primitive>();
+    this->primitives.init_buffer();
+    index = find_program_attrib(program, "vertex_primitive");
+    glEnableVertexAttribArray(index);
+    // 3 GLushort attributes, not normalized
+    glVertexAttribIPointer(index, 3, GL_UNSIGNED_SHORT, 0, nullptr);
+
+    this->uniform_texture_window = find_program_uniform(program, "texture_window");
+    glUniform4i(this->uniform_texture_window, 0, 0, 0, 0);
+    // the copy of VRAM is on unit 0
+    glUniform1i(find_program_uniform(program, "vram"), 0);
+
+    // VRAM framebuffer and its copy, both start out like VRAM: all 0
+    this->init_framebuffer(this->read_texture, this->read_framebuffer);
+    this->init_framebuffer(this->vram_texture, this->vram_framebuffer);
+    glViewport(0, 0, VRAM_WIDTH, VRAM_HEIGHT);
+    glEnable(GL_SCISSOR_TEST);
+    this->set_drawing_area(0, 0, VRAM_WIDTH - 1, VRAM_HEIGHT - 1);
+
     // Clear screen
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glClearColor(0.0, 0.0, 0.0, 1.0);    
     glClear(GL_COLOR_BUFFER_BIT);
     SDL_GL_SwapWindow(this->window);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->vram_framebuffer);
     
     // verify all went well
     this->check_for_errors();
 }
 
+// A 1024x512 framebuffer with 5 bits of every component and the mask bit in alpha, left bound
+void Renderer::init_framebuffer(GLuint& texture, GLuint& framebuffer)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // 8 bits per component keep the 5 bit values exact
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VRAM_WIDTH, VRAM_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        DEBUG("ERROR:GL_VRAM_framebuffer_incomplete");
+        throw std::exception();
+    }
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
 bool Renderer::init_sdl()
 {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -206,18 +307,30 @@ void Renderer::check_for_errors()
 
 void Renderer::display()
 {
+    if (this->headless)
+    {
+        this->draw();
+        return;
+    }
+    this->upload_vram();
     this->draw();
+
+    // VRAM line 0 is the bottom line of the framebuffer, the window shows it at the top
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->vram_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, VRAM_WIDTH, VRAM_HEIGHT, 0, SCREEN_HEIGHT_PX, SCREEN_WIDTH_PX, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->vram_framebuffer);
+    glEnable(GL_SCISSOR_TEST);
+
     SDL_GL_SwapWindow(this->window);
     this->check_for_errors();
 }
 
-void Renderer::draw() 
+// the vertex buffers are written through persistent mappings, they can only be reused once
+// the GPU is done with them
+void Renderer::wait_for_gpu()
 {
-    // make sure all data is lfushed to buffer
-    // glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)this->nvertices);
-
-    // wait for GPU to complete
     auto sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
     while (true) {
@@ -228,32 +341,226 @@ void Renderer::draw()
             break;
         }
     }
+    glDeleteSync(sync);
+}
+
+void Renderer::draw() 
+{
+    if (this->headless || this->nvertices == 0)
+    {
+        this->nvertices = 0;
+        return;
+    }
+
+    // make sure all data is lfushed to buffer
+    // glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->read_texture);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)this->nvertices);
+
+    // wait for GPU to complete
+    this->wait_for_gpu();
 
     // reset buffers
     this->nvertices = 0;
 }
 
-void Renderer::push_triangle(Position positions[3], Color colors[3]) 
+// Draw what was written to VRAM behind the renderer into the framebuffer. The queued primitives
+// were sent before those writes, they are drawn first
+void Renderer::upload_vram()
 {
-    // make sure we have enough room to queue the vertices
-    if (this->nvertices + 3 > VERTEX_BUFFER_LEN)
+    if ((this->vram->dirty_tiles_any & DIRTY_RENDERER) == 0)
     {
-        DEBUG("VERTEX_BUFFERS_FULL!_FORCING_DRAW!");
-        this->draw();
+        return;
     }
-    
-    for (const auto& i : { 0,1,2 }) 
+    this->draw();
+
+    this->uploads.clear();
+    this->vram->upload(DIRTY_RENDERER, this->uploads);
+    uint32_t count = 0;
+    for (const auto& rect : this->uploads)
     {
-        // push
-        this->positions.set(this->nvertices, positions[i]);
-        this->colors.set(this->nvertices, colors[i]);
-        // DEBUG("Triangle-vertex:" << positions[i].x << "," << positions[i].y << " -> " << (float(positions[i].x)/512)-1.0f << "," << float(positions[i].y / 256.0));
-        this->nvertices++;
+        Position corners[4] = {
+            Position((GLshort)rect.x, (GLshort)rect.y),
+            Position((GLshort)(rect.x + rect.width), (GLshort)rect.y),
+            Position((GLshort)rect.x, (GLshort)(rect.y + rect.height)),
+            Position((GLshort)(rect.x + rect.width), (GLshort)(rect.y + rect.height))
+        };
+        for (const auto& i : { 0,1,2,1,2,3 })
+        {
+            this->copy_positions.set(count++, corners[i]);
+        }
+        extend(this->unsynced, rect);
     }
+
+    glUseProgram(this->copy_program);
+    glBindVertexArray(this->copy_vertex_array_object);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, this->vram->texture());
+    glDisable(GL_SCISSOR_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)count);
+    glEnable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(this->program);
+    glBindVertexArray(this->vertex_array_object);
+
+    // the pixel buffer is written again by the next upload
+    this->wait_for_gpu();
 }
 
-void Renderer::push_quad(Position positions[4], Color colors[4]) 
+// Bring the copy the primitives read from up to date with what was drawn
+void Renderer::update_read_copy()
 {
+    auto& rect = this->unsynced;
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->vram_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->read_framebuffer);
+    glBlitFramebuffer(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height,
+                      rect.x, rect.y, rect.x + rect.width, rect.y + rect.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->vram_framebuffer);
+    glEnable(GL_SCISSOR_TEST);
+    this->unsynced = {0, 0, 0, 0};
+}
+
+// Bring the tiles in 'rect' up to date in 'vram' with what was drawn into the framebuffer
+void Renderer::download_vram(const VramRect& rect)
+{
+    if (!this->drawn_any || rect.width == 0 || rect.height == 0)
+    {
+        return;
+    }
+    this->draw();
+
+    // tile rows and columns covered by the rect, it wraps around VRAM
+    const uint32_t tile_rows = VRAM_HEIGHT / VRAM_TILE_HEIGHT;
+    bool rows[tile_rows] = {};
+    bool columns[VRAM_TILES_X] = {};
+    uint32_t row_count = std::min((rect.y % VRAM_TILE_HEIGHT + rect.height + VRAM_TILE_HEIGHT - 1) / VRAM_TILE_HEIGHT, tile_rows);
+    uint32_t column_count = std::min<uint32_t>((rect.x % VRAM_TILE_WIDTH + rect.width + VRAM_TILE_WIDTH - 1) / VRAM_TILE_WIDTH, VRAM_TILES_X);
+    for (uint32_t i = 0; i < row_count; i++)
+    {
+        rows[(rect.y / VRAM_TILE_HEIGHT + i) % tile_rows] = true;
+    }
+    for (uint32_t i = 0; i < column_count; i++)
+    {
+        columns[(rect.x / VRAM_TILE_WIDTH + i) % VRAM_TILES_X] = true;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->vram_framebuffer);
+    bool remaining = false;
+    for (uint32_t row = 0; row < tile_rows; row++)
+    {
+        bool* drawn = &this->drawn_tiles[row * VRAM_TILES_X];
+        uint32_t column = 0;
+        while (column < VRAM_TILES_X)
+        {
+            if (!drawn[column] || !rows[row] || !columns[column])
+            {
+                remaining = remaining || drawn[column];
+                column++;
+                continue;
+            }
+            uint32_t first = column;
+            for (; column < VRAM_TILES_X && drawn[column] && columns[column]; column++)
+            {
+                drawn[column] = false;
+            }
+            this->download_tiles(row, first, column - first);
+        }
+    }
+    this->drawn_any = remaining;
+}
+
+// Read a run of tiles from the framebuffer and convert them back to VRAM words
+void Renderer::download_tiles(const uint32_t& row, const uint32_t& first, const uint32_t& count)
+{
+    uint32_t x = first * VRAM_TILE_WIDTH;
+    uint32_t y = row * VRAM_TILE_HEIGHT;
+    uint32_t width = count * VRAM_TILE_WIDTH;
+    this->download_pixels.resize((size_t)width * VRAM_TILE_HEIGHT * 4);
+    glReadPixels(GLint(x), GLint(y), GLsizei(width), VRAM_TILE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, this->download_pixels.data());
+
+    // the framebuffer keeps 5 bit components scaled to 8 bits and the mask bit in alpha,
+    // it already has these pixels so they are not uploaded again
+    const uint8_t* pixel = this->download_pixels.data();
+    for (uint32_t line = 0; line < VRAM_TILE_HEIGHT; line++)
+    {
+        for (uint32_t i = 0; i < width; i++, pixel += 4)
+        {
+            uint16_t word = (uint16_t)(((pixel[0] * 31 + 127) / 255) | (((pixel[1] * 31 + 127) / 255) << 5) |
+                                       (((pixel[2] * 31 + 127) / 255) << 10) | (pixel[3] >= 0x80 ? 0x8000 : 0));
+            this->vram->set(x + i, y + line, word, (uint8_t)(DIRTY_ALL & ~DIRTY_RENDERER));
+        }
+    }
+}
+
+void Renderer::push_primitive(Position* positions, Color* colors, TexCoord* texcoords, const Primitive& primitive, const uint32_t& count)
+{
+    // hidden frames are uploaded from VRAM once they are shown
+    if (this->headless)
+    {
+        return;
+    }
+    this->upload_vram();
+
+    // area drawn, the GPU skips primitives larger than VRAM
+    int32_t left = VRAM_WIDTH, top = VRAM_HEIGHT, right = -VRAM_WIDTH, bottom = -VRAM_HEIGHT;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        left = std::min(left, (int32_t)positions[i].x);
+        right = std::max(right, (int32_t)positions[i].x);
+        top = std::min(top, (int32_t)positions[i].y);
+        bottom = std::max(bottom, (int32_t)positions[i].y);
+    }
+    if (right - left >= VRAM_WIDTH || bottom - top >= VRAM_HEIGHT)
+    {
+        return;
+    }
+    left = std::max(left + this->offset_x, (int32_t)this->drawing_area.x);
+    top = std::max(top + this->offset_y, (int32_t)this->drawing_area.y);
+    right = std::min(right + this->offset_x, (int32_t)(this->drawing_area.x + this->drawing_area.width) - 1);
+    bottom = std::min(bottom + this->offset_y, (int32_t)(this->drawing_area.y + this->drawing_area.height) - 1);
+    if (right < left || bottom < top)
+    {
+        return;
+    }
+    VramRect area = {(uint32_t)left, (uint32_t)top, (uint32_t)(right - left + 1), (uint32_t)(bottom - top + 1)};
+
+    // what the fragment shader reads must have been drawn, including the queued primitives
+    std::vector<VramRect> reads;
+    if (primitive.flags & PRIMITIVE_TEXTURED)
+    {
+        uint32_t depth = (primitive.page >> 7) & 3;
+        uint32_t width = depth == 0 ? 64 : (depth == 1 ? 128 : 256);
+        push_wrapped(reads, (primitive.page & 0xf) * 64, ((primitive.page >> 4) & 1) * 256, width, 256);
+        if (depth < 2)
+        {
+            push_wrapped(reads, (primitive.clut & 0x3f) * 16, (primitive.clut >> 6) & 0x1ff, depth == 0 ? 16 : 256, 1);
+        }
+    }
+    if (primitive.flags & (PRIMITIVE_SEMI_TRANSPARENT | PRIMITIVE_CHECK_MASK))
+    {
+        reads.push_back(area);
+    }
+    for (const auto& rect : reads)
+    {
+        if (intersects(rect, this->unsynced))
+        {
+            this->draw();
+            this->update_read_copy();
+            break;
+        }
+    }
+    extend(this->unsynced, area);
+    for (uint32_t y = area.y / VRAM_TILE_HEIGHT; y <= (area.y + area.height - 1) / VRAM_TILE_HEIGHT; y++)
+    {
+        for (uint32_t x = area.x / VRAM_TILE_WIDTH; x <= (area.x + area.width - 1) / VRAM_TILE_WIDTH; x++)
+        {
+            this->drawn_tiles[y * VRAM_TILES_X + x] = true;
+        }
+    }
+    this->drawn_any = true;
+
     // make sure we have enough room to queue the vertices
     // 2 triangles = 1 quad, so 6 vertices
     if (this->nvertices + 6 > VERTEX_BUFFER_LEN)
@@ -261,33 +568,48 @@ void Renderer::push_quad(Position positions[4], Color colors[4])
         DEBUG("VERTEX_BUFFERS_FULL!_FORCING_DRAW!");
         this->draw();
     }
-    
-    // push first triangle
-    for (const auto& i : { 0,1,2 }) 
-    {
-        this->positions.set(this->nvertices, positions[i]);
-        this->colors.set(this->nvertices, colors[i]);
-        // DEBUG("Triangle-vertex-for-quad:" << positions[i].x << "," << positions[i].y << " -> " << (float(positions[i].x)/512)-1.0f << "," << float(positions[i].y / 256.0));
-        this->nvertices++;
-    }
-    // push second triangle
-    for (const auto& i : { 1,2,3 }) 
+
+    // quads are drawn as the triangles 0-1-2 and 1-2-3
+    for (const auto& i : { 0,1,2,1,2,3 })
     {
+        if (i == 3 && count == 3)
+        {
+            break;
+        }
         this->positions.set(this->nvertices, positions[i]);
         this->colors.set(this->nvertices, colors[i]);
-        // DEBUG("Triangle-vertex-for-quad:" << positions[i].x << "," << positions[i].y << " -> " << (float(positions[i].x)/512)-1.0f << "," << float(positions[i].y / 256.0));
+        this->texcoords.set(this->nvertices, texcoords[i]);
+        this->primitives.set(this->nvertices, primitive);
         this->nvertices++;
     }
 }
 
+void Renderer::push_triangle(Position positions[3], Color colors[3], TexCoord texcoords[3], const Primitive& primitive)
+{
+    this->push_primitive(positions, colors, texcoords, primitive, 3);
+}
+
+void Renderer::push_quad(Position positions[4], Color colors[4], TexCoord texcoords[4], const Primitive& primitive)
+{
+    this->push_primitive(positions, colors, texcoords, primitive, 4);
+}
+
 Renderer::~Renderer()
 {
     SDL_DestroyWindow(this->window);
     SDL_Quit();
+    glDeleteFramebuffers(1, &this->vram_framebuffer);
+    glDeleteFramebuffers(1, &this->read_framebuffer);
+    glDeleteTextures(1, &this->vram_texture);
+    glDeleteTextures(1, &this->read_texture);
     glDeleteVertexArrays(1, &this->vertex_array_object);
+    glDeleteVertexArrays(1, &this->copy_vertex_array_object);
     glDeleteShader(this->vertex_shader);
     glDeleteShader(this->fragment_shader);
+    glDeleteShader(this->copy_vertex_shader);
+    glDeleteShader(this->copy_fragment_shader);
     glDeleteProgram(this->program);
+    glDeleteProgram(this->copy_program);
 }
 
 void Renderer::set_drawing_offset(const int16_t& x, const int16_t& y)
@@ -295,6 +617,27 @@ void Renderer::set_drawing_offset(const int16_t& x, const int16_t& y)
     // draw before applying offset
     this->draw();
 
+    this->offset_x = x;
+    this->offset_y = y;
     glUniform2i(this->uniform_offset, GLint(x), GLint(y));
 }
 
+void Renderer::set_drawing_area(const uint16_t& left, const uint16_t& top, const uint16_t& right, const uint16_t& bottom)
+{
+    // draw before clipping to the new area
+    this->draw();
+
+    uint32_t width = right >= left ? right - left + 1 : 0;
+    uint32_t height = bottom >= top ? bottom - top + 1 : 0;
+    this->drawing_area = {left, top, width, height};
+    // framebuffer lines are VRAM lines
+    glScissor(GLint(left), GLint(top), GLsizei(width), GLsizei(height));
+}
+
+void Renderer::set_texture_window(const uint8_t& mask_x, const uint8_t& mask_y, const uint8_t& offset_x, const uint8_t& offset_y)
+{
+    // draw before changing the window
+    this->draw();
+
+    glUniform4i(this->uniform_texture_window, GLint(mask_x), GLint(mask_y), GLint(offset_x), GLint(offset_y));
+}
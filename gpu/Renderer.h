@@ -16,7 +16,9 @@
 
 #include "../util/logging.h"
 #include "../util/filesystem.h"
+#include "../memory/Vram.h"
 #include <cstring>
+#include <vector>
 
 #ifndef GL_MAP_WRITE_BIT
 #define GL_MAP_WRITE_BIT 0x0002
@@ -50,6 +52,37 @@ struct Color {
     };
 };
 
+struct TexCoord {
+    GLubyte u;
+    GLubyte v;
+    TexCoord(GLubyte u, GLubyte v)
+    {
+        this->u = u;
+        this->v = v;
+    };
+};
+
+// Primitive::flags
+const GLushort PRIMITIVE_TEXTURED = 1u << 0; // texels blended with the colour
+const GLushort PRIMITIVE_SEMI_TRANSPARENT = 1u << 1;
+const GLushort PRIMITIVE_FORCE_MASK = 1u << 2; // set the mask bit of the pixels drawn
+const GLushort PRIMITIVE_CHECK_MASK = 1u << 3; // do not draw over pixels with the mask bit
+const uint32_t PRIMITIVE_MODE_SHIFT = 4; // 2 bits of semi-transparency mode
+
+// Attributes shared by the vertices of a primitive, the fragment shader reads the texture
+// and its CLUT from the VRAM framebuffer with them
+struct Primitive {
+    GLushort page; // texpage attribute: page x in bits 0-3, page y in bit 4, depth in bits 7-8
+    GLushort clut; // CLUT attribute: x / 16 in bits 0-5, y in bits 6-14
+    GLushort flags;
+    Primitive(GLushort page, GLushort clut, GLushort flags)
+    {
+        this->page = page;
+        this->clut = clut;
+        this->flags = flags;
+    };
+};
+
 // Parse a position from a gp0 param
 inline Position pos_from_gp0(const uint32_t& value)
 {
@@ -93,12 +126,13 @@ public:
         glBufferStorage(GL_ARRAY_BUFFER, buffer_size, NULL, access);
 #endif
         this->map = (T*)glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size, access);
-        memset(this->map, 0, buffer_size);
         if (this->map == NULL)
         {
             DEBUG("ERROR:gl_buffer_range_mapped_is_null");
             throw std::exception();
         }
+        // raw GL memory, the elements are filled in before they are drawn
+        memset((void*)this->map, 0, buffer_size);
         DEBUG("MAP:" << this->map)
     }
 
@@ -120,20 +154,38 @@ public:
     }
 };
 
+// Draws into a 1024x512 framebuffer that stands for VRAM, the window shows all of it. Texture
+// lookups, the texture window, mask bits and semi-transparency are done in the fragment shader
+// from a copy of that framebuffer. The copy is brought up to date before a primitive reads an
+// area drawn since the last update, which also orders the primitives that blend with the ones
+// under them. While the renderer is not headless the framebuffer is the current VRAM and the
+// software rasterizer does not run: the tiles drawn are read back into 'vram' by download_vram()
+// when it is accessed from the CPU side. Writes to VRAM the renderer did not draw itself (image
+// loads, loaded states, frames drawn while headless) are uploaded from 'vram' through its pixel
+// buffer before the next primitive.
 class Renderer
 {
 public:
-    Renderer();
+    explicit Renderer(Vram* vram);
     ~Renderer();
 
-    void push_triangle(Position positions[3], Color colors[3]);
-    void push_quad(Position positions[4], Color colors[4]);
+    void push_triangle(Position positions[3], Color colors[3], TexCoord texcoords[3], const Primitive& primitive);
+    void push_quad(Position positions[4], Color colors[4], TexCoord texcoords[4], const Primitive& primitive);
     void display();
     void set_drawing_offset(const int16_t& x, const int16_t& y);
+    // inclusive, in VRAM pixels
+    void set_drawing_area(const uint16_t& left, const uint16_t& top, const uint16_t& right, const uint16_t& bottom);
+    // mask and offset in texels
+    void set_texture_window(const uint8_t& mask_x, const uint8_t& mask_y, const uint8_t& offset_x, const uint8_t& offset_y);
+    // copy the tiles drawn in 'rect' (wrapping around VRAM) back into 'vram'
+    void download_vram(const VramRect& rect);
+
+    bool headless = false; // discard primitives instead of drawing and presenting them
 private:
     SDL_Window* window;
     SDL_Surface* screen_surface;
     SDL_GLContext gl_context;
+    Vram* vram; // written behind the renderer, see DIRTY_RENDERER
 
     GLuint vertex_shader;
     GLuint fragment_shader;
@@ -141,12 +193,42 @@ private:
     GLuint vertex_array_object; // openGL vertex array object
     Buffer<Position> positions; // buffer with positions
     Buffer<Color> colors; // buffer with colors
+    Buffer<TexCoord> texcoords; // buffer with texture coordinates
+    Buffer<Primitive> primitives; // buffer with primitive attributes
     uint32_t nvertices = 0; // current n of vertices in the buffers
     GLint uniform_offset; // offset for drawing vertices
-    
+    GLint uniform_texture_window;
+    int16_t offset_x = 0;
+    int16_t offset_y = 0;
+    VramRect drawing_area = {0, 0, VRAM_WIDTH, VRAM_HEIGHT};
+
+    // VRAM framebuffer, and the copy the primitives read from
+    GLuint vram_texture;
+    GLuint vram_framebuffer;
+    GLuint read_texture;
+    GLuint read_framebuffer;
+    VramRect unsynced = {0, 0, 0, 0}; // drawn since the copy was updated, including queued primitives
+    bool drawn_tiles[VRAM_TILES] = {}; // drawn since 'vram' was updated, including queued primitives
+    bool drawn_any = false;
+    std::vector<uint8_t> download_pixels;
+
+    // draws the uploaded VRAM words into the framebuffer
+    GLuint copy_vertex_shader;
+    GLuint copy_fragment_shader;
+    GLuint copy_program;
+    GLuint copy_vertex_array_object;
+    Buffer<Position> copy_positions;
+    std::vector<VramRect> uploads;
+
     bool init_sdl();
+    void init_framebuffer(GLuint& texture, GLuint& framebuffer);
     void check_for_errors();
+    void wait_for_gpu();
     void draw();
+    void upload_vram();
+    void update_read_copy();
+    void download_tiles(const uint32_t& row, const uint32_t& first, const uint32_t& count);
+    void push_primitive(Position* positions, Color* colors, TexCoord* texcoords, const Primitive& primitive, const uint32_t& count);
 };
 
 #endif
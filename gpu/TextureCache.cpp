@@ -0,0 +1,154 @@
+#include "TextureCache.h"
+#include "../memory/DirtyPages.h"
+#include <cstring>
+
+// halfwords of VRAM a row of the page is read from
+static uint32_t page_width(const TextureDepth& depth)
+{
+    switch (depth)
+    {
+        case T4Bit:
+            return TEXTURE_PAGE_SIZE / 4;
+        case T8Bit:
+            return TEXTURE_PAGE_SIZE / 2;
+        default:
+            return TEXTURE_PAGE_SIZE;
+    }
+}
+
+// bit mask of the tile columns covered by 'width' halfwords from 'x', wrapping around
+static uint16_t tile_columns(const uint32_t& x, const uint32_t& width)
+{
+    uint16_t columns = 0;
+    for (uint32_t column = x / VRAM_TILE_WIDTH; column <= (x + width - 1) / VRAM_TILE_WIDTH; column++)
+    {
+        columns |= (uint16_t)(1u << (column % VRAM_TILES_X));
+    }
+    return columns;
+}
+
+TextureCache::TextureCache(Vram* vram)
+{
+    this->vram = vram;
+}
+
+TexturePage* TextureCache::lookup(const uint8_t& page_x, const uint8_t& page_y, const TextureDepth& depth, const uint16_t& clut)
+{
+    this->invalidate_written_tiles();
+
+    // 15-bit pages have no CLUT, the attribute is left out of the key so they are shared
+    uint16_t clut_key = depth == T15Bit ? 0 : clut & 0x7fff;
+    uint32_t key = ((uint32_t)clut_key << 8) | ((uint32_t)depth << 5) | ((uint32_t)(page_y & 1) << 4) | (page_x & 0xf);
+    this->uses++;
+
+    if (this->last != nullptr && this->last->key == key)
+    {
+        this->last->last_use = this->uses;
+        this->hits++;
+        return this->last;
+    }
+    TexturePage* oldest = nullptr;
+    for (auto& page : this->pages)
+    {
+        if (page->key == key)
+        {
+            page->last_use = this->uses;
+            this->last = page.get();
+            this->hits++;
+            return this->last;
+        }
+        if (oldest == nullptr || page->last_use < oldest->last_use)
+        {
+            oldest = page.get();
+        }
+    }
+    this->misses++;
+
+    TexturePage* page = oldest;
+    if (this->pages.size() < TEXTURE_CACHE_PAGES)
+    {
+        this->pages.push_back(std::make_unique<TexturePage>());
+        page = this->pages.back().get();
+    }
+    page->key = key;
+    page->x = (uint32_t)(page_x & 0xf) * 64;
+    page->y = (uint32_t)(page_y & 1) * 256;
+    page->depth = depth;
+    page->clut_x = (uint32_t)(clut & 0x3f) * 16;
+    page->clut_y = (uint32_t)(clut >> 6) & 0x1ff;
+    page->page_columns = tile_columns(page->x, page_width(depth));
+    page->clut_columns = depth == T15Bit ? 0 : tile_columns(page->clut_x, depth == T4Bit ? 16 : 256);
+    page->last_use = this->uses;
+    this->invalidate_rows(*page, 0, TEXTURE_PAGE_SIZE);
+    this->last = page;
+    return page;
+}
+
+void TextureCache::invalidate_rows(TexturePage& page, const uint32_t& first, const uint32_t& count)
+{
+    memset(&page.row_valid[first], 0, count * sizeof(bool));
+}
+
+// drops what was read from the tiles written since the last lookup
+void TextureCache::invalidate_written_tiles()
+{
+    if ((this->vram->dirty_tiles_any & DIRTY_TEXTURE) == 0)
+    {
+        return;
+    }
+    for (uint32_t tile = 0; tile < VRAM_TILES; tile++)
+    {
+        if ((this->vram->dirty_tiles[tile] & DIRTY_TEXTURE) == 0)
+        {
+            continue;
+        }
+        uint16_t column = (uint16_t)(1u << (tile % VRAM_TILES_X));
+        uint32_t top = (tile / VRAM_TILES_X) * VRAM_TILE_HEIGHT;
+        for (auto& page : this->pages)
+        {
+            if ((page->clut_columns & column) != 0 && page->clut_y >= top && page->clut_y < top + VRAM_TILE_HEIGHT)
+            {
+                this->invalidate_rows(*page, 0, TEXTURE_PAGE_SIZE);
+            }
+            else if ((page->page_columns & column) != 0 && top >= page->y && top < page->y + TEXTURE_PAGE_SIZE)
+            {
+                this->invalidate_rows(*page, top - page->y, VRAM_TILE_HEIGHT);
+            }
+        }
+    }
+    this->vram->clear_dirty_tiles(DIRTY_TEXTURE);
+}
+
+void TextureCache::decode_row(TexturePage& page, const uint8_t& v)
+{
+    uint16_t* texels = &page.texels[v * TEXTURE_PAGE_SIZE];
+    uint32_t y = page.y + v;
+    switch (page.depth)
+    {
+        case T4Bit:
+            for (uint32_t u = 0; u < TEXTURE_PAGE_SIZE; u += 4)
+            {
+                uint16_t indices = this->vram->get(page.x + u / 4, y);
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    texels[u + i] = this->vram->get(page.clut_x + ((indices >> (i * 4)) & 0xf), page.clut_y);
+                }
+            }
+            break;
+        case T8Bit:
+            for (uint32_t u = 0; u < TEXTURE_PAGE_SIZE; u += 2)
+            {
+                uint16_t indices = this->vram->get(page.x + u / 2, y);
+                texels[u] = this->vram->get(page.clut_x + (indices & 0xff), page.clut_y);
+                texels[u + 1] = this->vram->get(page.clut_x + (indices >> 8), page.clut_y);
+            }
+            break;
+        default:
+            for (uint32_t u = 0; u < TEXTURE_PAGE_SIZE; u++)
+            {
+                texels[u] = this->vram->get(page.x + u, y);
+            }
+            break;
+    }
+    page.row_valid[v] = true;
+}
@@ -0,0 +1,74 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "../memory/Vram.h"
+
+// Depth of pixel values in a texture page
+enum TextureDepth {
+    T4Bit = 0, // 4 bits per pixel
+    T8Bit = 1,
+    T15Bit = 2
+};
+
+// texels per side of a texture page
+const uint32_t TEXTURE_PAGE_SIZE = 256;
+// decoded pages kept at most, the least recently used one is dropped when a new one is needed
+const uint32_t TEXTURE_CACHE_PAGES = 64;
+
+// A texture page as the primitives see it: 256x256 texels with the CLUT already applied, in the
+// 16-bit format of VRAM. Rows are decoded the first time they are sampled.
+struct TexturePage
+{
+    uint32_t key;
+    uint32_t x, y; // top left of the page in VRAM
+    TextureDepth depth;
+    uint32_t clut_x, clut_y; // first CLUT entry in VRAM
+    uint16_t page_columns; // tile columns the texels are read from
+    uint16_t clut_columns; // tile columns of the CLUT
+    uint64_t last_use;
+    bool row_valid[TEXTURE_PAGE_SIZE];
+    uint16_t texels[TEXTURE_PAGE_SIZE * TEXTURE_PAGE_SIZE];
+};
+
+// Textures decoded from VRAM for the software rasterizer, keyed by texture page, depth and CLUT.
+// Palettized textures are expanded once instead of for every texel drawn. Writes to VRAM are
+// tracked per tile, a write only drops the rows that were read from the tile, or the whole page
+// when it hits the CLUT.
+class TextureCache
+{
+public:
+    explicit TextureCache(Vram* vram);
+
+    // page at page_x * 64, page_y * 256 in VRAM, with the CLUT attribute of a primitive (ignored
+    // for 15-bit pages). The pointer is valid until the next lookup
+    TexturePage* lookup(const uint8_t& page_x, const uint8_t& page_y, const TextureDepth& depth, const uint16_t& clut);
+
+    const uint16_t* row(TexturePage& page, const uint8_t& v)
+    {
+        if (!page.row_valid[v])
+        {
+            this->decode_row(page, v);
+        }
+        return &page.texels[v * TEXTURE_PAGE_SIZE];
+    };
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+private:
+    Vram* vram; // the cache clears its DIRTY_TEXTURE bit of the tiles
+    std::vector<std::unique_ptr<TexturePage>> pages;
+    TexturePage* last = nullptr; // consecutive primitives tend to use the same page
+    uint64_t uses = 0;
+
+    void invalidate_written_tiles();
+    void invalidate_rows(TexturePage& page, const uint32_t& first, const uint32_t& count);
+    void decode_row(TexturePage& page, const uint8_t& v);
+};
+
+#endif
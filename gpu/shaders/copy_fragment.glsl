@@ -0,0 +1,11 @@
+#version 330 core
+
+// VRAM words uploaded from the CPU
+uniform usampler2D vram16;
+out vec4 frag_color;
+
+void main() {
+    uint word = texelFetch(vram16, ivec2(gl_FragCoord.xy), 0).r;
+    // 5 bit components, the mask bit in alpha
+    frag_color = vec4(float(word & 31u) / 31.0, float((word >> 5) & 31u) / 31.0, float((word >> 10) & 31u) / 31.0, float(word >> 15));
+}
@@ -0,0 +1,8 @@
+#version 330 core
+in ivec2 vertex_position;
+
+void main() 
+{
+    // corners of a VRAM rect, framebuffer lines are VRAM lines
+    gl_Position = vec4((float(vertex_position.x) / 512) - 1.0, (float(vertex_position.y) / 256) - 1.0, 0.0, 1.0);
+}
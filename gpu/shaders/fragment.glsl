@@ -1,9 +1,122 @@
 #version 330 core
 
 in vec3 color;
+in vec2 texcoord;
+// texpage attribute, CLUT attribute, flags
+flat in uvec3 primitive;
 out vec4 frag_color;
 
-void main() {
-    // hardcode to opaque pixels
-    frag_color = vec4(color, 1.0);
-}
\ No newline at end of file
+// copy of the VRAM framebuffer: textures, CLUTs and the pixels under the primitive
+uniform sampler2D vram;
+// mask x, y and offset x, y in texels
+uniform ivec4 texture_window;
+
+// Primitive::flags in Renderer.h
+const uint TEXTURED = 1u;
+const uint SEMI_TRANSPARENT = 2u;
+const uint FORCE_MASK = 4u;
+const uint CHECK_MASK = 8u;
+const uint MODE_SHIFT = 4u;
+
+// the framebuffer keeps the 5 bit components and the mask bit in alpha
+uint vram_word(ivec2 position)
+{
+    uvec4 c = uvec4(round(texelFetch(vram, position & ivec2(1023, 511), 0) * vec4(31.0, 31.0, 31.0, 1.0)));
+    return c.r | (c.g << 5) | (c.b << 10) | (c.a << 15);
+}
+
+uvec3 components(uint word)
+{
+    return uvec3(word & 31u, (word >> 5) & 31u, (word >> 10) & 31u);
+}
+
+// texel of the texture page, through the CLUT for 4 and 8 bit pages
+uint texel(ivec2 uv)
+{
+    uint page = primitive.x;
+    uint clut = primitive.y;
+    ivec2 base = ivec2(int(page & 15u) * 64, int((page >> 4) & 1u) * 256);
+    ivec2 clut_base = ivec2(int(clut & 63u) * 16, int((clut >> 6) & 511u));
+    uint depth = (page >> 7) & 3u;
+
+    if (depth == 0u)
+    {
+        uint indices = vram_word(base + ivec2(uv.x / 4, uv.y));
+        uint index = (indices >> uint((uv.x & 3) * 4)) & 15u;
+        return vram_word(clut_base + ivec2(int(index), 0));
+    }
+    if (depth == 1u)
+    {
+        uint indices = vram_word(base + ivec2(uv.x / 2, uv.y));
+        uint index = (indices >> uint((uv.x & 1) * 8)) & 255u;
+        return vram_word(clut_base + ivec2(int(index), 0));
+    }
+    return vram_word(base + uv);
+}
+
+void main()
+{
+    uint flags = primitive.z;
+    // framebuffer lines are VRAM lines
+    uint back = vram_word(ivec2(gl_FragCoord.xy));
+    if ((flags & CHECK_MASK) != 0u && (back & 0x8000u) != 0u)
+    {
+        discard;
+    }
+
+    uvec3 rgb = uvec3(clamp(color, 0.0, 255.0));
+    uvec3 front;
+    uint mask = 0u;
+    bool blended = (flags & SEMI_TRANSPARENT) != 0u;
+    if ((flags & TEXTURED) != 0u)
+    {
+        ivec2 uv = ivec2(texcoord) & 255;
+        uv = (uv & ~texture_window.xy) | (texture_window.zw & texture_window.xy);
+        uint t = texel(uv);
+        // black without the mask bit is transparent
+        if (t == 0u)
+        {
+            discard;
+        }
+        // a colour of 0x80 leaves the texel as it is
+        front = min((components(t) * rgb) >> 7u, uvec3(31u));
+        mask = t >> 15;
+        // only the texels with the mask bit are semi-transparent
+        blended = blended && mask != 0u;
+    }
+    else
+    {
+        front = rgb >> 3u;
+    }
+
+    if (blended)
+    {
+        ivec3 b = ivec3(components(back));
+        ivec3 f = ivec3(front);
+        uint mode = (flags >> MODE_SHIFT) & 3u;
+        ivec3 c;
+        if (mode == 0u)
+        {
+            c = (b + f) / 2;
+        }
+        else if (mode == 1u)
+        {
+            c = b + f;
+        }
+        else if (mode == 2u)
+        {
+            c = b - f;
+        }
+        else
+        {
+            c = b + f / 4;
+        }
+        front = uvec3(clamp(c, 0, 31));
+    }
+    if ((flags & FORCE_MASK) != 0u)
+    {
+        mask = 1u;
+    }
+
+    frag_color = vec4(vec3(front) / 31.0, float(mask));
+}
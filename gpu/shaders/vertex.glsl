@@ -1,8 +1,12 @@
 #version 330 core
 in ivec2 vertex_position;
 in ivec3 vertex_color;
+in uvec2 vertex_texcoord;
+in uvec3 vertex_primitive;
 
 out vec3 color;
+out vec2 texcoord;
+flat out uvec3 primitive;
 
 // drawing offset
 uniform ivec2 uniform_offset; 
@@ -12,15 +16,18 @@ void main()
     // apply offset
     ivec2 position = vertex_position + uniform_offset;
 
-    // Convert VRAM coords into OpenGL coords (e.g. 0;1023, 0;511 -> -1;1, -1;1)
-    float xpos = (float(position.x) / 512) - 1.0;
-    // VRAM puts 0 to top, OpenGL to bottom, so flip
-    float ypos = 1.0 - (float(position.y) / 256);
+    // Convert VRAM coords into OpenGL coords (e.g. 0;1023, 0;511 -> -1;1, -1;1). Moved by half a
+    // pixel, the console samples a pixel at its top left corner and OpenGL at its centre
+    float xpos = ((float(position.x) + 0.5) / 512) - 1.0;
+    // framebuffer lines are VRAM lines, the window flips them when showing the framebuffer
+    float ypos = ((float(position.y) + 0.5) / 256) - 1.0;
 
     gl_Position.xyzw = vec4(xpos, ypos, 0.0, 1.0);
 
-    // Convert from 0;255 to 0;1
-    color = vec3(float(vertex_color.r) / 255,
-                 float(vertex_color.g) / 255,
-                 float(vertex_color.b) / 255);
+    // colour components stay 0;255, the fragment shader works on the integer values
+    color = vec3(vertex_color);
+
+    // texel coordinates in the texture page
+    texcoord = vec2(vertex_texcoord);
+    primitive = vertex_primitive;
 }
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "Batch.h"
+#include "../state/Movie.h"
+#include "../state/FrameHash.h"
+#include "../util/logging.h"
+
+bool readBatchJobs(const std::string &fname, std::vector<BatchJob> &jobs) {
+    std::ifstream file(fname);
+    if (!file) {
+        DEBUG("Unable_to_read_batch_file:" << fname);
+        return false;
+    }
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string token;
+        BatchJob job = BatchJob();
+        bool empty = true;
+        while (tokens >> token) {
+            empty = false;
+            if (token.rfind("frames=", 0) == 0) {
+                job.frames = strtoull(token.c_str() + 7, nullptr, 10);
+            } else if (token.rfind("exe=", 0) == 0) {
+                job.exe = token.substr(4);
+            } else if (token.rfind("disc=", 0) == 0) {
+                job.disc = token.substr(5);
+            } else if (token.rfind("replay=", 0) == 0) {
+                job.replay = token.substr(7);
+            } else {
+                DEBUG("Unknown_batch_option_at_line_" << std::dec << line_number << ":" << token);
+                return false;
+            }
+        }
+        if (empty) {
+            continue;
+        }
+        if (job.frames == 0 && job.replay.empty()) {
+            DEBUG("Batch_job_at_line_" << std::dec << line_number << "_never_ends,_give_frames_or_a_movie");
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+BatchRunner::BatchRunner(Bios *bios, const MachineConfig &config, const uint32_t &threads)
+    : predecoded(PredecodedBios(*bios)) {
+    this->bios = bios;
+    this->config = config;
+    this->config.headless = true;
+    // the jobs already keep every core busy
+    this->config.mdec_threads = 0;
+    this->threads = std::max<uint32_t>(1, threads);
+}
+
+std::vector<BatchResult> BatchRunner::run(const std::vector<BatchJob> &jobs) {
+    std::vector<BatchResult> results(jobs.size());
+
+    // executables are read-only once loaded, every machine running one points at the same copy
+    std::map<std::string, std::unique_ptr<PsxExe>> exes;
+    for (const auto& job : jobs) {
+        if (job.exe.empty() || exes.count(job.exe) != 0) {
+            continue;
+        }
+        auto exe = std::make_unique<PsxExe>();
+        if (!exe->load(job.exe)) {
+            exe = nullptr; // jobs using it fail
+        }
+        exes[job.exe] = std::move(exe);
+    }
+
+    std::atomic<size_t> next_job = 0;
+    auto worker = [&]() {
+        while (true) {
+            auto i = next_job.fetch_add(1);
+            if (i >= jobs.size()) {
+                return;
+            }
+            // the map is shared between the workers, only look it up
+            const auto& job = jobs[i];
+            const PsxExe* exe = nullptr;
+            if (!job.exe.empty()) {
+                exe = exes.at(job.exe).get();
+                if (exe == nullptr) {
+                    continue;
+                }
+            }
+            results[i] = this->runJob(job, exe);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    auto count = std::min<size_t>(this->threads, jobs.size());
+    for (size_t i = 0; i < count; i++) {
+        pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return results;
+}
+
+BatchResult BatchRunner::runJob(const BatchJob &job, const PsxExe *exe) {
+    BatchResult result = BatchResult();
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        // a few MiB, too large for a worker stack
+        auto machine = std::make_unique<Machine>(this->bios, this->config, &this->predecoded);
+        if (exe != nullptr) {
+            machine->sideload(exe);
+        }
+        if (!job.disc.empty()) {
+            auto disc = open_disc(job.disc);
+            if (!disc) {
+                return result;
+            }
+            machine->insertDisc(std::move(disc));
+        }
+
+        Movie movie = Movie();
+        if (!job.replay.empty()) {
+            MovieOptions options = MovieOptions();
+            if (!movie.replay(job.replay, machine->cpu, options)) {
+                return result;
+            }
+            machine->applyMovieOptions(options);
+        }
+
+        while (job.frames == 0 || machine->frames < job.frames) {
+            machine->runFrame();
+            if (movie.replaying()) {
+                movie.replayEvents(machine->scheduler.cycles, machine->cpu);
+                if (movie.finished()) {
+                    break;
+                }
+            }
+        }
+
+        FrameHasher hasher = FrameHasher();
+        result.hash = hasher.hash(machine->cpu);
+        result.frames = machine->frames;
+        result.cycles = machine->scheduler.cycles;
+        result.ok = true;
+    } catch (const std::exception& e) {
+        // the machine hit something unimplemented, the other jobs go on
+        DEBUG("Batch_job_failed");
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
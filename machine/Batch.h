@@ -0,0 +1,46 @@
+#ifndef PSXEMU_BATCH_H
+#define PSXEMU_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Machine.h"
+
+struct BatchJob {
+    std::string exe; // side-loaded executable, empty to boot the BIOS shell
+    std::string disc; // .cue or .bin image in the drive
+    std::string replay; // movie to replay, its recorded options replace the configured ones
+    uint64_t frames = 0; // frames to run, 0 to run until the movie ends
+};
+
+struct BatchResult {
+    bool ok = false;
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+    uint64_t hash = 0; // frame hash of the final state
+    double seconds = 0; // host time spent on the job
+};
+
+// Jobs, one per line: "frames=<n> exe=<file> disc=<file> replay=<file>", every key optional. '#' starts a comment
+bool readBatchJobs(const std::string& fname, std::vector<BatchJob>& jobs);
+
+// Runs jobs on headless machines spread over a pool of worker threads. Every worker builds a
+// machine per job, so only as many machines as workers exist at a time. The BIOS image and
+// the executables are loaded once and shared by all of them.
+class BatchRunner {
+public:
+    BatchRunner(Bios* bios, const MachineConfig& config, const uint32_t& threads);
+
+    // results are in the order of the jobs
+    std::vector<BatchResult> run(const std::vector<BatchJob>& jobs);
+
+private:
+    Bios* bios;
+    PredecodedBios predecoded; // of the BIOS, shared like the BIOS itself
+    MachineConfig config;
+    uint32_t threads;
+
+    BatchResult runJob(const BatchJob& job, const PsxExe* exe);
+};
+
+#endif //PSXEMU_BATCH_H
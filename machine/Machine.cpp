@@ -0,0 +1,88 @@
+#include "Machine.h"
+#include "../util/logging.h"
+
+Machine::Machine(Bios *bios, const MachineConfig &config, const PredecodedBios *predecoded)
+    : bios(bios),
+      gpu(Gpu(config.headless)),
+      spu(Spunit(&this->scheduler)),
+      irq(InterruptController(&this->scheduler)),
+      timers(Timers(&this->scheduler, &this->irq, &this->gpu)),
+      cdrom(CdRomController(&this->scheduler, &this->irq)),
+      interconnect(Interconnect(bios, &this->ram, &this->dma, &this->gpu, &this->spu, &this->scheduler, &this->irq, &this->timers, &this->cdrom, &this->mdec)),
+      cpu(Cpu(&this->interconnect)),
+      hle(BiosHle(&this->ram)) {
+    this->gpu.irq = &this->irq;
+    this->cpu.predecoded_bios = predecoded;
+
+    this->cpu.gte.enableRtpCache(config.gte_cache);
+    this->cpu.idle_skip = config.idle_skip;
+    this->spu.reverb_enabled = config.reverb;
+    this->mdec.start_workers(config.mdec_threads);
+    for (const auto& name : config.hle_disabled) {
+        if (!this->hle.setEnabled(name, false)) {
+            DEBUG("Unknown_BIOS_HLE_function:" << name);
+        }
+    }
+    if (config.bios_hle) {
+        this->cpu.hle = &this->hle;
+    }
+
+    this->scheduler.setHandler(VBlankEvent, [this]() {
+        this->gpu.vblank();
+        this->irq.request(IrqVBlank);
+        this->frame_done = true;
+        this->frames++;
+        this->scheduler.schedule(VBlankEvent, this->gpu.cpu_cycles_per_frame());
+    });
+    this->scheduler.schedule(VBlankEvent, this->gpu.cpu_cycles_per_frame());
+    // nothing to do, interrupts are checked after every slice
+    this->scheduler.setHandler(InterruptCheckEvent, []() {});
+}
+
+void Machine::sideload(const PsxExe *exe) {
+    // fast boot: the BIOS initializes the kernel, then the executable replaces the shell
+    this->cpu.sideload_exe = exe;
+}
+
+void Machine::insertDisc(std::unique_ptr<Disc> disc) {
+    this->disc = std::move(disc);
+    this->cdrom.disc = this->disc.get();
+}
+
+void Machine::runSlice() {
+    while (!this->scheduler.due()) {
+        this->cpu.runNextInstruction();
+    }
+    this->scheduler.runEvents();
+    this->cpu.checkInterrupts();
+}
+
+void Machine::runFrame() {
+    do {
+        this->runSlice();
+    } while (!this->frame_done);
+    this->frame_done = false;
+}
+
+MovieOptions Machine::movieOptions() const {
+    MovieOptions options = MovieOptions();
+    options.flags = (this->cpu.hle != nullptr ? MOVIE_FLAG_BIOS_HLE : 0) | (this->cpu.idle_skip ? MOVIE_FLAG_IDLE_SKIP : 0) |
+                    (this->spu.reverb_enabled ? MOVIE_FLAG_REVERB : 0);
+    options.hle_disabled = this->hle.disabledFunctions();
+    return options;
+}
+
+void Machine::applyMovieOptions(const MovieOptions &options) {
+    this->cpu.hle = (options.flags & MOVIE_FLAG_BIOS_HLE) != 0 ? &this->hle : nullptr;
+    this->cpu.idle_skip = (options.flags & MOVIE_FLAG_IDLE_SKIP) != 0;
+    this->spu.reverb_enabled = (options.flags & MOVIE_FLAG_REVERB) != 0;
+    // the functions interpreted instead of handled natively change the timing as well
+    for (const auto& name : this->hle.disabledFunctions()) {
+        this->hle.setEnabled(name, true);
+    }
+    for (const auto& name : options.hle_disabled) {
+        if (!this->hle.setEnabled(name, false)) {
+            DEBUG("Unknown_BIOS_HLE_function_in_movie:" << name);
+        }
+    }
+}
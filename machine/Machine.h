@@ -0,0 +1,69 @@
+#ifndef PSXEMU_MACHINE_H
+#define PSXEMU_MACHINE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../bios/Bios.h"
+#include "../bios/Hle.h"
+#include "../bios/Exe.h"
+#include "../cpu/Cpu.h"
+#include "../bus/Interconnect.h"
+#include "../state/Movie.h"
+
+struct MachineConfig {
+    bool headless = false; // no window or GL context, nothing is drawn
+    bool bios_hle = false;
+    bool idle_skip = true;
+    bool gte_cache = false;
+    bool reverb = true; // SPU reverb, off for throughput benchmarks
+    uint32_t mdec_threads = 2; // MDEC worker threads, 0 decodes FMVs on the emulation thread
+    std::vector<std::string> hle_disabled; // kernel functions kept interpreted
+};
+
+// A complete console: every component, wired together, with no global state. Machines only
+// share what is read-only, the BIOS image and side-loaded executables, so a process can run
+// any number of headless ones side by side. A machine is driven by a single thread at a time.
+class Machine {
+public:
+    // 'predecoded' is optional, built from the same BIOS
+    Machine(Bios* bios, const MachineConfig& config, const PredecodedBios* predecoded = nullptr);
+    // the components point at each other
+    Machine(const Machine&) = delete;
+    Machine& operator=(const Machine&) = delete;
+
+    Bios* bios; // shared, never written, like the predecoded table
+    Ram ram;
+    Dma dma;
+    Gpu gpu;
+    Scheduler scheduler;
+    Spunit spu;
+    InterruptController irq;
+    Timers timers;
+    CdRomController cdrom;
+    Mdec mdec;
+    Interconnect interconnect;
+    Cpu cpu;
+    BiosHle hle;
+
+    // host side, not part of the machine state
+    uint64_t frames = 0; // vertical blanks so far
+    bool frame_done = false; // set at every vertical blank, cleared by whoever services the frame
+    std::unique_ptr<Disc> disc; // every machine opens its own, mapped images still share the page cache
+
+    // run the executable instead of the BIOS shell, 'exe' must outlive the machine
+    void sideload(const PsxExe* exe);
+    // put a disc in the drive, nullptr empties it
+    void insertDisc(std::unique_ptr<Disc> disc);
+    // run the CPU until the next scheduled event
+    void runSlice();
+    // run until the next vertical blank
+    void runFrame();
+
+    // timing options, as recorded in movies
+    MovieOptions movieOptions() const;
+    void applyMovieOptions(const MovieOptions& options);
+};
+
+#endif //PSXEMU_MACHINE_H
@@ -1,16 +1,179 @@
 #include <cstdint>
 #include "bios/Bios.h"
+#include "cdrom/Compressed.h"
 #include "cpu/Cpu.h"
-#include "gpu/Gpu.h"
-#include "spu/Spu.h"
-#include "memory/Ram.h"
+#include "gpu/Constants.h"
+#include "machine/Machine.h"
+#include "machine/Batch.h"
+#include "spu/AudioOutput.h"
+#include "state/Savestate.h"
+#include "state/Rewind.h"
+#include "state/RunAhead.h"
+#include "state/Movie.h"
+#include "state/FrameHash.h"
 #include "util/logging.h"
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 const char* BIOS_FNAME   = "./SCPH1001.BIN";
 const uint32_t BIOS_SIZE = 512*1024; // 512KB bios size
 
-int main() {
+void print_stats(const Cpu& cpu)
+{
+    if (cpu.hle != nullptr)
+    {
+        cpu.hle->printStats();
+    }
+    if (cpu.idle_skip)
+    {
+        DEBUG("Idle_loops:_" << std::dec << cpu.idle_loops_skipped << "_skipped,_" << cpu.idle_cycles_skipped << "_cycles_fast_forwarded");
+    }
+    if (cpu.gte.rtpCacheEnabled())
+    {
+        DEBUG("GTE_RTP_cache:_" << std::dec << cpu.gte.rtp_cache_hits << "_hits,_" << cpu.gte.rtp_cache_misses << "_misses,_hit_rate_" << cpu.gte.rtpCacheHitRate());
+    }
+}
+
+void print_rewind_stats(RewindBuffer* rewind)
+{
+    if (rewind != nullptr)
+    {
+        DEBUG("Rewind:_" << std::dec << rewind->steps() << "_steps_in_" << rewind->memoryUsage() / 1024 << "KiB");
+    }
+}
+
+int main(int argc, char** argv) {
+
+    bool gte_cache = false;
+    bool bios_hle = false;
+    bool idle_skip = true;
+    std::vector<std::string> hle_disabled;
+    std::string exe_fname;
+    std::string state_fname = "./psxemu.state";
+    bool load_state = false;
+    uint32_t checkpoint_seconds = 0;
+    uint32_t rewind_mib = 0;
+    uint32_t rewind_interval = 10;
+    uint32_t run_ahead_frames = 0;
+    std::string record_fname;
+    std::string replay_fname;
+    bool headless = false;
+    bool reverb = true;
+    uint32_t mdec_threads = 2;
+    bool audio = true;
+    std::string audio_fname;
+    std::string hash_fname;
+    std::string disc_fname;
+    std::string pack_fname;
+    std::string batch_fname;
+    uint32_t batch_threads = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--gte-cache") == 0)
+        {
+            gte_cache = true; // memoize RTPS/RTPT results of static geometry
+        }
+        else if (strcmp(argv[i], "--bios-hle") == 0)
+        {
+            bios_hle = true; // run BIOS kernel functions natively
+        }
+        else if (strncmp(argv[i], "--bios-hle-off=", 15) == 0)
+        {
+            hle_disabled.emplace_back(argv[i] + 15); // keep interpreting a single kernel function
+        }
+        else if (strcmp(argv[i], "--no-idle-skip") == 0)
+        {
+            idle_skip = false; // always interpret busy-wait loops
+        }
+        else if (strncmp(argv[i], "--state=", 8) == 0)
+        {
+            state_fname = argv[i] + 8; // savestate file for F5/F7 and checkpoints
+        }
+        else if (strcmp(argv[i], "--load-state") == 0)
+        {
+            load_state = true; // resume from the savestate file
+        }
+        else if (strncmp(argv[i], "--checkpoint=", 13) == 0)
+        {
+            checkpoint_seconds = (uint32_t)strtoul(argv[i] + 13, nullptr, 10); // save every n emulated seconds
+        }
+        else if (strncmp(argv[i], "--rewind=", 9) == 0)
+        {
+            rewind_mib = (uint32_t)strtoul(argv[i] + 9, nullptr, 10); // memory budget of the rewind history
+        }
+        else if (strncmp(argv[i], "--rewind-interval=", 18) == 0)
+        {
+            rewind_interval = std::max<uint32_t>(1, (uint32_t)strtoul(argv[i] + 18, nullptr, 10)); // frames between rewind captures
+        }
+        else if (strncmp(argv[i], "--run-ahead=", 12) == 0)
+        {
+            run_ahead_frames = (uint32_t)strtoul(argv[i] + 12, nullptr, 10); // frames of input lag to hide
+        }
+        else if (strncmp(argv[i], "--record=", 9) == 0)
+        {
+            record_fname = argv[i] + 9; // record a movie from the start
+        }
+        else if (strncmp(argv[i], "--replay=", 9) == 0)
+        {
+            replay_fname = argv[i] + 9; // replay a movie and exit at its end
+        }
+        else if (strncmp(argv[i], "--frame-hashes=", 15) == 0)
+        {
+            hash_fname = argv[i] + 15; // per frame hash of RAM, VRAM and registers, '-' for stdout
+        }
+        else if (strcmp(argv[i], "--no-reverb") == 0)
+        {
+            reverb = false; // skip the SPU reverb unit
+        }
+        else if (strncmp(argv[i], "--mdec-threads=", 15) == 0)
+        {
+            mdec_threads = (uint32_t)strtoul(argv[i] + 15, nullptr, 10); // FMV decoding threads, 0 for none
+        }
+        else if (strcmp(argv[i], "--no-audio") == 0)
+        {
+            audio = false; // do not open the audio device
+        }
+        else if (strncmp(argv[i], "--audio-out=", 12) == 0)
+        {
+            audio_fname = argv[i] + 12; // write the SPU output to a WAV file instead of the audio device
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true; // do not draw, runs as fast as the CPU allows
+        }
+        else if (strncmp(argv[i], "--disc=", 7) == 0)
+        {
+            disc_fname = argv[i] + 7; // .cue, .cdz or .bin image in the CD-ROM drive
+        }
+        else if (strncmp(argv[i], "--pack-disc=", 12) == 0)
+        {
+            pack_fname = argv[i] + 12; // compress the --disc image into a .cdz image and exit
+        }
+        else if (strncmp(argv[i], "--batch=", 8) == 0)
+        {
+            batch_fname = argv[i] + 8; // run the jobs of a file on headless machines and exit
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            batch_threads = (uint32_t)strtoul(argv[i] + 10, nullptr, 10); // worker threads of the batch runner
+        }
+        else if (argv[i][0] != '-')
+        {
+            exe_fname = argv[i]; // PS-X EXE to run instead of the BIOS shell
+        }
+    }
+
+    if (!pack_fname.empty())
+    {
+        auto disc = disc_fname.empty() ? nullptr : open_disc(disc_fname);
+        return disc && write_compressed_disc(*disc, pack_fname) ? 0 : 1;
+    }
 
     if (!file_exists(BIOS_FNAME))
     {
@@ -18,32 +181,230 @@ int main() {
         return 1;
     }
 
-    SDL_Init(SDL_INIT_VIDEO);
-
     Bios bios = Bios(BIOS_FNAME, BIOS_SIZE);
-    Ram ram = Ram();
-    Dma dma = Dma();
-    Gpu gpu = Gpu();
-    Spunit spu = Spunit(); // SPU is a reserved keyword??
 
-    Interconnect interconnect = Interconnect(&bios, &ram, &dma, &gpu, &spu);
+    MachineConfig config = MachineConfig();
+    config.headless = headless;
+    config.bios_hle = bios_hle;
+    config.idle_skip = idle_skip;
+    config.gte_cache = gte_cache;
+    config.reverb = reverb;
+    config.mdec_threads = mdec_threads;
+    config.hle_disabled = hle_disabled;
+
+    if (!batch_fname.empty())
+    {
+        std::vector<BatchJob> jobs;
+        if (!readBatchJobs(batch_fname, jobs))
+        {
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        BatchRunner runner = BatchRunner(&bios, config, batch_threads);
+        auto results = runner.run(jobs);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // one line per job: index, status, frames, cycles, final hash, seconds
+        bool ok = true;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const auto& result = results[i];
+            printf("%zu %s %llu %llu %016llx %.3f\n", i, result.ok ? "ok" : "failed",
+                   (unsigned long long)result.frames, (unsigned long long)result.cycles,
+                   (unsigned long long)result.hash, result.seconds);
+            ok = ok && result.ok;
+        }
+        DEBUG("Batch:_" << std::dec << results.size() << "_jobs_in_" << elapsed << "s");
+        return ok ? 0 : 1;
+    }
+
+    // the window and GL context are global to the process, only this machine gets them
+    if (!headless)
+    {
+        SDL_Init(SDL_INIT_VIDEO);
+    }
+    PredecodedBios predecoded = PredecodedBios(bios);
+    auto machine = std::make_unique<Machine>(&bios, config, &predecoded);
+    Cpu& cpu = machine->cpu;
+    Scheduler& scheduler = machine->scheduler;
+
+    PsxExe exe = PsxExe();
+    if (!exe_fname.empty())
+    {
+        if (!exe.load(exe_fname))
+        {
+            return 1;
+        }
+        machine->sideload(&exe);
+    }
+    if (!disc_fname.empty())
+    {
+        auto disc = open_disc(disc_fname);
+        if (!disc)
+        {
+            return 1;
+        }
+        machine->insertDisc(std::move(disc));
+    }
+
+    // savestates are captured between two CPU slices, the buffer is reused for every capture
+    Savestate state = Savestate(SaveMode);
+    SavestateWriter state_writer = SavestateWriter();
+    auto save_state = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        state.rewind(SaveMode);
+        serializeSystem(state, cpu);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        DEBUG("Savestate_captured:_" << std::dec << state.buffer.size() << "_bytes_in_" << elapsed.count() << "us");
+        // the writer compresses and writes on its own thread, hand it a copy
+        state_writer.write(state_fname, std::vector<uint8_t>(state.buffer));
+    };
+    auto restore_state = [&]() {
+        state_writer.wait();
+        Savestate loaded = Savestate(LoadMode);
+        if (!readSavestateFile(state_fname, loaded.buffer) || !serializeSystem(loaded, cpu))
+        {
+            DEBUG("Savestate_not_loaded:" << state_fname);
+            return false;
+        }
+        DEBUG("Savestate_loaded:" << state_fname);
+        return true;
+    };
+    std::unique_ptr<RewindBuffer> rewind;
+    if (rewind_mib != 0)
+    {
+        rewind = std::make_unique<RewindBuffer>((size_t)rewind_mib * 1024 * 1024, rewind_interval);
+    }
+
+    uint64_t next_checkpoint = (uint64_t)checkpoint_seconds * CPU_CLOCK_HZ;
+
+    // after the initial schedule, so the saved deadlines win
+    if (load_state)
+    {
+        restore_state();
+    }
+
+    // everything from outside the machine goes through the movie, when one is recorded or replayed
+    Movie movie = Movie();
+    if (!replay_fname.empty())
+    {
+        MovieOptions options = MovieOptions();
+        if (!movie.replay(replay_fname, cpu, options))
+        {
+            return 1;
+        }
+        // timing options of the recording
+        machine->applyMovieOptions(options);
+    }
+    else if (!record_fname.empty())
+    {
+        if (!movie.record(record_fname, cpu, machine->movieOptions()))
+        {
+            return 1;
+        }
+    }
+    // the host replaced the machine state
+    auto state_loaded = [&](const uint64_t& cycle) {
+        movie.stateLoaded(cycle, cpu);
+    };
+
+    // headless runs go faster than real time, their audio can only go to a file
+    std::unique_ptr<AudioOutput> audio_output;
+    if (!audio_fname.empty())
+    {
+        auto wav = std::make_unique<WavAudioOutput>();
+        if (!wav->open(audio_fname))
+        {
+            return 1;
+        }
+        audio_output = std::move(wav);
+    }
+    else if (audio && !headless)
+    {
+        auto device = std::make_unique<SdlAudioOutput>();
+        if (device->open())
+        {
+            audio_output = std::move(device);
+        }
+    }
+    if (!audio_output)
+    {
+        audio_output = std::make_unique<NullAudioOutput>();
+    }
+    machine->spu.output = [&](const int16_t* frames, const uint32_t& count) {
+        audio_output->write(frames, count);
+    };
 
-    Cpu cpu = Cpu(&interconnect);
+    auto shutdown = [&]() {
+        movie.stop(scheduler.cycles);
+        print_stats(cpu);
+        print_rewind_stats(rewind.get());
+        audio_output->print_stats();
+    };
+
+    std::unique_ptr<FrameHasher> hasher;
+    if (!hash_fname.empty())
+    {
+        hasher = std::make_unique<FrameHasher>();
+        if (!hasher->open(hash_fname))
+        {
+            return 1;
+        }
+    }
+
+    std::unique_ptr<RunAhead> run_ahead;
+    if (run_ahead_frames != 0 && (movie.recording() || movie.replaying()))
+    {
+        // ahead frames would read inputs at cycles that are undone afterwards
+        DEBUG("Run-ahead_is_disabled_while_recording_or_replaying_a_movie");
+    }
+    else if (run_ahead_frames != 0)
+    {
+        run_ahead = std::make_unique<RunAhead>(&cpu, run_ahead_frames);
+    }
+    auto run_ahead_frame = [&]() {
+        machine->runFrame();
+    };
 
     // Main Loop
     SDL_Event e; 
     while (true) // <3
     {
-        // only check for events every 50k cpu instructions
-        uint32_t instructions_run = 0;
-        while (instructions_run <= 50000)
+        // the host is serviced once per frame
+        machine->runFrame();
+
+        if (checkpoint_seconds != 0 && scheduler.cycles >= next_checkpoint)
         {
-            cpu.runNextInstruction();
-            instructions_run++;
+            next_checkpoint = scheduler.cycles + (uint64_t)checkpoint_seconds * CPU_CLOCK_HZ;
+            save_state();
         }
 
-        // check for events
-        SDL_PollEvent(&e);
+        if (hasher)
+        {
+            hasher->frame(cpu, machine->frames, scheduler.cycles);
+        }
+
+        if (rewind && machine->frames % rewind->interval == 0)
+        {
+            rewind->capture(cpu);
+        }
+
+        if (movie.replaying())
+        {
+            movie.replayEvents(scheduler.cycles, cpu);
+            if (movie.finished())
+            {
+                DEBUG("Movie_finished_at_cycle_" << std::dec << scheduler.cycles);
+                shutdown();
+                return 0;
+            }
+        }
+
+        // check for events, there is no window without a renderer
+        if (headless || !SDL_PollEvent(&e))
+        {
+            e.type = SDL_FIRSTEVENT; // no event
+        }
         switch (e.type)
         {
             case SDL_WINDOWEVENT: // Window closed
@@ -51,16 +412,57 @@ int main() {
                 {
                     case SDL_WINDOWEVENT_CLOSE:  
                         DEBUG("Window closed")
+                        shutdown();
                         return 0;
                         break;
                     default: break;
                 }
                 break; 
+            case SDL_KEYDOWN:
+                if (e.key.keysym.sym == SDLK_F5)
+                {
+                    save_state();
+                }
+                else if (movie.replaying())
+                {
+                    // the recorded host events replace the live ones
+                }
+                else if (e.key.keysym.sym == SDLK_F7)
+                {
+                    auto cycle = scheduler.cycles;
+                    if (restore_state())
+                    {
+                        state_loaded(cycle);
+                    }
+                }
+                else if (e.key.keysym.sym == SDLK_BACKSPACE && rewind)
+                {
+                    // held down, key repeat steps further back
+                    auto cycle = scheduler.cycles;
+                    if (rewind->rewind(cpu))
+                    {
+                        state_loaded(cycle);
+                    }
+                }
+                break;
             case SDL_QUIT: // sigint etc.
+                shutdown();
                 return 0;
                 break;              
             default: break;
         }
+
+        if (run_ahead)
+        {
+            // frames run ahead are not real frames
+            auto real_frames = machine->frames;
+            // and they are heard when they are run for real
+            SpuOutput output;
+            std::swap(output, machine->spu.output);
+            run_ahead->run(run_ahead_frame);
+            std::swap(output, machine->spu.output);
+            machine->frames = real_frames;
+        }
     }
 
     return 0;
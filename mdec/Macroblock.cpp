@@ -0,0 +1,256 @@
+#include "Macroblock.h"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PSXEMU_MDEC_AVX2
+#endif
+
+uint32_t macroblock_output_size(const MdecDepth& depth)
+{
+    switch (depth)
+    {
+        case Depth4Bit:
+            return MDEC_BLOCK_SIZE / 2;
+        case Depth8Bit:
+            return MDEC_BLOCK_SIZE;
+        case Depth24Bit:
+            return 16 * 16 * 3;
+        default:
+            return 16 * 16 * 2;
+    }
+}
+
+uint32_t macroblock_blocks(const MdecDepth& depth)
+{
+    return depth == Depth4Bit || depth == Depth8Bit ? MDEC_MONO_BLOCKS : MDEC_COLOR_BLOCKS;
+}
+
+void set_idct_matrix(IdctMatrix& matrix, const int16_t* scale_table)
+{
+    for (uint32_t i = 0; i < MDEC_BLOCK_SIZE; i++)
+    {
+        matrix.scale[i] = (int16_t)(scale_table[i] / 8);
+    }
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        for (uint32_t x = 0; x < 8; x++)
+        {
+            matrix.pairs[k][x * 2] = matrix.scale[(2 * k) * 8 + x];
+            matrix.pairs[k][x * 2 + 1] = matrix.scale[(2 * k + 1) * 8 + x];
+        }
+    }
+}
+
+// one pass of the IDCT: dst[y][x] = sum of src[z][y] * scale[z][x], the result is transposed so
+// the second pass works on the other dimension
+// http://problemkaputt.de/psx-spx.htm#mdecdecompression
+static void idct_pass(const int16_t* src, int16_t* dst, const int16_t* scale)
+{
+    for (uint32_t y = 0; y < 8; y++)
+    {
+        for (uint32_t x = 0; x < 8; x++)
+        {
+            int32_t sum = 0;
+            for (uint32_t z = 0; z < 8; z++)
+            {
+                sum += src[z * 8 + y] * scale[z * 8 + x];
+            }
+            dst[y * 8 + x] = (int16_t)std::clamp((sum + 0xfff) >> 13, -0x8000, 0x7fff);
+        }
+    }
+}
+
+static void idct_portable(int16_t* block, const IdctMatrix& matrix)
+{
+    int16_t temp[MDEC_BLOCK_SIZE];
+    idct_pass(block, temp, matrix.scale);
+    idct_pass(temp, block, matrix.scale);
+}
+
+static int32_t clamp_component(const int32_t& value)
+{
+    return std::clamp(value, -128, 127);
+}
+
+// fixed point YUV to RGB, 8 fractional bits: R = Y + 1.402 Cr, G = Y - 0.3437 Cb - 0.7143 Cr,
+// B = Y + 1.772 Cb
+const int32_t CR_TO_R = 359;
+const int32_t CB_TO_G = -88;
+const int32_t CR_TO_G = -183;
+const int32_t CB_TO_B = 454;
+
+static void color_portable(const Macroblock& macroblock, const MacroblockFormat& format, uint8_t* out)
+{
+    int32_t offset = format.is_signed ? 0 : 128;
+    for (uint32_t y = 0; y < 16; y++)
+    {
+        for (uint32_t x = 0; x < 16; x++)
+        {
+            auto chroma = (y / 2) * 8 + x / 2;
+            int32_t cr = macroblock.blocks[BlockCr][chroma];
+            int32_t cb = macroblock.blocks[BlockCb][chroma];
+            int32_t luma = macroblock.blocks[BlockY1 + (y / 8) * 2 + x / 8][(y % 8) * 8 + x % 8];
+            auto r = (uint8_t)(clamp_component(luma + ((CR_TO_R * cr) >> 8)) + offset);
+            auto g = (uint8_t)(clamp_component(luma + ((CB_TO_G * cb + CR_TO_G * cr) >> 8)) + offset);
+            auto b = (uint8_t)(clamp_component(luma + ((CB_TO_B * cb) >> 8)) + offset);
+            auto pixel = y * 16 + x;
+            if (format.depth == Depth24Bit)
+            {
+                out[pixel * 3] = r;
+                out[pixel * 3 + 1] = g;
+                out[pixel * 3 + 2] = b;
+            }
+            else
+            {
+                // the top 5 bits of the 8-bit components
+                auto rgb15 = (uint16_t)((r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10) | (format.bit15 ? 0x8000 : 0));
+                out[pixel * 2] = (uint8_t)rgb15;
+                out[pixel * 2 + 1] = (uint8_t)(rgb15 >> 8);
+            }
+        }
+    }
+}
+
+static void convert_mono(const int16_t* block, const MacroblockFormat& format, uint8_t* out)
+{
+    int32_t offset = format.is_signed ? 0 : 128;
+    if (format.depth == Depth4Bit)
+    {
+        memset(out, 0, MDEC_BLOCK_SIZE / 2);
+    }
+    for (uint32_t i = 0; i < MDEC_BLOCK_SIZE; i++)
+    {
+        auto value = (uint8_t)(clamp_component(block[i]) + offset);
+        if (format.depth == Depth8Bit)
+        {
+            out[i] = value;
+        }
+        else
+        {
+            // first pixel in the low nibble
+            out[i / 2] |= (uint8_t)((value >> 4) << ((i % 2) * 4));
+        }
+    }
+}
+
+#ifdef PSXEMU_MDEC_AVX2
+// same operations as idct_pass, a row of 8 outputs at a time with two frequencies per multiply-add
+__attribute__((target("avx2")))
+static void idct_pass_avx2(const int16_t* src, int16_t* dst, const IdctMatrix& matrix)
+{
+    __m256i pairs[4];
+    for (int k = 0; k < 4; k++)
+    {
+        pairs[k] = _mm256_load_si256((const __m256i*)matrix.pairs[k]);
+    }
+    const __m256i round = _mm256_set1_epi32(0xfff);
+    for (uint32_t y = 0; y < 8; y++)
+    {
+        __m256i sum = round;
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            uint32_t coefficients = (uint16_t)src[(2 * k) * 8 + y] | ((uint32_t)(uint16_t)src[(2 * k + 1) * 8 + y] << 16);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_set1_epi32((int32_t)coefficients), pairs[k]));
+        }
+        sum = _mm256_srai_epi32(sum, 13);
+        // packs works within 128-bit lanes, the permute puts the 8 results next to each other
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(dst + y * 8), _mm256_castsi256_si128(packed));
+    }
+}
+
+__attribute__((target("avx2")))
+static void idct_avx2(int16_t* block, const IdctMatrix& matrix)
+{
+    alignas(32) int16_t temp[MDEC_BLOCK_SIZE];
+    idct_pass_avx2(block, temp, matrix);
+    idct_pass_avx2(temp, block, matrix);
+}
+
+// same operations as color_portable, 8 pixels at a time
+__attribute__((target("avx2")))
+static void color_avx2(const Macroblock& macroblock, const MacroblockFormat& format, uint8_t* out)
+{
+    const __m256i cr_to_r = _mm256_set1_epi32(CR_TO_R), cb_to_g = _mm256_set1_epi32(CB_TO_G);
+    const __m256i cr_to_g = _mm256_set1_epi32(CR_TO_G), cb_to_b = _mm256_set1_epi32(CB_TO_B);
+    const __m256i low = _mm256_set1_epi32(-128), high = _mm256_set1_epi32(127);
+    const __m256i offset = _mm256_set1_epi32(format.is_signed ? 0 : 128), mask = _mm256_set1_epi32(0xff);
+    const __m256i bit15 = _mm256_set1_epi32(format.bit15 ? 0x8000 : 0);
+    // 4 pixels of 24 bits in the low 12 bytes of each 128-bit lane
+    const __m256i rgb24 = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint8_t row[16 * 3 + 4]; // the last 16-byte store runs 4 bytes past the row
+
+    for (uint32_t y = 0; y < 16; y++)
+    {
+        for (uint32_t half = 0; half < 2; half++)
+        {
+            auto chroma = (y / 2) * 8 + half * 4;
+            // every chroma sample covers two pixels of the row
+            __m128i cr16 = _mm_loadl_epi64((const __m128i*)&macroblock.blocks[BlockCr][chroma]);
+            __m128i cb16 = _mm_loadl_epi64((const __m128i*)&macroblock.blocks[BlockCb][chroma]);
+            __m256i cr = _mm256_cvtepi16_epi32(_mm_unpacklo_epi16(cr16, cr16));
+            __m256i cb = _mm256_cvtepi16_epi32(_mm_unpacklo_epi16(cb16, cb16));
+            __m256i luma = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((const __m128i*)&macroblock.blocks[BlockY1 + (y / 8) * 2 + half][(y % 8) * 8]));
+
+            __m256i r = _mm256_add_epi32(luma, _mm256_srai_epi32(_mm256_mullo_epi32(cr, cr_to_r), 8));
+            __m256i g = _mm256_add_epi32(luma, _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(cb, cb_to_g), _mm256_mullo_epi32(cr, cr_to_g)), 8));
+            __m256i b = _mm256_add_epi32(luma, _mm256_srai_epi32(_mm256_mullo_epi32(cb, cb_to_b), 8));
+            r = _mm256_and_si256(_mm256_add_epi32(_mm256_min_epi32(_mm256_max_epi32(r, low), high), offset), mask);
+            g = _mm256_and_si256(_mm256_add_epi32(_mm256_min_epi32(_mm256_max_epi32(g, low), high), offset), mask);
+            b = _mm256_and_si256(_mm256_add_epi32(_mm256_min_epi32(_mm256_max_epi32(b, low), high), offset), mask);
+
+            if (format.depth == Depth24Bit)
+            {
+                __m256i pixels = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+                pixels = _mm256_shuffle_epi8(pixels, rgb24);
+                _mm_storeu_si128((__m128i*)(row + half * 24), _mm256_castsi256_si128(pixels));
+                _mm_storeu_si128((__m128i*)(row + half * 24 + 12), _mm256_extracti128_si256(pixels, 1));
+            }
+            else
+            {
+                __m256i pixels = _mm256_or_si256(_mm256_srli_epi32(r, 3), _mm256_slli_epi32(_mm256_srli_epi32(g, 3), 5));
+                pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_srli_epi32(b, 3), 10));
+                pixels = _mm256_or_si256(pixels, bit15);
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(pixels, pixels), _MM_SHUFFLE(3, 1, 2, 0));
+                _mm_storeu_si128((__m128i*)(out + y * 32 + half * 16), _mm256_castsi256_si128(packed));
+            }
+        }
+        if (format.depth == Depth24Bit)
+        {
+            memcpy(out + y * 48, row, 48);
+        }
+    }
+}
+#endif
+
+MdecKernels select_mdec_kernels()
+{
+#ifdef PSXEMU_MDEC_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {idct_avx2, color_avx2};
+    }
+#endif
+    return {idct_portable, color_portable};
+}
+
+void render_macroblock(Macroblock& macroblock, const MacroblockFormat& format, const IdctMatrix& matrix,
+                       const MdecKernels& kernels, uint8_t* out)
+{
+    auto blocks = macroblock_blocks(format.depth);
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        kernels.idct(macroblock.blocks[i], matrix);
+    }
+    if (blocks == MDEC_MONO_BLOCKS)
+    {
+        convert_mono(macroblock.blocks[0], format, out);
+    }
+    else
+    {
+        kernels.color(macroblock, format, out);
+    }
+}
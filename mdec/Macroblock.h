@@ -0,0 +1,80 @@
+#ifndef MACROBLOCK_H
+#define MACROBLOCK_H
+
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t MDEC_BLOCK_SIZE = 64; // 8x8 coefficients or pixels
+// a colour macroblock is 16x16 pixels: Cr and Cb at half resolution, then four luminance blocks
+const uint32_t MDEC_COLOR_BLOCKS = 6;
+const uint32_t MDEC_MONO_BLOCKS = 1;
+
+// order of the blocks in the stream
+enum MdecBlock
+{
+    BlockCr = 0,
+    BlockCb = 1,
+    BlockY1 = 2, // top left
+    BlockY2 = 3, // top right
+    BlockY3 = 4, // bottom left
+    BlockY4 = 5 // bottom right
+};
+
+// bits 27-28 of the decode command
+enum MdecDepth
+{
+    Depth4Bit = 0, // monochrome
+    Depth8Bit = 1, // monochrome
+    Depth24Bit = 2,
+    Depth15Bit = 3
+};
+
+struct MacroblockFormat
+{
+    MdecDepth depth;
+    bool is_signed; // otherwise 128 is added to the components
+    bool bit15; // set bit 15 of 15-bit pixels
+};
+
+// bytes of output per macroblock
+uint32_t macroblock_output_size(const MdecDepth& depth);
+// blocks per macroblock
+uint32_t macroblock_blocks(const MdecDepth& depth);
+
+// the scale table sent with command 3, laid out for the kernels
+struct IdctMatrix
+{
+    // scale[z * 8 + x] / 8: weight of frequency z for position x
+    alignas(32) int16_t scale[MDEC_BLOCK_SIZE];
+    // two frequencies interleaved for 16-bit multiply-adds: pairs[k][x * 2 + i] = scale[(2k + i) * 8 + x]
+    alignas(32) int16_t pairs[4][16];
+};
+
+void set_idct_matrix(IdctMatrix& matrix, const int16_t* scale_table);
+
+// blocks in raster order: dequantized coefficients in, after the IDCT signed pixels
+struct Macroblock
+{
+    alignas(32) int16_t blocks[MDEC_COLOR_BLOCKS][MDEC_BLOCK_SIZE];
+};
+
+// both passes of the separable IDCT, in place
+typedef void (*IdctKernel)(int16_t* block, const IdctMatrix& matrix);
+// YUV to 24-bit or 15-bit RGB of a colour macroblock, 16x16 pixels in raster order
+typedef void (*ColorKernel)(const Macroblock& macroblock, const MacroblockFormat& format, uint8_t* out);
+
+struct MdecKernels
+{
+    IdctKernel idct;
+    ColorKernel color;
+};
+
+// the AVX2 kernels if the CPU has them, the portable ones otherwise. Both give the same result
+MdecKernels select_mdec_kernels();
+
+// IDCT and conversion of a whole macroblock, macroblock_output_size() bytes go to 'out'
+void render_macroblock(Macroblock& macroblock, const MacroblockFormat& format, const IdctMatrix& matrix,
+                       const MdecKernels& kernels, uint8_t* out);
+
+#endif
@@ -0,0 +1,349 @@
+#include "Mdec.h"
+#include "../state/Savestate.h"
+#include "../util/logging.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// position in the block of the n-th coefficient of the stream
+static const uint8_t ZIGZAG_TO_RASTER[MDEC_BLOCK_SIZE] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// end of block, also used as padding between macroblocks
+const uint16_t MDEC_END_OF_BLOCK = 0xfe00;
+// the read part of the output is dropped once it is this large
+const uint32_t MDEC_OUTPUT_COMPACT = 64 * 1024;
+
+static int32_t signed10(const uint16_t& value)
+{
+    return ((int32_t)(value & 0x3ff) ^ 0x200) - 0x200;
+}
+
+Mdec::Mdec()
+    : kernels(select_mdec_kernels()),
+      pipeline(&this->matrix, this->kernels)
+{
+    // the BIOS uploads this table before any decoding, it is only a sane start
+    for (uint32_t z = 0; z < 8; z++)
+    {
+        double weight = z == 0 ? sqrt(0.5) : 1.0;
+        for (uint32_t x = 0; x < 8; x++)
+        {
+            this->scale_table[z * 8 + x] = (int16_t)lround(weight * cos((2 * x + 1) * z * M_PI / 16) * 0x7fff);
+        }
+    }
+    set_idct_matrix(this->matrix, this->scale_table);
+}
+
+void Mdec::start_workers(const uint32_t& threads)
+{
+    this->pipeline.start(threads);
+}
+
+uint32_t Mdec::output_words() const
+{
+    // queued macroblocks count as decoded, so the status does not depend on the workers
+    return (uint32_t)(this->output.size() - this->output_position + this->pipeline.pending_size()) / 4;
+}
+
+void Mdec::collect_output(const uint32_t& size)
+{
+    auto available = (uint32_t)(this->output.size() - this->output_position);
+    if (available < size)
+    {
+        this->pipeline.collect(this->output, size - available);
+    }
+}
+
+uint32_t Mdec::status() const
+{
+    uint32_t value = 0;
+    if (this->output_words() == 0)
+    {
+        value |= 1u << 31;
+    }
+    if (this->words_remaining != 0)
+    {
+        value |= 1u << 29; // busy receiving parameters
+    }
+    if (this->dma_in_enabled)
+    {
+        value |= 1u << 28;
+    }
+    if (this->dma_out_enabled && this->output_words() != 0)
+    {
+        value |= 1u << 27;
+    }
+    value |= (uint32_t)this->format.depth << 25;
+    value |= (uint32_t)this->format.is_signed << 24;
+    value |= (uint32_t)this->format.bit15 << 23;
+    // 0-3 for the luminance blocks, 4 and 5 for Cr and Cb, always 4 in monochrome
+    uint32_t block = macroblock_blocks(this->format.depth) == MDEC_MONO_BLOCKS ? 4 : (this->current_block + 4) % 6;
+    value |= block << 16;
+    value |= (this->words_remaining - 1) & 0xffff;
+    return value;
+}
+
+void Mdec::reset()
+{
+    this->command = MdecNoCommand;
+    this->words_remaining = 0;
+    this->parameter_index = 0;
+    this->format = {Depth4Bit, false, false};
+    this->current_block = 0;
+    this->in_block = false;
+    this->collect_output(UINT32_MAX);
+    this->output.clear();
+    this->output_position = 0;
+}
+
+uint32_t Mdec::load(const uint32_t& offset)
+{
+    if (offset == 4)
+    {
+        return this->status();
+    }
+    uint32_t word = 0;
+    if (this->output_words() != 0)
+    {
+        this->dma_read((uint8_t*)&word, 1);
+    }
+    return word;
+}
+
+void Mdec::store(const uint32_t& offset, const uint32_t& value)
+{
+    if (offset == 0)
+    {
+        this->write_word(value);
+        this->pipeline.kick();
+        return;
+    }
+    if (value & (1u << 31))
+    {
+        this->reset();
+    }
+    this->dma_in_enabled = (value & (1u << 30)) != 0;
+    this->dma_out_enabled = (value & (1u << 29)) != 0;
+}
+
+void Mdec::start_command(const uint32_t& value)
+{
+    this->command = (MdecCommand)(value >> 29);
+    // every command sets the output format bits of the status
+    this->format.depth = (MdecDepth)((value >> 27) & 3);
+    this->format.is_signed = (value & (1u << 26)) != 0;
+    this->format.bit15 = (value & (1u << 25)) != 0;
+    this->parameter_index = 0;
+    switch (this->command)
+    {
+        case MdecDecode:
+            this->words_remaining = value & 0xffff;
+            this->current_block = 0;
+            this->in_block = false;
+            break;
+        case MdecSetQuant:
+            this->color_quant = (value & 1) != 0;
+            this->words_remaining = this->color_quant ? 32 : 16;
+            break;
+        case MdecSetScale:
+            this->words_remaining = 32;
+            break;
+        default:
+            // the parameters are received and ignored
+            DEBUG("Unknown_MDEC_command:0x" << std::hex << value);
+            this->words_remaining = value & 0xffff;
+            break;
+    }
+}
+
+void Mdec::write_word(const uint32_t& value)
+{
+    if (this->words_remaining == 0)
+    {
+        this->start_command(value);
+        return;
+    }
+    this->words_remaining--;
+    switch (this->command)
+    {
+        case MdecDecode:
+            this->decode_halfword((uint16_t)value);
+            this->decode_halfword((uint16_t)(value >> 16));
+            break;
+        case MdecSetQuant:
+            for (uint32_t i = 0; i < 4; i++, this->parameter_index++)
+            {
+                auto byte = (uint8_t)(value >> (i * 8));
+                if (this->parameter_index < MDEC_BLOCK_SIZE)
+                {
+                    this->quant_luma[this->parameter_index] = byte;
+                }
+                else
+                {
+                    this->quant_color[this->parameter_index - MDEC_BLOCK_SIZE] = byte;
+                }
+            }
+            break;
+        case MdecSetScale:
+            this->scale_table[this->parameter_index++] = (int16_t)value;
+            this->scale_table[this->parameter_index++] = (int16_t)(value >> 16);
+            if (this->words_remaining == 0)
+            {
+                // the queued macroblocks use the previous table
+                this->collect_output(UINT32_MAX);
+                set_idct_matrix(this->matrix, this->scale_table);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// run-length decoding and dequantization, one halfword at a time
+void Mdec::decode_halfword(const uint16_t& value)
+{
+    bool color = macroblock_blocks(this->format.depth) == MDEC_COLOR_BLOCKS;
+    // Cr and Cb use the colour table
+    const uint8_t* quant = color && this->current_block <= BlockCb ? this->quant_color : this->quant_luma;
+    int16_t* block = this->macroblock.blocks[this->current_block];
+    int32_t coefficient;
+
+    if (!this->in_block)
+    {
+        if (value == MDEC_END_OF_BLOCK)
+        {
+            return; // padding
+        }
+        // DC coefficient and the quantization scale of the block
+        memset(block, 0, MDEC_BLOCK_SIZE * sizeof(int16_t));
+        this->quant_scale = value >> 10;
+        this->coefficient = 0;
+        this->in_block = true;
+        coefficient = signed10(value) * quant[0];
+    }
+    else
+    {
+        // number of zero coefficients, then an AC coefficient
+        this->coefficient += (value >> 10) + 1;
+        if (this->coefficient >= MDEC_BLOCK_SIZE)
+        {
+            this->end_block();
+            return;
+        }
+        coefficient = (signed10(value) * quant[this->coefficient] * (int32_t)this->quant_scale + 4) / 8;
+    }
+    // a scale of 0 leaves the coefficients unquantized and in raster order
+    if (this->quant_scale == 0)
+    {
+        coefficient = signed10(value) * 2;
+    }
+    auto position = this->quant_scale == 0 ? this->coefficient : ZIGZAG_TO_RASTER[this->coefficient];
+    block[position] = (int16_t)std::clamp(coefficient, -0x400, 0x3ff);
+}
+
+void Mdec::end_block()
+{
+    this->in_block = false;
+    this->current_block++;
+    if (this->current_block < macroblock_blocks(this->format.depth))
+    {
+        return;
+    }
+    this->current_block = 0;
+
+    if (this->pipeline.running())
+    {
+        this->pipeline.submit(this->macroblock, this->format, this->output);
+        return;
+    }
+    auto size = macroblock_output_size(this->format.depth);
+    auto start = this->output.size();
+    this->output.resize(start + size);
+    render_macroblock(this->macroblock, this->format, this->matrix, this->kernels, &this->output[start]);
+}
+
+void Mdec::dma_write(const uint8_t* source, const uint32_t& count)
+{
+    uint32_t i = 0;
+    while (i < count)
+    {
+        if (this->command == MdecDecode && this->words_remaining != 0)
+        {
+            // the coefficients, straight from RAM
+            auto n = std::min(count - i, this->words_remaining);
+            for (uint32_t j = 0; j < n * 2; j++)
+            {
+                uint16_t halfword;
+                memcpy(&halfword, source + (size_t)i * 4 + j * 2, 2);
+                this->decode_halfword(halfword);
+            }
+            this->words_remaining -= n;
+            i += n;
+            continue;
+        }
+        uint32_t word;
+        memcpy(&word, source + (size_t)i * 4, 4);
+        this->write_word(word);
+        i++;
+    }
+    this->pipeline.kick();
+}
+
+bool Mdec::output_ready(const uint32_t& count) const
+{
+    return this->output_words() >= count;
+}
+
+void Mdec::dma_read(uint8_t* destination, const uint32_t& count)
+{
+    this->collect_output(count * 4);
+    memcpy(destination, &this->output[this->output_position], (size_t)count * 4);
+    this->output_position += count * 4;
+    if (this->output_position == this->output.size())
+    {
+        this->output.clear();
+        this->output_position = 0;
+    }
+    else if (this->output_position >= MDEC_OUTPUT_COMPACT)
+    {
+        this->output.erase(this->output.begin(), this->output.begin() + this->output_position);
+        this->output_position = 0;
+    }
+}
+
+void Mdec::serialize(Savestate& state)
+{
+    state.section("MDEC");
+    this->collect_output(UINT32_MAX);
+    state.value(this->command);
+    state.value(this->words_remaining);
+    state.value(this->parameter_index);
+    state.value(this->format);
+    state.value(this->color_quant);
+    state.value(this->dma_in_enabled);
+    state.value(this->dma_out_enabled);
+    state.value(this->quant_luma);
+    state.value(this->quant_color);
+    state.value(this->scale_table);
+    state.value(this->macroblock);
+    state.value(this->current_block);
+    state.value(this->coefficient);
+    state.value(this->quant_scale);
+    state.value(this->in_block);
+
+    // only the part that was not read yet
+    uint32_t size = (uint32_t)(this->output.size() - this->output_position);
+    state.value(size);
+    if (!state.saving())
+    {
+        this->output.resize(size);
+        this->output_position = 0;
+        set_idct_matrix(this->matrix, this->scale_table);
+    }
+    state.bytes(this->output.data() + this->output_position, size);
+}
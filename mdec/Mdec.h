@@ -0,0 +1,89 @@
+#ifndef MDEC_H
+#define MDEC_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "Macroblock.h"
+#include "Pipeline.h"
+
+class Savestate;
+
+// MDEC commands, bits 29-31 of the command word
+enum MdecCommand
+{
+    MdecNoCommand = 0,
+    MdecDecode = 1, // decode macroblocks, bits 0-15 are the number of parameter words
+    MdecSetQuant = 2, // 64 bytes of luminance quant table, then 64 of colour if bit 0 is set
+    MdecSetScale = 3 // 64 signed halfwords of IDCT scale table
+};
+
+// Macroblock decoder at 0x1f801820: FMV frames are sent through DMA channel 0 as run-length
+// coded, quantized DCT coefficients and come back through DMA channel 1 as 15-bit or 24-bit
+// pixels. Every macroblock is run-length decoded as soon as its last halfword arrives, and
+// converted right away or queued for the worker threads; the output waits in a FIFO that is as
+// large as needed.
+// http://problemkaputt.de/psx-spx.htm#macroblockdecodermdec
+class Mdec
+{
+public:
+    Mdec();
+    ~Mdec() {};
+
+    // IDCT and colour conversion on 'threads' workers, 0 converts on the calling thread
+    void start_workers(const uint32_t& threads);
+
+    // 0: command and parameters / decoded data, 4: control / status
+    uint32_t load(const uint32_t& offset);
+    void store(const uint32_t& offset, const uint32_t& value);
+
+    // DMA channel 0, 'count' words of commands and parameters
+    void dma_write(const uint8_t* source, const uint32_t& count);
+    // DMA channel 1 waits until 'count' words are decoded
+    bool output_ready(const uint32_t& count) const;
+    void dma_read(uint8_t* destination, const uint32_t& count);
+
+    void serialize(Savestate& state);
+
+private:
+    MdecKernels kernels;
+
+    // command
+    MdecCommand command = MdecNoCommand;
+    uint32_t words_remaining = 0; // parameter words of the current command
+    uint32_t parameter_index = 0; // halfwords or bytes of a table received so far
+    MacroblockFormat format = {Depth4Bit, false, false};
+    bool color_quant = false; // the quant table command has a colour table
+    bool dma_in_enabled = false, dma_out_enabled = false;
+
+    // tables
+    uint8_t quant_luma[MDEC_BLOCK_SIZE] = {};
+    uint8_t quant_color[MDEC_BLOCK_SIZE] = {};
+    int16_t scale_table[MDEC_BLOCK_SIZE] = {};
+    IdctMatrix matrix;
+    MdecPipeline pipeline;
+
+    // run-length decoding of the current macroblock
+    Macroblock macroblock;
+    uint32_t current_block = 0; // in stream order
+    uint32_t coefficient = 0; // index of the last coefficient written, in zigzag order
+    uint32_t quant_scale = 0;
+    bool in_block = false; // the DC coefficient of the current block was read
+
+    // decoded data, read from 'output_position' on. The macroblocks in the pipeline come after it
+    std::vector<uint8_t> output;
+    uint32_t output_position = 0;
+
+    uint32_t status() const;
+    void reset();
+    void write_word(const uint32_t& value);
+    void start_command(const uint32_t& value);
+    void decode_halfword(const uint16_t& value);
+    void end_block();
+    uint32_t output_words() const;
+    // waits for the pipeline, 'size' bytes can be read from the output afterwards
+    void collect_output(const uint32_t& size);
+};
+
+#endif
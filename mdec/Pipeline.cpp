@@ -0,0 +1,124 @@
+#include "Pipeline.h"
+
+MdecPipeline::MdecPipeline(const IdctMatrix* matrix, const MdecKernels& kernels)
+{
+    this->matrix = matrix;
+    this->kernels = kernels;
+}
+
+MdecPipeline::~MdecPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->work_ready.notify_all();
+    for (auto& worker : this->workers)
+    {
+        worker.join();
+    }
+}
+
+void MdecPipeline::start(const uint32_t& threads)
+{
+    if (threads == 0 || this->running())
+    {
+        return;
+    }
+    this->jobs = std::make_unique<MdecJob[]>(MDEC_PIPELINE_JOBS);
+    for (uint32_t i = 0; i < MDEC_PIPELINE_JOBS; i++)
+    {
+        this->jobs[i].done.store(false, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        this->workers.emplace_back(&MdecPipeline::run_worker, this);
+    }
+}
+
+bool MdecPipeline::run_job()
+{
+    auto index = this->claimed.load(std::memory_order_relaxed);
+    do
+    {
+        if (index >= this->submitted.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+    } while (!this->claimed.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel));
+
+    auto& job = this->jobs[index % MDEC_PIPELINE_JOBS];
+    render_macroblock(job.macroblock, job.format, *this->matrix, this->kernels, job.pixels);
+    job.done.store(true, std::memory_order_release);
+    return true;
+}
+
+void MdecPipeline::run_worker()
+{
+    while (true)
+    {
+        if (this->run_job())
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->work_ready.wait(lock, [this]() {
+            return this->stopping || this->claimed.load() < this->submitted.load();
+        });
+        if (this->stopping)
+        {
+            return;
+        }
+    }
+}
+
+void MdecPipeline::submit(const Macroblock& macroblock, const MacroblockFormat& format, std::vector<uint8_t>& output)
+{
+    auto index = this->submitted.load(std::memory_order_relaxed);
+    if (index - this->collected == MDEC_PIPELINE_JOBS)
+    {
+        this->collect(output, 1);
+    }
+    auto& job = this->jobs[index % MDEC_PIPELINE_JOBS];
+    job.macroblock = macroblock;
+    job.format = format;
+    this->pending_bytes += macroblock_output_size(format.depth);
+    this->submitted.store(index + 1, std::memory_order_release);
+}
+
+void MdecPipeline::kick()
+{
+    if (this->claimed.load() >= this->submitted.load())
+    {
+        return;
+    }
+    // a worker checks for work with the lock held, it cannot miss the notification
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+    }
+    this->work_ready.notify_all();
+}
+
+void MdecPipeline::collect(std::vector<uint8_t>& output, const uint32_t& size)
+{
+    uint32_t appended = 0;
+    auto submitted = this->submitted.load(std::memory_order_relaxed);
+    while (appended < size && this->collected < submitted)
+    {
+        auto& job = this->jobs[this->collected % MDEC_PIPELINE_JOBS];
+        while (!job.done.load(std::memory_order_acquire))
+        {
+            // help instead of waiting, the job itself may not have been taken yet
+            if (!this->run_job())
+            {
+                std::this_thread::yield();
+            }
+        }
+        auto bytes = macroblock_output_size(job.format.depth);
+        output.insert(output.end(), job.pixels, job.pixels + bytes);
+        job.done.store(false, std::memory_order_relaxed);
+        this->collected++;
+        this->pending_bytes -= bytes;
+        appended += bytes;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Macroblock.h"
+
+// macroblocks in flight, a 640x480 frame has 1200. The oldest is collected when the ring is full
+const uint32_t MDEC_PIPELINE_JOBS = 512;
+
+struct MdecJob
+{
+    Macroblock macroblock;
+    MacroblockFormat format;
+    std::atomic<bool> done;
+    alignas(32) uint8_t pixels[16 * 16 * 3];
+};
+
+// Worker threads for the IDCT and the colour conversion of macroblocks, which do not depend on
+// each other. The emulation thread run-length decodes and submits them in stream order and
+// collects the pixels in the same order, so the output does not depend on the timing of the
+// workers. While it waits for a macroblock, the emulation thread converts queued ones itself.
+class MdecPipeline
+{
+public:
+    // 'matrix' must not change while macroblocks are queued
+    MdecPipeline(const IdctMatrix* matrix, const MdecKernels& kernels);
+    ~MdecPipeline();
+    MdecPipeline(const MdecPipeline&) = delete;
+    MdecPipeline& operator=(const MdecPipeline&) = delete;
+
+    void start(const uint32_t& threads);
+    bool running() const { return !this->workers.empty(); }
+
+    // queues a copy of 'macroblock'. If the ring is full, the oldest one is collected into 'output'
+    void submit(const Macroblock& macroblock, const MacroblockFormat& format, std::vector<uint8_t>& output);
+    // wakes the workers up for the submitted macroblocks
+    void kick();
+    // bytes of pixels the queued macroblocks will give
+    uint32_t pending_size() const { return this->pending_bytes; }
+    // appends the pixels of the oldest macroblocks to 'output', in order, until at least 'size'
+    // bytes were appended or nothing is queued
+    void collect(std::vector<uint8_t>& output, const uint32_t& size);
+
+private:
+    const IdctMatrix* matrix;
+    MdecKernels kernels;
+    std::unique_ptr<MdecJob[]> jobs;
+    std::atomic<uint64_t> submitted = 0; // only written by the emulation thread
+    std::atomic<uint64_t> claimed = 0; // jobs taken by a worker or the emulation thread
+    uint64_t collected = 0;
+    uint32_t pending_bytes = 0;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    // converts one queued macroblock, false if none is left
+    bool run_job();
+    void run_worker();
+};
+
+#endif
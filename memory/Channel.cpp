@@ -1,4 +1,5 @@
 #include "Channel.h"
+#include "../state/Savestate.h"
 #include <exception>
 #include <iostream>
 #include "../util/logging.h"
@@ -114,4 +115,19 @@ void Channel::done() {
     this->trigger = false;
 
     // TODO: set other fields for particular interrupts
-}
\ No newline at end of file
+}
+
+void Channel::serialize(Savestate &state) {
+    state.value(this->base);
+    state.value(this->direction);
+    state.value(this->enable);
+    state.value(this->step);
+    state.value(this->sync);
+    state.value(this->trigger);
+    state.value(this->chop);
+    state.value(this->chopDmaSz);
+    state.value(this->chopCpuSz);
+    state.value(this->dummy);
+    state.value(this->blockSize);
+    state.value(this->blockCount);
+}
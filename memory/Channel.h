@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include "../util/logging.h"
 
+class Savestate;
+
 enum Direction {
     ToRam = 0,
     FromRam = 1,
@@ -54,6 +56,7 @@ public:
     Step getStepMode() const;
     uint32_t getTransferSize() const;
     void done();
+    void serialize(Savestate& state);
 
 private:
     bool enable;
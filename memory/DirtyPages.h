@@ -0,0 +1,15 @@
+#ifndef PSXEMU_DIRTYPAGES_H
+#define PSXEMU_DIRTYPAGES_H
+
+#include <cstdint>
+
+// RAM and VRAM keep one byte of flags per page. A write sets all bits, every
+// consumer of the flags owns one bit and only clears that one. VRAM also keeps
+// flags per 64x16 tile, for consumers that need to know where in a line it was written.
+const uint8_t DIRTY_ALL = 0xff;
+const uint8_t DIRTY_REWIND = 1u << 0; // written since the last rewind capture
+const uint8_t DIRTY_HASH = 1u << 1; // written since the last frame hash
+const uint8_t DIRTY_TEXTURE = 1u << 2; // written since the texture cache checked it (VRAM tiles)
+const uint8_t DIRTY_RENDERER = 1u << 3; // written behind the renderer since it uploaded it (VRAM tiles)
+
+#endif //PSXEMU_DIRTYPAGES_H
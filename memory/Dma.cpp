@@ -1,4 +1,5 @@
 #include "Dma.h"
+#include "../state/Savestate.h"
 #include "../util/logging.h"
 
 void Dma::setControl(const uint32_t &value)  {
@@ -27,14 +28,34 @@ uint32_t Dma::getInterrupt() {
 void Dma::setInterrupt(uint32_t val) {
     this->irqDummy = (uint8_t) (val & 0x3fu);
     this->forceIrq = (val >> 15u) & 1u;
-    this->channelIrqEnable = (uint8_t) (val >> 16u);
-    this->forceIrq = (val >> 23u) & 1u;
+    this->channelIrqEnable = (uint8_t) ((val >> 16u) & 0x7fu);
+    this->irqEnable = ((val >> 23u) & 1u) != 0;
 
     // writing 1 to a flag resets it
-    auto ack = (uint8_t) ((val >> 24u) & 0x3fu);
+    auto ack = (uint8_t) ((val >> 24u) & 0x7fu);
     this->channelIrqFlags &= ~ack;
 }
 
+// set the channel's interrupt flag at the end of a transfer, if enabled
+void Dma::channelDone(const Port &port) {
+    if ((this->channelIrqEnable & (1u << port)) != 0) {
+        this->channelIrqFlags |= (uint8_t) (1u << port);
+    }
+}
+
 Channel* Dma::getChannel(const Port &port) {
     return &(this->channels[port]);
-}
\ No newline at end of file
+}
+
+void Dma::serialize(Savestate &state) {
+    state.section("DMA ");
+    state.value(this->control);
+    state.value(this->irqEnable);
+    state.value(this->channelIrqEnable);
+    state.value(this->channelIrqFlags);
+    state.value(this->forceIrq);
+    state.value(this->irqDummy);
+    for (auto& channel : this->channels) {
+        channel.serialize(state);
+    }
+}
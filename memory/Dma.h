@@ -5,17 +5,19 @@
 #include <cstdint>
 #include "Range.h"
 
+class Savestate;
+
 // Direct Memory Access
 class Dma {
 private:
     Channel channels[7]; // The 7 channel instances
 
     // dma interrupt register, unpacked into variables
-    bool irqEnable; // master IRQ enable
-    uint8_t channelIrqEnable;
-    uint8_t channelIrqFlags;
-    uint8_t forceIrq; // if set, interrupt is always active
-    uint8_t irqDummy; // not sure what these bits do
+    bool irqEnable = false; // master IRQ enable
+    uint8_t channelIrqEnable = 0;
+    uint8_t channelIrqFlags = 0;
+    uint8_t forceIrq = 0; // if set, interrupt is always active
+    uint8_t irqDummy = 0; // not sure what these bits do
 
 public:
     uint32_t control; // DMA control register
@@ -28,8 +30,10 @@ public:
     bool irq() const;
     uint32_t getInterrupt();
     void setInterrupt(uint32_t val);
+    void channelDone(const Port &port);
     void setControl(const uint32_t &value);
     Channel* getChannel(const Port &Port);
+    void serialize(Savestate& state);
 };
 
 #endif //PSXEMU_DMA_H
\ No newline at end of file
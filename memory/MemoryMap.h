@@ -14,5 +14,6 @@ const Range TIMERS = Range(0x1f801100,48); // the playstation has three independ
 const Range GPU = Range(0x1f801810, 8);
 const Range DMA = Range(0x1f801080,0x80); // dma, direct memory access
 const Range CDROM_STATUS = Range(0x1f801800, 8); // CD ROM status registers etc.
+const Range MDEC = Range(0x1f801820, 8); // macroblock decoder command/data and control/status
 
 #endif //PSXEMU_MEMORYMAP_H
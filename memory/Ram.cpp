@@ -3,6 +3,7 @@
 #include <bitset>
 #include <iostream>
 #include "Ram.h"
+#include "../state/Savestate.h"
 
 // fetch the 32 bit little endian word at offset (offset = offset in ram memory range)
 uint32_t Ram::load32(const uint32_t& offset) const {
@@ -29,10 +30,12 @@ void Ram::store32(const uint32_t &offset, const uint32_t &value) {
     this->data[offset + 1] = b1;
     this->data[offset + 2] = b2;
     this->data[offset + 3] = b3;
+    this->dirty[offset >> RAM_PAGE_SHIFT] = DIRTY_ALL;
 }
 
 void Ram::store8(const uint32_t &offset, const uint8_t &value) {
     this->data[offset] = value;
+    this->dirty[offset >> RAM_PAGE_SHIFT] = DIRTY_ALL;
 }
 
 uint8_t Ram::load8(const uint32_t &offset) {
@@ -45,6 +48,7 @@ void Ram::store16(const uint32_t &offset, const uint16_t &value) {
 
     this->data[offset + 0] = b0;
     this->data[offset + 1] = b1;
+    this->dirty[offset >> RAM_PAGE_SHIFT] = DIRTY_ALL;
 }
 
 uint16_t Ram::load16(const uint32_t& offset) {
@@ -53,3 +57,21 @@ uint16_t Ram::load16(const uint32_t& offset) {
 
     return b0 | (uint16_t) (b1 << 8u);
 }
+
+void Ram::markDirty(const uint32_t &offset, const uint32_t &size) {
+    if (size == 0) {
+        return;
+    }
+    std::fill(this->dirty.begin() + (offset >> RAM_PAGE_SHIFT), this->dirty.begin() + ((offset + size - 1) >> RAM_PAGE_SHIFT) + 1, DIRTY_ALL);
+}
+
+void Ram::clearDirty(const uint8_t &consumer) {
+    for (auto& flags : this->dirty) {
+        flags &= (uint8_t) ~consumer;
+    }
+}
+
+void Ram::serialize(Savestate &state) {
+    state.section("RAM ");
+    state.pages(this->data.data(), this->data.size(), this->dirty.data(), 1u << RAM_PAGE_SHIFT);
+}
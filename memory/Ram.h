@@ -3,6 +3,12 @@
 
 #include <vector>
 #include "Range.h"
+#include "DirtyPages.h"
+
+class Savestate;
+
+// granularity of the dirty page tracking
+const uint32_t RAM_PAGE_SHIFT = 12;
 
 class Ram {
 public:
@@ -10,10 +16,13 @@ public:
     const uint32_t SIZE = 2 * 1024 * 1024; // 2 MB
 
     std::vector<unsigned char> data;
+    // flags per page, see DirtyPages.h
+    std::vector<uint8_t> dirty;
 
     Ram() : range(Range(START_ADDRESS, SIZE)) {
         data = std::vector<unsigned char>(SIZE);
         std::fill(data.begin(), data.end(), 0xca); // fill with whatever value
+        dirty = std::vector<uint8_t>(SIZE >> RAM_PAGE_SHIFT, DIRTY_ALL);
     }
 
     Range range;
@@ -28,6 +37,11 @@ public:
     void store16(const uint32_t &offset, const uint16_t &value);
 
     uint16_t load16(const uint32_t &offset);
+
+    // for writes that bypass the store methods
+    void markDirty(const uint32_t& offset, const uint32_t& size);
+    void clearDirty(const uint8_t& consumer);
+    void serialize(Savestate& state);
 };
 
 
@@ -1,60 +1,79 @@
 #include "Vram.h"
+#include <cstring>
+#include "../state/Savestate.h"
 
-RGBA Vram::get_16bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y)
+void Vram::store(const uint16_t& value, const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y)
 {
-    // return texel data at x, y from VRAM
-    uint8_t index = (page_y + y * VRAM_WIDTH) + page_x + x;
-    uint16_t texel_data = this->vram[index];
-
-    // no CLUT used in 16 bit texels, parse data directly
-    RGBA texel = {
-        .r = (uint8_t)(texel_data & 0x1F),
-        .g = (uint8_t)((texel_data >> 5) & 0x1f),
-        .b = (uint8_t)((texel_data >> 10) & 0x1f),
-        .a = (uint8_t)((texel_data >> 15) & 0x1)
-    };
-    
-    return texel;
+    this->set(x, y, value);
 }
 
-RGBA Vram::get_8bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y)
+void Vram::clear_dirty(const uint8_t& consumer)
 {
-    int _index = (y * VRAM_WIDTH) + x/2;
-    // get only the wanted texel's CLUT index
-    uint8_t index = (this->vram[_index] >> (x % 2) * 4) & 0xF; 
-    // return corresponding value in CLUT
-    uint16_t texel_data = this->vram[(this->clut_y * VRAM_WIDTH) + this->clut_x + index];
+    for (auto& flags : this->dirty)
+    {
+        flags &= (uint8_t)~consumer;
+    }
+}
 
-    RGBA texel = {
-        .r = (uint8_t)(texel_data & 0x1F),
-        .g = (uint8_t)((texel_data >> 5) & 0x1f),
-        .b = (uint8_t)((texel_data >> 10) & 0x1f),
-        .a = (uint8_t)((texel_data >> 15) & 0x1)
-    };
-    
-    return texel;
+void Vram::clear_dirty_tiles(const uint8_t& consumer)
+{
+    for (auto& flags : this->dirty_tiles)
+    {
+        flags &= (uint8_t)~consumer;
+    }
+    this->dirty_tiles_any &= (uint8_t)~consumer;
 }
 
-RGBA Vram::get_4bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y)
+void Vram::upload(const uint8_t& consumer, std::vector<VramRect>& rects)
 {
-    int _index = (y * VRAM_WIDTH) + x/4;
-    // get only the wanted texel's CLUT index
-    uint8_t index = (this->vram[_index] >> (x % 4) * 4) & 0xF; 
-    // return corresponding value in CLUT
-    uint16_t texel_data = this->vram[(this->clut_y * VRAM_WIDTH) + this->clut_x + index];
+    if ((this->dirty_tiles_any & consumer) == 0)
+    {
+        return;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo16);
+    glBindTexture(GL_TEXTURE_2D, this->texture16);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, VRAM_WIDTH);
+    for (uint32_t row = 0; row < VRAM_HEIGHT / VRAM_TILE_HEIGHT; row++)
+    {
+        uint8_t* flags = &this->dirty_tiles[row * VRAM_TILES_X];
+        uint32_t column = 0;
+        while (column < VRAM_TILES_X)
+        {
+            if ((flags[column] & consumer) == 0)
+            {
+                column++;
+                continue;
+            }
+            uint32_t first = column;
+            for (; column < VRAM_TILES_X && (flags[column] & consumer) != 0; column++)
+            {
+                flags[column] &= (uint8_t)~consumer;
+            }
+            VramRect rect = {first * VRAM_TILE_WIDTH, row * VRAM_TILE_HEIGHT, (column - first) * VRAM_TILE_WIDTH, VRAM_TILE_HEIGHT};
 
-    RGBA texel = {
-        .r = (uint8_t)(texel_data & 0x1F),
-        .g = (uint8_t)((texel_data >> 5) & 0x1f),
-        .b = (uint8_t)((texel_data >> 10) & 0x1f),
-        .a = (uint8_t)((texel_data >> 15) & 0x1)
-    };
-    
-    return texel;
+            // the buffer has the layout of VRAM, the texture reads the rect from its offset
+            size_t offset = (size_t)rect.y * VRAM_WIDTH + rect.x;
+            for (uint32_t line = 0; line < rect.height; line++)
+            {
+                memcpy(this->ptr16 + offset + line * VRAM_WIDTH, this->vram + offset + line * VRAM_WIDTH, rect.width * sizeof(uint16_t));
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+                            (const void*)(offset * sizeof(uint16_t)));
+            rects.push_back(rect);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    this->dirty_tiles_any &= (uint8_t)~consumer;
 }
-    
-void Vram::store(const uint16_t& value, const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y)
+
+void Vram::serialize(Savestate& state)
 {
-	int index = (y * VRAM_WIDTH) + x;
-    this->vram[index] = value;
-}
\ No newline at end of file
+    state.section("VRAM");
+    state.pages(this->vram, sizeof(this->vram), this->dirty, sizeof(uint16_t) << VRAM_PAGE_SHIFT);
+    if (!state.saving())
+    {
+        memset(this->dirty_tiles, DIRTY_ALL, sizeof(this->dirty_tiles));
+        this->dirty_tiles_any = DIRTY_ALL;
+    }
+}
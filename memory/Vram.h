@@ -4,6 +4,9 @@
 #pragma once
 
 #include <stdint.h>
+#include "DirtyPages.h"
+#include <cstring>
+#include <vector>
 
 #define GL_GLEXT_PROTOTYPES 1
 #define GL3_PROTOTYPES 1
@@ -17,19 +20,31 @@
 #define VRAM_WIDTH 1024
 #define VRAM_HEIGHT 512
 #define VRAM_SIZE VRAM_WIDTH*VRAM_HEIGHT
+// dirty page tracking, 2048 pixels (two lines) per page
+#define VRAM_PAGE_SHIFT 11
+#define VRAM_PAGES (VRAM_SIZE >> VRAM_PAGE_SHIFT)
+// write tracking for the texture cache, 64x16 pixel tiles: a 4-bit texture page is one column
+#define VRAM_TILE_WIDTH 64
+#define VRAM_TILE_HEIGHT 16
+#define VRAM_TILES_X (VRAM_WIDTH / VRAM_TILE_WIDTH)
+#define VRAM_TILES (VRAM_TILES_X * (VRAM_HEIGHT / VRAM_TILE_HEIGHT))
 
-struct RGBA {
-    char r;
-    char g;
-    char b;
-    char a;
+class Savestate;
+
+// area of VRAM, in pixels
+struct VramRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
 };
 
 class Vram
 {
 public:
     Vram() {
-
+        memset(this->dirty, DIRTY_ALL, sizeof(this->dirty));
+        memset(this->dirty_tiles, DIRTY_ALL, sizeof(this->dirty_tiles));
     };
     ~Vram() {
 
@@ -37,12 +52,13 @@ public:
 
     void init()
     {
-        uint32_t access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+        uint32_t access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 	
-	    // 16bit VRAM pixel buffer
+	    // 16bit VRAM pixel buffer, the uploads are staged in it
         glGenBuffers(1, &pbo16);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo16);
-        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, VRAM_SIZE, nullptr, access);	
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, VRAM_SIZE * sizeof(uint16_t), nullptr, access);
+	    this->ptr16 = (uint16_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, VRAM_SIZE * sizeof(uint16_t), access);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         glGenTextures(1, &texture16);
         glBindTexture(GL_TEXTURE_2D, texture16);
@@ -53,26 +69,41 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-        // allocate sapce on gpu and bind
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, VRAM_WIDTH, VRAM_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-        glBindTexture(GL_TEXTURE_2D, texture16);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo16);
-	    this->ptr16 = (uint16_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, VRAM_SIZE, access);
+        // allocate sapce on gpu, the raw 16 bit words are read with an unsigned sampler
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, VRAM_WIDTH, VRAM_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
     };
 
-    void upload() 
+    // Upload the tiles with the 'consumer' bit set to texture16 and clear the bit. Every run of
+    // written tiles in a row of tiles is appended to 'rects'
+    void upload(const uint8_t& consumer, std::vector<VramRect>& rects);
+    uint32_t texture() const { return this->texture16; }
+
+    // pixel at x, y, both wrap around
+    uint16_t get(const uint32_t& x, const uint32_t& y) const
     {
-        // Upload 16bit texture to GPU
-        glBindTexture(GL_TEXTURE_2D, texture16);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo16);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, VRAM_WIDTH, VRAM_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, 0);
+        return this->vram[(y % VRAM_HEIGHT) * VRAM_WIDTH + (x % VRAM_WIDTH)];
+    };
+
+    // 'tile_flags' are set on the tile, a writer that keeps a consumer up to date leaves its bit out
+    void set(const uint32_t& x, const uint32_t& y, const uint16_t& value, const uint8_t& tile_flags = DIRTY_ALL)
+    {
+        uint32_t index = (y % VRAM_HEIGHT) * VRAM_WIDTH + (x % VRAM_WIDTH);
+        this->vram[index] = value;
+        this->dirty[index >> VRAM_PAGE_SHIFT] = DIRTY_ALL;
+        this->dirty_tiles[((y % VRAM_HEIGHT) / VRAM_TILE_HEIGHT) * VRAM_TILES_X + (x % VRAM_WIDTH) / VRAM_TILE_WIDTH] |= tile_flags;
+        this->dirty_tiles_any |= tile_flags;
     };
 
-    RGBA get_4bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y);
-    RGBA get_8bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y);
-    RGBA get_16bit_texel(const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y);
     void store(const uint16_t& value, const uint16_t& x, const uint16_t& y, const uint16_t& page_x, const uint16_t& page_y);
-    
+    void clear_dirty(const uint8_t& consumer);
+    void clear_dirty_tiles(const uint8_t& consumer);
+    void serialize(Savestate& state);
+
+    uint8_t dirty[VRAM_PAGES]; // flags per page, see DirtyPages.h
+    uint8_t dirty_tiles[VRAM_TILES]; // flags per tile
+    uint8_t dirty_tiles_any = DIRTY_ALL; // a consumer can skip the tiles while its bit is clear
+    const uint16_t* data() const { return this->vram; }
+
 private:
 	uint32_t pbo4, pbo8, pbo16; 
 	uint32_t texture4, texture8, texture16;
@@ -81,8 +112,6 @@ private:
     uint16_t* ptr16;
 
     uint16_t vram[VRAM_SIZE] = { 0 };
-    uint16_t clut_x; // TODO
-    uint16_t clut_y; // TODO
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "Adpcm.h"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// prediction filters, in 1/64
+const int32_t FILTER_POS[5] = {0, 60, 115, 98, 122};
+const int32_t FILTER_NEG[5] = {0, 0, -52, -55, -60};
+
+// Every sample is its nibble in the top 4 bits of a 16 bit word, shifted right arithmetically,
+// which only depends on the block header and is done for the whole block at once.
+// The filter feeds every sample into the next one and stays scalar.
+static void expand_nibbles(const VAGSample& block, const uint32_t& shift, int16_t* expanded)
+{
+#ifdef __SSE2__
+    // the 14 data bytes of the block, samples 28-31 come out as zeros and are not used
+    __m128i bytes = _mm_srli_si128(_mm_loadu_si128((const __m128i*)&block), 2);
+    // both nibbles of a byte go to consecutive words: b0 b0 b1 b1 ...
+    __m128i low = _mm_unpacklo_epi8(bytes, bytes);
+    __m128i high = _mm_unpackhi_epi8(bytes, bytes);
+    __m128i words[4] = {
+        _mm_unpacklo_epi16(low, low),
+        _mm_unpackhi_epi16(low, low),
+        _mm_unpacklo_epi16(high, high),
+        _mm_unpackhi_epi16(high, high)
+    };
+    // low nibble of even words to the top (<< 12), high nibble of odd words (<< 8)
+    const __m128i move = _mm_set_epi16(0x100, 0x1000, 0x100, 0x1000, 0x100, 0x1000, 0x100, 0x1000);
+    const __m128i mask = _mm_set1_epi16((short)0xf000);
+    const __m128i count = _mm_cvtsi32_si128((int)shift);
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i nibbles = _mm_and_si128(_mm_mullo_epi16(words[i], move), mask);
+        _mm_storeu_si128((__m128i*)(expanded + i * 8), _mm_sra_epi16(nibbles, count));
+    }
+#else
+    for (uint32_t i = 0; i < ADPCM_BLOCK_SAMPLES; i++)
+    {
+        uint8_t byte = block.packed[i / 2];
+        uint16_t nibble = (i & 1) ? (byte >> 4) : (byte & 0xf);
+        expanded[i] = (int16_t)(uint16_t)(nibble << 12) >> shift;
+    }
+#endif
+}
+
+void decode_adpcm_block(const VAGSample& block, int16_t* samples, int16_t& old, int16_t& older)
+{
+    uint32_t shift = block.pack_info & 0xf;
+    if (shift > 12)
+    {
+        shift = 9; // reserved values behave like 9
+    }
+    uint32_t filter = std::min<uint32_t>((block.pack_info >> 4) & 0x7, 4);
+
+    int16_t expanded[32];
+    expand_nibbles(block, shift, expanded);
+
+    int32_t pos = FILTER_POS[filter], neg = FILTER_NEG[filter];
+    int32_t s1 = old, s2 = older;
+    for (uint32_t i = 0; i < ADPCM_BLOCK_SAMPLES; i++)
+    {
+        int32_t sample = expanded[i] + ((s1 * pos + s2 * neg + 32) >> 6);
+        sample = std::clamp(sample, -0x8000, 0x7fff);
+        samples[i] = (int16_t)sample;
+        s2 = s1;
+        s1 = sample;
+    }
+    old = (int16_t)s1;
+    older = (int16_t)s2;
+}
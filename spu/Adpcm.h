@@ -0,0 +1,27 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t ADPCM_BLOCK_SIZE = 16; // bytes
+const uint32_t ADPCM_BLOCK_SAMPLES = 28;
+
+// flags of a block
+const uint8_t ADPCM_LOOP_END = 1u << 0; // jump to the repeat address after this block
+const uint8_t ADPCM_LOOP_REPEAT = 1u << 1; // with LOOP_END: keep playing, otherwise the voice is released
+const uint8_t ADPCM_LOOP_START = 1u << 2; // this block becomes the repeat address
+
+// a 16 byte block of SPU ADPCM ("VAG") data, 28 4-bit samples
+struct VAGSample {
+    unsigned char pack_info; // shift in bits 0-3, filter in bits 4-6
+    unsigned char flags;
+    unsigned char packed[14]; // two samples per byte, low nibble first
+};
+
+// decode the 28 samples of 'block'. 'old' and 'older' are the last two samples of the previous
+// block of the voice, the filters predict from them. They are updated for the next block
+void decode_adpcm_block(const VAGSample& block, int16_t* samples, int16_t& old, int16_t& older);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef ADSR_H
+#define ADSR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <algorithm>
+
+const int32_t ADSR_MAX_LEVEL = 0x7fff;
+// the envelope does not change any more
+const uint32_t ADSR_NEVER = UINT32_MAX;
+
+enum AdsrPhase {
+    AdsrOff,
+    AdsrAttack,
+    AdsrDecay,
+    AdsrSustain,
+    AdsrRelease
+};
+
+// a 7 bit rate (shift in bits 2-6, step in bits 0-1) in linear mode: the level changes by
+// 'step' every 'cycles' samples. Exponential mode scales both with the level at run time
+struct AdsrRate {
+    uint32_t cycles;
+    int32_t step;
+};
+
+// http://problemkaputt.de/psx-spx.htm#spuvolumeandadsrgenerator
+//   AdsrCycles = 1 SHL Max(0,ShiftValue-11)
+//   AdsrStep = StepValue SHL Max(0,11-ShiftValue), StepValue +7..+4 or -8..-5
+constexpr std::array<AdsrRate, 128> make_adsr_rates(const bool& decrease)
+{
+    std::array<AdsrRate, 128> rates = {};
+    for (int32_t rate = 0; rate < 128; rate++)
+    {
+        int32_t shift = rate >> 2;
+        int32_t step = decrease ? -8 + (rate & 3) : 7 - (rate & 3);
+        rates[rate].cycles = 1u << (shift > 11 ? shift - 11 : 0);
+        rates[rate].step = step * (1 << (shift < 11 ? 11 - shift : 0));
+    }
+    return rates;
+}
+
+inline constexpr std::array<AdsrRate, 128> ADSR_INCREASE = make_adsr_rates(false);
+inline constexpr std::array<AdsrRate, 128> ADSR_DECREASE = make_adsr_rates(true);
+
+static_assert(ADSR_INCREASE[0].cycles == 1 && ADSR_INCREASE[0].step == 7 << 11);
+static_assert(ADSR_DECREASE[127].cycles == 1u << 20 && ADSR_DECREASE[127].step == -5);
+
+// Level of a volume register. A fixed volume (bit 15 clear) is 15 bit signed and halved. In sweep
+// mode the level moves from where it was with the rates of the envelope: bit 14 exponential,
+// bit 13 decrease, bit 12 negative phase, bits 0-6 the rate.
+struct VolumeSweep
+{
+    int32_t level = 0;
+    uint32_t wait = 0; // samples until the next step, 0 when not sweeping
+
+    // the level of the next 'samples' samples, the sweep is stepped once for all of them
+    int32_t advance(const uint16_t& value, const uint32_t& samples)
+    {
+        int32_t current = this->level;
+        if ((value & 0x8000) == 0)
+        {
+            this->level = (int16_t)(value << 1);
+            this->wait = 0;
+            return this->level;
+        }
+        uint32_t rate = value & 0x7f;
+        bool exponential = (value & 0x4000) != 0;
+        bool decrease = (value & 0x2000) != 0;
+        int32_t magnitude = std::min(current < 0 ? -current : current, ADSR_MAX_LEVEL);
+        uint32_t remaining = samples;
+        while (rate != 0x7f && (decrease ? magnitude > 0 : magnitude < ADSR_MAX_LEVEL))
+        {
+            uint32_t cycles = (decrease ? ADSR_DECREASE : ADSR_INCREASE)[rate].cycles;
+            if (exponential && !decrease && magnitude > 0x6000)
+            {
+                cycles *= 4; // exponential increase slows down near the top
+            }
+            if (this->wait == 0 || this->wait > cycles)
+            {
+                this->wait = cycles;
+            }
+            if (this->wait > remaining)
+            {
+                this->wait -= remaining;
+                break;
+            }
+            remaining -= this->wait;
+            this->wait = 0;
+            int32_t step = (decrease ? ADSR_DECREASE : ADSR_INCREASE)[rate].step;
+            if (exponential && decrease)
+            {
+                step = (step * magnitude) >> 15; // exponential decrease is proportional to the level
+            }
+            magnitude = std::clamp(magnitude + step, 0, ADSR_MAX_LEVEL);
+        }
+        this->level = (value & 0x1000) != 0 ? -magnitude : magnitude;
+        return current;
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "AudioOutput.h"
+#include "Spu.h"
+#include "../util/logging.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstring>
+
+AudioRing::AudioRing(const uint32_t& frames)
+{
+    // a power of two, the indices wrap with a mask
+    uint32_t size = 1;
+    while (size < frames)
+    {
+        size <<= 1;
+    }
+    this->buffer.resize((size_t)size * 2);
+    this->mask = size - 1;
+}
+
+uint32_t AudioRing::fill() const
+{
+    return this->write_index.load(std::memory_order_acquire) - this->read_index.load(std::memory_order_acquire);
+}
+
+uint32_t AudioRing::push(const int16_t* frames, const uint32_t& count)
+{
+    auto write = this->write_index.load(std::memory_order_relaxed);
+    auto read = this->read_index.load(std::memory_order_acquire);
+    auto n = std::min(count, this->mask + 1 - (write - read));
+    // at most two runs, before and after the end of the buffer
+    auto first = std::min(n, this->mask + 1 - (write & this->mask));
+    memcpy(&this->buffer[(size_t)(write & this->mask) * 2], frames, (size_t)first * 4);
+    memcpy(&this->buffer[0], frames + (size_t)first * 2, (size_t)(n - first) * 4);
+    this->write_index.store(write + n, std::memory_order_release);
+    return n;
+}
+
+uint32_t AudioRing::pop(int16_t* frames, const uint32_t& count)
+{
+    auto read = this->read_index.load(std::memory_order_relaxed);
+    auto write = this->write_index.load(std::memory_order_acquire);
+    auto n = std::min(count, write - read);
+    auto first = std::min(n, this->mask + 1 - (read & this->mask));
+    memcpy(frames, &this->buffer[(size_t)(read & this->mask) * 2], (size_t)first * 4);
+    memcpy(frames + (size_t)first * 2, &this->buffer[0], (size_t)(n - first) * 4);
+    this->read_index.store(read + n, std::memory_order_release);
+    return n;
+}
+
+void NullAudioOutput::write(const int16_t* /* frames */, const uint32_t& count)
+{
+    this->frames += count;
+}
+
+void NullAudioOutput::print_stats() const
+{
+    DEBUG("Audio:_" << std::dec << this->frames << "_frames_dropped_without_output");
+}
+
+WavAudioOutput::~WavAudioOutput()
+{
+    if (this->file != nullptr)
+    {
+        // the sizes are known now
+        fseek(this->file, 0, SEEK_SET);
+        this->write_header();
+        fclose(this->file);
+    }
+}
+
+void WavAudioOutput::write_header()
+{
+    auto data_size = (uint32_t)std::min<uint64_t>(this->frames * 4, UINT32_MAX - 36);
+    uint32_t riff_size = 36 + data_size;
+    uint32_t format_size = 16, rate = SPU_SAMPLE_RATE, byte_rate = SPU_SAMPLE_RATE * 4;
+    uint16_t format = 1, channels = 2, block_align = 4, bits = 16;
+    fwrite("RIFF", 1, 4, this->file);
+    fwrite(&riff_size, 4, 1, this->file);
+    fwrite("WAVEfmt ", 1, 8, this->file);
+    fwrite(&format_size, 4, 1, this->file);
+    fwrite(&format, 2, 1, this->file);
+    fwrite(&channels, 2, 1, this->file);
+    fwrite(&rate, 4, 1, this->file);
+    fwrite(&byte_rate, 4, 1, this->file);
+    fwrite(&block_align, 2, 1, this->file);
+    fwrite(&bits, 2, 1, this->file);
+    fwrite("data", 1, 4, this->file);
+    fwrite(&data_size, 4, 1, this->file);
+}
+
+bool WavAudioOutput::open(const std::string& fname)
+{
+    this->file = fopen(fname.c_str(), "wb");
+    if (!this->file)
+    {
+        DEBUG("Unable_to_write_audio_file:" << fname);
+        return false;
+    }
+    // the sizes are filled in when the file is closed
+    this->write_header();
+    return true;
+}
+
+void WavAudioOutput::write(const int16_t* frames, const uint32_t& count)
+{
+    fwrite(frames, 4, count, this->file);
+    this->frames += count;
+}
+
+void WavAudioOutput::print_stats() const
+{
+    DEBUG("Audio:_" << std::dec << this->frames << "_frames_written");
+}
+
+SdlAudioOutput::~SdlAudioOutput()
+{
+    if (this->device != 0)
+    {
+        SDL_CloseAudioDevice(this->device);
+    }
+}
+
+bool SdlAudioOutput::open()
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        DEBUG("Unable_to_initialize_SDL_audio:" << SDL_GetError());
+        return false;
+    }
+    SDL_AudioSpec wanted = {};
+    wanted.freq = SPU_SAMPLE_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 2;
+    wanted.samples = AUDIO_DEVICE_FRAMES;
+    wanted.callback = &SdlAudioOutput::callback;
+    wanted.userdata = this;
+    SDL_AudioSpec obtained = {};
+    // no changes allowed, SDL converts whatever the device wants
+    this->device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+    if (this->device == 0)
+    {
+        DEBUG("Unable_to_open_audio_device:" << SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void SdlAudioOutput::callback(void* userdata, uint8_t* stream, int length)
+{
+    auto output = (SdlAudioOutput*)userdata;
+    auto frames = (int16_t*)stream;
+    auto count = (uint32_t)length / 4;
+    auto n = output->ring.pop(frames, count);
+    if (n != 0)
+    {
+        memcpy(output->last_played, frames + (size_t)(n - 1) * 2, 4);
+    }
+    if (n < count)
+    {
+        // holding the last frame clicks less than dropping to silence
+        for (auto i = n; i < count; i++)
+        {
+            memcpy(frames + (size_t)i * 2, output->last_played, 4);
+        }
+        output->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t SdlAudioOutput::resample(const int16_t* frames, const uint32_t& count, const uint32_t& step)
+{
+    // frame i of the input lies at position i + 1, between frame i - 1 (or the last frame
+    // written) and frame i
+    auto needed = (size_t)(((uint64_t)count << 16) / step + 2) * 2;
+    if (this->resampled.size() < needed)
+    {
+        this->resampled.resize(needed);
+    }
+    auto out = this->resampled.data();
+    uint32_t n = 0;
+    auto position = this->position;
+    while ((position >> 16) < count)
+    {
+        auto i = position >> 16;
+        auto frac = (int32_t)(position & 0xffff) >> 1; // 15 bits, the products fit in 32
+        const int16_t* a = i == 0 ? this->last_written : frames + (size_t)(i - 1) * 2;
+        const int16_t* b = frames + (size_t)i * 2;
+        out[n * 2] = (int16_t)(a[0] + (((b[0] - a[0]) * frac) >> 15));
+        out[n * 2 + 1] = (int16_t)(a[1] + (((b[1] - a[1]) * frac) >> 15));
+        n++;
+        position += step;
+    }
+    this->position = position - (count << 16);
+    memcpy(this->last_written, frames + (size_t)(count - 1) * 2, 4);
+    return n;
+}
+
+void SdlAudioOutput::write(const int16_t* frames, const uint32_t& count)
+{
+    if (this->device == 0 || count == 0)
+    {
+        return;
+    }
+    // above the target the ring is drained faster than it is filled, below slower
+    auto fill = this->ring.fill();
+    auto error = std::clamp(((double)fill - AUDIO_TARGET_FRAMES) / AUDIO_TARGET_FRAMES, -1.0, 1.0);
+    auto step = (uint32_t)(65536.0 * (1.0 + AUDIO_MAX_RATE_ADJUST * error));
+
+    auto n = this->resample(frames, count, step);
+    auto written = this->ring.push(this->resampled.data(), n);
+    if (written < n)
+    {
+        this->overruns++;
+        this->dropped_frames += n - written;
+    }
+    if (!this->playing && this->ring.fill() >= AUDIO_TARGET_FRAMES)
+    {
+        SDL_PauseAudioDevice(this->device, 0);
+        this->playing = true;
+    }
+}
+
+void SdlAudioOutput::print_stats() const
+{
+    DEBUG("Audio:_" << std::dec << this->underruns.load() << "_underruns,_" << this->overruns << "_overruns,_" << this->dropped_frames << "_frames_dropped");
+}
@@ -0,0 +1,113 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// stereo frames in the ring between the emulation thread and the audio device, about 186 ms
+const uint32_t AUDIO_RING_FRAMES = 8192;
+// fill level the rate control aims for, about 46 ms: enough to ride out a slow frame
+const uint32_t AUDIO_TARGET_FRAMES = 2048;
+// frames the device asks for at once
+const uint16_t AUDIO_DEVICE_FRAMES = 512;
+// largest change of the resampling ratio, small enough to be inaudible (about 8 cents)
+const double AUDIO_MAX_RATE_ADJUST = 0.005;
+
+// Single producer, single consumer ring of interleaved stereo frames. The indices only grow,
+// their difference is the fill level; neither side ever waits for the other
+class AudioRing
+{
+public:
+    explicit AudioRing(const uint32_t& frames);
+
+    uint32_t fill() const;
+    // producer side, returns the frames that fit
+    uint32_t push(const int16_t* frames, const uint32_t& count);
+    // consumer side, returns the frames that were there
+    uint32_t pop(int16_t* frames, const uint32_t& count);
+
+private:
+    std::vector<int16_t> buffer;
+    uint32_t mask;
+    // on their own cache lines, each one is only written by one thread
+    alignas(64) std::atomic<uint32_t> read_index = 0;
+    alignas(64) std::atomic<uint32_t> write_index = 0;
+};
+
+// Receives the mixed SPU output on the emulation thread. Not part of the machine state
+class AudioOutput
+{
+public:
+    virtual ~AudioOutput() {};
+
+    virtual void write(const int16_t* frames, const uint32_t& count) = 0;
+    virtual void print_stats() const {};
+};
+
+// drops everything, headless runs without --audio-out
+class NullAudioOutput : public AudioOutput
+{
+public:
+    void write(const int16_t* frames, const uint32_t& count) override;
+    void print_stats() const override;
+
+private:
+    uint64_t frames = 0;
+};
+
+// 16-bit stereo WAV file at the SPU rate, every frame the SPU mixes, nothing is resampled
+class WavAudioOutput : public AudioOutput
+{
+public:
+    ~WavAudioOutput();
+
+    bool open(const std::string& fname);
+    void write(const int16_t* frames, const uint32_t& count) override;
+    void print_stats() const override;
+
+private:
+    FILE* file = nullptr;
+    uint64_t frames = 0;
+
+    void write_header();
+};
+
+// SDL audio device fed from an AudioRing by the SDL callback. The emulation thread never waits
+// for the device: the emulated and the device clocks drift apart, so the frames are resampled
+// on their way into the ring with a ratio that pulls the fill level back to the target. Frames
+// that do not fit are dropped (overrun), a callback that finds the ring short repeats the last
+// frame (underrun)
+class SdlAudioOutput : public AudioOutput
+{
+public:
+    ~SdlAudioOutput();
+
+    bool open();
+    void write(const int16_t* frames, const uint32_t& count) override;
+    void print_stats() const override;
+
+    std::atomic<uint64_t> underruns = 0; // callbacks that found the ring short
+    uint64_t overruns = 0; // writes that did not fit
+    uint64_t dropped_frames = 0;
+
+private:
+    uint32_t device = 0;
+    bool playing = false; // the device starts once the ring is at its target
+    AudioRing ring = AudioRing(AUDIO_RING_FRAMES);
+    int16_t last_played[2] = {}; // only used by the callback
+
+    // linear resampler, the position is in 16.16 frames from the last frame of the previous write
+    uint32_t position = 0;
+    int16_t last_written[2] = {};
+    std::vector<int16_t> resampled;
+
+    static void callback(void* userdata, uint8_t* stream, int length);
+    uint32_t resample(const int16_t* frames, const uint32_t& count, const uint32_t& step);
+};
+
+#endif
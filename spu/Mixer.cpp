@@ -0,0 +1,91 @@
+#include "Mixer.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PSXEMU_MIX_AVX2
+#endif
+
+static void mix_portable(const MixBlock& block, const uint32_t& samples, MixOutput& out)
+{
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        const auto& taps = block.taps[n];
+        const auto& weights = block.weights[n];
+        const auto& envelope = block.envelope[n];
+        int32_t sum_left = 0, sum_right = 0, reverb_left = 0, reverb_right = 0;
+        for (uint32_t lane = 0; lane < block.lanes; lane++)
+        {
+            int32_t sample = (taps[0][lane] * weights[0][lane] + taps[1][lane] * weights[1][lane] +
+                              taps[2][lane] * weights[2][lane] + taps[3][lane] * weights[3][lane]) >> 15;
+            sample = (sample * envelope[lane]) >> 15;
+            int32_t l = (sample * block.volume_left[lane]) >> 15;
+            int32_t r = (sample * block.volume_right[lane]) >> 15;
+            sum_left += l;
+            sum_right += r;
+            reverb_left += l & block.reverb[lane];
+            reverb_right += r & block.reverb[lane];
+        }
+        out.left[n] = sum_left;
+        out.right[n] = sum_right;
+        out.reverb_left[n] = reverb_left;
+        out.reverb_right[n] = reverb_right;
+    }
+}
+
+#ifdef PSXEMU_MIX_AVX2
+__attribute__((target("avx2")))
+static int32_t horizontal_sum(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// same operations as mix_portable, 8 voices per instruction
+__attribute__((target("avx2")))
+static void mix_avx2(const MixBlock& block, const uint32_t& samples, MixOutput& out)
+{
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        const auto& taps = block.taps[n];
+        const auto& weights = block.weights[n];
+        const auto& envelope = block.envelope[n];
+        __m256i sum_left = _mm256_setzero_si256(), sum_right = _mm256_setzero_si256();
+        __m256i reverb_left = _mm256_setzero_si256(), reverb_right = _mm256_setzero_si256();
+        for (uint32_t lane = 0; lane < block.lanes; lane += MIX_LANE_GROUP)
+        {
+            __m256i sample = _mm256_setzero_si256();
+            for (int tap = 0; tap < 4; tap++)
+            {
+                __m256i t = _mm256_load_si256((const __m256i*)&taps[tap][lane]);
+                __m256i w = _mm256_load_si256((const __m256i*)&weights[tap][lane]);
+                sample = _mm256_add_epi32(sample, _mm256_mullo_epi32(t, w));
+            }
+            sample = _mm256_srai_epi32(sample, 15);
+            sample = _mm256_srai_epi32(_mm256_mullo_epi32(sample, _mm256_load_si256((const __m256i*)&envelope[lane])), 15);
+            __m256i l = _mm256_srai_epi32(_mm256_mullo_epi32(sample, _mm256_load_si256((const __m256i*)&block.volume_left[lane])), 15);
+            __m256i r = _mm256_srai_epi32(_mm256_mullo_epi32(sample, _mm256_load_si256((const __m256i*)&block.volume_right[lane])), 15);
+            __m256i reverb = _mm256_load_si256((const __m256i*)&block.reverb[lane]);
+            sum_left = _mm256_add_epi32(sum_left, l);
+            sum_right = _mm256_add_epi32(sum_right, r);
+            reverb_left = _mm256_add_epi32(reverb_left, _mm256_and_si256(l, reverb));
+            reverb_right = _mm256_add_epi32(reverb_right, _mm256_and_si256(r, reverb));
+        }
+        out.left[n] = horizontal_sum(sum_left);
+        out.right[n] = horizontal_sum(sum_right);
+        out.reverb_left[n] = horizontal_sum(reverb_left);
+        out.reverb_right[n] = horizontal_sum(reverb_right);
+    }
+}
+#endif
+
+MixKernel select_mix_kernel()
+{
+#ifdef PSXEMU_MIX_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return mix_avx2;
+    }
+#endif
+    return mix_portable;
+}
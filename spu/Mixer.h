@@ -0,0 +1,115 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t SPU_VOICES = 24;
+// output samples mixed at once, the voices are gathered for all of them and mixed in one go
+const uint32_t MIX_BLOCK_SAMPLES = 32;
+// voices in lanes, 8 per AVX2 register
+const uint32_t MIX_LANE_GROUP = 8;
+const uint32_t MIX_LANES = SPU_VOICES;
+
+// 4-tap Gaussian interpolation between ADPCM samples, the table from the SPU ROM (psx-spx), 1.0 = 0x8000.
+// For a position p (bits 4-11 of the pitch counter) the taps, oldest first, are weighted with
+// entries 0xff-p, 0x1ff-p, 0x100+p and p
+inline constexpr int16_t GAUSS_TABLE[512] = {
+    -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001,
+    -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001, -0x0001,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001,
+    0x0001, 0x0001, 0x0001, 0x0002, 0x0002, 0x0002, 0x0003, 0x0003,
+    0x0003, 0x0004, 0x0004, 0x0005, 0x0005, 0x0006, 0x0007, 0x0007,
+    0x0008, 0x0009, 0x0009, 0x000a, 0x000b, 0x000c, 0x000d, 0x000e,
+    0x000f, 0x0010, 0x0011, 0x0012, 0x0013, 0x0015, 0x0016, 0x0018,
+    0x0019, 0x001b, 0x001c, 0x001e, 0x0020, 0x0021, 0x0023, 0x0025,
+    0x0027, 0x0029, 0x002c, 0x002e, 0x0030, 0x0033, 0x0035, 0x0038,
+    0x003a, 0x003d, 0x0040, 0x0043, 0x0046, 0x0049, 0x004d, 0x0050,
+    0x0054, 0x0057, 0x005b, 0x005f, 0x0063, 0x0067, 0x006b, 0x006f,
+    0x0074, 0x0078, 0x007d, 0x0082, 0x0087, 0x008c, 0x0091, 0x0096,
+    0x009c, 0x00a1, 0x00a7, 0x00ad, 0x00b3, 0x00ba, 0x00c0, 0x00c7,
+    0x00cd, 0x00d4, 0x00db, 0x00e3, 0x00ea, 0x00f2, 0x00fa, 0x0101,
+    0x010a, 0x0112, 0x011b, 0x0123, 0x012c, 0x0135, 0x013f, 0x0148,
+    0x0152, 0x015c, 0x0166, 0x0171, 0x017b, 0x0186, 0x0191, 0x019c,
+    0x01a8, 0x01b4, 0x01c0, 0x01cc, 0x01d9, 0x01e5, 0x01f2, 0x0200,
+    0x020d, 0x021b, 0x0229, 0x0237, 0x0246, 0x0255, 0x0264, 0x0273,
+    0x0283, 0x0293, 0x02a3, 0x02b4, 0x02c4, 0x02d6, 0x02e7, 0x02f9,
+    0x030b, 0x031d, 0x0330, 0x0343, 0x0356, 0x036a, 0x037e, 0x0392,
+    0x03a7, 0x03bc, 0x03d1, 0x03e7, 0x03fc, 0x0413, 0x042a, 0x0441,
+    0x0458, 0x0470, 0x0488, 0x04a0, 0x04b9, 0x04d2, 0x04ec, 0x0506,
+    0x0520, 0x053b, 0x0556, 0x0572, 0x058e, 0x05aa, 0x05c7, 0x05e4,
+    0x0601, 0x061f, 0x063e, 0x065c, 0x067c, 0x069b, 0x06bb, 0x06dc,
+    0x06fd, 0x071e, 0x0740, 0x0762, 0x0784, 0x07a7, 0x07cb, 0x07ef,
+    0x0813, 0x0838, 0x085d, 0x0883, 0x08a9, 0x08d0, 0x08f7, 0x091e,
+    0x0946, 0x096f, 0x0998, 0x09c1, 0x09eb, 0x0a16, 0x0a40, 0x0a6c,
+    0x0a98, 0x0ac4, 0x0af1, 0x0b1e, 0x0b4c, 0x0b7a, 0x0ba9, 0x0bd8,
+    0x0c07, 0x0c38, 0x0c68, 0x0c99, 0x0ccb, 0x0cfd, 0x0d30, 0x0d63,
+    0x0d97, 0x0dcb, 0x0e00, 0x0e35, 0x0e6b, 0x0ea1, 0x0ed7, 0x0f0f,
+    0x0f46, 0x0f7f, 0x0fb7, 0x0ff1, 0x102a, 0x1065, 0x109f, 0x10db,
+    0x1116, 0x1153, 0x118f, 0x11cd, 0x120b, 0x1249, 0x1288, 0x12c7,
+    0x1307, 0x1347, 0x1388, 0x13c9, 0x140b, 0x144d, 0x1490, 0x14d4,
+    0x1517, 0x155c, 0x15a0, 0x15e6, 0x162c, 0x1672, 0x16b9, 0x1700,
+    0x1747, 0x1790, 0x17d8, 0x1821, 0x186a, 0x18b4, 0x18ff, 0x1949,
+    0x1995, 0x19e0, 0x1a2c, 0x1a79, 0x1ac6, 0x1b13, 0x1b61, 0x1baf,
+    0x1bfe, 0x1c4d, 0x1c9c, 0x1cec, 0x1d3c, 0x1d8d, 0x1dde, 0x1e2f,
+    0x1e81, 0x1ed3, 0x1f25, 0x1f78, 0x1fcb, 0x201f, 0x2072, 0x20c7,
+    0x211b, 0x2170, 0x21c5, 0x221b, 0x2271, 0x22c7, 0x231d, 0x2374,
+    0x23cb, 0x2422, 0x247a, 0x24d2, 0x252a, 0x2582, 0x25db, 0x2634,
+    0x268d, 0x26e6, 0x2740, 0x279a, 0x27f4, 0x284e, 0x28a8, 0x2903,
+    0x295e, 0x29b9, 0x2a14, 0x2a6f, 0x2acb, 0x2b27, 0x2b83, 0x2bdf,
+    0x2c3b, 0x2c97, 0x2cf4, 0x2d50, 0x2dad, 0x2e0a, 0x2e67, 0x2ec4,
+    0x2f21, 0x2f7e, 0x2fdc, 0x3039, 0x3097, 0x30f4, 0x3152, 0x31b0,
+    0x320d, 0x326b, 0x32c9, 0x3327, 0x3385, 0x33e3, 0x3441, 0x349f,
+    0x34fd, 0x355b, 0x35b9, 0x3617, 0x3675, 0x36d3, 0x3731, 0x378f,
+    0x37ed, 0x384a, 0x38a8, 0x3906, 0x3964, 0x39c1, 0x3a1f, 0x3a7c,
+    0x3ad9, 0x3b36, 0x3b93, 0x3bf0, 0x3c4d, 0x3ca9, 0x3d06, 0x3d62,
+    0x3dbe, 0x3e1a, 0x3e75, 0x3ed1, 0x3f2c, 0x3f87, 0x3fe1, 0x403c,
+    0x4096, 0x40ef, 0x4149, 0x41a2, 0x41fb, 0x4253, 0x42ab, 0x4303,
+    0x435b, 0x43b2, 0x4408, 0x445f, 0x44b5, 0x450a, 0x455f, 0x45b4,
+    0x4608, 0x465c, 0x46af, 0x4702, 0x4754, 0x47a6, 0x47f8, 0x4849,
+    0x4899, 0x48e9, 0x4938, 0x4987, 0x49d5, 0x4a23, 0x4a70, 0x4abc,
+    0x4b08, 0x4b54, 0x4b9e, 0x4be9, 0x4c32, 0x4c7b, 0x4cc3, 0x4d0b,
+    0x4d52, 0x4d98, 0x4dde, 0x4e23, 0x4e67, 0x4eab, 0x4eee, 0x4f30,
+    0x4f71, 0x4fb2, 0x4ff2, 0x5032, 0x5070, 0x50ae, 0x50eb, 0x5128,
+    0x5163, 0x519e, 0x51d8, 0x5212, 0x524a, 0x5282, 0x52b9, 0x52ef,
+    0x5324, 0x5359, 0x538c, 0x53bf, 0x53f1, 0x5422, 0x5452, 0x5481,
+    0x54b0, 0x54dd, 0x550a, 0x5536, 0x5561, 0x558b, 0x55b4, 0x55dc,
+    0x5603, 0x562a, 0x564f, 0x5673, 0x5697, 0x56ba, 0x56dc, 0x56fc,
+    0x571c, 0x573b, 0x5759, 0x5776, 0x5792, 0x57ad, 0x57c7, 0x57e0,
+    0x57f8, 0x5810, 0x5826, 0x583b, 0x584f, 0x5862, 0x5875, 0x5886,
+    0x5896, 0x58a5, 0x58b3, 0x58c0, 0x58cc, 0x58d7, 0x58e1, 0x58ea,
+    0x58f2, 0x58f9, 0x58ff, 0x5904, 0x5908, 0x590b, 0x590d, 0x590e
+};
+
+// One block of output samples with the voices in lanes (structure of arrays), so the
+// interpolation, the envelope and the volumes are computed for 8 voices at a time.
+// Lanes from 'lanes' on are not read, lanes of voices that stopped have zero taps
+struct MixBlock
+{
+    uint32_t lanes; // playing voices, rounded up to MIX_LANE_GROUP
+    alignas(32) int32_t taps[MIX_BLOCK_SAMPLES][4][MIX_LANES];
+    alignas(32) int32_t weights[MIX_BLOCK_SAMPLES][4][MIX_LANES];
+    alignas(32) int32_t envelope[MIX_BLOCK_SAMPLES][MIX_LANES];
+    // constant over the block
+    alignas(32) int32_t volume_left[MIX_LANES];
+    alignas(32) int32_t volume_right[MIX_LANES];
+    alignas(32) int32_t reverb[MIX_LANES]; // all bits set if the voice goes to the reverb unit
+};
+
+// sums of the voices, all of them and those with reverb enabled
+struct MixOutput
+{
+    int32_t left[MIX_BLOCK_SAMPLES];
+    int32_t right[MIX_BLOCK_SAMPLES];
+    int32_t reverb_left[MIX_BLOCK_SAMPLES];
+    int32_t reverb_right[MIX_BLOCK_SAMPLES];
+};
+
+// sums the voices of the first 'samples' samples of 'block'
+typedef void (*MixKernel)(const MixBlock& block, const uint32_t& samples, MixOutput& out);
+
+// the AVX2 kernel if the CPU has it, the portable one otherwise. Both give the same result
+MixKernel select_mix_kernel();
+
+#endif
@@ -0,0 +1,197 @@
+#include "Reverb.h"
+#include "Spu.h"
+#include "../state/Savestate.h"
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 1.0 = 0x8000, the same filter for both directions
+alignas(16) const int16_t REVERB_FIR[REVERB_FIR_PADDED] = {
+    -0x0001, 0x0000, 0x0002, 0x0000, -0x000a, 0x0000, 0x0023, 0x0000, -0x0067, 0x0000,
+    0x010a, 0x0000, -0x0268, 0x0000, 0x0534, 0x0000, -0x0b90, 0x0000, 0x2806, 0x4000,
+    0x2806, 0x0000, -0x0b90, 0x0000, 0x0534, 0x0000, -0x0268, 0x0000, 0x010a, 0x0000,
+    -0x0067, 0x0000, 0x0023, 0x0000, -0x000a, 0x0000, 0x0002, 0x0000, -0x0001, 0x0000
+};
+
+// the filter over the REVERB_FIR_PADDED samples from 'window' on
+static int32_t fir(const int16_t* window)
+{
+#ifdef __SSE2__
+    __m128i sum = _mm_setzero_si128();
+    for (uint32_t i = 0; i < REVERB_FIR_PADDED; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128((const __m128i*)(window + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(samples, _mm_load_si128((const __m128i*)(REVERB_FIR + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (uint32_t i = 0; i < REVERB_FIR_PADDED; i++)
+    {
+        sum += window[i] * REVERB_FIR[i];
+    }
+    return sum;
+#endif
+}
+
+static int32_t clamp16(const int32_t& value)
+{
+    return std::clamp(value, -0x8000, 0x7fff);
+}
+
+static int32_t multiply(const int32_t& a, const int32_t& b)
+{
+    return (a * b) >> 15;
+}
+
+void ReverbUnit::set_base(const uint16_t& value)
+{
+    this->base_register = value;
+    this->base_address = (value * 4u) & (SPU_RAM_MASK >> 1);
+    this->current = this->base_address;
+}
+
+uint32_t ReverbUnit::address(const int32_t& offset) const
+{
+    // offsets wrap around within the work area
+    int32_t size = (int32_t)(SPU_RAM_SIZE / 2 - this->base_address);
+    int32_t relative = ((int32_t)(this->current - this->base_address) + offset) % size;
+    if (relative < 0)
+    {
+        relative += size;
+    }
+    return (this->base_address + (uint32_t)relative) * 2;
+}
+
+int32_t ReverbUnit::read(const uint8_t* ram, const int32_t& offset) const
+{
+    auto a = this->address(offset);
+    return (int16_t)(ram[a] | (ram[a + 1] << 8));
+}
+
+void ReverbUnit::write(uint8_t* ram, const int32_t& offset, const int32_t& value) const
+{
+    auto a = this->address(offset);
+    auto sample = (uint16_t)clamp16(value);
+    ram[a] = (uint8_t)(sample & 0xff);
+    ram[a + 1] = (uint8_t)(sample >> 8);
+}
+
+void ReverbUnit::compute(uint8_t* ram, const bool& writes, const int32_t& in_left, const int32_t& in_right, int32_t& out_left,
+                     int32_t& out_right)
+{
+    // volumes are signed, addresses count 8 byte units and are turned into halfwords here
+    auto v = [this](const ReverbRegister& reg) { return (int32_t)(int16_t)this->registers[reg]; };
+    auto m = [this](const ReverbRegister& reg) { return (int32_t)this->registers[reg] * 4; };
+
+    int32_t lin = multiply(in_left, v(vLIN));
+    int32_t rin = multiply(in_right, v(vRIN));
+
+    if (writes)
+    {
+        // same side and different side reflections
+        int32_t l_same = multiply(lin + multiply(this->read(ram, m(dLSAME)), v(vWALL)) - this->read(ram, m(mLSAME) - 1), v(vIIR)) +
+                         this->read(ram, m(mLSAME) - 1);
+        int32_t r_same = multiply(rin + multiply(this->read(ram, m(dRSAME)), v(vWALL)) - this->read(ram, m(mRSAME) - 1), v(vIIR)) +
+                         this->read(ram, m(mRSAME) - 1);
+        int32_t l_diff = multiply(lin + multiply(this->read(ram, m(dRDIFF)), v(vWALL)) - this->read(ram, m(mLDIFF) - 1), v(vIIR)) +
+                         this->read(ram, m(mLDIFF) - 1);
+        int32_t r_diff = multiply(rin + multiply(this->read(ram, m(dLDIFF)), v(vWALL)) - this->read(ram, m(mRDIFF) - 1), v(vIIR)) +
+                         this->read(ram, m(mRDIFF) - 1);
+        this->write(ram, m(mLSAME), l_same);
+        this->write(ram, m(mRSAME), r_same);
+        this->write(ram, m(mLDIFF), l_diff);
+        this->write(ram, m(mRDIFF), r_diff);
+    }
+
+    // early echo
+    int32_t l = multiply(v(vCOMB1), this->read(ram, m(mLCOMB1))) + multiply(v(vCOMB2), this->read(ram, m(mLCOMB2))) +
+                multiply(v(vCOMB3), this->read(ram, m(mLCOMB3))) + multiply(v(vCOMB4), this->read(ram, m(mLCOMB4)));
+    int32_t r = multiply(v(vCOMB1), this->read(ram, m(mRCOMB1))) + multiply(v(vCOMB2), this->read(ram, m(mRCOMB2))) +
+                multiply(v(vCOMB3), this->read(ram, m(mRCOMB3))) + multiply(v(vCOMB4), this->read(ram, m(mRCOMB4)));
+
+    // two all-pass filters
+    const ReverbRegister stages[2][4] = {{mLAPF1, mRAPF1, dAPF1, vAPF1}, {mLAPF2, mRAPF2, dAPF2, vAPF2}};
+    for (const auto& stage : stages)
+    {
+        int32_t delay = m(stage[2]);
+        int32_t volume = v(stage[3]);
+        int32_t l_delayed = this->read(ram, m(stage[0]) - delay);
+        int32_t r_delayed = this->read(ram, m(stage[1]) - delay);
+        l = clamp16(l - multiply(volume, l_delayed));
+        r = clamp16(r - multiply(volume, r_delayed));
+        if (writes)
+        {
+            this->write(ram, m(stage[0]), l);
+            this->write(ram, m(stage[1]), r);
+        }
+        l = clamp16(multiply(l, volume) + l_delayed);
+        r = clamp16(multiply(r, volume) + r_delayed);
+    }
+    out_left = l;
+    out_right = r;
+
+    this->current = this->current + 1 < SPU_RAM_SIZE / 2 ? this->current + 1 : this->base_address;
+}
+
+void ReverbUnit::process(const int32_t* in_left, const int32_t* in_right, const uint32_t& samples, int32_t* out_left,
+                     int32_t* out_right, uint8_t* ram, const bool& writes)
+{
+    const int32_t* in[2] = {in_left, in_right};
+    int32_t* out[2] = {out_left, out_right};
+    for (int side = 0; side < 2; side++)
+    {
+        for (uint32_t i = 0; i < samples; i++)
+        {
+            this->input[side][REVERB_HISTORY + i] = (int16_t)clamp16(in[side][i]);
+        }
+    }
+
+    // every other sample goes through the reverb, the others are zeros in the output stream
+    int32_t down[2][MIX_BLOCK_SAMPLES];
+    bool odd = this->odd;
+    for (int side = 0; side < 2; side++)
+    {
+        for (uint32_t i = odd ? 0 : 1; i < samples; i += 2)
+        {
+            down[side][i] = clamp16(fir(&this->input[side][i]) >> 15);
+        }
+    }
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        int32_t wet[2] = {0, 0};
+        if (this->odd)
+        {
+            this->compute(ram, writes, down[0][i], down[1][i], wet[0], wet[1]);
+        }
+        this->output[0][REVERB_HISTORY + i] = (int16_t)wet[0];
+        this->output[1][REVERB_HISTORY + i] = (int16_t)wet[1];
+        this->odd = !this->odd;
+    }
+
+    for (int side = 0; side < 2; side++)
+    {
+        // half of the window are zeros, twice the gain
+        for (uint32_t i = 0; i < samples; i++)
+        {
+            out[side][i] = clamp16(fir(&this->output[side][i]) >> 14);
+        }
+        memmove(this->input[side], this->input[side] + samples, REVERB_HISTORY * sizeof(int16_t));
+        memmove(this->output[side], this->output[side] + samples, REVERB_HISTORY * sizeof(int16_t));
+    }
+}
+
+void ReverbUnit::serialize(Savestate& state)
+{
+    state.value(this->registers);
+    state.value(this->base_register);
+    state.value(this->base_address);
+    state.value(this->current);
+    state.value(this->odd);
+    state.value(this->input);
+    state.value(this->output);
+}
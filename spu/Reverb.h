@@ -0,0 +1,67 @@
+#ifndef REVERB_H
+#define REVERB_H
+
+#pragma once
+
+#include <stdint.h>
+#include "Mixer.h"
+
+class Savestate;
+
+// taps of the half-band filter between 44.1 and 22.05 kHz, padded to a multiple of 8 with a 0
+const uint32_t REVERB_FIR_TAPS = 39;
+const uint32_t REVERB_FIR_PADDED = 40;
+// samples kept from the previous block for the filter windows
+const uint32_t REVERB_HISTORY = REVERB_FIR_TAPS - 1;
+
+// reverb configuration registers at 0x1f801dc0, in order
+enum ReverbRegister
+{
+    dAPF1, dAPF2, vIIR, vCOMB1, vCOMB2, vCOMB3, vCOMB4, vWALL,
+    vAPF1, vAPF2, mLSAME, mRSAME, mLCOMB1, mRCOMB1, mLCOMB2, mRCOMB2,
+    dLSAME, dRSAME, mLDIFF, mRDIFF, mLCOMB3, mRCOMB3, mLCOMB4, mRCOMB4,
+    dLDIFF, dRDIFF, mLAPF1, mRAPF1, mLAPF2, mRAPF2, vLIN, vRIN,
+    ReverbRegisterCount
+};
+
+// The reverb unit: the input of the voices with reverb enabled is filtered down to 22.05 kHz,
+// run through the echo and all-pass stages, which read and write a ring buffer in SPU RAM
+// (the work area, from the base address to the end of RAM), and filtered back up to 44.1 kHz.
+// A mixed block is processed in three passes: the down-sampling filter for the whole block,
+// the reverb itself, which is sequential through SPU RAM, and the up-sampling filter.
+// The filters run 8 taps at a time with SSE2.
+// http://problemkaputt.de/psx-spx.htm#spureverbformula
+class ReverbUnit
+{
+public:
+    uint16_t registers[ReverbRegisterCount] = {};
+
+    // mBASE, work area start in 8 byte units
+    uint16_t base() const { return this->base_register; }
+    void set_base(const uint16_t& value);
+
+    // 'in' is the sum of the voices with reverb enabled, 'out' the reverb output before the
+    // output volume. 'writes' is the reverb master enable of SPUCNT, the work area is only
+    // written when it is set
+    void process(const int32_t* in_left, const int32_t* in_right, const uint32_t& samples, int32_t* out_left,
+                 int32_t* out_right, uint8_t* ram, const bool& writes);
+    void serialize(Savestate& state);
+
+private:
+    uint16_t base_register = 0;
+    uint32_t base_address = 0; // in halfwords, like current
+    uint32_t current = 0; // moves on by a halfword at every 22.05 kHz sample
+    bool odd = false; // the reverb runs at every other output sample
+
+    // 44.1 kHz input and zero-stuffed output, after the history of the previous block
+    int16_t input[2][REVERB_HISTORY + MIX_BLOCK_SAMPLES + 1] = {};
+    int16_t output[2][REVERB_HISTORY + MIX_BLOCK_SAMPLES + 1] = {};
+
+    uint32_t address(const int32_t& offset) const;
+    int32_t read(const uint8_t* ram, const int32_t& offset) const;
+    void write(uint8_t* ram, const int32_t& offset, const int32_t& value) const;
+    void compute(uint8_t* ram, const bool& writes, const int32_t& in_left, const int32_t& in_right, int32_t& out_left,
+                 int32_t& out_right);
+};
+
+#endif
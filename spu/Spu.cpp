@@ -1,12 +1,23 @@
 #include "Spu.h"
+#include "../state/Savestate.h"
 #include "../util/logging.h"
 #include "../util/bitops.h"
 #include <math.h>
+#include <algorithm>
+#include <cstring>
 #include <exception>
 
-Spunit::Spunit()
+Spunit::Spunit(Scheduler* scheduler)
 {
+    this->scheduler = scheduler;
+    this->kernel = select_mix_kernel();
+    this->mixed.reserve(SPU_CHUNK_SAMPLES * 2);
 
+    this->scheduler->setHandler(SpuEvent, [this]() {
+        this->sync();
+        this->scheduler->schedule(SpuEvent, SPU_CHUNK_SAMPLES * SPU_CYCLES_PER_SAMPLE);
+    });
+    this->scheduler->schedule(SpuEvent, SPU_CHUNK_SAMPLES * SPU_CYCLES_PER_SAMPLE);
 }
 
 Spunit::~Spunit()
@@ -16,6 +27,8 @@ Spunit::~Spunit()
 
 uint16_t Spunit::load16(const uint32_t &address)
 {
+    this->sync();
+
     // voice registers
     if (address >= 0x1f801c00 && address < 0x1f801d80)
     {
@@ -30,22 +43,100 @@ uint16_t Spunit::load16(const uint32_t &address)
         case 0x1f801daa:
             return this->spu_control_1;
             break;
+        case 0x1f801d80:
+            return this->master_volume_left;
+            break;
+        case 0x1f801d82:
+            return this->master_volume_right;
+            break;
+        case 0x1f801d84:
+            return this->reverb_depth_left;
+            break;
+        case 0x1f801d86:
+            return this->reverb_depth_right;
+            break;
+        // key on and off read back the last value written
         case 0x1f801d88:
-            return 0; // TODO write only, try to ignore for now
+            return (uint16_t)(this->key_on & 0xffff);
             break;
         case 0x1f801d8a:
-            return 0; // TODO write only, try to ignore for now
+            return (uint16_t)(this->key_on >> 16);
             break;
         case 0x1f801d8c:
-            return 0; // TODO write only, try to ignore for now
+            return (uint16_t)(this->key_off & 0xffff);
             break;
         case 0x1f801d8e:
-            return 0; // TODO write only, try to ignore for now
+            return (uint16_t)(this->key_off >> 16);
+            break;
+        case 0x1f801d90:
+            return (uint16_t)(this->fm_voices & 0xffff);
+            break;
+        case 0x1f801d92:
+            return (uint16_t)(this->fm_voices >> 16);
+            break;
+        case 0x1f801d94:
+            return (uint16_t)(this->noise_voices & 0xffff);
+            break;
+        case 0x1f801d96:
+            return (uint16_t)(this->noise_voices >> 16);
+            break;
+        case 0x1f801d98:
+            return (uint16_t)(this->reverb_voices & 0xffff);
+            break;
+        case 0x1f801d9a:
+            return (uint16_t)(this->reverb_voices >> 16);
+            break;
+        case 0x1f801da0:
+            return this->unknown_da0;
+            break;
+        case 0x1f801da4:
+            return this->irq_address;
+            break;
+        case 0x1f801db0:
+            return this->cd_vol_left;
+            break;
+        case 0x1f801db2:
+            return this->cd_vol_right;
+            break;
+        case 0x1f801db4:
+            return this->ext_vol_left;
+            break;
+        case 0x1f801db6:
+            return this->ext_vol_right;
+            break;
+        // the main volume as it currently is, while sweeping
+        case 0x1f801db8:
+            return (uint16_t)this->master_sweep_left.level;
+            break;
+        case 0x1f801dba:
+            return (uint16_t)this->master_sweep_right.level;
+            break;
+        case 0x1f801dbc:
+            return this->unknown_dbc[0];
+            break;
+        case 0x1f801dbe:
+            return this->unknown_dbc[1];
             break;
         case 0x1f801dac:
             return this->spu_control_2;
             break;
+        case 0x1f801da6:
+            return this->spu_mem_addr;
+            break;
+        case 0x1f801d9c:
+            return (uint16_t)(this->end_flags() & 0xffff);
+            break;
+        case 0x1f801d9e:
+            return (uint16_t)(this->end_flags() >> 16);
+            break;
+        case 0x1f801da2:
+            return this->reverb.base();
+            break;
         default:
+            if (address >= REVERB_REGISTERS && address < REVERB_REGISTERS + 2 * ReverbRegisterCount)
+            {
+                return this->reverb.registers[(address - REVERB_REGISTERS) / 2];
+            }
             break; 
     }    
     DEBUG("STUB:Unhandled_read_from_SPU_register:0x" << std::hex << address);
@@ -59,34 +150,35 @@ uint16_t Spunit::read_from_voice_channel_register(const uint32_t& address)
 
     uint32_t channel_reg_offset = (address - 0x1f801c00);
 
-    uint32_t channel    = std::floor(channel_reg_offset / (16 * 8));
-    uint32_t target_reg = std::floor((channel_reg_offset - channel*(16 * 8)) / 16);
+    // 16 bytes per voice, 8 halfword registers
+    uint32_t channel    = channel_reg_offset / 16;
+    uint32_t target_reg = (channel_reg_offset % 16) / 2;
     
     switch(target_reg) 
     {
         case 0:
-            return this->channels[channel]->volume_left;
+            return this->channels[channel].volume_left;
             break;
         case 1:
-            return this->channels[channel]->volume_right;
+            return this->channels[channel].volume_right;
             break;
         case 2:
-            return this->channels[channel]->frequency;
+            return this->channels[channel].frequency;
             break;
         case 3:
-            return this->channels[channel]->startaddr_sound;
+            return this->channels[channel].startaddr_sound;
             break;
         case 4:
-            return this->channels[channel]->attack_rate;
+            return this->channels[channel].attack_rate;
             break;
         case 5:
-            return this->channels[channel]->adsr_2;
+            return this->channels[channel].adsr_2;
             break;
         case 6:
-            return this->channels[channel]->adsr_volume;
+            return this->channels[channel].adsr_volume;
             break;
         case 7:
-            return this->channels[channel]->current_repeat_addr;
+            return this->channels[channel].current_repeat_addr;
             break;
         default:
             DEBUG("Invalid_target_SPU_channel_register:" << std::dec << target_reg);
@@ -101,8 +193,9 @@ void Spunit::store_to_voice_channel_register(const uint32_t& address, const uint
 
     uint32_t channel_reg_offset = (address - 0x1f801c00);
 
-    uint32_t channel    = std::floor(channel_reg_offset / (16 * 8));
-    uint32_t target_reg = std::floor((channel_reg_offset - channel*(16 * 8)) / 16);
+    // 16 bytes per voice, 8 halfword registers
+    uint32_t channel    = channel_reg_offset / 16;
+    uint32_t target_reg = (channel_reg_offset % 16) / 2;
     
     // DEBUG("address: " << std::dec << address);
     // DEBUG("offset: " << std::dec << channel_reg_offset);
@@ -112,28 +205,28 @@ void Spunit::store_to_voice_channel_register(const uint32_t& address, const uint
     switch(target_reg) 
     {
         case 0:
-            this->channels[channel]->volume_left = value;
+            this->channels[channel].volume_left = value;
             break;
         case 1:
-            this->channels[channel]->volume_right = value;
+            this->channels[channel].volume_right = value;
             break;
         case 2:
-            this->channels[channel]->frequency = value;
+            this->channels[channel].frequency = value;
             break;
         case 3:
-            this->channels[channel]->startaddr_sound = value;
+            this->channels[channel].startaddr_sound = value;
             break;
         case 4:
-            this->channels[channel]->attack_rate = value;
+            this->channels[channel].attack_rate = value;
             break;
         case 5:
-            this->channels[channel]->adsr_2 = value;
+            this->channels[channel].adsr_2 = value;
             break;
         case 6:
-            this->channels[channel]->adsr_volume = value;
+            this->channels[channel].adsr_volume = value;
             break;
         case 7:
-            this->channels[channel]->current_repeat_addr = value;
+            this->channels[channel].current_repeat_addr = value;
             break;
         default:
             DEBUG("Invalid_target_SPU_channel_register:" << std::dec << target_reg);
@@ -144,6 +237,9 @@ void Spunit::store_to_voice_channel_register(const uint32_t& address, const uint
 
 void Spunit::store16(const uint32_t &address, const uint16_t &value)
 {
+    // the samples before the write are mixed with the old values
+    this->sync();
+
     // voice registers
     if (address >= 0x1f801c00 && address < 0x1f801d80)
     {
@@ -167,51 +263,69 @@ void Spunit::store16(const uint32_t &address, const uint16_t &value)
             this->reverb_depth_right = value;
             return; break;
         case 0x1f801d8c:
-            // left word of stop sound play
-            this->stop_sound_play((((uint32_t)(value)) & 0x0000ffffu) << 16u);
+            // voices 0-15 of stop sound play
+            this->key_off = (this->key_off & 0xffff0000u) | value;
+            this->stop_sound_play((((uint32_t)(value)) & 0x0000ffffu));
             return; break;
         case 0x1f801d8e:
-            // right word of stop sound play
-            this->stop_sound_play((((uint32_t)(value)) & 0x0000ffffu));
+            // voices 16-23 of stop sound play
+            this->key_off = (this->key_off & 0xffffu) | (((uint32_t)value & 0xffu) << 16u);
+            this->stop_sound_play((((uint32_t)(value)) & 0x0000ffffu) << 16u);
             return; break;
         case 0x1f801d88:
-            this->start_sound_play((((uint32_t)(value)) & 0x0000ffffu) << 16u);
+            this->key_on = (this->key_on & 0xffff0000u) | value;
+            this->start_sound_play(((uint32_t)(value)) & 0x0000ffffu);
             return; break;
         case 0x1f801d8a:
-            this->start_sound_play(((uint32_t)(value)) & 0x0000ffffu);
+            this->key_on = (this->key_on & 0xffffu) | (((uint32_t)value & 0xffu) << 16u);
+            this->start_sound_play((((uint32_t)(value)) & 0x0000ffffu) << 16u);
             return; break;
         case 0x1f801d90:
-            // left word of set channel mode to FM
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::FM);
+            // voices 0-15 of set channel mode to FM
+            this->fm_voices = (this->fm_voices & 0xffff0000u) | value;
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::FM);
             return; break;
         case 0x1f801d92:
-            // right word of set channel mode to FM
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::FM);
+            // voices 16-23 of set channel mode to FM
+            this->fm_voices = (this->fm_voices & 0xffffu) | (((uint32_t)value & 0xffu) << 16u);
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::FM);
             return; break;
         case 0x1f801d94:
-            // left word of set channel mode to noise gen
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::NoiseGenerator);
+            // voices 0-15 of set channel mode to noise gen
+            this->noise_voices = (this->noise_voices & 0xffff0000u) | value;
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::NoiseGenerator);
             return; break;
         case 0x1f801d96:
-            // right word of set channel mode to noise gen
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::NoiseGenerator);
+            // voices 16-23 of set channel mode to noise gen
+            this->noise_voices = (this->noise_voices & 0xffffu) | (((uint32_t)value & 0xffu) << 16u);
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::NoiseGenerator);
             return; break;
         case 0x1f801d98:
-            // left word of set channel mode to reverb
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::Reverb);
+            // voices 0-15 of set channel mode to reverb
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::Reverb);
+            this->reverb_voices = (this->reverb_voices & 0xffff0000u) | value;
             return; break;
         case 0x1f801d9a:
-            // right word of set channel mode to reverb
-            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu), ChannelMode::Reverb);
+            // voices 16-23 of set channel mode to reverb
+            this->set_channel_mode((((uint32_t)(value)) & 0x0000ffffu) << 16u, ChannelMode::Reverb);
+            this->reverb_voices = (this->reverb_voices & 0xffffu) | (((uint32_t)value & 0xffu) << 16u);
+            return; break;
+        case 0x1f801da0:
+            this->unknown_da0 = value;
             return; break;
         case 0x1f801da2:
-            DEBUG("STUB:write_to_SPU_start_addr_reverb_buffer")
+            this->reverb.set_base(value);
+            return; break;
+        case 0x1f801da4:
+            this->irq_address = value;
             return; break;
         case 0x1f801da6:
             this->spu_mem_addr = value;
+            this->transfer_address = (value * 8u) & SPU_RAM_MASK;
             return; break;
         case 0x1f801da8:
             this->data_to_spu = value;
+            this->write_data(value);
             return; break;
         case 0x1f801daa:
             this->set_spu_control_1(value);
@@ -234,11 +348,22 @@ void Spunit::store16(const uint32_t &address, const uint16_t &value)
         case 0x1f801db6:
             this->ext_vol_right = value;
             return; break;
+        case 0x1f801db8:
+            this->master_sweep_left.level = (int16_t)value;
+            return; break;
+        case 0x1f801dba:
+            this->master_sweep_right.level = (int16_t)value;
+            return; break;
+        case 0x1f801dbc:
+            this->unknown_dbc[0] = value;
+            return; break;
+        case 0x1f801dbe:
+            this->unknown_dbc[1] = value;
+            return; break;
         default:
-            // Reverb Registers
-            if (address >= 0x1f801d84 && address <= 0x1f801dfe)
+            if (address >= REVERB_REGISTERS && address < REVERB_REGISTERS + 2 * ReverbRegisterCount)
             {
-                DEBUG("STUB:write_to_SPU_reverb_register");
+                this->reverb.registers[(address - REVERB_REGISTERS) / 2] = value;
                 return; break;
             }
             break;
@@ -251,15 +376,31 @@ void Spunit::store16(const uint32_t &address, const uint16_t &value)
 void Spunit::set_spu_control_1(const uint16_t& value)
 {
     // Set SPU control register 1
-    // TODO: parse values into members
     this->spu_control_1 = value;
+    auto mode = (SpuTransferMode)((value >> 4) & 3);
+    if (mode == TransferManualWrite)
+    {
+        this->flush_fifo();
+    }
+    // the status mirrors the mode bits, and asks for DMA in the DMA modes. Transfers complete
+    // at once, the busy flag is never set
+    uint16_t status = (this->spu_status & ~0x03bfu) | (value & 0x3f);
+    if (mode == TransferDmaWrite)
+    {
+        status |= 0x0180;
+    }
+    else if (mode == TransferDmaRead)
+    {
+        status |= 0x0280;
+    }
+    this->spu_status = status;
 }
 
 void Spunit::set_spu_control_2(const uint16_t& value)
 {
     // Set SPU control register 2
     // TODO: parse values into members
-    this->spu_control_1 = value;
+    this->spu_control_2 = value;
 }
 
 void Spunit::set_spu_status(const uint16_t& value)
@@ -277,7 +418,7 @@ void Spunit::start_sound_play(const uint32_t& value)
         // if bit is set, 
         if (CHECK_BIT_FROM_RIGHT(value, i)) 
         {
-            this->channels[i]->start_play();
+            this->channels[i].start_play();
         }
     }
 }
@@ -290,11 +431,80 @@ void Spunit::stop_sound_play(const uint32_t& value)
         // if bit is set, 
         if (CHECK_BIT_FROM_RIGHT(value, i)) 
         {
-            this->channels[i]->stop_play();
+            this->channels[i].stop_play();
         }
     }
 }
 
+void Spunit::write_data(const uint16_t& value)
+{
+    // manual transfer, the FIFO goes to the transfer address when SPUCNT starts it
+    if (this->fifo_size == SPU_FIFO_SIZE)
+    {
+        DEBUG("SPU_transfer_FIFO_full,_halfword_dropped");
+        return;
+    }
+    this->fifo[this->fifo_size++] = value;
+    // a transfer that is already running takes the new data right away
+    if (((this->spu_control_1 >> 4) & 3) == TransferManualWrite)
+    {
+        this->flush_fifo();
+    }
+}
+
+void Spunit::flush_fifo()
+{
+    for (uint32_t i = 0; i < this->fifo_size; i++)
+    {
+        this->ram[this->transfer_address] = (uint8_t)(this->fifo[i] & 0xff);
+        this->ram[this->transfer_address + 1] = (uint8_t)(this->fifo[i] >> 8);
+        this->transfer_address = (this->transfer_address + 2) & SPU_RAM_MASK;
+    }
+    this->fifo_size = 0;
+}
+
+void Spunit::dma_write(const uint8_t* source, const uint32_t& size)
+{
+    // the voices have to play what was in sound RAM before the transfer
+    this->sync();
+    // at most two runs, the transfer address wraps at the end of sound RAM
+    uint32_t done = 0;
+    while (done < size)
+    {
+        auto n = std::min(size - done, SPU_RAM_SIZE - this->transfer_address);
+        memcpy(&this->ram[this->transfer_address], source + done, n);
+        this->transfer_address = (this->transfer_address + n) & SPU_RAM_MASK;
+        done += n;
+    }
+}
+
+void Spunit::dma_read(uint8_t* destination, const uint32_t& size)
+{
+    // the reverb may still write the work area before the transfer
+    this->sync();
+    uint32_t done = 0;
+    while (done < size)
+    {
+        auto n = std::min(size - done, SPU_RAM_SIZE - this->transfer_address);
+        memcpy(destination + done, &this->ram[this->transfer_address], n);
+        this->transfer_address = (this->transfer_address + n) & SPU_RAM_MASK;
+        done += n;
+    }
+}
+
+uint32_t Spunit::end_flags() const
+{
+    uint32_t flags = 0;
+    for (int i=0; i<24; ++i)
+    {
+        if (this->channels[i].end_reached)
+        {
+            flags |= 1u << i;
+        }
+    }
+    return flags;
+}
+
 void Spunit::set_channel_mode(const uint32_t& value, const ChannelMode& mode)
 {
     // Get which channel out of the 24
@@ -303,7 +513,164 @@ void Spunit::set_channel_mode(const uint32_t& value, const ChannelMode& mode)
         // if bit is set, 
         if (CHECK_BIT_FROM_RIGHT(value, i)) 
         {
-            this->channels[i]->mode = mode;
+            this->channels[i].mode = mode;
+        }
+    }
+}
+
+void Spunit::sync()
+{
+    auto cycles = this->scheduler->cycles;
+    if (cycles < this->sync_cycle + SPU_CYCLES_PER_SAMPLE)
+    {
+        return;
+    }
+    auto samples = (cycles - this->sync_cycle) / SPU_CYCLES_PER_SAMPLE;
+    this->sync_cycle += samples * SPU_CYCLES_PER_SAMPLE;
+    this->mix((uint32_t)samples);
+}
+
+void Spunit::mix(const uint32_t& samples)
+{
+    // registers do not change during a sync, the playing voices are put in lanes once
+    auto& block = this->mix_block;
+    uint32_t voices[SPU_VOICES];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < SPU_VOICES; i++)
+    {
+        if (this->channels[i].playing())
+        {
+            voices[count++] = i;
+        }
+    }
+    block.lanes = (count + MIX_LANE_GROUP - 1) & ~(MIX_LANE_GROUP - 1);
+    for (uint32_t lane = 0; lane < block.lanes; lane++)
+    {
+        bool used = lane < count;
+        block.volume_left[lane] = 0;
+        block.volume_right[lane] = 0;
+        block.reverb[lane] = used && (this->reverb_voices & (1u << voices[lane])) ? -1 : 0;
+        for (uint32_t s = 0; !used && s < MIX_BLOCK_SAMPLES; s++)
+        {
+            block.envelope[s][lane] = 0;
+        }
+    }
+    // SPU enabled and unmuted
+    bool audible = (this->spu_control_1 & 0xc000) == 0xc000;
+    bool reverb_writes = this->spu_control_1 & 0x80; // reverb master enable
+    int32_t reverb_volume_left = (int16_t)this->reverb_depth_left;
+    int32_t reverb_volume_right = (int16_t)this->reverb_depth_right;
+
+    this->mixed.resize((size_t)samples * 2);
+    auto ram = this->ram.data();
+    MixOutput sums;
+    int32_t wet_left[MIX_BLOCK_SAMPLES] = {}, wet_right[MIX_BLOCK_SAMPLES] = {};
+    for (uint32_t done = 0; done < samples; done += MIX_BLOCK_SAMPLES)
+    {
+        auto n = std::min(MIX_BLOCK_SAMPLES, samples - done);
+        // volume sweeps run whether the voice plays or not, stepped once per block
+        int32_t volumes[SPU_VOICES][2];
+        for (uint32_t i = 0; i < SPU_VOICES; i++)
+        {
+            auto& channel = this->channels[i];
+            volumes[i][0] = channel.sweep_left.advance(channel.volume_left, n);
+            volumes[i][1] = channel.sweep_right.advance(channel.volume_right, n);
         }
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            block.volume_left[lane] = volumes[voices[lane]][0];
+            block.volume_right[lane] = volumes[voices[lane]][1];
+        }
+        int32_t master_left = this->master_sweep_left.advance(this->master_volume_left, n);
+        int32_t master_right = this->master_sweep_right.advance(this->master_volume_right, n);
+        // gather the envelope and the interpolation taps voice by voice, this is where blocks
+        // get decoded
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            auto& channel = this->channels[voices[lane]];
+            channel.render_envelope(&block.envelope[0][lane], MIX_LANES, n);
+            for (uint32_t s = 0; s < n; s++)
+            {
+                if (!channel.playing())
+                {
+                    for (int tap = 0; tap < 4; tap++)
+                    {
+                        block.taps[s][tap][lane] = 0;
+                    }
+                    continue;
+                }
+                channel.decode_block(ram);
+                auto taps = channel.taps();
+                auto phase = (channel.pitch_counter >> 4) & 0xff;
+                for (int tap = 0; tap < 4; tap++)
+                {
+                    block.taps[s][tap][lane] = taps[tap];
+                }
+                block.weights[s][0][lane] = GAUSS_TABLE[0xff - phase];
+                block.weights[s][1][lane] = GAUSS_TABLE[0x1ff - phase];
+                block.weights[s][2][lane] = GAUSS_TABLE[0x100 + phase];
+                block.weights[s][3][lane] = GAUSS_TABLE[phase];
+                channel.advance(channel.frequency);
+            }
+            channel.end_block();
+        }
+        this->kernel(block, n, sums);
+        if (this->reverb_enabled)
+        {
+            this->reverb.process(sums.reverb_left, sums.reverb_right, n, wet_left, wet_right, ram, reverb_writes);
+        }
+
+        auto out = this->mixed.data() + (size_t)done * 2;
+        for (uint32_t s = 0; s < n; s++)
+        {
+            int32_t l = std::clamp(sums.left[s], -0x8000, 0x7fff) + ((wet_left[s] * reverb_volume_left) >> 15);
+            int32_t r = std::clamp(sums.right[s], -0x8000, 0x7fff) + ((wet_right[s] * reverb_volume_right) >> 15);
+            l = std::clamp(l, -0x8000, 0x7fff);
+            r = std::clamp(r, -0x8000, 0x7fff);
+            out[s * 2] = audible ? (int16_t)((l * master_left) >> 15) : 0;
+            out[s * 2 + 1] = audible ? (int16_t)((r * master_right) >> 15) : 0;
+        }
+    }
+    if (this->output)
+    {
+        this->output(this->mixed.data(), samples);
+    }
+}
+
+void Spunit::serialize(Savestate& state)
+{
+    state.section("SPU ");
+    for (auto& channel : this->channels)
+    {
+        channel.serialize(state);
     }
+    state.value(this->master_volume_left);
+    state.value(this->master_volume_right);
+    state.value(this->master_sweep_left);
+    state.value(this->master_sweep_right);
+    state.value(this->reverb_depth_left);
+    state.value(this->reverb_depth_right);
+    state.value(this->spu_mem_addr);
+    state.value(this->transfer_address);
+    state.value(this->sync_cycle);
+    state.value(this->reverb_voices);
+    state.value(this->key_on);
+    state.value(this->key_off);
+    state.value(this->fm_voices);
+    state.value(this->noise_voices);
+    state.value(this->irq_address);
+    state.value(this->unknown_da0);
+    state.bytes(this->unknown_dbc, sizeof(this->unknown_dbc));
+    this->reverb.serialize(state);
+    state.value(this->data_to_spu);
+    state.bytes(this->fifo, sizeof(this->fifo));
+    state.value(this->fifo_size);
+    state.value(this->spu_control_1);
+    state.value(this->spu_control_2);
+    state.value(this->spu_status);
+    state.value(this->cd_vol_left);
+    state.value(this->cd_vol_right);
+    state.value(this->ext_vol_left);
+    state.value(this->ext_vol_right);
+    state.bytes(this->ram.data(), this->ram.size());
 }
@@ -4,30 +4,78 @@
 #pragma once
 
 #include <stdint.h>
+#include <functional>
+#include <vector>
+#include "../bus/Scheduler.h"
 #include "../memory/Range.h"
 #include "../util/logging.h"
+#include "Mixer.h"
+#include "Reverb.h"
 #include "VoiceChannel.h"
 
-struct VAGSample {
-    unsigned char pack_info;
-    unsigned char flags;
-    unsigned char packed[14];
+class Savestate;
+
+const uint32_t SPU_RAM_SIZE = 512 * 1024;
+const uint32_t SPU_RAM_MASK = SPU_RAM_SIZE - 1;
+const uint32_t SPU_SAMPLE_RATE = 44100;
+const uint64_t SPU_CYCLES_PER_SAMPLE = 768; // CPU clock / 44100
+// samples mixed at every SpuEvent, about a frame. Register accesses mix whatever is due before them
+const uint32_t SPU_CHUNK_SAMPLES = 735;
+
+const uint32_t REVERB_REGISTERS = 0x1f801dc0;
+// halfwords written to 0x1f801da8 wait here until SPUCNT starts a manual transfer
+const uint32_t SPU_FIFO_SIZE = 32;
+
+// SPUCNT bits 4-5
+enum SpuTransferMode
+{
+    TransferStop = 0,
+    TransferManualWrite = 1,
+    TransferDmaWrite = 2,
+    TransferDmaRead = 3
 };
 
+// receives the mixed output, 'count' interleaved stereo frames
+typedef std::function<void(const int16_t* frames, const uint32_t& count)> SpuOutput;
+
 class Spunit
 {
 public:
     const uint32_t START_ADDRESS = 0x1f801c00;
     const uint16_t SIZE = 640;
 
-    Spunit(); 
+    explicit Spunit(Scheduler* scheduler);
     ~Spunit();
 
     Range range = Range(START_ADDRESS, SIZE);
 
     void store16(const uint32_t &address, const uint16_t &value);
     uint16_t load16(const uint32_t &address);
+    void serialize(Savestate& state);
+
+    // sound RAM: ADPCM samples, the reverb work area and the capture buffers
+    std::vector<uint8_t> ram = std::vector<uint8_t>(SPU_RAM_SIZE);
+    // not part of the machine state, the output is dropped if there is none
+    SpuOutput output;
+    // the reverb unit is skipped entirely when off, for throughput benchmarks
+    bool reverb_enabled = true;
+
+    // mix every sample due up to the current cycle
+    void sync();
+    // DMA channel 4, 'size' bytes to or from sound RAM at the transfer address
+    void dma_write(const uint8_t* source, const uint32_t& size);
+    void dma_read(uint8_t* destination, const uint32_t& size);
 private:
+    Scheduler* scheduler;
+    uint64_t sync_cycle = 0; // the samples before this cycle are mixed
+    MixKernel kernel;
+    MixBlock mix_block = {};
+    std::vector<int16_t> mixed; // interleaved output of a sync
+    ReverbUnit reverb;
+    uint32_t reverb_voices = 0; // EON, 0x1f801d98
+
+    void mix(const uint32_t& samples);
+
     uint16_t read_from_voice_channel_register(const uint32_t& address);
     void store_to_voice_channel_register(const uint32_t& address, const uint16_t& value);
 
@@ -37,41 +85,54 @@ private:
     void set_spu_control_2(const uint16_t& value);
     void set_spu_status(const uint16_t& value);
     void set_channel_mode(const uint32_t& value, const ChannelMode& mode);
+    void write_data(const uint16_t& value);
+    void flush_fifo();
+    uint32_t end_flags() const;
     
     // registers
-    VoiceChannel* channels[24] = { // 0x1f801c00 to 0x1f801d80
-        new VoiceChannel(0),
-        new VoiceChannel(1),
-        new VoiceChannel(2),
-        new VoiceChannel(3),
-        new VoiceChannel(4),
-        new VoiceChannel(5),
-        new VoiceChannel(6),
-        new VoiceChannel(7),
-        new VoiceChannel(8),
-        new VoiceChannel(9),
-        new VoiceChannel(10),
-        new VoiceChannel(11),
-        new VoiceChannel(12),
-        new VoiceChannel(13),
-        new VoiceChannel(14),
-        new VoiceChannel(15),
-        new VoiceChannel(16),
-        new VoiceChannel(17),
-        new VoiceChannel(18),
-        new VoiceChannel(19),
-        new VoiceChannel(20),
-        new VoiceChannel(21),
-        new VoiceChannel(22),
-        new VoiceChannel(23)
+    VoiceChannel channels[24] = { // 0x1f801c00 to 0x1f801d80
+        VoiceChannel(0),
+        VoiceChannel(1),
+        VoiceChannel(2),
+        VoiceChannel(3),
+        VoiceChannel(4),
+        VoiceChannel(5),
+        VoiceChannel(6),
+        VoiceChannel(7),
+        VoiceChannel(8),
+        VoiceChannel(9),
+        VoiceChannel(10),
+        VoiceChannel(11),
+        VoiceChannel(12),
+        VoiceChannel(13),
+        VoiceChannel(14),
+        VoiceChannel(15),
+        VoiceChannel(16),
+        VoiceChannel(17),
+        VoiceChannel(18),
+        VoiceChannel(19),
+        VoiceChannel(20),
+        VoiceChannel(21),
+        VoiceChannel(22),
+        VoiceChannel(23)
     }; 
     uint16_t master_volume_left  = 0; // 0x1f801d80
     uint16_t master_volume_right = 0; // 0x1f801d82
+    VolumeSweep master_sweep_left;
+    VolumeSweep master_sweep_right;
     uint16_t reverb_depth_left   = 0; // 0x1f801d84
     uint16_t reverb_depth_right  = 0; // 0x1f801d86
-    // 0x1f801d8c (2 x 16bit registers, stop sound play, Write only
+    uint32_t key_on              = 0; // 0x1f801d88, last value written
+    uint32_t key_off             = 0; // 0x1f801d8c, last value written
+    uint32_t fm_voices           = 0; // PMON, 0x1f801d90
+    uint32_t noise_voices        = 0; // NON, 0x1f801d94
+    uint16_t unknown_da0         = 0; // 0x1f801da0
+    uint16_t irq_address         = 0; // 0x1f801da4, in units of 8 bytes
     uint16_t spu_mem_addr        = 0; // 0x1f801da6
+    uint32_t transfer_address    = 0; // in bytes, starts at spu_mem_addr * 8 and moves on with every transfer
     uint16_t data_to_spu         = 0; // 0x1f801da8
+    uint16_t fifo[SPU_FIFO_SIZE]  = {};
+    uint32_t fifo_size           = 0;
     uint16_t spu_control_1       = 0; // 0x1f801daa
     uint16_t spu_control_2       = 0; // 0x1f801dac
     uint16_t spu_status          = 0; // 0x1f801dae
@@ -79,6 +140,7 @@ private:
     uint16_t cd_vol_right        = 0; // 0x1f801db2
     uint16_t ext_vol_left        = 0; // 0x1f801db4
     uint16_t ext_vol_right       = 0; // 0x1f801db6
+    uint16_t unknown_dbc[2]      = {}; // 0x1f801dbc
 };
 
 #endif
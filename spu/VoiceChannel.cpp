@@ -1,17 +1,240 @@
 #include "VoiceChannel.h"
+#include "Spu.h"
+#include "../state/Savestate.h"
 #include "../util/logging.h"
+#include <algorithm>
+#include <cstring>
+
+// address registers count 8 byte units, blocks are 16 byte aligned
+static uint32_t block_address(const uint16_t& reg)
+{
+    return (reg * 8u) & SPU_RAM_MASK & ~(ADPCM_BLOCK_SIZE - 1);
+}
 
 void VoiceChannel::stop_play() 
 {
     // For a full ADSR pattern, OFF would be usually issued 
     // in the Sustain period, however, it can be issued 
     // at any time (eg. to abort Attack, skip the Decay and Sustain periods, and switch immediately to Release)
-    DEBUG("STUB:stop_play_on_voice:" << this->voice_number);
+    this->key_off = true;
+    if (this->envelope_phase != AdsrOff)
+    {
+        this->start_envelope_phase(AdsrRelease);
+    }
 }
 
 void VoiceChannel::start_play() 
 {
-    // TODO: Starts the ADSR Envelope, and automatically initializes ADSR Volume to zero, 
-    // TODO: and copies Voice Start Address to Voice Repeat Address
-    DEBUG("STUB:start_play_on_voice:" << this->voice_number);
-}
\ No newline at end of file
+    // Starts the ADSR Envelope, and automatically initializes ADSR Volume to zero, 
+    // and copies Voice Start Address to Voice Repeat Address
+    this->key_on = true;
+    this->key_off = false;
+    this->status = true;
+    this->adsr_volume = 0;
+    this->start_envelope_phase(AdsrAttack);
+    this->current_repeat_addr = this->startaddr_sound;
+    this->current_address = block_address(this->startaddr_sound);
+    this->pitch_counter = 0;
+    this->end_reached = false;
+    this->block_decoded = false;
+    this->adpcm_old = 0;
+    this->adpcm_older = 0;
+    memset(this->samples, 0, sizeof(this->samples));
+}
+
+void VoiceChannel::decode_next_block(const uint8_t* ram)
+{
+    const auto& block = *(const VAGSample*)(ram + this->current_address);
+    this->block_flags = block.flags;
+    if (block.flags & ADPCM_LOOP_START)
+    {
+        this->current_repeat_addr = (uint16_t)(this->current_address / 8);
+    }
+    // keep the end of the previous block for the interpolation
+    memcpy(this->samples, this->samples + ADPCM_BLOCK_SAMPLES, 3 * sizeof(int16_t));
+    decode_adpcm_block(block, this->samples + 3, this->adpcm_old, this->adpcm_older);
+    this->block_decoded = true;
+}
+
+void VoiceChannel::advance(const uint32_t& pitch)
+{
+    // at most 4 samples per step, a block is never skipped
+    this->pitch_counter += std::min<uint32_t>(pitch, 0x4000);
+    if ((this->pitch_counter >> 12) < ADPCM_BLOCK_SAMPLES)
+    {
+        return;
+    }
+    this->pitch_counter -= ADPCM_BLOCK_SAMPLES << 12;
+    this->block_decoded = false;
+    if (this->block_flags & ADPCM_LOOP_END)
+    {
+        this->end_reached = true;
+        this->current_address = block_address(this->current_repeat_addr);
+        if (!(this->block_flags & ADPCM_LOOP_REPEAT))
+        {
+            // the voice is muted at once, without going through the release
+            this->adsr_volume = 0;
+            this->envelope_phase = AdsrOff;
+            this->envelope_wait = ADSR_NEVER;
+            this->status = false;
+        }
+        return;
+    }
+    this->current_address = (this->current_address + ADPCM_BLOCK_SIZE) & SPU_RAM_MASK;
+}
+
+void VoiceChannel::envelope_rate(uint32_t& rate, bool& exponential, bool& decrease) const
+{
+    // ADSR register 1 (attack_rate): attack mode, shift and step in bits 15-8, decay shift in
+    // bits 7-4, sustain level in bits 3-0. Register 2: sustain mode, direction, shift and step
+    // in bits 15-6, release mode and shift in bits 5-0
+    switch (this->envelope_phase)
+    {
+        case AdsrAttack:
+            rate = (this->attack_rate >> 8) & 0x7f;
+            exponential = this->attack_rate & 0x8000;
+            decrease = false;
+            break;
+        case AdsrDecay:
+            rate = ((this->attack_rate >> 4) & 0xf) << 2;
+            exponential = true;
+            decrease = true;
+            break;
+        case AdsrSustain:
+            rate = (this->adsr_2 >> 6) & 0x7f;
+            exponential = this->adsr_2 & 0x8000;
+            decrease = this->adsr_2 & 0x4000;
+            break;
+        default:
+            rate = (this->adsr_2 & 0x1f) << 2;
+            exponential = this->adsr_2 & 0x20;
+            decrease = true;
+            break;
+    }
+}
+
+void VoiceChannel::start_envelope_phase(const AdsrPhase& phase)
+{
+    this->envelope_phase = phase;
+    int32_t sustain_level = ((this->attack_rate & 0xf) + 1) * 0x800;
+    if (this->envelope_phase == AdsrDecay && this->adsr_volume <= sustain_level)
+    {
+        this->envelope_phase = AdsrSustain;
+    }
+    this->schedule_envelope_step();
+}
+
+void VoiceChannel::schedule_envelope_step()
+{
+    uint32_t rate;
+    bool exponential, decrease;
+    this->envelope_rate(rate, exponential, decrease);
+    int32_t level = this->adsr_volume;
+    // the slowest rate never steps, neither does a sustain that reached its end
+    bool saturated = this->envelope_phase == AdsrSustain && (decrease ? level == 0 : level == ADSR_MAX_LEVEL);
+    if (this->envelope_phase == AdsrOff || rate == 0x7f || saturated)
+    {
+        this->envelope_wait = ADSR_NEVER;
+        return;
+    }
+    uint32_t cycles = (decrease ? ADSR_DECREASE : ADSR_INCREASE)[rate].cycles;
+    if (exponential && !decrease && level > 0x6000)
+    {
+        cycles *= 4; // exponential increase slows down near the top
+    }
+    this->envelope_wait = cycles;
+}
+
+void VoiceChannel::envelope_step()
+{
+    uint32_t rate;
+    bool exponential, decrease;
+    this->envelope_rate(rate, exponential, decrease);
+    int32_t level = this->adsr_volume;
+    int32_t step = (decrease ? ADSR_DECREASE : ADSR_INCREASE)[rate].step;
+    if (exponential && decrease)
+    {
+        step = (step * level) >> 15; // exponential decrease is proportional to the level
+    }
+    level = std::clamp(level + step, 0, ADSR_MAX_LEVEL);
+    this->adsr_volume = (uint16_t)level;
+
+    switch (this->envelope_phase)
+    {
+        case AdsrAttack:
+            if (level == ADSR_MAX_LEVEL)
+            {
+                this->start_envelope_phase(AdsrDecay);
+                return;
+            }
+            break;
+        case AdsrDecay:
+            if (level <= ((this->attack_rate & 0xf) + 1) * 0x800)
+            {
+                this->start_envelope_phase(AdsrSustain);
+                return;
+            }
+            break;
+        case AdsrRelease:
+            if (level == 0)
+            {
+                this->start_envelope_phase(AdsrOff);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    this->schedule_envelope_step();
+}
+
+void VoiceChannel::render_envelope(int32_t* out, const uint32_t& stride, const uint32_t& samples)
+{
+    uint32_t done = 0;
+    while (done < samples)
+    {
+        uint32_t run = std::min(this->envelope_wait, samples - done);
+        int32_t level = this->adsr_volume;
+        for (uint32_t i = 0; i < run; i++)
+        {
+            out[(size_t)(done + i) * stride] = level;
+        }
+        done += run;
+        if (this->envelope_wait != ADSR_NEVER)
+        {
+            this->envelope_wait -= run;
+            if (this->envelope_wait == 0)
+            {
+                this->envelope_step();
+            }
+        }
+    }
+}
+
+void VoiceChannel::serialize(Savestate& state)
+{
+    state.value(this->mode);
+    state.value(this->volume_left);
+    state.value(this->volume_right);
+    state.value(this->sweep_left);
+    state.value(this->sweep_right);
+    state.value(this->frequency);
+    state.value(this->startaddr_sound);
+    state.value(this->attack_rate);
+    state.value(this->adsr_2);
+    state.value(this->adsr_volume);
+    state.value(this->current_repeat_addr);
+    state.value(this->key_on);
+    state.value(this->key_off);
+    state.value(this->status);
+    state.value(this->current_address);
+    state.value(this->pitch_counter);
+    state.value(this->end_reached);
+    state.value(this->block_decoded);
+    state.value(this->block_flags);
+    state.value(this->adpcm_old);
+    state.value(this->adpcm_older);
+    state.value(this->samples);
+    state.value(this->envelope_phase);
+    state.value(this->envelope_wait);
+}
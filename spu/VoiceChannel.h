@@ -4,6 +4,10 @@
 #pragma once
 
 #include <stdint.h>
+#include "Adpcm.h"
+#include "Adsr.h"
+
+class Savestate;
 
 enum ChannelMode {
     FM,
@@ -35,9 +39,46 @@ public:
     uint16_t adsr_2;
     uint16_t adsr_volume;
     uint16_t current_repeat_addr;
+    // levels of volume_left and volume_right
+    VolumeSweep sweep_left;
+    VolumeSweep sweep_right;
+
+    // playback of the ADPCM data in SPU RAM
+    uint32_t current_address = 0; // byte address of the block being played
+    uint32_t pitch_counter = 0; // position in the block, 12 fractional bits
+    bool end_reached = false; // ENDX flag, a block with LOOP_END was played since key on
 
     void start_play();
     void stop_play();
+    bool playing() const { return this->status; }
+
+    // decode the block at current_address, only if the voice just moved into it
+    void decode_block(const uint8_t* ram)
+    {
+        if (!this->block_decoded)
+        {
+            this->decode_next_block(ram);
+        }
+    }
+    // the 4 samples up to the current position, oldest first, for the interpolation
+    const int16_t* taps() const { return this->samples + (this->pitch_counter >> 12); }
+    // move on by one output sample, 'pitch' 0x1000 is one ADPCM sample, and into the next block
+    // at the end of this one
+    void advance(const uint32_t& pitch);
+
+    // envelope level (adsr_volume) of the next 'samples' samples into out[0], out[stride], ...
+    // The level only changes every few samples, it is written in runs and stepped in between
+    void render_envelope(int32_t* out, const uint32_t& stride, const uint32_t& samples);
+    // after a mixed block: a voice whose release ended stops playing
+    void end_block()
+    {
+        if (this->envelope_phase == AdsrOff)
+        {
+            this->status = false;
+        }
+    }
+
+    void serialize(Savestate& state);
     
 private:
     int voice_number;
@@ -46,6 +87,21 @@ private:
     bool key_on  = false;
     bool key_off = false;
     bool status  = false;
+
+    bool block_decoded = false;
+    uint8_t block_flags = 0;
+    int16_t adpcm_old = 0, adpcm_older = 0;
+    // the decoded block, after the last 3 samples of the previous one
+    int16_t samples[3 + ADPCM_BLOCK_SAMPLES] = {};
+
+    AdsrPhase envelope_phase = AdsrOff;
+    uint32_t envelope_wait = ADSR_NEVER; // samples until the next step of the envelope
+
+    void decode_next_block(const uint8_t* ram);
+    void envelope_rate(uint32_t& rate, bool& exponential, bool& decrease) const;
+    void start_envelope_phase(const AdsrPhase& phase);
+    void schedule_envelope_step();
+    void envelope_step();
 };
 
 
@@ -0,0 +1,62 @@
+#include "FrameHash.h"
+#include "../cpu/Cpu.h"
+#include "../util/hash.h"
+#include "../util/logging.h"
+
+FrameHasher::~FrameHasher() {
+    if (this->out != nullptr && this->out != stdout) {
+        fclose(this->out);
+    }
+}
+
+bool FrameHasher::open(const std::string &fname) {
+    this->out = fname == "-" ? stdout : fopen(fname.c_str(), "w");
+    if (this->out == nullptr) {
+        DEBUG("Unable_to_write_frame_hashes:" << fname);
+        return false;
+    }
+    return true;
+}
+
+uint64_t FrameHasher::hash(Cpu &cpu) {
+    auto ram = cpu.interconnect->ram;
+    // a frame drawn by the renderer is read back first
+    cpu.interconnect->gpu->sync_vram();
+    auto& vram = cpu.interconnect->gpu->vram;
+    const uint32_t ram_page_size = 1u << RAM_PAGE_SHIFT;
+    const uint32_t vram_page_size = 1u << VRAM_PAGE_SHIFT; // in pixels
+
+    this->ram_hashes.resize(ram->dirty.size());
+    for (size_t page = 0; page < ram->dirty.size(); page++) {
+        if (ram->dirty[page] & DIRTY_HASH) {
+            this->ram_hashes[page] = xxh64(ram->data.data() + page * ram_page_size, ram_page_size);
+            this->pages_hashed++;
+        }
+    }
+    for (size_t page = 0; page < VRAM_PAGES; page++) {
+        if (vram.dirty[page] & DIRTY_HASH) {
+            this->vram_hashes[page] = xxh64(vram.data() + page * vram_page_size, vram_page_size * sizeof(uint16_t));
+            this->pages_hashed++;
+        }
+    }
+    ram->clearDirty(DIRTY_HASH);
+    vram.clear_dirty(DIRTY_HASH);
+
+    // CPU and GTE registers, a few hundred bytes
+    this->registers.rewind(SaveMode);
+    cpu.serialize(this->registers);
+
+    uint64_t hashes[3] = {
+        xxh64(this->ram_hashes.data(), this->ram_hashes.size() * sizeof(uint64_t)),
+        xxh64(this->vram_hashes, sizeof(this->vram_hashes)),
+        xxh64(this->registers.buffer.data(), this->registers.buffer.size()),
+    };
+    return xxh64(hashes, sizeof(hashes));
+}
+
+void FrameHasher::frame(Cpu &cpu, const uint64_t &frame, const uint64_t &cycle) {
+    auto hash = this->hash(cpu);
+    if (this->out != nullptr) {
+        fprintf(this->out, "%llu %llu %016llx\n", (unsigned long long) frame, (unsigned long long) cycle, (unsigned long long) hash);
+    }
+}
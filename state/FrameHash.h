@@ -0,0 +1,37 @@
+#ifndef PSXEMU_FRAMEHASH_H
+#define PSXEMU_FRAMEHASH_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Savestate.h"
+#include "../memory/Vram.h"
+
+class Cpu;
+
+// Hash of RAM, VRAM and the CPU registers, computed once per frame. Page hashes are kept
+// between frames and only pages written since the last frame are hashed again, so this is
+// cheap enough to leave on. Two runs (or two CPU backends) are in sync as long as their
+// hash streams match.
+class FrameHasher {
+public:
+    ~FrameHasher();
+
+    // write one line per frame to 'fname' ("-" for stdout)
+    bool open(const std::string& fname);
+
+    uint64_t hash(Cpu& cpu);
+    // hash the current frame and write it to the side channel
+    void frame(Cpu& cpu, const uint64_t& frame, const uint64_t& cycle);
+
+    uint64_t pages_hashed = 0;
+
+private:
+    FILE* out = nullptr;
+    std::vector<uint64_t> ram_hashes;
+    uint64_t vram_hashes[VRAM_PAGES] = {};
+    Savestate registers = Savestate(SaveMode);
+};
+
+#endif //PSXEMU_FRAMEHASH_H
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstring>
+#include "Movie.h"
+#include "../cpu/Cpu.h"
+#include "../util/logging.h"
+
+struct MovieHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t savestate_version; // layout of the initial state and of MovieLoadState payloads
+    uint32_t flags;
+    uint32_t hle_disabled_size; // NUL terminated function names, between the header and the state
+    uint64_t state_size;
+};
+
+struct MovieEventHeader {
+    uint64_t cycle;
+    uint32_t type;
+    uint32_t size;
+};
+
+Movie::~Movie() {
+    if (this->file != nullptr) {
+        fclose(this->file);
+    }
+}
+
+bool Movie::record(const std::string &fname, Cpu &cpu, const MovieOptions &options) {
+    this->file = fopen(fname.c_str(), "wb");
+    if (this->file == nullptr) {
+        DEBUG("Unable_to_write_movie:" << fname);
+        return false;
+    }
+
+    this->state.rewind(SaveMode);
+    serializeSystem(this->state, cpu);
+
+    std::string hle_disabled;
+    for (const auto& name : options.hle_disabled) {
+        hle_disabled.append(name).push_back('\0');
+    }
+    MovieHeader header = {MOVIE_MAGIC, MOVIE_VERSION, SAVESTATE_VERSION, options.flags, (uint32_t)hle_disabled.size(), this->state.buffer.size()};
+    fwrite(&header, sizeof(header), 1, this->file);
+    fwrite(hle_disabled.data(), 1, hle_disabled.size(), this->file);
+    fwrite(this->state.buffer.data(), 1, this->state.buffer.size(), this->file);
+    DEBUG("Recording_movie:" << fname);
+    return true;
+}
+
+bool Movie::replay(const std::string &fname, Cpu &cpu, MovieOptions &options) {
+    FILE* movie = fopen(fname.c_str(), "rb");
+    if (movie == nullptr) {
+        DEBUG("Movie_not_found:" << fname);
+        return false;
+    }
+
+    MovieHeader header = {};
+    if (fread(&header, sizeof(header), 1, movie) != 1 || header.magic != MOVIE_MAGIC || header.version != MOVIE_VERSION) {
+        DEBUG("Invalid_movie_file:" << fname);
+        fclose(movie);
+        return false;
+    }
+    if (header.savestate_version != SAVESTATE_VERSION) {
+        DEBUG("Movie_recorded_with_savestate_version_" << std::dec << header.savestate_version << "_expected_" << SAVESTATE_VERSION);
+        fclose(movie);
+        return false;
+    }
+
+    std::string hle_disabled(header.hle_disabled_size, '\0');
+    bool ok = fread(hle_disabled.data(), 1, hle_disabled.size(), movie) == hle_disabled.size();
+    Savestate initial = Savestate(LoadMode);
+    initial.buffer.resize(header.state_size);
+    ok = ok && fread(initial.buffer.data(), 1, initial.buffer.size(), movie) == initial.buffer.size();
+
+    MovieEventHeader event_header = {};
+    while (ok && fread(&event_header, sizeof(event_header), 1, movie) == 1) {
+        MovieEvent event = {event_header.cycle, event_header.type, std::vector<uint8_t>(event_header.size)};
+        ok = fread(event.payload.data(), 1, event.payload.size(), movie) == event.payload.size();
+        this->events.push_back(std::move(event));
+    }
+    fclose(movie);
+    if (!ok) {
+        DEBUG("Truncated_movie_file:" << fname);
+        return false;
+    }
+
+    if (!serializeSystem(initial, cpu)) {
+        DEBUG("Invalid_movie_file:" << fname);
+        return false;
+    }
+    options.flags = header.flags;
+    options.hle_disabled.clear();
+    for (size_t start = 0; start < hle_disabled.size();) {
+        size_t end = std::min(hle_disabled.find('\0', start), hle_disabled.size());
+        options.hle_disabled.push_back(hle_disabled.substr(start, end - start));
+        start = end + 1;
+    }
+    this->replay_mode = true;
+    DEBUG("Replaying_movie:" << fname << "_events:" << std::dec << this->events.size());
+    return true;
+}
+
+void Movie::stop(const uint64_t &cycle) {
+    if (this->file == nullptr) {
+        return;
+    }
+    this->write(cycle, MovieEnd, nullptr, 0);
+    fclose(this->file);
+    this->file = nullptr;
+}
+
+uint32_t Movie::input(const uint64_t &cycle, const uint32_t &port, const uint32_t &live) {
+    if (this->replay_mode) {
+        // the latest recorded state of this port at or before 'cycle'
+        auto& i = this->next_input[port];
+        for (; i < this->events.size() && this->events[i].cycle <= cycle; i++) {
+            const auto& event = this->events[i];
+            if (event.type == MovieLoadState && i >= this->next_event) {
+                // the events after it are on the timeline of the loaded state
+                break;
+            }
+            uint32_t payload[2];
+            if (event.type == MovieInput && event.payload.size() == sizeof(payload)) {
+                memcpy(payload, event.payload.data(), sizeof(payload));
+                if (payload[0] == port) {
+                    this->ports[port] = payload[1];
+                }
+            }
+        }
+        return this->ports[port];
+    }
+
+    if (this->file != nullptr && live != this->ports[port]) {
+        uint32_t payload[2] = {port, live};
+        this->write(cycle, MovieInput, (const uint8_t*) payload, sizeof(payload));
+    }
+    this->ports[port] = live;
+    return live;
+}
+
+void Movie::stateLoaded(const uint64_t &cycle, Cpu &cpu) {
+    if (this->file == nullptr) {
+        return;
+    }
+    // the cycle is the one the machine had before the load, that is where the replay applies it
+    this->state.rewind(SaveMode);
+    serializeSystem(this->state, cpu);
+    this->write(cycle, MovieLoadState, this->state.buffer.data(), (uint32_t) this->state.buffer.size());
+}
+
+void Movie::replayEvents(const uint64_t &cycle, Cpu &cpu) {
+    for (; this->next_event < this->events.size() && this->events[this->next_event].cycle <= cycle; this->next_event++) {
+        auto& event = this->events[this->next_event];
+        if (event.type == MovieLoadState) {
+            Savestate loaded = Savestate(LoadMode);
+            loaded.buffer = event.payload;
+            if (!serializeSystem(loaded, cpu)) {
+                DEBUG("Skipped_invalid_state_in_movie_at_cycle_" << std::dec << event.cycle);
+            }
+
+            // the cycle count jumped, the following events belong to the new timeline
+            this->next_event++;
+            for (auto& i : this->next_input) {
+                i = std::max(i, this->next_event);
+            }
+            return;
+        }
+    }
+}
+
+void Movie::write(const uint64_t &cycle, const uint32_t &type, const uint8_t *payload, const uint32_t &size) {
+    MovieEventHeader header = {cycle, type, size};
+    fwrite(&header, sizeof(header), 1, this->file);
+    if (size != 0) {
+        fwrite(payload, 1, size, this->file);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PSXEMU_MOVIE_H
+#define PSXEMU_MOVIE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Savestate.h"
+
+const uint32_t MOVIE_MAGIC = 0x4d585350; // "PSXM"
+const uint32_t MOVIE_VERSION = 2;
+const uint32_t MOVIE_PORTS = 2;
+
+// options that change the timing of the emulation, a movie is replayed with the recorded ones
+const uint32_t MOVIE_FLAG_BIOS_HLE = 1u << 0;
+const uint32_t MOVIE_FLAG_IDLE_SKIP = 1u << 1;
+const uint32_t MOVIE_FLAG_REVERB = 1u << 2; // the reverb unit writes its work area in SPU RAM
+
+struct MovieOptions {
+    uint32_t flags = 0;
+    std::vector<std::string> hle_disabled; // kernel functions kept interpreted with MOVIE_FLAG_BIOS_HLE
+};
+
+enum MovieEventType {
+    MovieInput = 0, // controller state of a port as seen by the game, payload: port, state
+    MovieLoadState = 1, // the host replaced the machine state (savestate load, rewind), payload: the state
+    MovieEnd = 2, // end of the recording
+};
+
+struct MovieEvent {
+    uint64_t cycle; // global cycle count at which the event happened
+    uint32_t type;
+    std::vector<uint8_t> payload;
+};
+
+// Recording and replay of everything that enters the emulation from outside: the initial state,
+// the controller state whenever the game reads it and host actions replacing the machine state,
+// each keyed by the global cycle count. Everything else is deterministic, so replaying the events
+// on top of the initial state reproduces the run bit by bit.
+// A movie needs the same BIOS (and EXE, if one was side-loaded) as the recording.
+class Movie {
+public:
+    ~Movie();
+
+    // write the header and the current machine state
+    bool record(const std::string& fname, Cpu& cpu, const MovieOptions& options);
+    // read a movie and load its initial state, the recorded options are returned
+    bool replay(const std::string& fname, Cpu& cpu, MovieOptions& options);
+    void stop(const uint64_t& cycle);
+
+    bool recording() const { return this->file != nullptr; }
+    bool replaying() const { return this->replay_mode; }
+    // all events have been replayed
+    bool finished() const { return this->replay_mode && this->next_event >= this->events.size(); }
+
+    // Controller state read by the game at 'cycle'. When recording, changes of the live state
+    // are written to the movie; when replaying, the live state is ignored.
+    uint32_t input(const uint64_t& cycle, const uint32_t& port, const uint32_t& live);
+    // the host replaced the machine state
+    void stateLoaded(const uint64_t& cycle, Cpu& cpu);
+    // apply the host events recorded up to 'cycle', called where the host events are handled
+    void replayEvents(const uint64_t& cycle, Cpu& cpu);
+
+private:
+    FILE* file = nullptr;
+    Savestate state = Savestate(SaveMode);
+    uint32_t ports[MOVIE_PORTS] = {};
+
+    bool replay_mode = false;
+    std::vector<MovieEvent> events;
+    size_t next_event = 0; // next host event to replay
+    size_t next_input[MOVIE_PORTS] = {}; // next input event of each port
+
+    void write(const uint64_t& cycle, const uint32_t& type, const uint8_t* payload, const uint32_t& size);
+};
+
+#endif //PSXEMU_MOVIE_H
@@ -0,0 +1,233 @@
+#include <cstring>
+#include "Rewind.h"
+#include "../cpu/Cpu.h"
+#include "../util/logging.h"
+
+// Builds a delta as a list of (zero bytes, literal bytes) pairs, literals hold older ^ newer
+class DeltaEncoder {
+public:
+    DeltaEncoder(const uint8_t* older, const uint8_t* newer, std::vector<uint8_t>& out)
+        : older(older), newer(newer), out(out) {}
+
+    void same(const size_t& size) {
+        if (this->literal_size != 0) {
+            this->flush();
+        }
+        this->zeroes += size;
+    }
+
+    void different(const size_t& offset, const size_t& size) {
+        if (this->literal_size == 0) {
+            this->literal_offset = offset;
+        }
+        this->literal_size += size;
+    }
+
+    // compare a range that may have changed, 8 bytes at a time
+    void compare(size_t offset, const size_t& end) {
+        for (; offset + 8 <= end; offset += 8) {
+            uint64_t a, b;
+            memcpy(&a, this->older + offset, 8);
+            memcpy(&b, this->newer + offset, 8);
+            if (a == b) {
+                this->same(8);
+            } else {
+                this->different(offset, 8);
+            }
+        }
+        for (; offset < end; offset++) {
+            if (this->older[offset] == this->newer[offset]) {
+                this->same(1);
+            } else {
+                this->different(offset, 1);
+            }
+        }
+    }
+
+    // trailing zeroes are implicit
+    void flush() {
+        if (this->literal_size == 0) {
+            return;
+        }
+        auto zeroes = (uint32_t) this->zeroes;
+        auto size = (uint32_t) this->literal_size;
+        auto position = this->out.size();
+        this->out.resize(position + 8 + size);
+        memcpy(this->out.data() + position, &zeroes, 4);
+        memcpy(this->out.data() + position + 4, &size, 4);
+        auto dst = this->out.data() + position + 8;
+        for (size_t i = 0; i < size; i++) {
+            dst[i] = this->older[this->literal_offset + i] ^ this->newer[this->literal_offset + i];
+        }
+        this->zeroes = 0;
+        this->literal_size = 0;
+    }
+
+private:
+    const uint8_t* older;
+    const uint8_t* newer;
+    std::vector<uint8_t>& out;
+    size_t zeroes = 0;
+    size_t literal_offset = 0;
+    size_t literal_size = 0;
+};
+
+// delta that turns 'newer' back into 'older'. Pages the capture of 'newer' reports as
+// clean were not written since 'older' was captured and are skipped without looking at them
+static void encodeDelta(const Savestate& older, const Savestate& newer, std::vector<uint8_t>& out) {
+    DeltaEncoder encoder = DeltaEncoder(older.buffer.data(), newer.buffer.data(), out);
+    size_t position = 0;
+
+    for (const auto& range : newer.tracked) {
+        encoder.compare(position, range.offset);
+        for (size_t page = 0; page < range.dirty.size(); page++) {
+            auto start = range.offset + page * range.page_size;
+            auto end = std::min(start + range.page_size, range.offset + range.size);
+            if (range.dirty[page] & DIRTY_REWIND) {
+                encoder.compare(start, end);
+            } else {
+                encoder.same(end - start);
+            }
+        }
+        position = range.offset + range.size;
+    }
+    encoder.compare(position, newer.buffer.size());
+    encoder.flush();
+}
+
+static void applyDelta(const std::vector<uint8_t>& delta, std::vector<uint8_t>& buffer) {
+    size_t position = 0;
+    size_t i = 0;
+    while (i + 8 <= delta.size()) {
+        uint32_t zeroes, size;
+        memcpy(&zeroes, delta.data() + i, 4);
+        memcpy(&size, delta.data() + i + 4, 4);
+        i += 8;
+        position += zeroes;
+        for (uint32_t j = 0; j < size; j++) {
+            buffer[position++] ^= delta[i++];
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(const size_t &budget, const uint32_t &interval) {
+    this->budget = budget;
+    this->interval = interval;
+    this->worker = std::thread([this]() { this->run(); });
+}
+
+RewindBuffer::~RewindBuffer() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop = true;
+    }
+    this->work.notify_one();
+    this->worker.join();
+}
+
+void RewindBuffer::capture(Cpu &cpu) {
+    Savestate state = Savestate(LoadMode); // does not allocate, replaced below
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        // do not let the worker fall arbitrarily far behind
+        this->idle.wait(lock, [this]() { return this->pending.size() < REWIND_MAX_PENDING; });
+        if (!this->spare.empty()) {
+            state = std::move(this->spare.back());
+            this->spare.pop_back();
+        } else {
+            state = Savestate(SaveMode);
+        }
+    }
+
+    state.rewind(SaveMode);
+    serializeSystem(state, cpu);
+    // the next capture only has to look at what is written from now on
+    cpu.interconnect->ram->clearDirty(DIRTY_REWIND);
+    cpu.interconnect->gpu->vram.clear_dirty(DIRTY_REWIND);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending.push_back(std::move(state));
+    }
+    this->work.notify_one();
+}
+
+bool RewindBuffer::rewind(Cpu &cpu) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->waitIdle(lock);
+
+    if (!this->has_newest) {
+        return false;
+    }
+    if (!this->deltas.empty()) {
+        applyDelta(this->deltas.back(), this->newest.buffer);
+        this->delta_bytes -= this->deltas.back().size();
+        this->deltas.pop_back();
+    }
+
+    // the restored capture becomes the base of the next delta. Without older
+    // deltas left it is still restored, going back as far as the history allows
+    this->newest.rewind(LoadMode);
+    serializeSystem(this->newest, cpu);
+    this->newest.tracked.clear();
+    cpu.interconnect->ram->clearDirty(DIRTY_REWIND);
+    cpu.interconnect->gpu->vram.clear_dirty(DIRTY_REWIND);
+    return true;
+}
+
+size_t RewindBuffer::steps() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->deltas.size();
+}
+
+size_t RewindBuffer::memoryUsage() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->delta_bytes + this->newest.buffer.capacity();
+}
+
+void RewindBuffer::waitIdle(std::unique_lock<std::mutex> &lock) {
+    this->idle.wait(lock, [this]() { return this->pending.empty() && !this->busy; });
+}
+
+void RewindBuffer::run() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->work.wait(lock, [this]() { return this->stop || !this->pending.empty(); });
+        if (this->stop) {
+            return;
+        }
+
+        Savestate next = std::move(this->pending.front());
+        this->pending.pop_front();
+        this->busy = true;
+        lock.unlock();
+
+        std::vector<uint8_t> delta;
+        bool keep = this->has_newest && this->newest.buffer.size() == next.buffer.size();
+        if (keep) {
+            encodeDelta(this->newest, next, delta);
+            delta.shrink_to_fit();
+        }
+
+        lock.lock();
+        if (this->has_newest) {
+            this->spare.push_back(std::move(this->newest));
+        }
+        if (!keep) {
+            // first capture, or the state layout changed: the history can not be replayed
+            this->deltas.clear();
+            this->delta_bytes = 0;
+        } else {
+            this->delta_bytes += delta.size();
+            this->deltas.push_back(std::move(delta));
+            while (this->delta_bytes > this->budget && !this->deltas.empty()) {
+                this->delta_bytes -= this->deltas.front().size();
+                this->deltas.pop_front();
+            }
+        }
+        this->newest = std::move(next);
+        this->has_newest = true;
+        this->busy = false;
+        this->idle.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PSXEMU_REWIND_H
+#define PSXEMU_REWIND_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Savestate.h"
+
+// captures waiting for the worker before the emulation thread blocks
+const size_t REWIND_MAX_PENDING = 4;
+
+// In-memory history of the machine state. Every capture is stored as the XOR against the
+// next newer one, with runs of zeroes removed, and only the newest capture is kept in full.
+// Going back one step XORs the newest delta into it. RAM and VRAM pages that were not
+// written between two captures are skipped without being compared.
+// The emulation thread only serializes the machine, the deltas are computed on a worker thread.
+class RewindBuffer {
+public:
+    RewindBuffer(const size_t& budget, const uint32_t& interval);
+    ~RewindBuffer();
+
+    uint32_t interval; // frames between two captures
+
+    // snapshot the machine and hand it to the worker
+    void capture(Cpu& cpu);
+    // restore the previous capture, false if there is no history left
+    bool rewind(Cpu& cpu);
+
+    size_t steps();
+    size_t memoryUsage();
+
+private:
+    size_t budget; // bytes of deltas kept
+
+    std::mutex mutex;
+    std::condition_variable work; // signals the worker
+    std::condition_variable idle; // signals the emulation thread
+    std::deque<Savestate> pending; // captured, not encoded yet
+    std::vector<Savestate> spare; // buffers of encoded captures, reused to avoid page faults
+    bool busy = false;
+    bool stop = false;
+
+    // owned by the worker while it is busy
+    Savestate newest;
+    bool has_newest = false;
+    std::deque<std::vector<uint8_t>> deltas; // oldest first
+    size_t delta_bytes = 0;
+
+    std::thread worker;
+
+    void run();
+    void waitIdle(std::unique_lock<std::mutex>& lock);
+};
+
+#endif //PSXEMU_REWIND_H
@@ -0,0 +1,31 @@
+#include <cstring>
+#include "RunAhead.h"
+#include "../cpu/Cpu.h"
+
+RunAhead::RunAhead(Cpu *cpu, const uint32_t &frames) {
+    this->cpu = cpu;
+    this->frames = frames;
+    // only the frames run ahead are shown
+    this->cpu->interconnect->gpu->set_headless(true);
+}
+
+void RunAhead::run(const std::function<void()> &run_frame) {
+    auto ram = this->cpu->interconnect->ram;
+    auto gpu = this->cpu->interconnect->gpu;
+
+    this->state.rewind(SaveMode);
+    serializeSystem(this->state, *this->cpu);
+    this->ram_dirty = ram->dirty;
+    memcpy(this->vram_dirty, gpu->vram.dirty, sizeof(this->vram_dirty));
+
+    for (uint32_t i = 1; i <= this->frames; i++) {
+        gpu->set_headless(i != this->frames);
+        run_frame();
+    }
+    gpu->set_headless(true);
+
+    this->state.rewind(LoadMode);
+    serializeSystem(this->state, *this->cpu);
+    ram->dirty = this->ram_dirty;
+    memcpy(gpu->vram.dirty, this->vram_dirty, sizeof(this->vram_dirty));
+}
@@ -0,0 +1,33 @@
+#ifndef PSXEMU_RUNAHEAD_H
+#define PSXEMU_RUNAHEAD_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Savestate.h"
+#include "../memory/Vram.h"
+
+class Cpu;
+
+// Run-ahead hides the frames of lag a game has between reading the input and showing its
+// effect: after every real frame the machine is saved, a few frames are emulated ahead with
+// the current input, the last one is presented and the machine is restored. Real frames
+// are not presented, so the GPU output is always the ahead one.
+class RunAhead {
+public:
+    RunAhead(Cpu* cpu, const uint32_t& frames);
+
+    uint32_t frames; // frames emulated ahead of the real one
+
+    // called right after a real frame. 'run_frame' emulates until the next vertical blank
+    void run(const std::function<void()>& run_frame);
+
+private:
+    Cpu* cpu;
+    Savestate state = Savestate(SaveMode); // reused every frame
+    // restoring makes every page dirty, but the machine is back where it was
+    std::vector<uint8_t> ram_dirty;
+    uint8_t vram_dirty[VRAM_PAGES];
+};
+
+#endif //PSXEMU_RUNAHEAD_H
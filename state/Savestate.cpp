@@ -0,0 +1,195 @@
+#include <cstdio>
+#include <exception>
+#include "Savestate.h"
+#include "../memory/DirtyPages.h"
+#include "../cpu/Cpu.h"
+#include "../util/logging.h"
+#ifdef PSXEMU_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+const uint32_t SAVESTATE_FILE_MAGIC = 0x46585350; // "PSXF"
+const uint32_t CODEC_NONE = 0;
+const uint32_t CODEC_ZSTD = 1;
+// fast levels keep background compression well below the checkpoint interval
+const int ZSTD_LEVEL = 3;
+
+// file header, followed by the (compressed) state
+struct SavestateFileHeader {
+    uint32_t magic;
+    uint32_t codec;
+    uint64_t size; // uncompressed size
+};
+
+Savestate::Savestate(const SavestateMode &mode) {
+    this->mode = mode;
+    if (mode == SaveMode) {
+        this->buffer.reserve(SAVESTATE_RESERVE);
+    }
+}
+
+void Savestate::rewind(const SavestateMode &mode) {
+    this->mode = mode;
+    this->position = 0;
+    if (mode == SaveMode) {
+        this->buffer.clear();
+        this->tracked.clear();
+    }
+}
+
+void Savestate::bytes(void *data, const size_t &size) {
+    if (this->mode == SaveMode) {
+        auto src = (const uint8_t *) data;
+        this->buffer.insert(this->buffer.end(), src, src + size);
+        return;
+    }
+
+    if (this->position + size > this->buffer.size()) {
+        DEBUG("ERROR:savestate_truncated_at_" << std::dec << this->position);
+        throw std::exception();
+    }
+    memcpy(data, this->buffer.data() + this->position, size);
+    this->position += size;
+}
+
+void Savestate::pages(void *data, const size_t &size, uint8_t *dirty, const size_t &page_size) {
+    auto count = (size + page_size - 1) / page_size;
+    if (this->mode == SaveMode) {
+        this->tracked.push_back({this->buffer.size(), size, page_size, std::vector<uint8_t>(dirty, dirty + count)});
+    } else {
+        memset(dirty, DIRTY_ALL, count);
+    }
+    this->bytes(data, size);
+}
+
+void Savestate::section(const char *tag) {
+    char value[4];
+    memcpy(value, tag, 4);
+    this->bytes(value, 4);
+
+    if (this->mode == LoadMode && memcmp(value, tag, 4) != 0) {
+        DEBUG("ERROR:savestate_section_mismatch_expected_" << std::string(tag, 4) << "_at_" << std::dec << this->position - 4);
+        throw std::exception();
+    }
+}
+
+bool serializeSystem(Savestate &state, Cpu &cpu) {
+    uint32_t magic = SAVESTATE_MAGIC;
+    uint32_t version = SAVESTATE_VERSION;
+    // checked before anything is loaded, a state from another build leaves the machine untouched
+    if (!state.saving() && state.buffer.size() < sizeof(magic) + sizeof(version)) {
+        DEBUG("ERROR:savestate_too_short");
+        return false;
+    }
+    state.value(magic);
+    state.value(version);
+    if (magic != SAVESTATE_MAGIC) {
+        DEBUG("ERROR:not_a_savestate");
+        return false;
+    }
+    if (version != SAVESTATE_VERSION) {
+        DEBUG("ERROR:incompatible_savestate_version_" << std::dec << version << "_expected_" << SAVESTATE_VERSION);
+        return false;
+    }
+
+    cpu.serialize(state);
+    cpu.interconnect->serialize(state);
+    return true;
+}
+
+SavestateWriter::~SavestateWriter() {
+    this->wait();
+}
+
+void SavestateWriter::write(const std::string &fname, std::vector<uint8_t> &&buffer) {
+    // one write at a time, a checkpoint interval is much longer than a write anyway
+    this->wait();
+    this->worker = std::thread([fname, buffer = std::move(buffer)]() {
+        writeSavestateFile(fname, buffer);
+    });
+}
+
+void SavestateWriter::wait() {
+    if (this->worker.joinable()) {
+        this->worker.join();
+    }
+}
+
+bool writeSavestateFile(const std::string &fname, const std::vector<uint8_t> &buffer) {
+    SavestateFileHeader header = {SAVESTATE_FILE_MAGIC, CODEC_NONE, buffer.size()};
+    const uint8_t *payload = buffer.data();
+    size_t payload_size = buffer.size();
+
+#ifdef PSXEMU_HAVE_ZSTD
+    std::vector<uint8_t> compressed(ZSTD_compressBound(buffer.size()));
+    auto compressed_size = ZSTD_compress(compressed.data(), compressed.size(), buffer.data(), buffer.size(), ZSTD_LEVEL);
+    if (!ZSTD_isError(compressed_size)) {
+        header.codec = CODEC_ZSTD;
+        payload = compressed.data();
+        payload_size = compressed_size;
+    }
+#endif
+
+    // write to a temporary file first, a crash during a checkpoint must not destroy the previous one
+    auto tmp_fname = fname + ".tmp";
+    FILE *file = fopen(tmp_fname.c_str(), "wb");
+    if (!file) {
+        DEBUG("Unable_to_write_savestate:" << tmp_fname);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(payload, 1, payload_size, file) == payload_size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_fname.c_str(), fname.c_str()) != 0) {
+        DEBUG("Unable_to_write_savestate:" << fname);
+        return false;
+    }
+    return true;
+}
+
+bool readSavestateFile(const std::string &fname, std::vector<uint8_t> &buffer) {
+    FILE *file = fopen(fname.c_str(), "rb");
+    if (!file) {
+        DEBUG("Savestate_not_found:" << fname);
+        return false;
+    }
+
+    SavestateFileHeader header = {};
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != SAVESTATE_FILE_MAGIC) {
+        DEBUG("Invalid_savestate_file:" << fname);
+        fclose(file);
+        return false;
+    }
+
+    std::vector<uint8_t> payload;
+    uint8_t chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        payload.insert(payload.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    switch (header.codec) {
+        case CODEC_NONE:
+            if (payload.size() != header.size) {
+                DEBUG("Truncated_savestate_file:" << fname);
+                return false;
+            }
+            buffer = std::move(payload);
+            return true;
+#ifdef PSXEMU_HAVE_ZSTD
+        case CODEC_ZSTD: {
+            buffer.resize(header.size);
+            auto size = ZSTD_decompress(buffer.data(), buffer.size(), payload.data(), payload.size());
+            if (ZSTD_isError(size) || size != header.size) {
+                DEBUG("Corrupt_savestate_file:" << fname);
+                return false;
+            }
+            return true;
+        }
+#endif
+        default:
+            DEBUG("Unsupported_savestate_compression:" << std::dec << header.codec << "_in_" << fname);
+            return false;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef PSXEMU_SAVESTATE_H
+#define PSXEMU_SAVESTATE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class Cpu;
+
+const uint32_t SAVESTATE_MAGIC = 0x53585350; // "PSXS"
+// bump whenever a component changes what it serializes
+const uint32_t SAVESTATE_VERSION = 13;
+// RAM + VRAM + registers fit without growing the buffer
+const size_t SAVESTATE_RESERVE = 4 * 1024 * 1024;
+
+// a block of memory serialized with dirty page flags, see Savestate::pages()
+struct TrackedRange {
+    size_t offset; // position in the buffer
+    size_t size;
+    size_t page_size;
+    std::vector<uint8_t> dirty; // flags at the time of the capture
+};
+
+enum SavestateMode {
+    SaveMode,
+    LoadMode
+};
+
+// Snapshot of the whole machine in a single contiguous buffer. Components implement
+// serialize(Savestate&), which is used for both directions, so saving and loading
+// can not get out of sync. Plain values are copied as they are, there is no per-field
+// formatting: states are only meant to be loaded by the same build on the same host.
+class Savestate {
+public:
+    explicit Savestate(const SavestateMode& mode = SaveMode);
+
+    SavestateMode mode;
+    std::vector<uint8_t> buffer;
+    std::vector<TrackedRange> tracked; // filled when saving
+
+    bool saving() const { return this->mode == SaveMode; }
+    // start over, keeping the allocated buffer when saving
+    void rewind(const SavestateMode& mode);
+
+    void bytes(void* data, const size_t& size);
+    // like bytes(), but remembers which pages were written since the flags were last cleared,
+    // so a delta against the previous capture can skip the clean ones. Loading marks every page dirty
+    void pages(void* data, const size_t& size, uint8_t* dirty, const size_t& page_size);
+    // marks the start of a component, loading a state with a different layout fails here
+    void section(const char* tag);
+
+    template<typename T>
+    void value(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be copied into a savestate");
+        this->bytes(&value, sizeof(T));
+    }
+
+private:
+    size_t position = 0;
+};
+
+// Compresses (if built with zstd) and writes states on a background thread,
+// so checkpointing does not stall the emulation
+class SavestateWriter {
+public:
+    ~SavestateWriter();
+
+    // takes ownership of the buffer, returns immediately
+    void write(const std::string& fname, std::vector<uint8_t>&& buffer);
+    // blocks until the last write finished
+    void wait();
+
+private:
+    std::thread worker;
+};
+
+// header, CPU and everything reachable through its interconnect. Returns false without
+// touching the machine if a loaded state has the wrong magic or version
+bool serializeSystem(Savestate& state, Cpu& cpu);
+
+bool writeSavestateFile(const std::string& fname, const std::vector<uint8_t>& buffer);
+bool readSavestateFile(const std::string& fname, std::vector<uint8_t>& buffer);
+
+#endif //PSXEMU_SAVESTATE_H
@@ -0,0 +1,63 @@
+// A loop polling a timer whose interrupt is off must not be skipped as an idle loop: nothing is
+// scheduled for the moment the value it waits for shows up, the next event is the vertical blank.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "../machine/Machine.h"
+
+const char* BIOS_FNAME = "./idle_loop_test.bin";
+const uint32_t BIOS_SIZE = 512 * 1024;
+const uint32_t TIMER_TARGET = 0x2000;
+
+// at the reset vector: timer 0 counts the system clock up to TIMER_TARGET with its interrupt
+// off, the loop polls the target reached bit, then the counter is stored at 0x100 and 1 at 0x104
+const uint32_t PROGRAM[] = {
+    0x3c081f80, // lui   t0, 0x1f80
+    0x34092000, // ori   t1, zero, TIMER_TARGET
+    0xad091108, // sw    t1, 0x1108(t0)  timer 0 target
+    0xad001104, // sw    zero, 0x1104(t0)  timer 0 mode, resets the counter
+    0x8d091104, // loop: lw t1, 0x1104(t0)
+    0x00000000, // nop
+    0x31290800, // andi  t1, t1, 0x800  reached target
+    0x1120fffc, // beq   t1, zero, loop
+    0x00000000, // nop
+    0x950a1100, // lhu   t2, 0x1100(t0)  timer 0 counter
+    0x3c0b8000, // lui   t3, 0x8000
+    0xad6a0100, // sw    t2, 0x100(t3)
+    0x340c0001, // ori   t4, zero, 1
+    0xad6c0104, // sw    t4, 0x104(t3)
+    0x1000ffff, // done: beq zero, zero, done
+    0x00000000, // nop
+};
+
+int main() {
+    std::vector<char> image(BIOS_SIZE, 0);
+    memcpy(image.data(), PROGRAM, sizeof(PROGRAM));
+    std::ofstream(BIOS_FNAME, std::ios::binary).write(image.data(), (std::streamsize) image.size());
+    Bios bios = Bios(BIOS_FNAME, BIOS_SIZE);
+    std::remove(BIOS_FNAME);
+
+    MachineConfig config = MachineConfig();
+    config.headless = true;
+    config.idle_skip = true;
+    config.mdec_threads = 0;
+    // a few MiB, too large for the stack
+    auto machine = std::make_unique<Machine>(&bios, config);
+    machine->ram.store32(0x100, 0);
+    machine->ram.store32(0x104, 0);
+    while (machine->ram.load32(0x104) == 0 && machine->scheduler.cycles < 10 * 1000 * 1000) {
+        machine->runSlice();
+    }
+
+    auto done = machine->ram.load32(0x104) != 0;
+    auto counter = machine->ram.load32(0x100);
+    // the loop notices the target a few iterations after it is reached
+    if (!done || counter < TIMER_TARGET || counter > TIMER_TARGET + 0x40) {
+        printf("FAIL: polling loop left with timer 0 at 0x%x, expected 0x%x\n", counter, TIMER_TARGET);
+        return 1;
+    }
+    printf("ok: polling loop left with timer 0 at 0x%x\n", counter);
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include "Timers.h"
+#include "../gpu/Constants.h"
+#include "../util/logging.h"
+#include "../state/Savestate.h"
+#include <algorithm>
+#include <exception>
+
+const EventType TIMER_EVENTS[3] = { Timer0Event, Timer1Event, Timer2Event };
+const IrqSource TIMER_IRQS[3] = { IrqTimer0, IrqTimer1, IrqTimer2 };
+
+// ticks from the current counter value until the counter equals 'point', NEVER if it never does
+static uint64_t ticks_until(const Timer& timer, const uint32_t& point)
+{
+    uint32_t v = timer.value;
+    if (timer.reset_at_target && timer.target != 0)
+    {
+        uint32_t period = (uint32_t)timer.target + 1;
+        if (v <= timer.target)
+        {
+            if (point > timer.target)
+            {
+                return NEVER;
+            }
+            uint32_t distance = (point + period - v) % period;
+            return distance == 0 ? period : distance;
+        }
+        // counter was set above the target: count up to 0xffff, wrap, then reset at target
+        if (point > v)
+        {
+            return point - v;
+        }
+        if (point > timer.target)
+        {
+            return NEVER;
+        }
+        return (0x10000 - v) + point;
+    }
+
+    uint32_t distance = (point - v) & 0xffff;
+    return distance == 0 ? 0x10000 : distance;
+}
+
+// counter value after 'ticks' ticks
+static uint16_t value_after(const Timer& timer, const uint64_t& ticks)
+{
+    uint64_t v = timer.value;
+    if (timer.reset_at_target && timer.target != 0)
+    {
+        uint64_t period = (uint64_t)timer.target + 1;
+        if (v <= timer.target)
+        {
+            return (uint16_t)((v + ticks) % period);
+        }
+        uint64_t to_wrap = 0x10000 - v;
+        if (ticks < to_wrap)
+        {
+            return (uint16_t)(v + ticks);
+        }
+        return (uint16_t)((ticks - to_wrap) % period);
+    }
+    // a target of 0 never resets the counter
+    return (uint16_t)((v + ticks) & 0xffff);
+}
+
+// ticks until the next interrupt of this timer, NEVER if none is due
+static uint64_t ticks_until_irq(const Timer& timer)
+{
+    if (!timer.irq_repeat && timer.irq_fired)
+    {
+        return NEVER;
+    }
+    uint64_t ticks = NEVER;
+    if (timer.irq_at_target)
+    {
+        ticks = std::min(ticks, ticks_until(timer, timer.target));
+    }
+    if (timer.irq_at_max)
+    {
+        ticks = std::min(ticks, ticks_until(timer, 0xffff));
+    }
+    return ticks;
+}
+
+Timers::Timers(Scheduler* scheduler, InterruptController* irq, Gpu* gpu)
+{
+    this->scheduler = scheduler;
+    this->irq = irq;
+    this->gpu = gpu;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        this->timers[i].irq_flag = true;
+        this->scheduler->setHandler(TIMER_EVENTS[i], [this, i]() { this->on_event(i); });
+    }
+}
+
+TimerClock Timers::clock(const uint32_t& index) const
+{
+    auto source = this->timers[index].clock_source;
+    switch (index)
+    {
+        case 0:
+            return (source & 1) != 0 ? DotClock : SysClock;
+        case 1:
+            return (source & 1) != 0 ? HBlank : SysClock;
+        default:
+            return (source & 2) != 0 ? SysClockDiv8 : SysClock;
+    }
+}
+
+// ticks per CPU cycle, as the fraction num/den
+void Timers::tick_rate(const uint32_t& index, uint64_t& num, uint64_t& den) const
+{
+    switch (this->clock(index))
+    {
+        case SysClock:
+            num = 1;
+            den = 1;
+            break;
+        case SysClockDiv8:
+            num = 1;
+            den = 8;
+            break;
+        case DotClock:
+            num = this->gpu->clock_hz();
+            den = CPU_CLOCK_HZ * this->gpu->dotclock_divider();
+            break;
+        case HBlank:
+            num = this->gpu->clock_hz();
+            den = CPU_CLOCK_HZ * this->gpu->cycles_per_line();
+            break;
+    }
+}
+
+bool Timers::stopped(const uint32_t& index) const
+{
+    auto& timer = this->timers[index];
+    // timer 2 sync modes 0 and 3 stop the counter
+    return index == 2 && timer.sync_enable && (timer.sync_mode == 0 || timer.sync_mode == 3);
+}
+
+// number of ticks between two points in time. Computed relative to cycle 0, so
+// fractional clocks (dot clock, hblank) keep their phase between accesses
+uint64_t Timers::ticks_between(const uint32_t& index, const uint64_t& from, const uint64_t& to) const
+{
+    if (this->stopped(index))
+    {
+        return 0;
+    }
+    uint64_t num, den;
+    this->tick_rate(index, num, den);
+    auto a = (unsigned __int128)from * num / den;
+    auto b = (unsigned __int128)to * num / den;
+    return (uint64_t)(b - a);
+}
+
+void Timers::advance(Timer& timer, uint64_t ticks)
+{
+    if (ticks == 0)
+    {
+        return;
+    }
+    if (ticks >= ticks_until(timer, timer.target))
+    {
+        timer.reached_target = true;
+    }
+    if (ticks >= ticks_until(timer, 0xffff))
+    {
+        timer.reached_max = true;
+    }
+    timer.value = value_after(timer, ticks);
+}
+
+// bring the counter up to date with the global cycle count
+void Timers::sync(const uint32_t& index)
+{
+    auto& timer = this->timers[index];
+    auto now = this->scheduler->cycles;
+
+    this->advance(timer, this->ticks_between(index, timer.base_cycle, now));
+    timer.base_cycle = now;
+}
+
+// schedule the next target/overflow interrupt. Must be called right after sync()
+void Timers::schedule_irq(const uint32_t& index)
+{
+    auto& timer = this->timers[index];
+    auto ticks = ticks_until_irq(timer);
+
+    if (ticks == NEVER || this->stopped(index))
+    {
+        this->scheduler->cancel(TIMER_EVENTS[index]);
+        return;
+    }
+
+    // first cycle at which 'ticks' more ticks have happened
+    uint64_t num, den;
+    this->tick_rate(index, num, den);
+    auto now = (unsigned __int128)timer.base_cycle;
+    auto tick = now * num / den + ticks;
+    auto cycle = (tick * den + num - 1) / num;
+
+    this->scheduler->schedule(TIMER_EVENTS[index], std::max<uint64_t>(1, (uint64_t)(cycle - now)));
+}
+
+void Timers::on_event(const uint32_t& index)
+{
+    auto& timer = this->timers[index];
+
+    // the clock rate may have changed since the event was scheduled, make sure the point was actually reached
+    auto due = ticks_until_irq(timer);
+    auto elapsed = this->ticks_between(index, timer.base_cycle, this->scheduler->cycles);
+    this->sync(index);
+
+    if (due != NEVER && elapsed >= due)
+    {
+        timer.irq_fired = true;
+        if (timer.irq_toggle)
+        {
+            // toggle mode: bit 10 flips on every event, the interrupt fires when it goes low
+            timer.irq_flag = !timer.irq_flag;
+            if (!timer.irq_flag)
+            {
+                this->irq->request(TIMER_IRQS[index]);
+            }
+        }
+        else
+        {
+            // pulse mode: bit 10 goes low for a few cycles only
+            this->irq->request(TIMER_IRQS[index]);
+        }
+    }
+
+    this->schedule_irq(index);
+}
+
+uint32_t Timers::load(const uint32_t& offset)
+{
+    uint32_t index = offset >> 4;
+    if (index > 2)
+    {
+        DEBUG("Unhandled_timer_read:0x" << std::hex << offset);
+        throw std::exception();
+    }
+
+    auto& timer = this->timers[index];
+    this->sync(index);
+
+    switch (offset & 0xf)
+    {
+        case 0:
+            return timer.value;
+        case 4:
+        {
+            uint32_t mode = 0;
+            mode |= ((uint32_t)timer.sync_enable) << 0;
+            mode |= ((uint32_t)timer.sync_mode) << 1;
+            mode |= ((uint32_t)timer.reset_at_target) << 3;
+            mode |= ((uint32_t)timer.irq_at_target) << 4;
+            mode |= ((uint32_t)timer.irq_at_max) << 5;
+            mode |= ((uint32_t)timer.irq_repeat) << 6;
+            mode |= ((uint32_t)timer.irq_toggle) << 7;
+            mode |= ((uint32_t)timer.clock_source) << 8;
+            mode |= ((uint32_t)timer.irq_flag) << 10;
+            mode |= ((uint32_t)timer.reached_target) << 11;
+            mode |= ((uint32_t)timer.reached_max) << 12;
+            // reached flags are reset after reading
+            timer.reached_target = false;
+            timer.reached_max = false;
+            return mode;
+        }
+        case 8:
+            return timer.target;
+        default:
+            DEBUG("Unhandled_timer_read:0x" << std::hex << offset);
+            throw std::exception();
+    }
+}
+
+void Timers::store(const uint32_t& offset, const uint32_t& value)
+{
+    uint32_t index = offset >> 4;
+    if (index > 2)
+    {
+        DEBUG("Unhandled_timer_write:0x" << std::hex << offset);
+        throw std::exception();
+    }
+
+    auto& timer = this->timers[index];
+    this->sync(index);
+
+    switch (offset & 0xf)
+    {
+        case 0:
+            timer.value = (uint16_t)value;
+            break;
+        case 4:
+            timer.sync_enable     = (value & 1) != 0;
+            timer.sync_mode       = (uint8_t)((value >> 1) & 3);
+            timer.reset_at_target = ((value >> 3) & 1) != 0;
+            timer.irq_at_target   = ((value >> 4) & 1) != 0;
+            timer.irq_at_max      = ((value >> 5) & 1) != 0;
+            timer.irq_repeat      = ((value >> 6) & 1) != 0;
+            timer.irq_toggle      = ((value >> 7) & 1) != 0;
+            timer.clock_source    = (uint8_t)((value >> 8) & 3);
+            // writing the mode resets the counter and the interrupt state
+            timer.irq_flag = true;
+            timer.irq_fired = false;
+            timer.value = 0;
+            if (timer.sync_enable && index != 2)
+            {
+                DEBUG("STUB:timer_" << std::dec << index << "_blank_synchronization_mode_" << (uint32_t)timer.sync_mode << "_runs_freely");
+            }
+            break;
+        case 8:
+            timer.target = (uint16_t)value;
+            break;
+        default:
+            DEBUG("Unhandled_timer_write:0x" << std::hex << offset);
+            throw std::exception();
+    }
+
+    this->schedule_irq(index);
+}
+
+void Timers::serialize(Savestate& state)
+{
+    // pending interrupts are restored with the scheduler deadlines
+    state.section("TMR ");
+    state.value(this->timers);
+}
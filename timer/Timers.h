@@ -0,0 +1,71 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#pragma once
+
+#include <stdint.h>
+#include "../bus/Scheduler.h"
+#include "../bus/Irq.h"
+#include "../gpu/Gpu.h"
+
+class Savestate;
+
+// clock sources of the root counters
+enum TimerClock {
+    SysClock, // CPU clock
+    SysClockDiv8, // CPU clock / 8, timer 2 only
+    DotClock, // GPU dot clock, timer 0 only
+    HBlank // once per scanline, timer 1 only
+};
+
+// a single root counter. The counter is not ticked, its value is computed from the
+// global cycle count when needed, relative to the last point it was known (base)
+struct Timer {
+    uint16_t value;  // counter value at base_cycle
+    uint64_t base_cycle;
+    uint16_t target;
+    // mode register, unpacked
+    bool sync_enable;
+    uint8_t sync_mode;
+    bool reset_at_target; // otherwise wraps after 0xffff
+    bool irq_at_target;
+    bool irq_at_max;
+    bool irq_repeat; // otherwise one-shot
+    bool irq_toggle; // otherwise pulse
+    uint8_t clock_source;
+    bool irq_flag; // bit 10, 1 = no interrupt
+    bool reached_target;
+    bool reached_max;
+    bool irq_fired; // one-shot interrupt already happened
+};
+
+// The three root counters at 0x1f801100
+// http://problemkaputt.de/psx-spx.htm#timers
+class Timers
+{
+public:
+    Timers(Scheduler* scheduler, InterruptController* irq, Gpu* gpu);
+    ~Timers() {};
+
+    uint32_t load(const uint32_t& offset);
+    void store(const uint32_t& offset, const uint32_t& value);
+    void serialize(Savestate& state);
+
+    Timer timers[3] = {};
+
+private:
+    Scheduler* scheduler;
+    InterruptController* irq;
+    Gpu* gpu;
+
+    TimerClock clock(const uint32_t& index) const;
+    void tick_rate(const uint32_t& index, uint64_t& num, uint64_t& den) const;
+    bool stopped(const uint32_t& index) const;
+    uint64_t ticks_between(const uint32_t& index, const uint64_t& from, const uint64_t& to) const;
+    void sync(const uint32_t& index);
+    void advance(Timer& timer, uint64_t ticks);
+    void schedule_irq(const uint32_t& index);
+    void on_event(const uint32_t& index);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xedb88320), as used by zip and by the
+// checksums published for BIOS and disc dumps
+
+constexpr std::array<uint32_t, 256> crc32_make_table()
+{
+    std::array<uint32_t, 256> table = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC32_TABLE = crc32_make_table();
+
+// 'crc' continues a previous checksum, so data can be fed in pieces
+inline uint32_t crc32_checksum(const void* data, const size_t& len, uint32_t crc = 0)
+{
+    auto p = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = CRC32_TABLE[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif
@@ -14,7 +14,8 @@ inline std::string current_time()
     time_t now = time(NULL);
     std::string buf;
     buf.resize(40);
-    struct tm tstruct = *localtime(&now);
+    struct tm tstruct = {};
+    localtime_r(&now, &tstruct); // machines may log from several threads
     strftime((char*)buf.data(), sizeof(buf), "%X", &tstruct);
     return buf;
 }